@@ -0,0 +1,636 @@
+#include "BoundingVolumeHierarchy.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Buckets the object centers are sorted into when looking
+// for the cheapest split
+#define BVH_SAH_BINS 12
+
+// How far leaf boxes are fattened, as a fraction of their
+// largest side, so objects can move a little for free
+#define BVH_FAT_MARGIN 0.1f
+
+// Half the surface area of a box (the halving doesn't change
+// which of two costs is lower)
+static float SurfaceArea(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	float x = boxMax.x - boxMin.x;
+	float y = boxMax.y - boxMin.y;
+	float z = boxMax.z - boxMin.z;
+	return x * y + y * z + z * x;
+}
+
+static void Union(const XMFLOAT3& aMin, const XMFLOAT3& aMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax,
+	XMFLOAT3* outMin, XMFLOAT3* outMax)
+{
+	outMin->x = aMin.x < bMin.x ? aMin.x : bMin.x;
+	outMin->y = aMin.y < bMin.y ? aMin.y : bMin.y;
+	outMin->z = aMin.z < bMin.z ? aMin.z : bMin.z;
+	outMax->x = aMax.x > bMax.x ? aMax.x : bMax.x;
+	outMax->y = aMax.y > bMax.y ? aMax.y : bMax.y;
+	outMax->z = aMax.z > bMax.z ? aMax.z : bMax.z;
+}
+
+static bool Contains(const XMFLOAT3& outerMin, const XMFLOAT3& outerMax, const XMFLOAT3& innerMin, const XMFLOAT3& innerMax)
+{
+	return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+		outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+}
+
+static bool Overlaps(const XMFLOAT3& aMin, const XMFLOAT3& aMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax)
+{
+	return aMin.x <= bMax.x && aMin.y <= bMax.y && aMin.z <= bMax.z &&
+		bMin.x <= aMax.x && bMin.y <= aMax.y && bMin.z <= aMax.z;
+}
+
+static void Fatten(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, XMFLOAT3* fatMin, XMFLOAT3* fatMax)
+{
+	float largest = boxMax.x - boxMin.x;
+	if (boxMax.y - boxMin.y > largest) largest = boxMax.y - boxMin.y;
+	if (boxMax.z - boxMin.z > largest) largest = boxMax.z - boxMin.z;
+	float margin = largest * BVH_FAT_MARGIN;
+
+	*fatMin = XMFLOAT3(boxMin.x - margin, boxMin.y - margin, boxMin.z - margin);
+	*fatMax = XMFLOAT3(boxMax.x + margin, boxMax.y + margin, boxMax.z + margin);
+}
+
+// --------------------------------------------------------
+// Tests a box against the planes still set in planeMask.
+// Returns false if it's entirely behind one of them, and
+// clears the planes it's entirely in front of
+// --------------------------------------------------------
+static bool BoxInPlanes(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, const XMFLOAT4 planes[6], unsigned int* planeMask)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		if (!(*planeMask & (1 << p)))
+			continue;
+
+		// The corners furthest along and against the plane's normal
+		const XMFLOAT4& plane = planes[p];
+		float nearX = plane.x >= 0.0f ? boxMax.x : boxMin.x;
+		float nearY = plane.y >= 0.0f ? boxMax.y : boxMin.y;
+		float nearZ = plane.z >= 0.0f ? boxMax.z : boxMin.z;
+		if (plane.x * nearX + plane.y * nearY + plane.z * nearZ + plane.w < 0.0f)
+			return false;
+
+		float farX = plane.x >= 0.0f ? boxMin.x : boxMax.x;
+		float farY = plane.y >= 0.0f ? boxMin.y : boxMax.y;
+		float farZ = plane.z >= 0.0f ? boxMin.z : boxMax.z;
+		if (plane.x * farX + plane.y * farY + plane.z * farZ + plane.w >= 0.0f)
+			*planeMask &= ~(1 << p);
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Slab test - where a ray enters a box, if it does before
+// maxDistance.  inverseDirection is 1 / direction per axis
+// --------------------------------------------------------
+static bool RayHitsBox(const XMFLOAT3& origin, const XMFLOAT3& inverseDirection,
+	const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, float maxDistance, float* entry)
+{
+	const float* o = &origin.x;
+	const float* inv = &inverseDirection.x;
+	const float* lo = &boxMin.x;
+	const float* hi = &boxMax.x;
+
+	float tNear = 0.0f;
+	float tFar = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float t1 = (lo[axis] - o[axis]) * inv[axis];
+		float t2 = (hi[axis] - o[axis]) * inv[axis];
+		if (t1 > t2) { float t = t1; t1 = t2; t2 = t; }
+		if (t1 > tNear) tNear = t1;
+		if (t2 < tFar) tFar = t2;
+		if (tNear > tFar)
+			return false;
+	}
+	*entry = tNear;
+	return true;
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+	root = BVH_NONE;
+	objectCount = 0;
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+}
+
+unsigned int BoundingVolumeHierarchy::GetObjectCount()
+{
+	return objectCount;
+}
+
+// --------------------------------------------------------
+// What the build sorts - an object with its leaf box (already
+// fattened).  Kept together, so splitting a range only ever
+// reads it front to back
+// --------------------------------------------------------
+struct BoundingVolumeHierarchy::BuildItem
+{
+	XMFLOAT3 Center;
+	unsigned int Object;
+	XMFLOAT3 Min;
+	XMFLOAT3 Max;
+};
+
+// --------------------------------------------------------
+// Top down build.  Each range of objects is split where the
+// two halves' areas (weighted by how many objects each
+// holds) add up to the least, which keeps queries from
+// wandering into big, mostly empty boxes
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::Build(const XMFLOAT3* boxMins, const XMFLOAT3* boxMaxs, unsigned int count)
+{
+	nodes.clear();
+	freeNodes.clear();
+	refitLeaves.clear();
+	objectLeaves.assign(count, BVH_NONE);
+	objectMins.assign(boxMins, boxMins + count);
+	objectMaxs.assign(boxMaxs, boxMaxs + count);
+	objectCount = count;
+	root = BVH_NONE;
+	if (count == 0)
+		return;
+
+	std::vector<BuildItem> items(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		items[i].Center = XMFLOAT3(
+			(boxMins[i].x + boxMaxs[i].x) * 0.5f,
+			(boxMins[i].y + boxMaxs[i].y) * 0.5f,
+			(boxMins[i].z + boxMaxs[i].z) * 0.5f);
+		items[i].Object = i;
+		Fatten(boxMins[i], boxMaxs[i], &items[i].Min, &items[i].Max);
+	}
+
+	// A binary tree with one object per leaf has 2n - 1 nodes
+	nodes.reserve(count * 2 - 1);
+	root = BuildRange(&items[0], count);
+}
+
+// --------------------------------------------------------
+// Builds a tree over items[0, count) and returns its root.
+// Uses its own stack rather than recursing, since a lopsided
+// scene can make the tree deep
+// --------------------------------------------------------
+unsigned int BoundingVolumeHierarchy::BuildRange(BuildItem* items, unsigned int count)
+{
+	struct BuildTask
+	{
+		unsigned int First;
+		unsigned int Count;
+		unsigned int Parent;
+		unsigned int Side;
+	};
+	std::vector<BuildTask> tasks;
+	BuildTask first = { 0, count, BVH_NONE, 0 };
+	tasks.push_back(first);
+	unsigned int subtreeRoot = BVH_NONE;
+
+	while (!tasks.empty())
+	{
+		BuildTask task = tasks.back();
+		tasks.pop_back();
+		BuildItem* range = items + task.First;
+
+		unsigned int node = AllocateNode();
+		nodes[node].Parent = task.Parent;
+		if (task.Parent == BVH_NONE)
+			subtreeRoot = node;
+		else
+			nodes[task.Parent].Children[task.Side] = node;
+
+		if (task.Count == 1)
+		{
+			unsigned int object = range[0].Object;
+			nodes[node].Min = range[0].Min;
+			nodes[node].Max = range[0].Max;
+			nodes[node].Object = object;
+			objectLeaves[object] = node;
+			continue;
+		}
+
+		// Bounds of the boxes and of their centers
+		XMFLOAT3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX), boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		XMFLOAT3 centerMin = boxMin, centerMax = boxMax;
+		for (unsigned int i = 0; i < task.Count; i++)
+		{
+			Union(boxMin, boxMax, range[i].Min, range[i].Max, &boxMin, &boxMax);
+			Union(centerMin, centerMax, range[i].Center, range[i].Center, &centerMin, &centerMax);
+		}
+		nodes[node].Min = boxMin;
+		nodes[node].Max = boxMax;
+
+		// Split along the longest axis of the centers
+		int axis = 0;
+		float extent = centerMax.x - centerMin.x;
+		if (centerMax.y - centerMin.y > extent) { axis = 1; extent = centerMax.y - centerMin.y; }
+		if (centerMax.z - centerMin.z > extent) { axis = 2; extent = centerMax.z - centerMin.z; }
+		float axisMin = (&centerMin.x)[axis];
+
+		unsigned int leftCount = task.Count / 2;
+		if (extent > 0.0f)
+		{
+			// Bin the objects, then sweep both ways to find each split's cost
+			unsigned int binCounts[BVH_SAH_BINS] = {};
+			XMFLOAT3 binMins[BVH_SAH_BINS], binMaxs[BVH_SAH_BINS];
+			for (int b = 0; b < BVH_SAH_BINS; b++)
+			{
+				binMins[b] = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+				binMaxs[b] = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			}
+
+			float binScale = BVH_SAH_BINS / extent;
+			for (unsigned int i = 0; i < task.Count; i++)
+			{
+				int b = (int)(((&range[i].Center.x)[axis] - axisMin) * binScale);
+				if (b > BVH_SAH_BINS - 1) b = BVH_SAH_BINS - 1;
+				binCounts[b]++;
+				Union(binMins[b], binMaxs[b], range[i].Min, range[i].Max, &binMins[b], &binMaxs[b]);
+			}
+
+			float rightCosts[BVH_SAH_BINS];
+			XMFLOAT3 sweepMin(FLT_MAX, FLT_MAX, FLT_MAX), sweepMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			unsigned int sweepCount = 0;
+			for (int b = BVH_SAH_BINS - 1; b > 0; b--)
+			{
+				Union(sweepMin, sweepMax, binMins[b], binMaxs[b], &sweepMin, &sweepMax);
+				sweepCount += binCounts[b];
+				rightCosts[b] = sweepCount ? SurfaceArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+			}
+
+			// Split before bin bestSplit.  The first and last bins are never
+			// empty, so every split leaves something on both sides
+			int bestSplit = 1;
+			float bestCost = FLT_MAX;
+			sweepMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			sweepMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			sweepCount = 0;
+			for (int b = 1; b < BVH_SAH_BINS; b++)
+			{
+				Union(sweepMin, sweepMax, binMins[b - 1], binMaxs[b - 1], &sweepMin, &sweepMax);
+				sweepCount += binCounts[b - 1];
+				float cost = (sweepCount ? SurfaceArea(sweepMin, sweepMax) * sweepCount : 0.0f) + rightCosts[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = b;
+				}
+			}
+
+			BuildItem* middle = std::partition(range, range + task.Count, [&](const BuildItem& item)
+			{
+				int b = (int)(((&item.Center.x)[axis] - axisMin) * binScale);
+				return b < bestSplit;
+			});
+			leftCount = (unsigned int)(middle - range);
+		}
+
+		// Identical centers (or a split that rounding emptied) just halve
+		if (leftCount == 0 || leftCount == task.Count)
+			leftCount = task.Count / 2;
+
+		BuildTask left = { task.First, leftCount, node, 0 };
+		BuildTask right = { task.First + leftCount, task.Count - leftCount, node, 1 };
+		tasks.push_back(right);
+		tasks.push_back(left);
+	}
+	return subtreeRoot;
+}
+
+void BoundingVolumeHierarchy::Insert(unsigned int object, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	if (object < objectLeaves.size() && objectLeaves[object] != BVH_NONE)
+	{
+		SetBounds(object, boxMin, boxMax);
+		return;
+	}
+
+	SetObjectBox(object, boxMin, boxMax);
+	unsigned int leaf = AllocateNode();
+	Fatten(boxMin, boxMax, &nodes[leaf].Min, &nodes[leaf].Max);
+	nodes[leaf].Object = object;
+	objectLeaves[object] = leaf;
+	objectCount++;
+	InsertLeaf(leaf);
+}
+
+void BoundingVolumeHierarchy::Remove(unsigned int object)
+{
+	if (object >= objectLeaves.size() || objectLeaves[object] == BVH_NONE)
+		return;
+
+	unsigned int leaf = objectLeaves[object];
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	objectLeaves[object] = BVH_NONE;
+	objectCount--;
+}
+
+// --------------------------------------------------------
+// Leaves the tree alone while the object stays inside its
+// fattened box.  Otherwise a fast mover (clear of its old
+// box) is reinserted, and anything else is refit.  Objects
+// that aren't in the tree are ignored, like in Remove()
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::SetBounds(unsigned int object, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	if (object >= objectLeaves.size() || objectLeaves[object] == BVH_NONE)
+		return;
+
+	SetObjectBox(object, boxMin, boxMax);
+	unsigned int leaf = objectLeaves[object];
+	if (Contains(nodes[leaf].Min, nodes[leaf].Max, boxMin, boxMax))
+		return;
+
+	bool fastMover = !Overlaps(nodes[leaf].Min, nodes[leaf].Max, boxMin, boxMax);
+	if (fastMover)
+		RemoveLeaf(leaf);
+
+	Fatten(boxMin, boxMax, &nodes[leaf].Min, &nodes[leaf].Max);
+	if (fastMover)
+		InsertLeaf(leaf);
+	else
+		refitLeaves.push_back(leaf);
+}
+
+void BoundingVolumeHierarchy::Refit()
+{
+	for (size_t i = 0; i < refitLeaves.size(); i++)
+		RefitUpwards(nodes[refitLeaves[i]].Parent);
+	refitLeaves.clear();
+}
+
+// --------------------------------------------------------
+// Frustum culling - subtrees behind a plane are skipped, and
+// planes a box is entirely in front of aren't tested again
+// below it, so subtrees fully inside are taken without tests
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::CullFrustum(const XMFLOAT4 planes[6], std::vector<unsigned int>& visible)
+{
+	Refit();
+	visible.clear();
+	if (root == BVH_NONE)
+		return;
+
+	// Pairs of (node, planes left to test)
+	std::vector<unsigned int> stack;
+	stack.push_back(root);
+	stack.push_back(0x3F);
+	while (!stack.empty())
+	{
+		unsigned int planeMask = stack.back(); stack.pop_back();
+		unsigned int node = stack.back(); stack.pop_back();
+		const BvhNode& n = nodes[node];
+
+		if (planeMask && !BoxInPlanes(n.Min, n.Max, planes, &planeMask))
+			continue;
+
+		if (n.Object != BVH_NONE)
+		{
+			// Leaf boxes are fattened - the exact box decides
+			if (planeMask && !BoxInPlanes(objectMins[n.Object], objectMaxs[n.Object], planes, &planeMask))
+				continue;
+			visible.push_back(n.Object);
+			continue;
+		}
+
+		stack.push_back(n.Children[0]);
+		stack.push_back(planeMask);
+		stack.push_back(n.Children[1]);
+		stack.push_back(planeMask);
+	}
+}
+
+// --------------------------------------------------------
+// Picks the closest box along a ray.  Nearer children are
+// visited first, and anything entered past the best hit so
+// far is skipped
+//
+// distance - Along the (normalized) direction
+// --------------------------------------------------------
+bool BoundingVolumeHierarchy::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance,
+	unsigned int* object, float* distance)
+{
+	Refit();
+	if (root == BVH_NONE)
+		return false;
+
+	XMFLOAT3 dir;
+	XMStoreFloat3(&dir, XMVector3Normalize(XMLoadFloat3(&direction)));
+	XMFLOAT3 inverseDirection(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+	unsigned int hit = BVH_NONE;
+	float best = maxDistance;
+	std::vector<unsigned int> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned int node = stack.back(); stack.pop_back();
+		const BvhNode& n = nodes[node];
+		float entry;
+		if (!RayHitsBox(origin, inverseDirection, n.Min, n.Max, best, &entry))
+			continue;
+
+		if (n.Object != BVH_NONE)
+		{
+			if (RayHitsBox(origin, inverseDirection, objectMins[n.Object], objectMaxs[n.Object], best, &entry))
+			{
+				best = entry;
+				hit = n.Object;
+			}
+			continue;
+		}
+
+		// Push the farther child first, so the nearer is popped next
+		float entry0 = FLT_MAX, entry1 = FLT_MAX;
+		const BvhNode& c0 = nodes[n.Children[0]];
+		const BvhNode& c1 = nodes[n.Children[1]];
+		bool hit0 = RayHitsBox(origin, inverseDirection, c0.Min, c0.Max, best, &entry0);
+		bool hit1 = RayHitsBox(origin, inverseDirection, c1.Min, c1.Max, best, &entry1);
+		if (entry0 <= entry1)
+		{
+			if (hit1) stack.push_back(n.Children[1]);
+			if (hit0) stack.push_back(n.Children[0]);
+		}
+		else
+		{
+			if (hit0) stack.push_back(n.Children[0]);
+			if (hit1) stack.push_back(n.Children[1]);
+		}
+	}
+
+	if (hit == BVH_NONE)
+		return false;
+	*object = hit;
+	*distance = best;
+	return true;
+}
+
+unsigned int BoundingVolumeHierarchy::AllocateNode()
+{
+	unsigned int node;
+	if (!freeNodes.empty())
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		node = (unsigned int)nodes.size();
+		nodes.push_back(BvhNode());
+	}
+
+	nodes[node].Parent = BVH_NONE;
+	nodes[node].Object = BVH_NONE;
+	nodes[node].Children[0] = BVH_NONE;
+	nodes[node].Children[1] = BVH_NONE;
+	return node;
+}
+
+void BoundingVolumeHierarchy::FreeNode(unsigned int node)
+{
+	// Cleared, so a pending refit from a freed leaf does nothing
+	nodes[node].Parent = BVH_NONE;
+	nodes[node].Object = BVH_NONE;
+	freeNodes.push_back(node);
+}
+
+void BoundingVolumeHierarchy::SetObjectBox(unsigned int object, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	if (object >= objectLeaves.size())
+	{
+		objectLeaves.resize(object + 1, BVH_NONE);
+		objectMins.resize(object + 1);
+		objectMaxs.resize(object + 1);
+	}
+	objectMins[object] = boxMin;
+	objectMaxs[object] = boxMax;
+}
+
+// --------------------------------------------------------
+// Walks down to the sibling that adds the least area - the
+// area of the new parent, plus how much every box on the way
+// down had to grow - then pairs the leaf with it
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::InsertLeaf(unsigned int leaf)
+{
+	if (root == BVH_NONE)
+	{
+		root = leaf;
+		nodes[leaf].Parent = BVH_NONE;
+		return;
+	}
+
+	XMFLOAT3 leafMin = nodes[leaf].Min;
+	XMFLOAT3 leafMax = nodes[leaf].Max;
+	unsigned int sibling = root;
+	while (nodes[sibling].Object == BVH_NONE)
+	{
+		const BvhNode& n = nodes[sibling];
+		XMFLOAT3 unionMin, unionMax;
+		Union(n.Min, n.Max, leafMin, leafMax, &unionMin, &unionMax);
+		float area = SurfaceArea(n.Min, n.Max);
+		float unionArea = SurfaceArea(unionMin, unionMax);
+
+		// Pairing with this node makes a parent of unionArea.  Going
+		// further down grows this node by the difference either way
+		float pairCost = 2.0f * unionArea;
+		float inheritedCost = 2.0f * (unionArea - area);
+
+		float childCosts[2];
+		for (int c = 0; c < 2; c++)
+		{
+			const BvhNode& child = nodes[n.Children[c]];
+			Union(child.Min, child.Max, leafMin, leafMax, &unionMin, &unionMax);
+			childCosts[c] = SurfaceArea(unionMin, unionMax) + inheritedCost;
+			if (child.Object == BVH_NONE)
+				childCosts[c] -= SurfaceArea(child.Min, child.Max);
+		}
+
+		if (pairCost < childCosts[0] && pairCost < childCosts[1])
+			break;
+		sibling = childCosts[0] <= childCosts[1] ? n.Children[0] : n.Children[1];
+	}
+
+	unsigned int oldParent = nodes[sibling].Parent;
+	unsigned int newParent = AllocateNode();
+	nodes[newParent].Parent = oldParent;
+	nodes[newParent].Children[0] = sibling;
+	nodes[newParent].Children[1] = leaf;
+	Union(nodes[sibling].Min, nodes[sibling].Max, leafMin, leafMax, &nodes[newParent].Min, &nodes[newParent].Max);
+	nodes[sibling].Parent = newParent;
+	nodes[leaf].Parent = newParent;
+
+	if (oldParent == BVH_NONE)
+		root = newParent;
+	else
+	{
+		int side = nodes[oldParent].Children[0] == sibling ? 0 : 1;
+		nodes[oldParent].Children[side] = newParent;
+		RefitUpwards(oldParent);
+	}
+}
+
+// --------------------------------------------------------
+// Unhooks a leaf (which stays allocated).  Its parent goes
+// too, with the leaf's sibling taking the parent's place
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::RemoveLeaf(unsigned int leaf)
+{
+	if (leaf == root)
+	{
+		root = BVH_NONE;
+		return;
+	}
+
+	unsigned int parent = nodes[leaf].Parent;
+	unsigned int grandparent = nodes[parent].Parent;
+	unsigned int sibling = nodes[parent].Children[0] == leaf ? nodes[parent].Children[1] : nodes[parent].Children[0];
+
+	nodes[sibling].Parent = grandparent;
+	if (grandparent == BVH_NONE)
+		root = sibling;
+	else
+	{
+		int side = nodes[grandparent].Children[0] == parent ? 0 : 1;
+		nodes[grandparent].Children[side] = sibling;
+	}
+	nodes[leaf].Parent = BVH_NONE;
+	FreeNode(parent);
+
+	if (grandparent != BVH_NONE)
+		RefitUpwards(grandparent);
+}
+
+// --------------------------------------------------------
+// Recomputes boxes from their children going up, stopping
+// at the first that doesn't change (nothing above it needs to)
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::RefitUpwards(unsigned int node)
+{
+	while (node != BVH_NONE)
+	{
+		BvhNode& n = nodes[node];
+		const BvhNode& c0 = nodes[n.Children[0]];
+		const BvhNode& c1 = nodes[n.Children[1]];
+		XMFLOAT3 boxMin, boxMax;
+		Union(c0.Min, c0.Max, c1.Min, c1.Max, &boxMin, &boxMax);
+		if (boxMin.x == n.Min.x && boxMin.y == n.Min.y && boxMin.z == n.Min.z &&
+			boxMax.x == n.Max.x && boxMax.y == n.Max.y && boxMax.z == n.Max.z)
+			break;
+
+		n.Min = boxMin;
+		n.Max = boxMax;
+		node = n.Parent;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// No node / no object
+#define BVH_NONE 0xFFFFFFFF
+
+// --------------------------------------------------------
+// One box of the tree.  Leaves hold exactly one object
+// --------------------------------------------------------
+struct BvhNode
+{
+	DirectX::XMFLOAT3 Min;
+	unsigned int Parent;		// BVH_NONE for the root
+	DirectX::XMFLOAT3 Max;
+	unsigned int Object;		// BVH_NONE for inner nodes
+	unsigned int Children[2];	// BVH_NONE for leaves
+};
+
+// --------------------------------------------------------
+// A dynamic bounding volume hierarchy over the world space
+// boxes of many objects (identified by small integers), for
+// frustum culling and ray picking in less than linear time
+//
+// Build() makes a tree from scratch with the surface area
+// heuristic (binned along the longest axis of the centers).
+// Objects can then move without rebuilding:
+//  - Leaves hold a slightly fattened box, so small moves
+//    inside it cost nothing
+//  - Moves out of it refit - the leaf takes the new box and
+//    its ancestors are regrown at the next query
+//  - Fast movers (landing clear of their old box) are
+//    taken out and reinserted where they add the least area,
+//    so they don't stretch the boxes they used to be in
+// --------------------------------------------------------
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy();
+	~BoundingVolumeHierarchy();
+
+	// Replaces everything with objects [0, count)
+	void Build(const DirectX::XMFLOAT3* boxMins, const DirectX::XMFLOAT3* boxMaxs, unsigned int count);
+
+	void Insert(unsigned int object, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax);
+	void Remove(unsigned int object);
+	// The object's box changed (moved, rotated, scaled).  Does
+	// nothing for objects that aren't in the tree
+	void SetBounds(unsigned int object, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax);
+	// Regrows the boxes above leaves that changed.  Queries do this first
+	void Refit();
+
+	unsigned int GetObjectCount();
+
+	// Objects whose boxes reach into the frustum (see
+	// MeshletCuller::ExtractFrustumPlanes), in no particular order
+	void CullFrustum(const DirectX::XMFLOAT4 planes[6], std::vector<unsigned int>& visible);
+	// The object whose box the ray enters first, within maxDistance.
+	// Returns false (and leaves the outputs alone) if there isn't one
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance,
+		unsigned int* object, float* distance);
+
+private:
+	std::vector<BvhNode> nodes;
+	std::vector<unsigned int> freeNodes;
+	unsigned int root;
+
+	// By object.  Leaves hold fattened boxes, queries test these exact ones
+	std::vector<unsigned int> objectLeaves;
+	std::vector<DirectX::XMFLOAT3> objectMins;
+	std::vector<DirectX::XMFLOAT3> objectMaxs;
+	unsigned int objectCount;
+
+	std::vector<unsigned int> refitLeaves;	// Leaves whose boxes changed
+
+	unsigned int AllocateNode();
+	void FreeNode(unsigned int node);
+	void SetObjectBox(unsigned int object, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax);
+	struct BuildItem;
+	unsigned int BuildRange(BuildItem* items, unsigned int count);
+	void InsertLeaf(unsigned int leaf);
+	void RemoveLeaf(unsigned int leaf);
+	void RefitUpwards(unsigned int node);
+};
@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include "Meshlet.h"
 
 Camera::Camera(unsigned int width, unsigned int height) {
 	cameraDirection = XMVectorSet(0, 0, 1, 0);
@@ -94,3 +95,28 @@ void Camera::UpdateProjectionMatrix(unsigned int width, unsigned int height) {
 		100.0f);			  	// Far clip plane distance
 	XMStoreFloat4x4(&projectionMatrix, XMMatrixTranspose(P)); // Transpose for HLSL!
 }
+
+// Planes of the current view and projection, for culling
+void Camera::GetFrustumPlanes(XMFLOAT4 planes[6]) {
+	// Both matrices are stored transposed for HLSL
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&viewMatrix));
+	XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&projectionMatrix));
+	MeshletCuller::ExtractFrustumPlanes(view * projection, planes);
+}
+
+// Unprojects the pixel onto the near and far planes, and
+// aims from one to the other
+void Camera::GetPickRay(int x, int y, unsigned int width, unsigned int height, XMFLOAT3* origin, XMFLOAT3* direction) {
+	float ndcX = 2.0f * (x + 0.5f) / width - 1.0f;
+	float ndcY = 1.0f - 2.0f * (y + 0.5f) / height;
+
+	// Both matrices are stored transposed for HLSL
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&viewMatrix));
+	XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&projectionMatrix));
+	XMMATRIX inverseViewProj = XMMatrixInverse(0, view * projection);
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), inverseViewProj);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), inverseViewProj);
+
+	XMStoreFloat3(origin, nearPoint);
+	XMStoreFloat3(direction, XMVector3Normalize(farPoint - nearPoint));
+}
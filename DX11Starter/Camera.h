@@ -11,6 +11,9 @@ public:
 	XMFLOAT4X4 GetViewMatrix();
 	XMFLOAT4X4 GetProjectionMatrix();
 	XMFLOAT3 GetCameraPosition();
+	void GetFrustumPlanes(XMFLOAT4 planes[6]);	// World space, facing inwards
+	// World space ray through a pixel of a width x height screen
+	void GetPickRay(int x, int y, unsigned int width, unsigned int height, XMFLOAT3* origin, XMFLOAT3* direction);
 	void Update(float deltaTiime);
 	void SetCameraRotation(float rotationX, float rotationY);
 	void UpdateProjectionMatrix(unsigned int width, unsigned int height);
@@ -0,0 +1,71 @@
+// Vertex shader for meshes uploaded as CompactVertex data
+// - Same output as VertexShader.hlsl, so it pairs with PixelShader.hlsl
+// - The quantization ranges come from the mesh (see VertexCompressor)
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix transWorld;
+
+	float3 positionCenter;
+	float3 positionExtent;
+	float2 uvOffset;
+	float2 uvScale;
+};
+
+// Shared with every shader - set once a frame.  Every shader
+// declaring it must lay it out the same, or gets its own
+cbuffer perFrame : register(b1)
+{
+	matrix view;
+	matrix projection;
+	float time;		// Seconds since the game started
+};
+
+// Matches CompactVertex and its input layout
+struct VertexShaderInput
+{
+	float4 position		: POSITION;     // xyz in [-1, 1] of the bounds, w = handedness
+	float2 uv			: TEXCOORD;     // [0, 1] of the mesh's UV range
+	float2 normal		: NORMAL;       // Octahedral
+	float2 tangent		: TANGENT;      // Octahedral
+};
+
+// Same as VertexShader.hlsl
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal       : NORMAL;
+	float3 worldPos		: POSITION;
+	float2 uv           : TEXCOORD;
+	float4 tangent      : TANGENT;
+};
+
+// Undoes the octahedral encoding of a unit vector
+float3 DecodeOctahedral(float2 e)
+{
+	float3 v = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	if (v.z < 0)
+		v.xy = (1.0f - abs(v.yx)) * (v.xy >= 0 ? 1.0f : -1.0f);
+	return normalize(v);
+}
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	// Back to object space
+	float3 position = positionCenter + input.position.xyz * positionExtent;
+	float3 normal = DecodeOctahedral(input.normal);
+	float3 tangent = DecodeOctahedral(input.tangent);
+
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(position, 1.0f), worldViewProj);
+	output.worldPos = mul(float4(position, 1.0f), world).xyz;
+
+	output.normal = normalize(mul(normal, (float3x3)transWorld));
+	output.tangent.xyz = normalize(mul(tangent, (float3x3)transWorld));
+	output.tangent.w = input.position.w;
+	output.uv = uvOffset + input.uv * uvScale;
+
+	return output;
+}
@@ -0,0 +1,141 @@
+#include "ConstantBufferRing.h"
+#include <string.h>
+
+ConstantBufferRing::ConstantBufferRing(ID3D11Device* device, ID3D11DeviceContext* context, unsigned int capacity)
+	: allocator(capacity, CONSTANT_RING_ALIGNMENT, CONSTANT_RING_FRAMES)
+{
+	this->context = context;
+	context1 = 0;
+	buffer = 0;
+	for (unsigned int i = 0; i < CONSTANT_RING_FRAMES; i++)
+		frameQueries[i] = 0;
+	firstQuery = 0;
+	discardNext = true;
+	epoch = 0;
+	discardCount = 0;
+
+	// Offsets need the 11.1 runtime and driver support, and the
+	// NO_OVERWRITE maps need the driver to allow them too
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+		!options.ConstantBufferOffsetting ||
+		!options.MapNoOverwriteOnDynamicConstantBuffer)
+		return;
+	if (FAILED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1)))
+	{
+		context1 = 0;
+		return;
+	}
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = allocator.GetCapacity();
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(device->CreateBuffer(&desc, 0, &buffer)))
+	{
+		buffer = 0;
+		return;
+	}
+
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (unsigned int i = 0; i < CONSTANT_RING_FRAMES; i++)
+	{
+		if (FAILED(device->CreateQuery(&queryDesc, &frameQueries[i])))
+		{
+			// Can't fence, so can't be used
+			frameQueries[i] = 0;
+			buffer->Release();
+			buffer = 0;
+			return;
+		}
+	}
+}
+
+ConstantBufferRing::~ConstantBufferRing()
+{
+	for (unsigned int i = 0; i < CONSTANT_RING_FRAMES; i++)
+		if (frameQueries[i]) { frameQueries[i]->Release(); }
+	if (buffer) { buffer->Release(); }
+	if (context1) { context1->Release(); }
+}
+
+bool ConstantBufferRing::Write(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* constantCount)
+{
+	if (!buffer)
+		return false;
+
+	unsigned int offset;
+	if (!allocator.Allocate(size, &offset))
+	{
+		// Out of room - free what the GPU's done with, or failing
+		// that, let the driver rename the buffer
+		RetireFinishedFrames();
+		if (!allocator.Allocate(size, &offset))
+		{
+			Discard();
+			if (!allocator.Allocate(size, &offset))
+				return false;
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	D3D11_MAP mapType = discardNext ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (FAILED(context->Map(buffer, 0, mapType, 0, &mapped)))
+		return false;
+	memcpy((unsigned char*)mapped.pData + offset, data, size);
+	context->Unmap(buffer, 0);
+	discardNext = false;
+
+	*firstConstant = offset / 16;
+	*constantCount = (size + CONSTANT_RING_ALIGNMENT - 1) / CONSTANT_RING_ALIGNMENT * (CONSTANT_RING_ALIGNMENT / 16);
+	return true;
+}
+
+void ConstantBufferRing::EndFrame()
+{
+	if (!buffer)
+		return;
+
+	RetireFinishedFrames();
+	if (allocator.EndFrame())
+	{
+		unsigned int last = (firstQuery + allocator.GetFencedFrameCount() - 1) % CONSTANT_RING_FRAMES;
+		context->End(frameQueries[last]);
+	}
+	else
+	{
+		// The GPU's too far behind to fence another frame
+		Discard();
+	}
+
+	// This frame's ranges aren't safe to bind after it
+	epoch++;
+}
+
+void ConstantBufferRing::RetireFinishedFrames()
+{
+	while (allocator.GetFencedFrameCount() > 0)
+	{
+		// Don't flush - this only asks, it never waits
+		if (context->GetData(frameQueries[firstQuery], 0, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			break;
+
+		allocator.RetireFrame();
+		firstQuery = (firstQuery + 1) % CONSTANT_RING_FRAMES;
+	}
+}
+
+// --------------------------------------------------------
+// Starts the ring over - the next map DISCARDs, so the GPU
+// keeps the old contents for what it's yet to draw
+// --------------------------------------------------------
+void ConstantBufferRing::Discard()
+{
+	allocator.Reset();
+	firstQuery = 0;
+	discardNext = true;
+	epoch++;
+	discardCount++;
+}
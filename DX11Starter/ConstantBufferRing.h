@@ -0,0 +1,71 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include "RingAllocator.h"
+
+// D3D11.1 binds constant buffers from offsets in whole
+// 16 constant (256 byte) steps
+#define CONSTANT_RING_ALIGNMENT 256
+// Frames the GPU can be behind before the ring renames
+// the buffer rather than wait for it
+#define CONSTANT_RING_FRAMES 3
+
+// --------------------------------------------------------
+// One large dynamic constant buffer that small per draw
+// constant data is appended to, rather than each cbuffer
+// having a buffer of its own updated in place (which makes
+// the driver copy or rename it every time)
+//
+// Writes map the buffer with NO_OVERWRITE - the driver can
+// hand over the memory at once, since nothing the GPU may
+// still be reading is touched.  Each frame is fenced with
+// an event query and its space reused once that's passed.
+// If the ring fills up anyway, the next map DISCARDs the
+// whole buffer and starts it over
+//
+// Binding at offsets needs D3D11.1 (ID3D11DeviceContext1
+// and the ConstantBufferOffsetting option).  Without it
+// IsSupported() is false and the ring does nothing - see
+// ISimpleShader::SetConstantBufferRing()
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	ConstantBufferRing(ID3D11Device* device, ID3D11DeviceContext* context, unsigned int capacity);
+	~ConstantBufferRing();
+
+	bool IsSupported() { return buffer != 0; }
+	ID3D11Buffer* GetBuffer() { return buffer; }
+	ID3D11DeviceContext1* GetContext1() { return context1; }
+
+	// Changes whenever earlier writes may be gone (every frame,
+	// and whenever the buffer's discarded), so data written
+	// under an older one has to be written again
+	unsigned int GetEpoch() { return epoch; }
+	unsigned int GetDiscardCount() { return discardCount; }
+
+	// Copies data into the ring.  The range to bind it with,
+	// in 16 byte constants, comes back in the outputs
+	bool Write(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* constantCount);
+
+	// Fences this frame's writes and frees the space of
+	// frames the GPU has finished with.  Once a frame
+	void EndFrame();
+
+private:
+	ID3D11DeviceContext* context;
+	ID3D11DeviceContext1* context1;
+	ID3D11Buffer* buffer;
+	RingAllocator allocator;
+
+	// One per fenced frame, in the allocator's order
+	ID3D11Query* frameQueries[CONSTANT_RING_FRAMES];
+	unsigned int firstQuery;
+
+	bool discardNext;
+	unsigned int epoch;
+	unsigned int discardCount;
+
+	void RetireFinishedFrames();
+	void Discard();
+};
@@ -3,6 +3,7 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <string>
+#include "JobSystem.h"
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
@@ -69,6 +70,10 @@ protected:
 	ID3D11RenderTargetView* backBufferRTV;
 	ID3D11DepthStencilView* depthStencilView;
 
+	// Spreads work across every core - Update() and Draw() run on
+	// the thread that owns it, and can fork jobs onto the rest
+	JobSystem*				jobs;
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
@@ -67,15 +67,26 @@ Emitter::Emitter(
 		indices[indexCount++] = i + 2;
 		indices[indexCount++] = i + 3;
 	}
+
+	// Four vertices per particle - use 16-bit indices if they all fit
+	indexFormat = maxParticles * 4 <= 65536 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	unsigned short* shortIndices = 0;
+	if (indexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		shortIndices = new unsigned short[maxParticles * 6];
+		for (int i = 0; i < maxParticles * 6; i++)
+			shortIndices[i] = (unsigned short)indices[i];
+	}
+
 	D3D11_SUBRESOURCE_DATA indexData = {};
-	indexData.pSysMem = indices;
+	indexData.pSysMem = shortIndices ? (const void*)shortIndices : (const void*)indices;
 
 	// Regular (static) index buffer
 	D3D11_BUFFER_DESC ibDesc = {};
 	ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibDesc.CPUAccessFlags = 0;
 	ibDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibDesc.ByteWidth = sizeof(unsigned int) * maxParticles * 6;
+	ibDesc.ByteWidth = (shortIndices ? sizeof(unsigned short) : sizeof(unsigned int)) * maxParticles * 6;
 	device->CreateBuffer(&ibDesc, &indexData, &indexBuffer);
 
 	// Just make a single buffer to hold copy of all particle data
@@ -96,6 +107,7 @@ Emitter::Emitter(
 	device->CreateShaderResourceView(particleDataBuffer, &srvDesc, &particleDataSRV);
 
 	delete[] indices;
+	delete[] shortIndices;
 }
 
 
@@ -214,7 +226,7 @@ void Emitter::SpawnParticle(float currentTime)
 }
 
 
-void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera, float currentTime)
+void Emitter::Draw(ID3D11DeviceContext* context)
 {
 	// Do a raw copy of the particle data to the dynamic structured buffer
 	D3D11_MAPPED_SUBRESOURCE mapped = {};
@@ -227,11 +239,8 @@ void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera, float currentTi
 	UINT offset = 0;
 	ID3D11Buffer* nullBuffer = 0;
 	context->IASetVertexBuffers(0, 1, &nullBuffer, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-
+	context->IASetIndexBuffer(indexBuffer, indexFormat, 0);
 
-	vs->SetMatrix4x4("view", camera->GetViewMatrix());
-	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
 
 	vs->SetFloat3("acceleration", emitterAcceleration);
 	vs->SetFloat4("startColor", startColor);
@@ -239,7 +248,6 @@ void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera, float currentTi
 	vs->SetFloat("startSize", startSize);
 	vs->SetFloat("endSize", endSize);
 	vs->SetFloat("lifetime", lifetime);
-	vs->SetFloat("currentTime", currentTime);
 
 	vs->SetShader();
 
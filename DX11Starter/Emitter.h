@@ -52,7 +52,9 @@ public:
 	void UpdateSingleParticle(float currentTime, int index);
 	void SpawnParticle(float currentTime);
 
-	void Draw(ID3D11DeviceContext* context, Camera* camera, float currentTime);
+	// The camera and the time come from the shared perFrame buffer,
+	// which must already be set for the frame
+	void Draw(ID3D11DeviceContext* context);
 
 private:
 	// Emission properties
@@ -84,6 +86,7 @@ private:
 
 	// Rendering
 	ID3D11Buffer* indexBuffer;
+	DXGI_FORMAT indexFormat;
 
 	ID3D11Buffer* particleDataBuffer;
 	ID3D11ShaderResourceView* particleDataSRV;
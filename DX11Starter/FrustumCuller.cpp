@@ -0,0 +1,100 @@
+#include "FrustumCuller.h"
+
+using namespace DirectX;
+
+bool FrustumCuller::IsSphereVisible(const XMFLOAT3& center, float radius, const XMFLOAT4 planes[6])
+{
+	XMVECTOR c = XMLoadFloat3(&center);
+	for (int p = 0; p < 6; p++)
+	{
+		if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[p]), c)) < -radius)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Tests the corner of the box furthest along each plane's
+// normal - if even that one is behind the plane, they all are
+// --------------------------------------------------------
+bool FrustumCuller::IsBoxVisible(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, const XMFLOAT4 planes[6])
+{
+	XMVECTOR lo = XMLoadFloat3(&boxMin);
+	XMVECTOR hi = XMLoadFloat3(&boxMax);
+	XMVECTOR zero = XMVectorZero();
+	for (int p = 0; p < 6; p++)
+	{
+		XMVECTOR plane = XMLoadFloat4(&planes[p]);
+		XMVECTOR corner = XMVectorSelect(lo, hi, XMVectorGreaterOrEqual(plane, zero));
+		if (XMVectorGetX(XMPlaneDotCoord(plane, corner)) < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+unsigned int FrustumCuller::CullSpheres(const BoundingSpheres& spheres, const XMFLOAT4 planes[6],
+	unsigned char* visible)
+{
+	return CullSpheres(spheres, 0, (unsigned int)spheres.Radius.size(), planes, visible);
+}
+
+// --------------------------------------------------------
+// Each plane component is splatted across a vector, so one
+// multiply-add chain finds the distances of four spheres
+// to that plane.  A sphere is out once any distance is below
+// its negated radius
+//
+// visible - One byte per sphere, indexed like the spheres
+// --------------------------------------------------------
+unsigned int FrustumCuller::CullSpheres(const BoundingSpheres& spheres, unsigned int first, unsigned int last,
+	const XMFLOAT4 planes[6], unsigned char* visible)
+{
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = XMVectorReplicate(planes[p].x);
+		planeY[p] = XMVectorReplicate(planes[p].y);
+		planeZ[p] = XMVectorReplicate(planes[p].z);
+		planeW[p] = XMVectorReplicate(planes[p].w);
+	}
+
+	const float* centerX = spheres.CenterX.empty() ? 0 : &spheres.CenterX[0];
+	const float* centerY = spheres.CenterY.empty() ? 0 : &spheres.CenterY[0];
+	const float* centerZ = spheres.CenterZ.empty() ? 0 : &spheres.CenterZ[0];
+	const float* radius = spheres.Radius.empty() ? 0 : &spheres.Radius[0];
+
+	unsigned int visibleCount = 0;
+	unsigned int i = first;
+	for (; i + 4 <= last; i += 4)
+	{
+		XMVECTOR x = XMLoadFloat4((const XMFLOAT4*)&centerX[i]);
+		XMVECTOR y = XMLoadFloat4((const XMFLOAT4*)&centerY[i]);
+		XMVECTOR z = XMLoadFloat4((const XMFLOAT4*)&centerZ[i]);
+		XMVECTOR negRadius = XMVectorNegate(XMLoadFloat4((const XMFLOAT4*)&radius[i]));
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(x, planeX[p],
+				XMVectorMultiplyAdd(y, planeY[p], XMVectorMultiplyAdd(z, planeZ[p], planeW[p])));
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, negRadius));
+		}
+
+		XMUINT4 mask;
+		XMStoreUInt4(&mask, outside);
+		visible[i] = mask.x == 0;
+		visible[i + 1] = mask.y == 0;
+		visible[i + 2] = mask.z == 0;
+		visible[i + 3] = mask.w == 0;
+		visibleCount += visible[i] + visible[i + 1] + visible[i + 2] + visible[i + 3];
+	}
+
+	// The last few, one at a time
+	for (; i < last; i++)
+	{
+		XMFLOAT3 center(centerX[i], centerY[i], centerZ[i]);
+		visible[i] = IsSphereVisible(center, radius[i], planes);
+		visibleCount += visible[i];
+	}
+	return visibleCount;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// World space bounding spheres of many objects, one array
+// per component (structure of arrays), so four spheres load
+// into one XMVECTOR per component
+// --------------------------------------------------------
+struct BoundingSpheres
+{
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> Radius;
+};
+
+// --------------------------------------------------------
+// CPU visibility tests of whole objects against the view
+// frustum (see MeshletCuller::ExtractFrustumPlanes for the
+// planes).  Like the meshlet tests these need no GPU, so
+// they can be run (and timed) headlessly
+//
+// An object is culled only if its bounds are entirely
+// behind one plane, so the tests are conservative - a few
+// objects just outside a frustum corner are kept
+//
+// Game culls through the BoundingVolumeHierarchy instead.
+// CullSpheres stays as the brute force baseline it's timed
+// against (the BoundingVolumeHierarchyVsBruteForce benchmark)
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	static bool IsSphereVisible(const DirectX::XMFLOAT3& center, float radius, const DirectX::XMFLOAT4 planes[6]);
+	static bool IsBoxVisible(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, const DirectX::XMFLOAT4 planes[6]);
+
+	// Marks each sphere 1 (visible) or 0 (culled), four at a
+	// time, and returns how many are visible
+	static unsigned int CullSpheres(const BoundingSpheres& spheres, const DirectX::XMFLOAT4 planes[6],
+		unsigned char* visible);
+	// Spheres [first, last) only, so the list can be split into jobs
+	static unsigned int CullSpheres(const BoundingSpheres& spheres, unsigned int first, unsigned int last,
+		const DirectX::XMFLOAT4 planes[6], unsigned char* visible);
+};
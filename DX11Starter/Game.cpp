@@ -1,10 +1,102 @@
   #include "Game.h"
 #include "Vertex.h"
 #include "WICTextureLoader.h"
+#include "VertexCompressor.h"
+
+// Most pixels a simplified level of detail may be off by on screen
+#define LOD_MAX_PIXEL_ERROR 1.0f
+
+// Entities culled per job
+#define CULL_JOB_ENTITIES 16
+
+// Fewest entities sharing a mesh, material and LOD to draw instanced
+#define INSTANCE_MIN_BATCH 2
+
+// Depth the render queue's keys span (the camera's far plane)
+#define RENDER_QUEUE_MAX_DEPTH 100.0f
+
+// Passes of the render queue, in the order they're drawn
+#define RENDER_PASS_SCENE 0
+
+// Bytes of the per draw constant buffer ring (a few frames' worth)
+#define CONSTANT_RING_SIZE (1024 * 1024)
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// --------------------------------------------------------
+// Runs the emitter's update as a job, next to the
+// transform update
+// --------------------------------------------------------
+struct EmitterJobData
+{
+	Emitter* ParticleEmitter;
+	float DeltaTime;
+	float TotalTime;
+};
+
+static void UpdateEmitterJob(void* data, unsigned int first, unsigned int last)
+{
+	EmitterJobData* job = (EmitterJobData*)data;
+	job->ParticleEmitter->Update(job->DeltaTime, job->TotalTime);
+}
+
+// --------------------------------------------------------
+// Picks the level of detail of entities [first, last)
+// --------------------------------------------------------
+struct LodJobData
+{
+	GameEntity* const* Entities;
+	unsigned int* Lods;
+	XMFLOAT3 CameraPosition;
+	float ProjectionScale;
+};
+
+static void SelectLodsJob(void* data, unsigned int first, unsigned int last)
+{
+	LodJobData* job = (LodJobData*)data;
+	for (unsigned int i = first; i < last; i++)
+	{
+		GameEntity* entity = job->Entities[i];
+		XMFLOAT4X4 cullWorld;
+		XMStoreFloat4x4(&cullWorld, XMMatrixTranspose(XMLoadFloat4x4(entity->GetWorldMatrix())));
+		job->Lods[i] = entity->SelectLod(cullWorld, job->CameraPosition, job->ProjectionScale, LOD_MAX_PIXEL_ERROR);
+	}
+}
+
+// --------------------------------------------------------
+// Culls the meshlets of the entities Singles [first, last)
+// point to, if they're drawn at full detail.  Each entity
+// gets its own stats, so jobs never share totals
+// --------------------------------------------------------
+struct CullJobData
+{
+	GameEntity* const* Entities;
+	const unsigned int* Singles;
+	const unsigned int* Lods;
+	MeshletCullStats* Stats;
+	const XMFLOAT4* Frustum;
+	XMFLOAT3 CameraPosition;
+};
+
+static void CullEntitiesJob(void* data, unsigned int first, unsigned int last)
+{
+	CullJobData* job = (CullJobData*)data;
+	for (unsigned int s = first; s < last; s++)
+	{
+		unsigned int i = job->Singles[s];
+		GameEntity* entity = job->Entities[i];
+
+		job->Stats[i] = MeshletCullStats();
+		if (job->Lods[i] != 0)
+			continue;
+
+		XMFLOAT4X4 cullWorld;
+		XMStoreFloat4x4(&cullWorld, XMMatrixTranspose(XMLoadFloat4x4(entity->GetWorldMatrix())));
+		entity->CullMeshlets(cullWorld, job->Frustum, job->CameraPosition, &job->Stats[i]);
+	}
+}
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -26,6 +118,18 @@ Game::Game(HINSTANCE hInstance)
 	indexBuffer = 0;
 	vertexShader = 0;
 	pixelShader = 0;
+	compactVS = 0;
+	instancedVS = 0;
+	perFrameData = 0;
+	lightData = 0;
+	constantRing = 0;
+	entityBvh = 0;
+	instanceRenderer = 0;
+	renderQueue = 0;
+	renderBackend = 0;
+	renderCounter = 0;
+	renderStats = RenderBackendStats();
+	shaderUploadStats = SimpleShaderUploadStats();
 	/*refractVS = 0;
 	refractPS = 0;
 	quadVS = 0;
@@ -54,6 +158,12 @@ Game::~Game()
 	if (pixelShader) {
 		delete pixelShader;
 	}
+	if (compactVS) {
+		delete compactVS;
+	}
+	if (instancedVS) {
+		delete instancedVS;
+	}
 	if (particleVS) {
 		delete particleVS;
 	}
@@ -72,6 +182,11 @@ Game::~Game()
 	if (refractPS) {
 		delete refractPS;
 	}
+	// After the shaders using them
+	delete perFrameData;
+	delete lightData;
+	ISimpleShader::SetConstantBufferRing(0);
+	delete constantRing;
 
 	
 	// Delete our simple shader objects, which
@@ -94,7 +209,7 @@ Game::~Game()
 	//depthState->Release();
 	//blendState->Release();
 	//rasterState->Release();
-	//for (auto& e : entities) delete e;
+	for (auto& e : entities) delete e;
 	
 	
 	delete gameEntity1;
@@ -106,11 +221,18 @@ Game::~Game()
 	delete g1;
 	delete g2;
 	delete refractionEntity;
+	delete transforms;
+	delete entityBvh;
+	delete instanceRenderer;
+	delete renderQueue;
+	delete renderCounter;
+	delete renderBackend;
 	//delete g3;
 	delete camera1;
 	
 	delete material1;
 	delete material2;
+	delete compactMaterial;
 	delete refractionMaterial;
 }
 
@@ -136,8 +258,16 @@ void Game::Init()
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
+	// (shared cbuffers first, so the shaders find them)
+	perFrameData = new SimpleSharedConstantBuffer(device, context, "perFrame");
+	lightData = new SimpleSharedConstantBuffer(device, context, "dLightData");
 	LoadShaders();
 	CreateMatrices();
+
+	// Per draw constants go into one ring buffer, where D3D11.1
+	// can bind them at offsets (otherwise this does nothing)
+	constantRing = new ConstantBufferRing(device, context, CONSTANT_RING_SIZE);
+	ISimpleShader::SetConstantBufferRing(constantRing);
 	CreateBasicGeometry();
 
 	// This sends data to GPU!!!
@@ -148,7 +278,7 @@ void Game::Init()
 	
 
 	
-	pixelShader->SetFloat3("CameraPosition", XMFLOAT3(0, 0, -5)); // Matches camera view definition above
+	lightData->SetFloat3("CameraPosition", XMFLOAT3(0, 0, -5)); // Matches camera view definition above
 	
 	//Add depth, so can render without blending
 	//Add rasterize desc, depth stencil desc, blend desc
@@ -294,6 +424,17 @@ void Game::LoadShaders()
 
 	pixelShader = new SimplePixelShader(device, context);
 	pixelShader->LoadShaderFile(L"PixelShader.cso");
+
+	// Compact meshes have half/SNORM data, which reflection can't
+	// work out, so this one gets its input layout handed to it
+	unsigned int compactElementCount;
+	const D3D11_INPUT_ELEMENT_DESC* compactElements = VertexCompressor::GetInputLayout(VERTEX_FORMAT_COMPACT, &compactElementCount);
+	compactVS = new SimpleVertexShader(device, context, compactElements, compactElementCount);
+	compactVS->LoadShaderFile(L"CompactVS.cso");
+
+	// Matrices come per instance, from a second vertex buffer
+	instancedVS = new SimpleVertexShader(device, context);
+	instancedVS->LoadShaderFile(L"InstancedVS.cso");
 	// Refraction shaders
 	quadVS = new SimpleVertexShader(device, context);
 	quadVS->LoadShaderFile(L"FullscreenQuadVS.cso");
@@ -371,17 +512,33 @@ void Game::CreateBasicGeometry()
 	//
 	material1 = new Material(vertexShader, pixelShader, rockSRV, rockNormalSRV, samplerState);
 	 material2 = new Material(vertexShader, pixelShader, fenceSRV, fenceSRV, samplerState);
+	 compactMaterial = new Material(compactVS, pixelShader, rockSRV, rockNormalSRV, samplerState);
 	 refractionMaterial = new Material(refractVS, refractPS, refractionSRV, refractionSRV, refractSampler);
 	//material2 = new Material(vertexShader, pixelShader, rockNormalSRV, samplerState);
 	g1 = new Mesh("../../OBJ Files/sphere.obj", device);
-	g2 = new Mesh("../../OBJ Files/cube.obj", device);
-	gameEntity1 = new GameEntity(g1, material1);
-	gameEntity2 = new GameEntity(g1, material1);
-	//gameEntity3 = new GameEntity(g1, material1);
-	
-	gameEntity4 = new GameEntity(g2, material1);
-	gameEntity5 = new GameEntity(g2, material1);
-	refractionEntity = new GameEntity(g1,refractionMaterial);
+	g2 = new Mesh("../../OBJ Files/cube.obj", device, 0, VERTEX_FORMAT_COMPACT);
+	transforms = new TransformSystem();
+	gameEntity1 = new GameEntity(g1, material1, transforms);
+	gameEntity2 = new GameEntity(g1, material1, transforms);
+	//gameEntity3 = new GameEntity(g1, material1, transforms);
+	
+	gameEntity4 = new GameEntity(g2, compactMaterial, transforms);
+	gameEntity5 = new GameEntity(g2, compactMaterial, transforms);
+	refractionEntity = new GameEntity(g1,refractionMaterial, transforms);
+
+	// Copies of gameEntity1 lined up beside it, which follow it around
+	for (int i = 1; i < 5; i++)
+	{
+		GameEntity* copy = new GameEntity(g1, material1, transforms);
+		copy->SetParent(gameEntity1);
+		copy->Move(i * (-1.0f), 0.0f, 0.0f);
+		entities.push_back(copy);
+	}
+
+	// The refraction entity sits at a fixed offset from a moving pivot
+	refractionPivot = transforms->Create();
+	transforms->SetParent(refractionEntity->GetTransform(), refractionPivot);
+	refractionEntity->Move(-0.5f, 0.0f, -1.0f);
 	//g3 = new Mesh(vertices3, 4, indices3, 6, device);
 	//GameEntity* ge = new GameEntity(g1, material1);
 	//GameEntity* geFence = new GameEntity(g1, material2);
@@ -389,11 +546,35 @@ void Game::CreateBasicGeometry()
 	//entities.push_back(ge);
 	//entities.push_back(geFence);
 	camera1 = new Camera(width, height);
+
+	// Hierarchy over where gameEntity1, its copies and the two
+	// compact cubes start out
+	transforms->UpdateWorldMatrices(jobs);
+	unsigned int entityCount = (unsigned int)entities.size() + 3;
+	std::vector<XMFLOAT3> boxMins(entityCount), boxMaxs(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+		GetSceneEntity(i)->GetWorldBoundingBox(&boxMins[i], &boxMaxs[i]);
+	entityBvh = new BoundingVolumeHierarchy();
+	entityBvh->Build(&boxMins[0], &boxMaxs[0], entityCount);
+
+	instanceRenderer = new InstanceRenderer(device, entityCount);
+	renderQueue = new RenderQueue(RENDER_QUEUE_MAX_DEPTH);
+	renderBackend = new D3D11RenderBackend(context, instancedVS, "sampState", "DiffuseTexture", "NormalTexture");
+	renderCounter = new CountingRenderBackend(renderBackend);
 	
 	
 }
 
 
+GameEntity* Game::GetSceneEntity(unsigned int index)
+{
+	if (index == 0)
+		return gameEntity1;
+	if (index <= entities.size())
+		return entities[index - 1];
+	return index == entities.size() + 1 ? gameEntity4 : gameEntity5;
+}
+
 // --------------------------------------------------------
 // Handle resizing DirectX "stuff" to match the new window size.
 // For instance, updating our projection matrix's aspect ratio.
@@ -416,7 +597,12 @@ void Game::Update(float deltaTime, float totalTime)
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 	float sinTime = sin(totalTime * 2);
-	emitter->Update(deltaTime, totalTime);
+
+	// The emitter doesn't touch any transforms, so it
+	// updates on another core in the meantime
+	EmitterJobData emitterJob = { emitter, deltaTime, totalTime };
+	JobCounter emitterDone;
+	jobs->Run(UpdateEmitterJob, &emitterJob, 0, 1, &emitterDone);
 	/*XMMATRIX trans = XMMatrixTranslation(0.0f, sinTime, 0.0f);
 	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(trans));*/
 	/*gameEntity1->Scale(1.0f, 1.0f, 1.0f);
@@ -439,8 +625,21 @@ void Game::Update(float deltaTime, float totalTime)
 	//gameEntity5->Scale(0.5f, 0.5f, 1.0f);
 	gameEntity5->Move(2.8f * sinTime, 0.0f, -1.0f);
 	//gameEntity5->Scale(0.75f * sinTime + 0.75f, 0.75f * sinTime + 0.75f, 1.0f);
-	refractionEntity->Move( sinTime, 0.0f, -1.0f);
+	transforms->SetPosition(refractionPivot, sinTime, 0.0f, -1.0f);
+
+	// Compose every moved entity's matrices together, in batches,
+	// and carry them down to the children (across every core)
+	transforms->UpdateWorldMatrices(jobs);
 	camera1->Update(deltaTime);
+
+	// Keep the hierarchy up with where the entities went
+	for (unsigned int i = 0; i < entityBvh->GetObjectCount(); i++)
+	{
+		XMFLOAT3 boxMin, boxMax;
+		GetSceneEntity(i)->GetWorldBoundingBox(&boxMin, &boxMax);
+		entityBvh->SetBounds(i, boxMin, boxMax);
+	}
+	jobs->Wait(&emitterDone);
 	
 	
 
@@ -452,49 +651,123 @@ void Game::DrawScene(float totalTime) {
 	dLight1.DiffuseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
 	dLight1.Direction = { 1.0f, -1.0f, 0.0f };
 
-	pixelShader->SetData("dLight1", &dLight1, sizeof(DirectionaLight));
+	lightData->SetData("dLight1", &dLight1, sizeof(DirectionaLight));
 	//pixelShader->CopyAllBufferData();
 
 	dLight2.AmbientColor = { 0.1f, 0.1f, 0.5f, 1.0f };
 	dLight2.DiffuseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
 	dLight2.Direction = { -0.50f, 1.0f, 0.0f };
-	pixelShader->SetData("dLight2", &dLight2, sizeof(DirectionaLight));
+	lightData->SetData("dLight2", &dLight2, sizeof(DirectionaLight));
 	//pixelShader->CopyAllBufferData();
 	//Set Point Light
-	pixelShader->SetFloat3("PointLightPosition", XMFLOAT3(0, 5, 0));
-	pixelShader->SetFloat3("PointLightColor", XMFLOAT3(0.5, 0.5, 0.5));
-	pixelShader->SetFloat3("DirLightColor", XMFLOAT3(0.8f, 0.8f, 0.8f));
-	pixelShader->SetFloat3("CameraPosition", camera1->GetCameraPosition()); 
-	pixelShader->CopyAllBufferData() ;// Matches camera view definition above
-	gameEntity1->PrepareMaterial("sampState", "DiffuseTexture", "NormalTexture", camera1->GetViewMatrix(), camera1->GetProjectionMatrix());
-	
-	// Draw multiple of the same object
-	for (int i = 0; i < 5; i++)
+	lightData->SetFloat3("PointLightPosition", XMFLOAT3(0, 5, 0));
+	lightData->SetFloat3("PointLightColor", XMFLOAT3(0.5, 0.5, 0.5));
+	lightData->SetFloat3("DirLightColor", XMFLOAT3(0.8f, 0.8f, 0.8f));
+	lightData->SetFloat3("CameraPosition", camera1->GetCameraPosition()); 
+	// Once for every pixel shader drawing with them
+	lightData->CopyBufferData();
+	
+	// Each copy only draws the meshlets the camera can see
+	XMFLOAT4 frustum[6];
+	camera1->GetFrustumPlanes(frustum);
+	XMFLOAT3 cameraPosition = camera1->GetCameraPosition();
+	meshletStats = MeshletCullStats();
+
+	// Pixels one world unit covers at distance one (the projection's
+	// y scale is the same transposed or not)
+	float projectionScale = camera1->GetProjectionMatrix()._22 * height * 0.5f;
+
+	// The matrices must be up to date before any jobs read them
+	transforms->UpdateWorldMatrices(jobs);
+
+	// gameEntity1 and its copies (which share its material), and the
+	// compact cubes - only the ones whose bounds reach into the
+	// frustum get drawn
+	entityBvh->CullFrustum(frustum, visibleEntities);
+	drawEntities.clear();
+	for (size_t i = 0; i < visibleEntities.size(); i++)
+		drawEntities.push_back(GetSceneEntity(visibleEntities[i]));
+	if (drawEntities.empty())
+		return;
+	drawLods.resize(drawEntities.size());
+	drawStats.resize(drawEntities.size());
+
+	// Pick everyone's level of detail across the cores
+	LodJobData lodJob = { &drawEntities[0], &drawLods[0], cameraPosition, projectionScale };
+	JobCounter lodsPicked;
+	jobs->ParallelFor(SelectLodsJob, &lodJob, (unsigned int)drawEntities.size(), CULL_JOB_ENTITIES, &lodsPicked);
+	jobs->Wait(&lodsPicked);
+
+	// Batch up the ones that look alike.  Compact meshes need
+	// CompactVS, so they always go one at a time
+	instanceRenderer->Clear();
+	drawSingles.clear();
+	for (size_t i = 0; i < drawEntities.size(); i++)
+	{
+		GameEntity* entity = drawEntities[i];
+		if (entity->GetMesh()->GetVertexFormat() == VERTEX_FORMAT_FULL)
+			instanceRenderer->Add(entity->GetMesh(), entity->GetMaterial(), drawLods[i],
+				*entity->GetWorldMatrix(), *entity->GetWorldInverseTranspose(), (unsigned int)i);
+		else
+			drawSingles.push_back((unsigned int)i);
+	}
+	instanceRenderer->Build(INSTANCE_MIN_BATCH);
+	const std::vector<unsigned int>& unbatched = instanceRenderer->GetUnbatchedIds();
+	drawSingles.insert(drawSingles.end(), unbatched.begin(), unbatched.end());
+
+	// Cull the meshlets of those left over, across the cores again
+	if (!drawSingles.empty())
 	{
-		// Load, un-transpose, translate, re-transpose, store
-		XMMATRIX wMat = XMMatrixTranspose(XMLoadFloat4x4(gameEntity1->GetWorldMatrix()));
-		XMFLOAT4X4 w;
-		XMStoreFloat4x4(&w, XMMatrixTranspose(wMat * XMMatrixTranslation(i * (-1.0f), 0, 0)));
-
-		// Changes per object
-		vertexShader->SetMatrix4x4("world", w);
-
-		// This is a little sloppy, but just for the demo, copy everything
-		vertexShader->CopyAllBufferData();
-		// Finally do the actual drawing
-		gameEntity1->Draw(context);
+		CullJobData cullJob = { &drawEntities[0], &drawSingles[0], &drawLods[0], &drawStats[0], frustum, cameraPosition };
+		JobCounter culled;
+		jobs->ParallelFor(CullEntitiesJob, &cullJob, (unsigned int)drawSingles.size(), CULL_JOB_ENTITIES, &culled);
+		jobs->Wait(&culled);
 	}
+
+	// Then queue them up, sort by state and draw them on this
+	// thread, which owns the context.  Meshlets only cover the full
+	// detail level, so simplified levels are drawn whole
+	renderCounter->ResetStats();
+	renderQueue->Clear();
+	for (size_t s = 0; s < drawSingles.size(); s++)
+	{
+		unsigned int i = drawSingles[s];
+		GameEntity* entity = drawEntities[i];
+
+		XMFLOAT3 center;
+		float radius;
+		entity->GetWorldBoundingSphere(&center, &radius);
+		float depth = XMVectorGetX(XMVector3Length(XMLoadFloat3(&center) - XMLoadFloat3(&cameraPosition)));
+		RenderSortKey key = renderQueue->MakeKey(RENDER_PASS_SCENE, false, entity->GetMaterial(), entity->GetMesh(), depth);
+
+		if (drawLods[i] == 0)
+			entity->SubmitVisible(renderQueue, key);
+		else
+			entity->Submit(renderQueue, key, drawLods[i]);
+
+		meshletStats.Meshlets += drawStats[i].Meshlets;
+		meshletStats.Triangles += drawStats[i].Triangles;
+		meshletStats.FrustumCulled += drawStats[i].FrustumCulled;
+		meshletStats.ConeCulled += drawStats[i].ConeCulled;
+		meshletStats.CulledTriangles += drawStats[i].CulledTriangles;
+	}
+	renderQueue->Sort();
+	renderQueue->Execute(renderCounter);
+
+	// And the batches, a draw each
+	instanceRenderer->Draw(renderCounter);
+	renderStats = renderCounter->GetStats();
 	
 	// Particle states
 	
 }
-void Game::DrawParticles(float totalTime)
+void Game::DrawParticles()
 {
 	particlePS->SetInt("debugWireframe", 0);
 	particlePS->CopyAllBufferData();
 
 	// Draw the emitter
-	emitter->Draw(context, camera1, totalTime);
+	emitter->Draw(context);
 }
 void Game::DrawFullscreenQuad(ID3D11ShaderResourceView* texture) {
 	// First, turn off our buffers, as we'll be generating the vertex
@@ -512,22 +785,18 @@ void Game::DrawFullscreenQuad(ID3D11ShaderResourceView* texture) {
 	context->Draw(3, 0);
 }
 void Game::DrawRefraction() {
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	ID3D11Buffer* vb = refractionEntity->GetMeshVertexBuffer();
-	ID3D11Buffer* ib = refractionEntity->GetMeshIndexBuffer();
-	context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-	context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+	// Nothing to do if it's out of view
+	XMFLOAT4 frustum[6];
+	camera1->GetFrustumPlanes(frustum);
+	XMFLOAT3 boxMin, boxMax;
+	refractionEntity->GetWorldBoundingBox(&boxMin, &boxMax);
+	if (!FrustumCuller::IsBoxVisible(boxMin, boxMax, frustum))
+		return;
 
 	// Setup vertex shader
-	XMMATRIX wMat = XMMatrixTranspose(XMLoadFloat4x4(refractionEntity->GetWorldMatrix()));
-	XMFLOAT4X4 w;
-	XMStoreFloat4x4(&w, XMMatrixTranspose(wMat * XMMatrixTranslation(-0.5f, 0, -1.0f)));
-
-	
-	refractVS->SetMatrix4x4("world", w);
-	refractVS->SetMatrix4x4("view", camera1->GetViewMatrix());
-	refractVS->SetMatrix4x4("projection", camera1->GetProjectionMatrix());
+	// (the entity binds its own vertex and index buffers when drawn)
+	// (the camera is in the shared per frame buffer)
+	refractVS->SetMatrix4x4("world", *refractionEntity->GetWorldMatrix());
 	refractVS->CopyAllBufferData();
 	refractVS->SetShader();
 
@@ -553,6 +822,15 @@ void Game::Draw(float deltaTime, float totalTime)
 	// Background color (black in this case) for clearing
 	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
 
+	// Count this frame's constant buffer uploads
+	ISimpleShader::ResetUploadStats();
+
+	// The camera and the time, uploaded once for every shader drawing this frame
+	perFrameData->SetMatrix4x4("view", camera1->GetViewMatrix());
+	perFrameData->SetMatrix4x4("projection", camera1->GetProjectionMatrix());
+	perFrameData->SetFloat("time", totalTime);
+	perFrameData->CopyBufferData();
+
 	// Clear any and all render targets we intend to use, and the depth buffer
 	context->ClearRenderTargetView(backBufferRTV, color);
 	context->ClearRenderTargetView(refractionRTV, color);
@@ -568,7 +846,7 @@ void Game::Draw(float deltaTime, float totalTime)
 	context->OMSetBlendState(particleBlendState, blend, 0xffffffff);	// Additive blending
 	context->OMSetDepthStencilState(particleDepthState, 0);				// No depth WRITING
 	// No wireframe debug
-	DrawParticles(totalTime);
+	DrawParticles();
 	// Back to the screen, but NO depth buffer for now!
 	// We just need to plaster the pixels from the render target onto the 
 	// screen without affecting (or respecting) the existing depth buffer
@@ -601,6 +879,11 @@ void Game::Draw(float deltaTime, float totalTime)
 	swapChain->Present(0, 0);
 	// Must re-bind after Present() due to swap chain options
 	context->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
+
+	// Fence this frame's constants, so the ring reuses their space
+	// once the GPU is past them
+	constantRing->EndFrame();
+	shaderUploadStats = ISimpleShader::GetUploadStats();
 	
 }
 
@@ -614,7 +897,15 @@ void Game::Draw(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::OnMouseDown(WPARAM buttonState, int x, int y)
 {
-	// Add any custom code here...
+#if defined(DEBUG) || defined(_DEBUG)
+	// Report the entity under the cursor
+	XMFLOAT3 rayOrigin, rayDirection;
+	camera1->GetPickRay(x, y, width, height, &rayOrigin, &rayDirection);
+	unsigned int picked;
+	float distance;
+	if (entityBvh->Raycast(rayOrigin, rayDirection, D3D11_FLOAT32_MAX, &picked, &distance))
+		printf("Picked entity %u at distance %.2f\n", picked, distance);
+#endif
 
 	// Save the previous mouse position, so we have it for the future
 	prevMousePos.x = x;
@@ -9,6 +9,11 @@
 #include "Material.h"
 #include "Lights.h"
 #include "Emitter.h"
+#include "FrustumCuller.h"
+#include "BoundingVolumeHierarchy.h"
+#include "InstanceRenderer.h"
+#include "RenderQueue.h"
+#include "ConstantBufferRing.h"
 
 class Game 
 	: public DXCore
@@ -25,7 +30,7 @@ public:
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
 	void DrawScene(float totalTime);
-	void DrawParticles(float totalTime);
+	void DrawParticles();
 	void DrawFullscreenQuad(ID3D11ShaderResourceView* texture);
 	void DrawRefraction();
 	// Overridden mouse input helper methods
@@ -43,6 +48,7 @@ private:
 	void LoadShaders(); 
 	void CreateMatrices();
 	void CreateBasicGeometry();
+	GameEntity* GetSceneEntity(unsigned int index);	// By entityBvh object
 	
 	// Buffers to hold actual geometry data
 	ID3D11Buffer* vertexBuffer;
@@ -57,6 +63,12 @@ private:
 	// Wrappers for DirectX shaders to provide simplified functionality
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShader;
+	SimpleVertexShader* compactVS;	// For meshes in VERTEX_FORMAT_COMPACT
+	SimpleVertexShader* instancedVS;	// For InstanceRenderer batches
+	// cbuffers every shader shares, set and uploaded once a frame
+	SimpleSharedConstantBuffer* perFrameData;	// The camera
+	SimpleSharedConstantBuffer* lightData;	// The lights, for PixelShader
+	ConstantBufferRing* constantRing;	// Where every shader's own cbuffers go
 	// Refraction stuff ------------------------
 	// Render target view and SRV so we can render somewhere
 	// other than the screen - necessary for refracting things
@@ -97,12 +109,38 @@ private:
 	GameEntity* gameEntity5;
 	std::vector<GameEntity*> entities;
 	GameEntity* refractionEntity;
+	TransformSystem* transforms;	// Every entity's transform, packed together
+	TransformHandle refractionPivot;	// What the refraction entity orbits
 	Camera *camera1;
 	Material* material1;
 	Material* material2;
+	Material* compactMaterial;
 	Material* refractionMaterial;
 	DirectionaLight dLight1;
 	DirectionaLight dLight2;
+	MeshletCullStats meshletStats;	// Totals from the last DrawScene
+
+	// World boxes of the entities DrawScene draws - gameEntity1 is
+	// object 0, its copies follow, then gameEntity4 and gameEntity5
+	// (the compact cubes) - for culling and picking
+	BoundingVolumeHierarchy* entityBvh;
+	std::vector<unsigned int> visibleEntities;
+
+	// What DrawScene culls (on jobs) before drawing, one per entity
+	std::vector<GameEntity*> drawEntities;
+	std::vector<unsigned int> drawLods;
+	std::vector<MeshletCullStats> drawStats;
+
+	// Entities sharing a mesh and material are drawn a batch at a
+	// time.  The rest are queued one by one, their meshlets culled,
+	// and drawn in order of state
+	InstanceRenderer* instanceRenderer;
+	RenderQueue* renderQueue;
+	D3D11RenderBackend* renderBackend;
+	CountingRenderBackend* renderCounter;	// Wraps renderBackend
+	RenderBackendStats renderStats;	// From the last DrawScene
+	SimpleShaderUploadStats shaderUploadStats;	// From the last Draw
+	std::vector<unsigned int> drawSingles;	// Into drawEntities
 	
 };
 
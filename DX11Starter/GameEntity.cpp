@@ -1,62 +1,99 @@
 #include "GameEntity.h"
 
+// Closest the camera is treated as being when picking a level of
+// detail, so being inside the bounds doesn't divide by zero
+#define GAME_ENTITY_MIN_LOD_DISTANCE 1e-3f
 
-GameEntity::GameEntity(Mesh* mesh_1, Material* mat1) {
+// The length of the longest axis of a (not transposed) world
+// matrix, so bounds scaled by it are never underestimated
+static float GetLargestScale(DirectX::FXMMATRIX world) {
+	float largest = 0.0f;
+	for (int r = 0; r < 3; r++)
+	{
+		float axisScale = DirectX::XMVectorGetX(DirectX::XMVector3Length(world.r[r]));
+		if (axisScale > largest) largest = axisScale;
+	}
+	return largest;
+}
+
+
+GameEntity::GameEntity(Mesh* mesh_1, Material* mat1, TransformSystem* transforms) {
 	
 	mesh = mesh_1;
-	trans = {0.0f, 0.0f, 0.0f};
-	scale = {1.0f, 1.0f, 1.0f};
-	rot = {0.0f, 0.0f, 0.0f};
-	worldMatrix =
-	{ 1.0f, 0.0f, 0.0f, 0.0f,
-	 0.0f, 1.0f, 0.0f, 0.0f,
-	 0.0f, 0.0f, 1.0f, 0.0f,
-	 0.0f, 0.0f, 0.0f, 1.0f
-	};
+	this->transforms = transforms;
+	transform = transforms->Create();
 	material1 = mat1;
 	
 
 }
 GameEntity::~GameEntity() {
-	
+	transforms->Destroy(transform);
 }
 
 void GameEntity::SetTranslation(float x, float y, float z) {
-	trans = {x, y, z};
+	transforms->SetPosition(transform, x, y, z);
 }
 void GameEntity::SetScale(float x, float y, float z) {
-	scale = { x, y, z };
+	transforms->SetScale(transform, x, y, z);
 }
 void GameEntity::SetRotate(float x, float y, float z) {
-	rot = { x, y, z };
+	transforms->SetRotation(transform, x, y, z);
 }
 
 void GameEntity::Move(float x, float y, float z) {
 	SetTranslation(x, y, z);
-	DirectX::XMMATRIX translation = DirectX::XMMatrixTranslation(x, y, z);
-	DirectX::XMMATRIX scaling = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
-	DirectX::XMMATRIX rotation = DirectX::XMMatrixRotationRollPitchYaw(rot.x, rot.y, rot.z);
-	DirectX::XMStoreFloat4x4(&worldMatrix, DirectX::XMMatrixTranspose(scaling * rotation * translation));
 }
 void GameEntity::Scale(float x, float y, float z) {
 	SetScale(x, y, z);
-	DirectX::XMMATRIX translation = DirectX::XMMatrixTranslation(trans.x, trans.y, trans.z);
-	DirectX::XMMATRIX rotation = DirectX::XMMatrixRotationRollPitchYaw(rot.x, rot.y, rot.z);
-	DirectX::XMMATRIX scaling = DirectX::XMMatrixScaling(x, y, z);
-	DirectX::XMStoreFloat4x4(&worldMatrix, DirectX::XMMatrixTranspose(scaling * rotation * translation));
 }
 void GameEntity::Rotate(float x, float y, float z) {
 	SetRotate(x, y, z);
-	DirectX::XMMATRIX translation = DirectX::XMMatrixTranslation(trans.x, trans.y, trans.z);
-	DirectX::XMMATRIX scaling = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
-	DirectX::XMMATRIX rotation = DirectX::XMMatrixRotationRollPitchYaw(x, y, z);
-	DirectX::XMStoreFloat4x4(&worldMatrix, DirectX::XMMatrixTranspose(scaling * rotation * translation));
+}
+
+void GameEntity::SetParent(GameEntity* parent) {
+	if (parent)
+		transforms->SetParent(transform, parent->transform);
+	else
+		transforms->ClearParent(transform);
+}
+
+TransformHandle GameEntity::GetTransform() {
+	return transform;
 }
 
 DirectX::XMFLOAT4X4* GameEntity::GetWorldMatrix() {
-	
-	return &worldMatrix;
+	return transforms->GetWorldMatrix(transform);
 }
+
+DirectX::XMFLOAT4X4* GameEntity::GetWorldInverseTranspose() {
+	return transforms->GetWorldInverseTranspose(transform);
+}
+void GameEntity::GetWorldBoundingSphere(DirectX::XMFLOAT3* center, float* radius) {
+	DirectX::XMMATRIX w = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(GetWorldMatrix()));
+	DirectX::XMFLOAT3 localCenter = mesh->GetBoundsCenter();
+	DirectX::XMStoreFloat3(center, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&localCenter), w));
+	*radius = mesh->GetBoundsRadius() * GetLargestScale(w);
+}
+
+void GameEntity::GetWorldBoundingBox(DirectX::XMFLOAT3* boxMin, DirectX::XMFLOAT3* boxMax) {
+	DirectX::XMMATRIX w = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(GetWorldMatrix()));
+	DirectX::XMFLOAT3 localMin = mesh->GetBoundsMin();
+	DirectX::XMFLOAT3 localMax = mesh->GetBoundsMax();
+	DirectX::XMVECTOR lo = DirectX::XMLoadFloat3(&localMin);
+	DirectX::XMVECTOR hi = DirectX::XMLoadFloat3(&localMax);
+	DirectX::XMVECTOR center = DirectX::XMVector3TransformCoord((lo + hi) * 0.5f, w);
+	DirectX::XMVECTOR extent = (hi - lo) * 0.5f;
+
+	// Each world axis reaches as far as the rotated, scaled
+	// extents add up to along it
+	DirectX::XMVECTOR worldExtent =
+		DirectX::XMVectorAbs(w.r[0]) * DirectX::XMVectorSplatX(extent) +
+		DirectX::XMVectorAbs(w.r[1]) * DirectX::XMVectorSplatY(extent) +
+		DirectX::XMVectorAbs(w.r[2]) * DirectX::XMVectorSplatZ(extent);
+	DirectX::XMStoreFloat3(boxMin, center - worldExtent);
+	DirectX::XMStoreFloat3(boxMax, center + worldExtent);
+}
+
 ID3D11Buffer* GameEntity::GetMeshVertexBuffer() {
 	return mesh->GetVertexBuffer();
 	
@@ -66,45 +103,87 @@ ID3D11Buffer* GameEntity::GetMeshIndexBuffer() {
 	return mesh->GetIndexBuffer();
 }
 
-void GameEntity::PrepareMaterial(std::string SamplerName, std::string SRVName, std::string NormalSRVName, DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix) {
-	DirectX::XMMATRIX w = DirectX::XMLoadFloat4x4(&worldMatrix);
-	DirectX::XMVECTOR d = DirectX::XMMatrixDeterminant(w);
-	DirectX::XMMATRIX world = DirectX::XMMatrixInverse(&d, w);
-		
-	world = DirectX::XMMatrixTranspose(world);
-	DirectX::XMStoreFloat4x4(&transWorld, world);
-	
+Mesh* GameEntity::GetMesh() {
+	return mesh;
+}
 
-	material1->VertexShaderSetMatrices(worldMatrix, viewMatrix, projectionMatrix, transWorld);
-	// Once you've set all of the data you care to change for
-	// the next draw call, you need to actually send it to the GPU
-	//  - If you skip this, the "SetMatrix" calls above won't make it to the GPU!
-	material1->VertexShaderCopyAllBufferData();
-	material1->SetSamplerState(SamplerName);
-	material1->SetShaderResourceView(SRVName);
-	material1->SetShaderResourceNormalMapView(NormalSRVName);
-
-	material1->PixelShaderCopyAllBufferData(); // This sends data to GPU!!!
-	// Set the vertex and pixel shaders to use for the next Draw() command
-	//  - These don't technically need to be set every frame...YET
-	//  - Once you start applying different shaders to different objects,
-	//    you'll need to swap the current shaders before each draw
-	material1->SetVertexShader();
-	material1->SetPixelShader();
-	
+Material* GameEntity::GetMaterial() {
+	return material1;
 }
 
-void GameEntity::Draw(ID3D11DeviceContext* context) {
+void GameEntity::Draw(ID3D11DeviceContext* context, unsigned int lod) {
 
-	UINT stride = sizeof(Vertex);
+	UINT stride = mesh->GetVertexStride();
 	UINT offset = 0;
 	ID3D11Buffer* vertexBuffer1 = mesh->GetVertexBuffer();
 	ID3D11Buffer* indexBuffer1 = mesh->GetIndexBuffer();
 	context->IASetVertexBuffers(0, 1, &vertexBuffer1, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer1, DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer(indexBuffer1, mesh->GetIndexFormat(), 0);
 
+	const MeshLod& level = mesh->GetLod(lod);
 	context->DrawIndexed(
-		mesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
+		level.IndexCount,     // The number of indices to use (just this level of detail)
+		level.IndexOffset,     // Offset to the first index we want to use
 		0);    // Offset to add to each index when looking up vertices
 }
+
+unsigned int GameEntity::SelectLod(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& cameraPosition,
+	float projectionScale, float maxPixelError) {
+
+	if (mesh->GetLodCount() < 2)
+		return 0;
+
+	DirectX::XMMATRIX w = DirectX::XMLoadFloat4x4(&world);
+	float worldScale = GetLargestScale(w);
+
+	// Distance to the nearest point of the bounding sphere
+	DirectX::XMFLOAT3 localCenter = mesh->GetBoundsCenter();
+	DirectX::XMVECTOR center = DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&localCenter), w);
+	float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(center - DirectX::XMLoadFloat3(&cameraPosition)));
+	distance -= mesh->GetBoundsRadius() * worldScale;
+	if (distance < GAME_ENTITY_MIN_LOD_DISTANCE) distance = GAME_ENTITY_MIN_LOD_DISTANCE;
+
+	return mesh->SelectLod(worldScale * projectionScale / distance, maxPixelError);
+}
+
+void GameEntity::CullMeshlets(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4 frustumPlanes[6],
+	const DirectX::XMFLOAT3& cameraPosition, MeshletCullStats* stats) {
+
+	const std::vector<Meshlet>& meshlets = mesh->GetMeshlets();
+	visibleMeshlets.resize(meshlets.size());
+	if (!meshlets.empty())
+		MeshletCuller::Cull(&meshlets[0], (unsigned int)meshlets.size(), world, frustumPlanes, cameraPosition, &visibleMeshlets[0], stats);
+}
+
+void GameEntity::Submit(RenderQueue* queue, RenderSortKey key, unsigned int lod) {
+
+	queue->Submit(key, material1, mesh, *GetWorldMatrix(), *GetWorldInverseTranspose());
+	const MeshLod& level = mesh->GetLod(lod);
+	queue->AddRange(level.IndexOffset, level.IndexCount);
+}
+
+void GameEntity::SubmitVisible(RenderQueue* queue, RenderSortKey key) {
+
+	const std::vector<Meshlet>& meshlets = mesh->GetMeshlets();
+	if (meshlets.empty())
+	{
+		Submit(queue, key);
+		return;
+	}
+
+	// Meshlets are contiguous in the index buffer, so each run of
+	// visible meshlets is a single range
+	queue->Submit(key, material1, mesh, *GetWorldMatrix(), *GetWorldInverseTranspose());
+	size_t m = 0;
+	while (m < meshlets.size())
+	{
+		if (!visibleMeshlets[m]) { m++; continue; }
+
+		unsigned int firstIndex = meshlets[m].IndexOffset;
+		unsigned int indexCount = 0;
+		for (; m < meshlets.size() && visibleMeshlets[m]; m++)
+			indexCount += meshlets[m].TriangleCount * 3;
+
+		queue->AddRange(firstIndex, indexCount);
+	}
+}
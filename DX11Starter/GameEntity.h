@@ -1,34 +1,66 @@
 #pragma once
 #include "Mesh.h"
 #include "Material.h"
+#include "TransformSystem.h"
+#include "RenderQueue.h"
 class GameEntity {
 public:
-	GameEntity(Mesh* mesh_1, Material* mat1);
+	// The entity's transform lives in (and is composed by) transforms
+	GameEntity(Mesh* mesh_1, Material* mat1, TransformSystem* transforms);
 	~GameEntity();
 	//
 	void SetTranslation(float x, float y, float z);
 	void SetScale(float x, float y, float z);
 	void SetRotate(float x, float y, float z);
 
-	//
+	// Same as the setters
 	void Move(float x, float y, float z);
 	void Scale(float x, float y, float z);
 	void Rotate(float x, float y, float z);
 	
+	// The entity's transform becomes relative to parent's (0 for none)
+	void SetParent(GameEntity* parent);
+	TransformHandle GetTransform();
+
+	// Both transposed for HLSL, as of the last UpdateWorldMatrices() of
+	// the TransformSystem (which must come after any changes).  Only
+	// good until the next change to any entity's transform
 	DirectX::XMFLOAT4X4* GetWorldMatrix();
+	DirectX::XMFLOAT4X4* GetWorldInverseTranspose();
+
+	// The mesh's bounds, taken into world space (so the same goes for
+	// these).  The sphere grows by the largest axis scale, and the box
+	// stays axis aligned
+	void GetWorldBoundingSphere(DirectX::XMFLOAT3* center, float* radius);
+	void GetWorldBoundingBox(DirectX::XMFLOAT3* boxMin, DirectX::XMFLOAT3* boxMax);
 
 	ID3D11Buffer* GetMeshVertexBuffer();
 	ID3D11Buffer* GetMeshIndexBuffer();
+	Mesh* GetMesh();
+	Material* GetMaterial();
 
-	void PrepareMaterial(std::string SamplerName, std::string SRVName, std::string NormalSRVName,DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
-	void Draw(ID3D11DeviceContext* context);
+	// lod - Level of detail to draw (0 is the full mesh)
+	void Draw(ID3D11DeviceContext* context, unsigned int lod = 0);
+	// Picks the coarsest level of detail that stays within maxPixelError
+	// world           - The world matrix being drawn with (not transposed)
+	// projectionScale - Pixels covered by one unit at distance one
+	unsigned int SelectLod(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& cameraPosition,
+		float projectionScale, float maxPixelError);
+	// Keeps only the meshlets that pass a frustum and backface test,
+	// for the next SubmitVisible.  Culling touches nothing but this
+	// entity, so different entities can be culled on different threads
+	// world - The world matrix being drawn with (not transposed)
+	void CullMeshlets(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4 frustumPlanes[6],
+		const DirectX::XMFLOAT3& cameraPosition, MeshletCullStats* stats);
+	// Draw, queued for later instead
+	void Submit(RenderQueue* queue, RenderSortKey key, unsigned int lod = 0);
+	// Queues what the last CullMeshlets kept
+	void SubmitVisible(RenderQueue* queue, RenderSortKey key);
 private:
 	Mesh* mesh;
-	DirectX::XMFLOAT3 trans;
-	DirectX::XMFLOAT3 scale;
-	DirectX::XMFLOAT3 rot;
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 transWorld;
+	TransformSystem* transforms;
+	TransformHandle transform;
 
 	Material* material1;
+	std::vector<unsigned char> visibleMeshlets;	// From the last CullMeshlets
 };
\ No newline at end of file
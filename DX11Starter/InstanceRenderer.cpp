@@ -0,0 +1,162 @@
+#include "InstanceRenderer.h"
+#include <algorithm>
+
+InstanceRenderer::InstanceRenderer(ID3D11Device* device, unsigned int maxInstances)
+{
+	this->device = device;
+	instanceBuffer = 0;
+	bufferCapacity = 0;
+	CreateInstanceBuffer(maxInstances > 0 ? maxInstances : 1);
+}
+
+InstanceRenderer::~InstanceRenderer()
+{
+	if (instanceBuffer) { instanceBuffer->Release(); }
+}
+
+void InstanceRenderer::CreateInstanceBuffer(unsigned int capacity)
+{
+	bufferCapacity = capacity;
+	if (!device)
+		return;
+
+	if (instanceBuffer) { instanceBuffer->Release(); instanceBuffer = 0; }
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = sizeof(InstanceData) * capacity;
+	device->CreateBuffer(&desc, 0, &instanceBuffer);
+}
+
+void InstanceRenderer::Clear()
+{
+	items.clear();
+	added.clear();
+	addedIds.clear();
+	batches.clear();
+	instances.clear();
+	instanceIds.clear();
+	unbatchedIds.clear();
+}
+
+void InstanceRenderer::Add(Mesh* mesh, Material* material, unsigned int lod,
+	const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose, unsigned int id)
+{
+	InstanceItem item = { mesh, material, lod, (unsigned int)added.size() };
+	items.push_back(item);
+
+	InstanceData data = { world, worldInverseTranspose };
+	added.push_back(data);
+	addedIds.push_back(id);
+}
+
+void InstanceRenderer::Build(unsigned int minInstances)
+{
+	batches.clear();
+	instances.clear();
+	instanceIds.clear();
+	unbatchedIds.clear();
+
+	// Mesh first, so a mesh's materials and levels share one
+	// vertex buffer binding.  Ties keep the order of Add()
+	std::sort(items.begin(), items.end(), [](const InstanceItem& a, const InstanceItem& b)
+	{
+		if (a.ItemMesh != b.ItemMesh) return std::less<Mesh*>()(a.ItemMesh, b.ItemMesh);
+		if (a.ItemMaterial != b.ItemMaterial) return std::less<Material*>()(a.ItemMaterial, b.ItemMaterial);
+		if (a.Lod != b.Lod) return a.Lod < b.Lod;
+		return a.Added < b.Added;
+	});
+
+	size_t first = 0;
+	while (first < items.size())
+	{
+		size_t last = first + 1;
+		while (last < items.size() &&
+			items[last].ItemMesh == items[first].ItemMesh &&
+			items[last].ItemMaterial == items[first].ItemMaterial &&
+			items[last].Lod == items[first].Lod)
+			last++;
+
+		if (last - first < minInstances)
+		{
+			for (size_t i = first; i < last; i++)
+				unbatchedIds.push_back(addedIds[items[i].Added]);
+		}
+		else
+		{
+			InstanceBatch batch = { items[first].ItemMesh, items[first].ItemMaterial, items[first].Lod,
+				(unsigned int)instances.size(), (unsigned int)(last - first) };
+			batches.push_back(batch);
+
+			for (size_t i = first; i < last; i++)
+			{
+				instances.push_back(added[items[i].Added]);
+				instanceIds.push_back(addedIds[items[i].Added]);
+			}
+		}
+		first = last;
+	}
+}
+
+void InstanceRenderer::Draw(RenderBackend* backend)
+{
+	if (instances.empty())
+		return;
+
+	if (instances.size() > bufferCapacity)
+	{
+		unsigned int capacity = bufferCapacity * 2;
+		if (capacity < instances.size())
+			capacity = (unsigned int)instances.size();
+		CreateInstanceBuffer(capacity);
+	}
+
+	backend->UploadBuffer(instanceBuffer, &instances[0], (unsigned int)(sizeof(InstanceData) * instances.size()));
+
+	Mesh* boundMesh = 0;
+	Material* boundMaterial = 0;
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		const InstanceBatch& batch = batches[b];
+		if (batch.BatchMaterial != boundMaterial)
+		{
+			backend->BindInstancedMaterial(batch.BatchMaterial);
+			boundMaterial = batch.BatchMaterial;
+		}
+		if (batch.BatchMesh != boundMesh)
+		{
+			backend->BindInstancedMesh(batch.BatchMesh, instanceBuffer, sizeof(InstanceData));
+			boundMesh = batch.BatchMesh;
+		}
+
+		const MeshLod& lod = batch.BatchMesh->GetLod(batch.Lod);
+		backend->DrawIndexedInstanced(lod.IndexCount, batch.InstanceCount, lod.IndexOffset, batch.FirstInstance);
+	}
+}
+
+unsigned int InstanceRenderer::GetBatchCount()
+{
+	return (unsigned int)batches.size();
+}
+
+const InstanceBatch& InstanceRenderer::GetBatch(unsigned int batch)
+{
+	return batches[batch];
+}
+
+unsigned int InstanceRenderer::GetInstanceCount()
+{
+	return (unsigned int)instances.size();
+}
+
+unsigned int InstanceRenderer::GetInstanceId(unsigned int instance)
+{
+	return instanceIds[instance];
+}
+
+const std::vector<unsigned int>& InstanceRenderer::GetUnbatchedIds()
+{
+	return unbatchedIds;
+}
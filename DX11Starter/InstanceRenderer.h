@@ -0,0 +1,94 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "Mesh.h"
+#include "Material.h"
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// What InstancedVS reads per copy of a mesh, in the layouts
+// GameEntity keeps them (world transposed, transWorld as the
+// plain inverse)
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInverseTranspose;
+};
+
+// --------------------------------------------------------
+// A run of instances sharing a mesh, material and detail
+// level, drawn with one call
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	Mesh* BatchMesh;
+	Material* BatchMaterial;
+	unsigned int Lod;
+	unsigned int FirstInstance;
+	unsigned int InstanceCount;
+};
+
+// --------------------------------------------------------
+// Groups a frame's objects by (mesh, material, LOD) and
+// draws each group large enough to be worth it with a
+// single DrawIndexedInstanced, their matrices all uploaded
+// to one dynamic vertex buffer in one go
+//
+// Each frame: Clear(), Add() every object, Build(), Draw().
+// Objects left out of batches are for the caller to draw
+// one at a time (see GetUnbatchedIds)
+// --------------------------------------------------------
+class InstanceRenderer
+{
+public:
+	// device       - Makes the instance buffer (0 to only batch, with no GPU)
+	// maxInstances - Starting size of the buffer, which grows as needed
+	InstanceRenderer(ID3D11Device* device, unsigned int maxInstances);
+	~InstanceRenderer();
+
+	void Clear();
+	// id is the caller's name for the object, handed back by
+	// GetInstanceId and GetUnbatchedIds
+	void Add(Mesh* mesh, Material* material, unsigned int lod,
+		const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose, unsigned int id);
+	// Sorts what was added into batches.  Groups of fewer than
+	// minInstances are left unbatched
+	void Build(unsigned int minInstances);
+	// Uploads the instances and draws every batch, binding meshes
+	// and materials only when they change
+	void Draw(RenderBackend* backend);
+
+	unsigned int GetBatchCount();
+	const InstanceBatch& GetBatch(unsigned int batch);
+	unsigned int GetInstanceCount();
+	unsigned int GetInstanceId(unsigned int instance);
+	const std::vector<unsigned int>& GetUnbatchedIds();
+
+private:
+	struct InstanceItem
+	{
+		Mesh* ItemMesh;
+		Material* ItemMaterial;
+		unsigned int Lod;
+		unsigned int Added;		// Into added
+	};
+
+	ID3D11Device* device;
+	ID3D11Buffer* instanceBuffer;
+	unsigned int bufferCapacity;
+
+	std::vector<InstanceItem> items;
+	std::vector<InstanceData> added;
+	std::vector<unsigned int> addedIds;
+
+	// Built, in batch order
+	std::vector<InstanceBatch> batches;
+	std::vector<InstanceData> instances;
+	std::vector<unsigned int> instanceIds;
+	std::vector<unsigned int> unbatchedIds;
+
+	void CreateInstanceBuffer(unsigned int capacity);
+};
@@ -0,0 +1,64 @@
+// Vertex shader for drawing many copies of a mesh at once
+// - Same input and output as VertexShader.hlsl, but each copy's
+//   matrices come from the instance buffer (see InstanceRenderer)
+// - Rows are laid out as Game keeps its matrices: world
+//   transposed, transWorld as the plain inverse
+
+// Shared with every shader - set once a frame.  Every shader
+// declaring it must lay it out the same, or gets its own
+cbuffer perFrame : register(b1)
+{
+	matrix view;
+	matrix projection;
+	float time;		// Seconds since the game started
+};
+
+// Matches Vertex and InstanceData.  SimpleShader reads
+// _PER_INSTANCE semantics from vertex buffer slot 1
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float2 uv           : TEXCOORD;
+	float3 normal       : NORMAL;
+	float4 tangent      : TANGENT;
+
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+	float4 transWorld0	: TRANSWORLD_PER_INSTANCE0;
+	float4 transWorld1	: TRANSWORLD_PER_INSTANCE1;
+	float4 transWorld2	: TRANSWORLD_PER_INSTANCE2;
+	float4 transWorld3	: TRANSWORLD_PER_INSTANCE3;
+};
+
+// Same as VertexShader.hlsl
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal       : NORMAL;
+	float3 worldPos		: POSITION;
+	float2 uv           : TEXCOORD;
+	float4 tangent      : TANGENT;
+};
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	// Built from rows, these are the transposes of the cbuffer
+	// versions, so vectors go on the right
+	float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+	float3x3 transWorld = (float3x3)float4x4(input.transWorld0, input.transWorld1, input.transWorld2, input.transWorld3);
+
+	float4 worldPos = mul(world, float4(input.position, 1.0f));
+	output.position = mul(mul(worldPos, view), projection);
+	output.worldPos = worldPos.xyz;
+
+	output.normal = normalize(mul(transWorld, input.normal));
+	output.tangent.xyz = normalize(mul(transWorld, input.tangent.xyz));
+	output.tangent.w = input.tangent.w;
+	output.uv = input.uv;
+
+	return output;
+}
@@ -0,0 +1,172 @@
+#include "JobSystem.h"
+
+// Which queue belongs to the running thread.  Threads the
+// system didn't start (including the one that made it) use 0
+static thread_local unsigned int currentThread = 0;
+
+JobSystem::JobSystem(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	this->threadCount = threadCount;
+	queues = new WorkerQueue[threadCount];
+	queuedJobs = 0;
+	quit = false;
+
+	// The calling thread is thread 0, so it only needs the others
+	for (unsigned int t = 1; t < threadCount; t++)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, t));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+
+	delete[] queues;
+}
+
+unsigned int JobSystem::GetThreadCount()
+{
+	return threadCount;
+}
+
+void JobSystem::Run(JobFunction function, void* data, unsigned int first, unsigned int last, JobCounter* counter)
+{
+	Job job = { function, data, first, last, counter };
+	if (counter)
+		counter->Pending++;
+	Push(job);
+	WakeWorkers(1);
+}
+
+void JobSystem::ParallelFor(JobFunction function, void* data, unsigned int count, unsigned int grain, JobCounter* counter)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	unsigned int jobCount = (count + grain - 1) / grain;
+	if (counter)
+		counter->Pending += jobCount;
+
+	for (unsigned int first = 0; first < count; first += grain)
+	{
+		unsigned int last = count - first > grain ? first + grain : count;
+		Job job = { function, data, first, last, counter };
+		Push(job);
+	}
+	WakeWorkers(jobCount);
+}
+
+// --------------------------------------------------------
+// Joins - rather than sleep, the waiting thread runs jobs
+// (its own first, then stolen ones) until the counter's
+// jobs are all done
+// --------------------------------------------------------
+void JobSystem::Wait(JobCounter* counter)
+{
+	unsigned int thread = currentThread < threadCount ? currentThread : 0;
+	while (counter->Pending > 0)
+	{
+		Job job;
+		if (TakeJob(thread, &job))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::Push(const Job& job)
+{
+	// Counted before it's visible, so taking it never sees zero
+	queuedJobs++;
+
+	unsigned int thread = currentThread < threadCount ? currentThread : 0;
+	WorkerQueue& queue = queues[thread];
+	std::lock_guard<std::mutex> lock(queue.Lock);
+	queue.Jobs.push_back(job);
+}
+
+void JobSystem::WakeWorkers(unsigned int jobCount)
+{
+	if (workers.empty())
+		return;
+
+	// Taking the lock orders this after any worker's check of
+	// queuedJobs, so none can miss the wake up and sleep
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+	}
+	if (jobCount == 1)
+		wake.notify_one();
+	else
+		wake.notify_all();
+}
+
+// --------------------------------------------------------
+// Takes the newest job from the thread's own queue, or
+// failing that the oldest job from another thread's
+// --------------------------------------------------------
+bool JobSystem::TakeJob(unsigned int thread, Job* job)
+{
+	{
+		WorkerQueue& queue = queues[thread];
+		std::lock_guard<std::mutex> lock(queue.Lock);
+		if (!queue.Jobs.empty())
+		{
+			*job = queue.Jobs.back();
+			queue.Jobs.pop_back();
+			queuedJobs--;
+			return true;
+		}
+	}
+
+	for (unsigned int i = 1; i < threadCount; i++)
+	{
+		WorkerQueue& victim = queues[(thread + i) % threadCount];
+		std::lock_guard<std::mutex> lock(victim.Lock);
+		if (!victim.Jobs.empty())
+		{
+			*job = victim.Jobs.front();
+			victim.Jobs.pop_front();
+			queuedJobs--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	job.Function(job.Data, job.First, job.Last);
+	if (job.Counter)
+		job.Counter->Pending--;
+}
+
+void JobSystem::WorkerLoop(unsigned int thread)
+{
+	currentThread = thread;
+	while (!quit)
+	{
+		Job job;
+		if (TakeJob(thread, &job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+		wake.wait(lock, [this]() { return queuedJobs > 0 || quit; });
+	}
+}
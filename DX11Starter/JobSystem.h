@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Work done by one job - the items [first, last) of
+// whatever data points to
+// --------------------------------------------------------
+typedef void (*JobFunction)(void* data, unsigned int first, unsigned int last);
+
+// --------------------------------------------------------
+// Counts the unfinished jobs of one fork.  Jobs add to it
+// when queued and take away when done, so a join is just
+// waiting for it to reach zero
+// --------------------------------------------------------
+struct JobCounter
+{
+	std::atomic<unsigned int> Pending;
+
+	JobCounter() : Pending(0) { }
+};
+
+struct Job
+{
+	JobFunction Function;
+	void* Data;
+	unsigned int First;
+	unsigned int Last;
+	JobCounter* Counter;	// 0 if nothing waits on the job
+};
+
+// --------------------------------------------------------
+// Runs jobs across every core
+//
+// Each thread (the one that made the system is thread 0)
+// has its own queue.  A thread queues and takes its own jobs
+// at the back, so forked work stays warm in its cache, and
+// an idle thread steals from the front of the others'
+// queues, taking the oldest (usually largest) work.  Idle
+// workers sleep until something is queued
+//
+// Waiting on a counter runs queued jobs in the meantime, so
+// jobs can fork and join jobs of their own
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	// threadCount - Threads to run jobs on, including the calling
+	//               thread (0 for one per hardware thread)
+	JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+
+	unsigned int GetThreadCount();
+
+	// Queues one job over [first, last)
+	void Run(JobFunction function, void* data, unsigned int first, unsigned int last, JobCounter* counter);
+	// Queues [0, count) split into jobs of at most grain items
+	void ParallelFor(JobFunction function, void* data, unsigned int count, unsigned int grain, JobCounter* counter);
+	// Runs jobs until every job on counter is done
+	void Wait(JobCounter* counter);
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex Lock;
+		std::deque<Job> Jobs;
+	};
+
+	unsigned int threadCount;
+	WorkerQueue* queues;
+	std::vector<std::thread> workers;
+
+	// Sleeping workers wake when jobs are queued or on shutdown
+	std::atomic<unsigned int> queuedJobs;
+	std::atomic<bool> quit;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+
+	void Push(const Job& job);
+	void WakeWorkers(unsigned int jobCount);
+	bool TakeJob(unsigned int thread, Job* job);
+	void Execute(const Job& job);
+	void WorkerLoop(unsigned int thread);
+};
@@ -0,0 +1,204 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --------------------------------------------------------
+// Constructor - nothing is mapped until Open() is called
+// --------------------------------------------------------
+MappedFile::MappedFile()
+{
+	data = 0;
+	size = 0;
+	view = 0;
+	viewSize = 0;
+	fileSize = 0;
+
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = 0;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+// --------------------------------------------------------
+// Destructor - Unmaps the file if it is still open
+// --------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// --------------------------------------------------------
+// Maps the entire file into memory as read-only
+//
+// file - Path of the file to map
+//
+// Returns true if the file is mapped, false otherwise.  Empty
+// files can't be mapped, so they also return false
+// --------------------------------------------------------
+bool MappedFile::Open(const char* file)
+{
+	if (!OpenUnmapped(file))
+		return false;
+
+	// Files bigger than the address space can't be mapped whole
+	if (fileSize != (size_t)fileSize || !MapWindow(0, (size_t)fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Opens a file for reading through MapWindow(), without
+// mapping any of it yet
+//
+// file - Path of the file to open
+//
+// Returns true if the file is open, false otherwise.  Empty
+// files can't be mapped, so they also return false
+// --------------------------------------------------------
+bool MappedFile::OpenUnmapped(const char* file)
+{
+	// Clean up first, in the event this method is
+	// called more than once on the same object
+	Close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(
+		file,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER sizeInfo;
+	if (!GetFileSizeEx(fileHandle, &sizeInfo) || sizeInfo.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mappingHandle)
+	{
+		Close();
+		return false;
+	}
+	fileSize = (unsigned long long)sizeInfo.QuadPart;
+#else
+	fileDescriptor = open(file, O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileInfo;
+	if (fstat(fileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	fileSize = (unsigned long long)fileInfo.st_size;
+#endif
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Maps part of the file, unmapping whatever was mapped before
+//
+// offset     - Where in the file the window starts
+// windowSize - Bytes to map (clamped to the end of the file)
+//
+// Returns true if the window is mapped, after which GetData()
+// points at the byte at "offset" and GetSize() is its size
+// --------------------------------------------------------
+bool MappedFile::MapWindow(unsigned long long offset, size_t windowSize)
+{
+	Unmap();
+	if (offset >= fileSize)
+		return false;
+	if (windowSize > fileSize - offset)
+		windowSize = (size_t)(fileSize - offset);
+
+	// Views have to start on the OS's allocation granularity
+#ifdef _WIN32
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	unsigned long long granularity = systemInfo.dwAllocationGranularity;
+#else
+	unsigned long long granularity = (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+	unsigned long long viewOffset = offset - offset % granularity;
+	size_t lead = (size_t)(offset - viewOffset);
+
+#ifdef _WIN32
+	view = MapViewOfFile(mappingHandle, FILE_MAP_READ,
+		(DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xFFFFFFFF),
+		lead + windowSize);
+	if (!view)
+		return false;
+#else
+	view = mmap(0, lead + windowSize, PROT_READ, MAP_PRIVATE, fileDescriptor, (off_t)viewOffset);
+	if (view == MAP_FAILED)
+	{
+		view = 0;
+		return false;
+	}
+
+	// We read front to back, so let the OS read ahead
+	madvise(view, lead + windowSize, MADV_SEQUENTIAL);
+#endif
+
+	viewSize = lead + windowSize;
+	data = (const char*)view + lead;
+	size = windowSize;
+	return true;
+}
+
+// --------------------------------------------------------
+// Unmaps the current view, if there is one
+// --------------------------------------------------------
+void MappedFile::Unmap()
+{
+#ifdef _WIN32
+	if (view) { UnmapViewOfFile(view); }
+#else
+	if (view) { munmap(view, viewSize); }
+#endif
+
+	view = 0;
+	viewSize = 0;
+	data = 0;
+	size = 0;
+}
+
+// --------------------------------------------------------
+// Unmaps the file and releases the OS handles
+// --------------------------------------------------------
+void MappedFile::Close()
+{
+	Unmap();
+
+#ifdef _WIN32
+	if (mappingHandle) { CloseHandle(mappingHandle); mappingHandle = 0; }
+	if (fileHandle != INVALID_HANDLE_VALUE) { CloseHandle(fileHandle); fileHandle = INVALID_HANDLE_VALUE; }
+#else
+	if (fileDescriptor >= 0) { close(fileDescriptor); fileDescriptor = -1; }
+#endif
+
+	fileSize = 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Read-only memory mapping of a file on disk
+//
+// Uses CreateFileMapping on Windows and mmap everywhere
+// else, so loaders can parse files in place without
+// copying them into their own buffers first
+//
+// Files too big to keep mapped can be opened with
+// OpenUnmapped, and then viewed one window at a time
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Opens and maps the whole file - returns false on failure
+	bool Open(const char* file);
+	void Close();
+
+	// Opens the file without mapping any of it
+	bool OpenUnmapped(const char* file);
+
+	// Replaces the current view with one of part of the file
+	bool MapWindow(unsigned long long offset, size_t windowSize);
+
+	bool IsOpen() { return fileSize != 0; }
+	const char* GetData() { return data; }
+	size_t GetSize() { return size; }
+	unsigned long long GetFileSize() { return fileSize; }
+
+private:
+	// The current view - data may be past the start of the
+	// mapping, since mappings must start on an aligned offset
+	const char* data;
+	size_t size;
+	void* view;
+	size_t viewSize;
+	unsigned long long fileSize;
+
+	void Unmap();
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+};
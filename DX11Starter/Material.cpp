@@ -18,14 +18,6 @@ Material::~Material() {
 	
 
 }
-void Material::VertexShaderSetMatrices(DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection, DirectX::XMFLOAT4X4 transWorld) {
-
-	vertexShader->SetMatrix4x4("world", world);
-	vertexShader->SetMatrix4x4("view", view);
-	vertexShader->SetMatrix4x4("projection", projection);
-	vertexShader->SetMatrix4x4("transWorld", transWorld);
-}
-
 void Material::VertexShaderCopyAllBufferData() {
 
 	vertexShader->CopyAllBufferData();
@@ -52,13 +44,31 @@ ID3D11SamplerState* Material::GetSamplerState() {
 
 	return sampState;
 }
-void Material::SetSamplerState(std::string name) {
+SimpleVertexShader* Material::GetVertexShader() {
+
+	return vertexShader;
+}
+SimplePixelShader* Material::GetPixelShader() {
+
+	return pixelShader;
+}
+void Material::SetSamplerState(const std::string& name) {
 
 	pixelShader->SetSamplerState(name, sampState);
 }
-void Material::SetShaderResourceView(std::string name) {
+void Material::SetShaderResourceView(const std::string& name) {
 	pixelShader->SetShaderResourceView(name, SRView);
 }
-void Material::SetShaderResourceNormalMapView(std::string name) {
+void Material::SetShaderResourceNormalMapView(const std::string& name) {
 	pixelShader->SetShaderResourceView(name, NormalSRView);
+}
+void Material::SetSamplerState(SimpleShaderHandle handle) {
+
+	pixelShader->SetSamplerState(handle, sampState);
+}
+void Material::SetShaderResourceView(SimpleShaderHandle handle) {
+	pixelShader->SetShaderResourceView(handle, SRView);
+}
+void Material::SetShaderResourceNormalMapView(SimpleShaderHandle handle) {
+	pixelShader->SetShaderResourceView(handle, NormalSRView);
 }
\ No newline at end of file
@@ -1,21 +1,27 @@
 #pragma once
 #include "SimpleShader.h"
+#include "Vertex.h"
 
 class Material {
 public:
 	Material(SimpleVertexShader* vShader, SimplePixelShader* pShader, ID3D11ShaderResourceView* shaderResourceView, ID3D11ShaderResourceView* NormalMapSRView, ID3D11SamplerState* samplerState);
 	~Material();
 
-	void VertexShaderSetMatrices(DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection, DirectX::XMFLOAT4X4 transWorld);
 	void VertexShaderCopyAllBufferData();
 	void PixelShaderCopyAllBufferData();
 	void SetVertexShader();
 	void SetPixelShader();
-	void SetSamplerState(std::string name);
-	void SetShaderResourceView(std::string name);
-	void SetShaderResourceNormalMapView(std::string name);
+	void SetSamplerState(const std::string& name);
+	void SetShaderResourceView(const std::string& name);
+	void SetShaderResourceNormalMapView(const std::string& name);
+	// The same, by the pixel shader's handles
+	void SetSamplerState(SimpleShaderHandle handle);
+	void SetShaderResourceView(SimpleShaderHandle handle);
+	void SetShaderResourceNormalMapView(SimpleShaderHandle handle);
 	ID3D11ShaderResourceView* GetSRView();
 	ID3D11SamplerState* GetSamplerState();
+	SimpleVertexShader* GetVertexShader();
+	SimplePixelShader* GetPixelShader();
 
 private:
 	SimpleVertexShader* vertexShader;
@@ -1,6 +1,14 @@
 #include "Mesh.h"
 #include "Vertex.h"
-#include <fstream>
+#include "ObjReader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "TangentGenerator.h"
+#include "VertexCompressor.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <string>
 using namespace DirectX;
 
 Mesh::Mesh(Vertex* vertices_1,
@@ -8,185 +16,116 @@ Mesh::Mesh(Vertex* vertices_1,
 	unsigned int* indices_1,
 	int numIndice_1,ID3D11Device* device) {
 
-	// Create the VERTEX BUFFER description -----------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	numIndices = numVertices_1;
-	CreateBuffer(vertices_1, indices_1, numIndices, device);
+	vertexFormat = VERTEX_FORMAT_FULL;
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	numIndices = numIndice_1;
+	MeshLod full = { 0, (unsigned int)numIndice_1, 0.0f };
+	lods.push_back(full);
+	TangentGenerator::Generate(vertices_1, numVertices_1, indices_1, numIndice_1);
+	BuildCullingData(vertices_1, numVertices_1, indices_1);
+	CreateBuffer(vertices_1, numVertices_1, indices_1, sizeof(unsigned int), numIndice_1, device);
 }
-Mesh::Mesh(char* file, ID3D11Device* device) {
-	// File input object
-	std::ifstream obj(file);
-
-	// Check for successful open
-	if (!obj.is_open())
+Mesh::Mesh(char* file, ID3D11Device* device, unsigned int threadCount, VertexFormat format) {
+	// Start with empty buffers, in case the file can't be read
+	vertexFormat = format;
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	numIndices = 0;
+	quantization = VertexQuantization();
+	bounds.Min = bounds.Max = bounds.Center = XMFLOAT3(0, 0, 0);
+	bounds.Radius = 0.0f;
+
+	// Do we have an up to date binary cache of this file?  If so, the
+	// mapped blobs go straight into the buffers without any copies,
+	// and the bounds and meshlets come with them
+	std::string cacheFile = std::string(file) + ".meshcache";
+	MeshCache cache;
+	if (cache.Open(cacheFile.c_str(), file))
+	{
+		lods.assign(cache.GetLods(), cache.GetLods() + cache.GetLodCount());
+		bounds = *cache.GetBounds();
+		meshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + cache.GetMeshletCount());
+		numIndices = (int)cache.GetIndexCount();
+		CreateBuffer(
+			cache.GetVertices(), (int)cache.GetVertexCount(),
+			cache.GetIndices(), cache.GetIndexSize(), numIndices,
+			device);
 		return;
+	}
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
+	// Map the file and parse it in place (large files are split across threads)
 	std::vector<Vertex> verts;           // Verts we're assembling
 	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	ObjReader reader;
+	if (!reader.Read(file, verts, indices, threadCount) || indices.empty())
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-			}
-		}
+		// Still one (empty) level, so LOD 0 is always there to ask for
+		MeshLod empty = { 0, 0, 0.0f };
+		lods.push_back(empty);
+		return;
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
-
-
 	// - At this point, "verts" is a vector of Vertex structs, and can be used
 	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
 	//
 	// - The vector "indices" is similar. It's a vector of unsigned ints and
 	//    can be used directly for the index buffer: &indices[0] is the address of the first int
 	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-	// Create the VERTEX BUFFER description -----------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	numIndices = vertCounter;
-	CreateBuffer(&verts[0], &indices[0], vertCounter, device);
+	// - The reader welds identical position/uv/normal triplets, so vertices
+	//    are shared between triangles and the indices are a real index list
+	numIndices = (int)indices.size();
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Without welding we'd have had one vertex per index
+	printf("%s: %d verts (%d bytes) welded from %d (%d bytes)\n",
+		file,
+		(int)verts.size(), (int)(verts.size() * sizeof(Vertex)),
+		numIndices, (int)(numIndices * sizeof(Vertex)));
+#endif
+
+	// Reorder the triangles for the post-transform cache, then the
+	// vertices to match the new triangle order
+#if defined(DEBUG) || defined(_DEBUG)
+	VertexCacheStats before = MeshOptimizer::SimulateVertexCache(&indices[0], numIndices, (unsigned int)verts.size(), 16);
+#endif
+	MeshOptimizer::OptimizeVertexCache(&indices[0], numIndices, (unsigned int)verts.size());
+	verts.resize(MeshOptimizer::OptimizeVertexFetch(&verts[0], (unsigned int)verts.size(), &indices[0], numIndices));
+#if defined(DEBUG) || defined(_DEBUG)
+	VertexCacheStats after = MeshOptimizer::SimulateVertexCache(&indices[0], numIndices, (unsigned int)verts.size(), 16);
+	printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		file, before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+#endif
+
+	// Simplified levels of detail go after the full mesh, in the same
+	// index buffer, and all of them use the same vertices
+	MeshLod lodTable[MESH_MAX_LODS];
+	unsigned int lodCount = MeshSimplifier::BuildLodChain(&verts[0], (unsigned int)verts.size(), indices, lodTable, MESH_MAX_LODS);
+	lods.assign(lodTable, lodTable + lodCount);
+#if defined(DEBUG) || defined(_DEBUG)
+	for (unsigned int l = 0; l < lodCount; l++)
+		printf("%s: LOD %u, %u triangles, error %g\n", file, l, lodTable[l].IndexCount / 3, lodTable[l].Error);
+#endif
+
+	// Finish the vertices and save them for next time
+	TangentGenerator::Generate(&verts[0], (unsigned int)verts.size(), &indices[0], numIndices, threadCount);
+#if defined(DEBUG) || defined(_DEBUG)
+	if (vertexFormat == VERTEX_FORMAT_COMPACT)
+	{
+		CompactVertexError error;
+		VertexCompressor::MeasureError(&verts[0], (unsigned int)verts.size(), &error);
+		printf("%s: compact verts %d bytes (was %d), max error pos %g uv %g normal %.3f deg tangent %.3f deg\n",
+			file, error.CompactBytes, error.FullBytes,
+			error.MaxPositionError, error.MaxUVError, error.MaxNormalError, error.MaxTangentError);
+	}
+#endif
+	BuildCullingData(&verts[0], (int)verts.size(), &indices[0]);
+	MeshCache::Write(cacheFile.c_str(), file, &verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), &lods[0], lodCount,
+		bounds, meshlets.empty() ? 0 : &meshlets[0], (unsigned int)meshlets.size());
+
+	CreateBuffer(&verts[0], (int)verts.size(), &indices[0], sizeof(unsigned int), (int)indices.size(), device);
 }
 Mesh::~Mesh(void) {
 	if (vertexBuffer) { vertexBuffer->Release(); }
@@ -205,14 +144,118 @@ int Mesh::GetIndexCount() {
 
 	return numIndices;
 }
-void Mesh::CreateBuffer(Vertex* vertices_1,
-	unsigned int* indices_1,
+
+DXGI_FORMAT Mesh::GetIndexFormat() {
+	return indexFormat;
+}
+
+unsigned int Mesh::GetVertexStride() {
+	return VertexCompressor::GetStride(vertexFormat);
+}
+
+VertexFormat Mesh::GetVertexFormat() {
+	return vertexFormat;
+}
+
+const VertexQuantization& Mesh::GetQuantization() {
+	return quantization;
+}
+
+const std::vector<Meshlet>& Mesh::GetMeshlets() {
+	return meshlets;
+}
+
+unsigned int Mesh::GetLodCount() {
+	return (unsigned int)lods.size();
+}
+
+const MeshLod& Mesh::GetLod(unsigned int lod) {
+	return lods[lod];
+}
+
+// pixelsPerUnit - Pixels one object space unit covers on screen
+// maxPixelError - Most pixels the chosen level may be off by
+unsigned int Mesh::SelectLod(float pixelsPerUnit, float maxPixelError) {
+	return MeshSimplifier::SelectLod(&lods[0], (unsigned int)lods.size(), pixelsPerUnit, maxPixelError);
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsCenter() {
+	return bounds.Center;
+}
+
+float Mesh::GetBoundsRadius() {
+	return bounds.Radius;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsMin() {
+	return bounds.Min;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsMax() {
+	return bounds.Max;
+}
+
+// Works out the bounds and the meshlets of the full detail level
+// (lods must be set).  Cached meshes load both instead
+void Mesh::BuildCullingData(const Vertex* vertices_1,
+	int numVertices_1,
+	const unsigned int* indices_1) {
+
+	// Box around the vertices, and a bounding sphere around its center
+	XMVECTOR vertexMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR vertexMax = XMVectorReplicate(-FLT_MAX);
+	for (int v = 0; v < numVertices_1; v++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices_1[v].Position);
+		vertexMin = XMVectorMin(vertexMin, p);
+		vertexMax = XMVectorMax(vertexMax, p);
+	}
+	XMVECTOR center = (vertexMin + vertexMax) * 0.5f;
+	float radiusSq = 0.0f;
+	for (int v = 0; v < numVertices_1; v++)
+	{
+		float distanceSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&vertices_1[v].Position) - center));
+		if (distanceSq > radiusSq) radiusSq = distanceSq;
+	}
+	if (numVertices_1 == 0)
+		vertexMin = vertexMax = center = XMVectorZero();
+	XMStoreFloat3(&bounds.Center, center);
+	XMStoreFloat3(&bounds.Min, vertexMin);
+	XMStoreFloat3(&bounds.Max, vertexMax);
+	bounds.Radius = sqrtf(radiusSq);
+
+	// Split the full detail level into meshlets, so it can be culled in pieces
+	MeshletBuilder::Build(vertices_1, numVertices_1, indices_1, lods[0].IndexCount, meshlets);
+}
+
+// indexSize - Bytes per index in indices_1 (2 or 4).  Meshes with
+//             few enough vertices always end up with 16-bit indices
+// numIndice_1 - Indices of every level of detail (lods must be set)
+// device      - 0 to only set up the CPU side, with no buffers
+void Mesh::CreateBuffer(const Vertex* vertices_1,
+	int numVertices_1,
+	const void* indices_1,
+	unsigned int indexSize,
 	int numIndice_1, ID3D11Device* device) {
+
+	// Compress the vertices first if the mesh wants the compact layout
+	std::vector<CompactVertex> compactVerts;
+	const void* vertexData = vertices_1;
+	if (vertexFormat == VERTEX_FORMAT_COMPACT && numVertices_1 > 0)
+	{
+		compactVerts.resize(numVertices_1);
+		VertexCompressor::ComputeQuantization(vertices_1, numVertices_1, &quantization);
+		VertexCompressor::Encode(vertices_1, numVertices_1, quantization, &compactVerts[0]);
+		vertexData = &compactVerts[0];
+	}
+
+	numIndices = (int)lods[0].IndexCount;	// Draw() uses the full detail level
+	if (!device)
+		return;
 	
-	CalculateTangents(vertices_1, numIndice_1, indices_1, numIndice_1);
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * numIndice_1;       // 3 = number of vertices in the buffer
+	vbd.ByteWidth = GetVertexStride() * numVertices_1;     // 3 = number of vertices in the buffer
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -221,16 +264,29 @@ void Mesh::CreateBuffer(Vertex* vertices_1,
 	// Create the proper struct to hold the initial vertex data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialVertexData1;
-	initialVertexData1.pSysMem = vertices_1;
+	initialVertexData1.pSysMem = vertexData;
 	device->CreateBuffer(&vbd, &initialVertexData1, &vertexBuffer);
 
+	// Can every index fit in 16 bits?  If so, use half the memory
+	std::vector<unsigned short> shortIndices;
+	const void* indexData = indices_1;
+	if (indexSize == sizeof(unsigned int) && numVertices_1 <= 65536)
+	{
+		const unsigned int* wideIndices = (const unsigned int*)indices_1;
+		shortIndices.resize(numIndice_1);
+		for (int i = 0; i < numIndice_1; i++)
+			shortIndices[i] = (unsigned short)wideIndices[i];
+		indexData = shortIndices.empty() ? 0 : &shortIndices[0];
+		indexSize = sizeof(unsigned short);
+	}
+	indexFormat = indexSize == sizeof(unsigned short) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
 	// Create the INDEX BUFFER description ------------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
-	numIndices = numIndice_1;
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * numIndice_1;         // 3 = number of indices in the buffer
+	ibd.ByteWidth = indexSize * numIndice_1;         // 3 = number of indices in the buffer
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -239,84 +295,9 @@ void Mesh::CreateBuffer(Vertex* vertices_1,
 	// Create the proper struct to hold the initial index data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialIndexData1;
-	initialIndexData1.pSysMem = indices_1;
+	initialIndexData1.pSysMem = indexData;
 
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
 	device->CreateBuffer(&ibd, &initialIndexData1, &indexBuffer);
 }
-
-// Calculates the tangents of the vertices in a mesh
-// Code adapted from: http://www.terathon.com/code/tangent.html
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
-{
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
-
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numVerts;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
-
-
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-
-		// Use Gram-Schmidt orthogonalize
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
-
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
-}
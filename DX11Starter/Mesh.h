@@ -5,7 +5,15 @@
 #include "SimpleShader.h"
 #include <DirectXMath.h>
 #include "Vertex.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "MeshCache.h"
 
+// --------------------------------------------------------
+// A mesh's vertex and index buffers, with its detail levels,
+// meshlets and bounds.  Made with a 0 device, it has all but
+// the buffers - enough for batching and culling without a GPU
+// --------------------------------------------------------
 class Mesh
 {
 
@@ -14,27 +22,54 @@ public:
 		int numVertices_1,
 		unsigned int* indices_1,
 		int numIndic_1,ID3D11Device* device_1);
-	Mesh(char* file, ID3D11Device* device);
+	// A file that can't be read gives an empty mesh: one empty LOD, zero bounds and no buffers
+	// threadCount - Threads used to parse the OBJ file and build its tangents (0 = all hardware threads)
+	// format      - Layout of the vertex buffer (compact meshes need CompactVS)
+	Mesh(char* file, ID3D11Device* device, unsigned int threadCount = 0, VertexFormat format = VERTEX_FORMAT_FULL);
 	~Mesh();
 	
 
 	ID3D11Buffer* GetVertexBuffer();
 	ID3D11Buffer* GetIndexBuffer();
 	int GetIndexCount();
+	DXGI_FORMAT GetIndexFormat();	// R16_UINT for meshes with up to 65536 vertices
+	unsigned int GetVertexStride();
+	VertexFormat GetVertexFormat();
+	const VertexQuantization& GetQuantization();	// Only used by compact meshes
+	const std::vector<Meshlet>& GetMeshlets();	// Cover LOD 0 only
+	unsigned int GetLodCount();
+	const MeshLod& GetLod(unsigned int lod);
+	unsigned int SelectLod(float pixelsPerUnit, float maxPixelError);
+	// Object space bounds of the vertices - a sphere, and the box
+	// it's built around
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
 	
 
 private:
 
 	int numIndices;//An integer specifying how many indices are in the mesh's index buffer
+	VertexFormat vertexFormat;
+	DXGI_FORMAT indexFormat;
+	VertexQuantization quantization;
+	std::vector<Meshlet> meshlets;	// Clusters of the index buffer, for culling
+	std::vector<MeshLod> lods;		// Index ranges of each detail level (0 = full)
+	MeshBounds bounds;
 	
 
 	// Buffers to hold actual geometry data
 	ID3D11Buffer* vertexBuffer;
 	ID3D11Buffer* indexBuffer;
-	void CreateBuffer(Vertex* vertices_1,
-		unsigned int* indices_1,
+	void BuildCullingData(const Vertex* vertices_1,
+		int numVertices_1,
+		const unsigned int* indices_1);
+	void CreateBuffer(const Vertex* vertices_1,
+		int numVertices_1,
+		const void* indices_1,
+		unsigned int indexSize,
 		int numIndice_1, ID3D11Device* device);
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 
 	
 };
@@ -0,0 +1,302 @@
+#include "MeshCache.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+// Rounds an offset up to the next multiple of 16
+#define ALIGN_16(x) (((x) + 15) & ~15u)
+
+// --------------------------------------------------------
+// Constructor - nothing is mapped until Open() is called
+// --------------------------------------------------------
+MeshCache::MeshCache()
+{
+	header = 0;
+}
+
+// --------------------------------------------------------
+// Destructor - Unmaps the cache if it is still open
+// --------------------------------------------------------
+MeshCache::~MeshCache()
+{
+	Close();
+}
+
+// --------------------------------------------------------
+// Maps a cache file and verifies it before use
+//
+// cacheFile  - Path of the cache file
+// sourceFile - Path of the OBJ the cache was built from
+//
+// Returns true if the cache exists, matches the current Vertex
+// layout, matches the source's size and time and passes its checksum
+// --------------------------------------------------------
+bool MeshCache::Open(const char* cacheFile, const char* sourceFile)
+{
+	Close();
+
+	if (!file.Open(cacheFile) || file.GetSize() < sizeof(MeshCacheHeader))
+	{
+		file.Close();
+		return false;
+	}
+
+	const MeshCacheHeader* h = (const MeshCacheHeader*)file.GetData();
+
+	// Right kind of file, and written by this version of the code?
+	MeshCacheHeader expected = {};
+	DescribeVertexLayout(&expected);
+	if (memcmp(h->Magic, "MESH", 4) != 0 ||
+		h->Version != MESH_CACHE_VERSION ||
+		h->VertexStride != expected.VertexStride ||
+		h->AttributeCount != expected.AttributeCount ||
+		memcmp(h->Attributes, expected.Attributes, sizeof(expected.Attributes)) != 0)
+	{
+		file.Close();
+		return false;
+	}
+
+	// Has the OBJ changed (or gone) since the cache was written?
+	unsigned long long sourceSize;
+	long long sourceTime;
+	if (!GetSourceStamp(sourceFile, &sourceSize, &sourceTime) ||
+		sourceSize != h->SourceSize || sourceTime != h->SourceTime)
+	{
+		file.Close();
+		return false;
+	}
+
+	// Are the blobs actually in the file?
+	unsigned long long vertexEnd = (unsigned long long)h->VertexOffset + (unsigned long long)h->VertexCount * h->VertexStride;
+	unsigned long long indexEnd = (unsigned long long)h->IndexOffset + (unsigned long long)h->IndexCount * h->IndexSize;
+	unsigned long long meshletEnd = (unsigned long long)h->MeshletOffset + (unsigned long long)h->MeshletCount * sizeof(Meshlet);
+	if ((h->IndexSize != 2 && h->IndexSize != 4) ||
+		h->VertexOffset % 16 != 0 || h->IndexOffset % 16 != 0 || h->MeshletOffset % 16 != 0 ||
+		vertexEnd > file.GetSize() || indexEnd > file.GetSize() || meshletEnd > file.GetSize() ||
+		h->LodCount == 0 || h->LodCount > MESH_MAX_LODS)
+	{
+		file.Close();
+		return false;
+	}
+
+	// Does every level fit in the index blob?
+	for (unsigned int l = 0; l < h->LodCount; l++)
+	{
+		if ((unsigned long long)h->Lods[l].IndexOffset + h->Lods[l].IndexCount > h->IndexCount)
+		{
+			file.Close();
+			return false;
+		}
+	}
+
+	// And every meshlet in the full detail level?
+	const Meshlet* meshlets = (const Meshlet*)(file.GetData() + h->MeshletOffset);
+	unsigned long long fullEnd = (unsigned long long)h->Lods[0].IndexOffset + h->Lods[0].IndexCount;
+	for (unsigned int m = 0; m < h->MeshletCount; m++)
+	{
+		if ((unsigned long long)meshlets[m].IndexOffset + meshlets[m].TriangleCount * 3ull > fullEnd)
+		{
+			file.Close();
+			return false;
+		}
+	}
+
+	// Finally, make sure the data wasn't corrupted
+	unsigned int checksum = Checksum(file.GetData() + h->VertexOffset, (size_t)(vertexEnd - h->VertexOffset), 2166136261u);
+	checksum = Checksum(file.GetData() + h->IndexOffset, (size_t)(indexEnd - h->IndexOffset), checksum);
+	checksum = Checksum(file.GetData() + h->MeshletOffset, (size_t)(meshletEnd - h->MeshletOffset), checksum);
+	if (checksum != h->Checksum)
+	{
+		file.Close();
+		return false;
+	}
+
+	header = h;
+	return true;
+}
+
+// --------------------------------------------------------
+// Unmaps the cache file
+// --------------------------------------------------------
+void MeshCache::Close()
+{
+	header = 0;
+	file.Close();
+}
+
+// --------------------------------------------------------
+// Gets the mapped vertex blob
+// --------------------------------------------------------
+const Vertex* MeshCache::GetVertices()
+{
+	if (!header) return 0;
+	return (const Vertex*)(file.GetData() + header->VertexOffset);
+}
+
+// --------------------------------------------------------
+// Gets the mapped index blob (see GetIndexSize for its type)
+// --------------------------------------------------------
+const void* MeshCache::GetIndices()
+{
+	if (!header) return 0;
+	return file.GetData() + header->IndexOffset;
+}
+
+// --------------------------------------------------------
+// Gets the mapped meshlets of LOD 0
+// --------------------------------------------------------
+const Meshlet* MeshCache::GetMeshlets()
+{
+	if (!header) return 0;
+	return (const Meshlet*)(file.GetData() + header->MeshletOffset);
+}
+
+// --------------------------------------------------------
+// Writes a cache file for a mesh
+//
+// cacheFile   - Path of the cache file to create
+// sourceFile  - Path of the OBJ the mesh came from
+// verts       - The final vertices (tangents included)
+// indices     - The final indices (stored as 16-bit when they fit)
+// lods        - The levels of detail within the indices
+// bounds      - Bounds of the vertices
+// meshlets    - The meshlets of LOD 0
+//
+// The file is written under a temporary name and renamed
+// when complete, so a crash never leaves a half-written cache
+//
+// Returns true if the cache was written
+// --------------------------------------------------------
+bool MeshCache::Write(const char* cacheFile, const char* sourceFile,
+	const Vertex* verts, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount,
+	const MeshLod* lods, unsigned int lodCount,
+	const MeshBounds& bounds,
+	const Meshlet* meshlets, unsigned int meshletCount)
+{
+	if (lodCount == 0 || lodCount > MESH_MAX_LODS)
+		return false;
+
+	MeshCacheHeader h = {};
+	memcpy(h.Magic, "MESH", 4);
+	h.Version = MESH_CACHE_VERSION;
+	DescribeVertexLayout(&h);
+	if (!GetSourceStamp(sourceFile, &h.SourceSize, &h.SourceTime))
+		return false;
+
+	h.VertexCount = vertexCount;
+	h.VertexOffset = ALIGN_16((unsigned int)sizeof(MeshCacheHeader));
+	h.IndexCount = indexCount;
+	h.IndexSize = vertexCount <= 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+	h.IndexOffset = ALIGN_16(h.VertexOffset + vertexCount * h.VertexStride);
+	h.MeshletCount = meshletCount;
+	h.MeshletOffset = ALIGN_16(h.IndexOffset + indexCount * h.IndexSize);
+	h.Bounds = bounds;
+	h.LodCount = lodCount;
+	memcpy(h.Lods, lods, lodCount * sizeof(MeshLod));
+
+	// Narrow the indices, so the cache holds exactly what Mesh uploads
+	std::vector<unsigned short> shortIndices;
+	const void* indexData = indices;
+	if (h.IndexSize == sizeof(unsigned short))
+	{
+		shortIndices.resize(indexCount);
+		for (unsigned int i = 0; i < indexCount; i++)
+			shortIndices[i] = (unsigned short)indices[i];
+		indexData = shortIndices.empty() ? 0 : &shortIndices[0];
+	}
+
+	h.Checksum = Checksum(verts, vertexCount * sizeof(Vertex), 2166136261u);
+	h.Checksum = Checksum(indexData, indexCount * h.IndexSize, h.Checksum);
+	h.Checksum = Checksum(meshlets, meshletCount * sizeof(Meshlet), h.Checksum);
+
+	// Write everything to a temporary file first
+	std::string tempFile = std::string(cacheFile) + ".tmp";
+	FILE* out = fopen(tempFile.c_str(), "wb");
+	if (!out)
+		return false;
+
+	static const char padding[16] = {};
+	bool ok =
+		fwrite(&h, sizeof(h), 1, out) == 1 &&
+		fwrite(padding, 1, h.VertexOffset - sizeof(h), out) == h.VertexOffset - sizeof(h) &&
+		fwrite(verts, sizeof(Vertex), vertexCount, out) == vertexCount &&
+		fwrite(padding, 1, h.IndexOffset - (h.VertexOffset + vertexCount * h.VertexStride), out) == h.IndexOffset - (h.VertexOffset + vertexCount * h.VertexStride) &&
+		fwrite(indexData, h.IndexSize, indexCount, out) == indexCount &&
+		fwrite(padding, 1, h.MeshletOffset - (h.IndexOffset + indexCount * h.IndexSize), out) == h.MeshletOffset - (h.IndexOffset + indexCount * h.IndexSize) &&
+		fwrite(meshlets, sizeof(Meshlet), meshletCount, out) == meshletCount;
+	ok = (fclose(out) == 0) && ok;
+
+	// Swap it into place
+	remove(cacheFile);
+	if (!ok || rename(tempFile.c_str(), cacheFile) != 0)
+	{
+		remove(tempFile.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Fills in the layout descriptor for the current Vertex struct
+// --------------------------------------------------------
+void MeshCache::DescribeVertexLayout(MeshCacheHeader* header)
+{
+	static const MeshCacheAttribute layout[] =
+	{
+		{ "POSITION", 3, offsetof(Vertex, Position) },
+		{ "TEXCOORD", 2, offsetof(Vertex, UV) },
+		{ "NORMAL",   3, offsetof(Vertex, Normal) },
+		{ "TANGENT",  4, offsetof(Vertex, Tangent) },
+	};
+
+	header->VertexStride = sizeof(Vertex);
+	header->AttributeCount = sizeof(layout) / sizeof(layout[0]);
+	memset(header->Attributes, 0, sizeof(header->Attributes));
+	memcpy(header->Attributes, layout, sizeof(layout));
+}
+
+// --------------------------------------------------------
+// Gets the size and modification time of the source file
+// --------------------------------------------------------
+bool MeshCache::GetSourceStamp(const char* sourceFile, unsigned long long* size, long long* time)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(sourceFile, &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(sourceFile, &info) != 0)
+		return false;
+#endif
+
+	*size = (unsigned long long)info.st_size;
+	*time = (long long)info.st_mtime;
+	return true;
+}
+
+// --------------------------------------------------------
+// 32-bit FNV-1a, continued from a previous hash value.  This
+// hashes a word at a time rather than a byte at a time, since
+// it runs over the whole file on every load
+// --------------------------------------------------------
+unsigned int MeshCache::Checksum(const void* data, size_t size, unsigned int hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	size_t words = size / 4;
+	for (size_t i = 0; i < words; i++)
+	{
+		unsigned int word;
+		memcpy(&word, bytes + i * 4, 4);
+		hash = (hash ^ word) * 16777619u;
+	}
+
+	for (size_t i = words * 4; i < size; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "MappedFile.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "Vertex.h"
+
+// Bump this whenever the layout of the file changes
+#define MESH_CACHE_VERSION 6
+
+// --------------------------------------------------------
+// Object space bounds of a mesh's vertices - the box, and
+// a sphere around its center
+// --------------------------------------------------------
+struct MeshBounds
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+};
+
+// --------------------------------------------------------
+// Describes one attribute of the cached vertex layout, so
+// a cache written with a different Vertex struct is rejected
+// --------------------------------------------------------
+struct MeshCacheAttribute
+{
+	char Semantic[12];				// "POSITION", "TEXCOORD", ...
+	unsigned int ComponentCount;	// Number of 32-bit floats
+	unsigned int ByteOffset;		// Offset within the vertex
+};
+
+// --------------------------------------------------------
+// Header at the start of every mesh cache file.  The vertex,
+// index and meshlet blobs follow it at 16-byte aligned offsets
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char Magic[4];					// "MESH"
+	unsigned int Version;			// MESH_CACHE_VERSION
+
+	// Source OBJ file the cache was built from
+	unsigned long long SourceSize;
+	long long SourceTime;
+
+	// Vertex layout descriptor
+	unsigned int VertexStride;
+	unsigned int AttributeCount;
+	MeshCacheAttribute Attributes[4];
+
+	// Blobs
+	unsigned int VertexCount;
+	unsigned int VertexOffset;
+	unsigned int IndexCount;
+	unsigned int IndexSize;			// Bytes per index
+	unsigned int IndexOffset;
+	unsigned int MeshletCount;		// Of LOD 0
+	unsigned int MeshletOffset;
+	unsigned int Checksum;			// FNV-1a of all three blobs
+
+	// So loading doesn't walk the vertices again
+	MeshBounds Bounds;
+
+	// Levels of detail, as ranges of the index blob
+	unsigned int LodCount;
+	MeshLod Lods[MESH_MAX_LODS];
+};
+
+// --------------------------------------------------------
+// Versioned binary cache of an imported mesh
+//
+// Written next to the OBJ after it is first parsed, then
+// memory mapped on later runs so the vertex and index blobs
+// can go straight into buffer creation without re-parsing.
+// The bounds and meshlets are kept too, so nothing has to
+// be worked out from the vertices again
+// --------------------------------------------------------
+class MeshCache
+{
+public:
+	MeshCache();
+	~MeshCache();
+
+	// Maps a cache file - returns false if it is missing, stale or corrupt
+	bool Open(const char* cacheFile, const char* sourceFile);
+	void Close();
+
+	// Writes a cache file for the given source mesh
+	static bool Write(const char* cacheFile, const char* sourceFile,
+		const Vertex* verts, unsigned int vertexCount,
+		const unsigned int* indices, unsigned int indexCount,
+		const MeshLod* lods, unsigned int lodCount,
+		const MeshBounds& bounds,
+		const Meshlet* meshlets, unsigned int meshletCount);
+
+	// Getters for the mapped data (valid until Close)
+	const Vertex* GetVertices();
+	unsigned int GetVertexCount() { return header ? header->VertexCount : 0; }
+	const void* GetIndices();
+	unsigned int GetIndexCount() { return header ? header->IndexCount : 0; }
+	unsigned int GetIndexSize() { return header ? header->IndexSize : 0; }
+	unsigned int GetLodCount() { return header ? header->LodCount : 0; }
+	const MeshLod* GetLods() { return header ? header->Lods : 0; }
+	const Meshlet* GetMeshlets();
+	unsigned int GetMeshletCount() { return header ? header->MeshletCount : 0; }
+	const MeshBounds* GetBounds() { return header ? &header->Bounds : 0; }
+	const MeshCacheHeader* GetHeader() { return header; }
+
+private:
+	MappedFile file;
+	const MeshCacheHeader* header;
+
+	static void DescribeVertexLayout(MeshCacheHeader* header);
+	static bool GetSourceStamp(const char* sourceFile, unsigned long long* size, long long* time);
+	static unsigned int Checksum(const void* data, size_t size, unsigned int hash);
+};
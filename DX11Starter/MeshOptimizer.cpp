@@ -0,0 +1,269 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Size of the LRU cache modeled while ordering triangles
+#define FORSYTH_CACHE_SIZE 32
+
+// Valences past this all get the same (tiny) score boost
+#define FORSYTH_MAX_VALENCE 64
+
+// --------------------------------------------------------
+// Scoring tables for Forsyth's algorithm.  Vertices score
+// higher when they're near the front of the cache, and
+// when they have few triangles left to draw (so we finish
+// off vertices rather than leaving stragglers)
+// --------------------------------------------------------
+struct ForsythScores
+{
+	float Cache[FORSYTH_CACHE_SIZE];
+	float Valence[FORSYTH_MAX_VALENCE + 1];
+
+	ForsythScores()
+	{
+		const float cacheDecayPower = 1.5f;
+		const float lastTriScore = 0.75f;
+		const float valenceBoostScale = 2.0f;
+		const float valenceBoostPower = 0.5f;
+
+		for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+		{
+			// The three most recent vertices get a fixed score, so
+			// we don't favor reusing the triangle we just drew
+			if (i < 3)
+				Cache[i] = lastTriScore;
+			else
+				Cache[i] = powf(1.0f - (i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), cacheDecayPower);
+		}
+
+		Valence[0] = 0.0f;
+		for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+			Valence[i] = valenceBoostScale * powf((float)i, -valenceBoostPower);
+	}
+
+	float Score(int cachePosition, unsigned int liveTriangles) const
+	{
+		// Vertices with nothing left to draw are worthless
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? Cache[cachePosition] : 0.0f;
+		return score + Valence[liveTriangles < FORSYTH_MAX_VALENCE ? liveTriangles : FORSYTH_MAX_VALENCE];
+	}
+};
+
+// --------------------------------------------------------
+// Reorders triangles to get the most out of the GPU's
+// post-transform vertex cache, using Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation"
+//
+// indices     - The index list, reordered in place
+// indexCount  - Number of indices (a multiple of 3)
+// vertexCount - Number of vertices the indices refer to
+// --------------------------------------------------------
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	static const ForsythScores scores;
+
+	unsigned int triCount = indexCount / 3;
+	if (triCount == 0 || vertexCount == 0)
+		return;
+
+	// Build vertex -> triangle adjacency (one flat array, with
+	// each vertex owning a range of it)
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (unsigned int i = 0; i < triCount * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(triCount * 3);
+	std::vector<unsigned int> adjacencyCount(vertexCount, 0);
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			adjacency[adjacencyOffset[v] + adjacencyCount[v]++] = t;
+		}
+	}
+
+	// Initial scores - nothing is in the cache yet
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScore[v] = scores.Score(-1, liveTriangles[v]);
+
+	std::vector<float> triangleScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		triangleScore[t] =
+			vertexScore[indices[t * 3 + 0]] +
+			vertexScore[indices[t * 3 + 1]] +
+			vertexScore[indices[t * 3 + 2]];
+	}
+
+	// The modeled cache, with room for a triangle's worth of overflow
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	std::vector<unsigned int> output(triCount * 3);
+	unsigned int scanCursor = 0;
+	int bestTriangle = -1;
+
+	for (unsigned int out = 0; out < triCount; out++)
+	{
+		// Nothing good in the cache?  Fall back to the next
+		// triangle in file order that hasn't been drawn yet
+		if (bestTriangle < 0)
+		{
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTriangle = (int)scanCursor;
+		}
+
+		// Emit the triangle and remove it from its vertices' lists
+		unsigned int t = (unsigned int)bestTriangle;
+		unsigned int* tri = &indices[t * 3];
+		emitted[t] = true;
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = tri[c];
+			output[out * 3 + c] = v;
+
+			unsigned int* list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int i = 0; i < adjacencyCount[v]; i++)
+			{
+				if (list[i] == t)
+				{
+					list[i] = list[--adjacencyCount[v]];
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// Push the triangle's vertices to the front of the cache
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+			newCache[newCount++] = tri[c];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that was or is in the cache, and
+		// pass the change in score along to the vertex's triangles
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+
+			float score = scores.Score(cachePosition[v], liveTriangles[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			unsigned int* list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int j = 0; j < adjacencyCount[v]; j++)
+				triangleScore[list[j]] += delta;
+		}
+
+		// Only once every score is final, pick the best triangle
+		// touching the cache (a triangle shares up to three of its
+		// vertices, so scanning as we go could pick a stale score)
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			unsigned int* list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int j = 0; j < adjacencyCount[v]; j++)
+			{
+				unsigned int adjacent = list[j];
+				if (triangleScore[adjacent] > bestScore)
+				{
+					bestScore = triangleScore[adjacent];
+					bestTriangle = (int)adjacent;
+				}
+			}
+		}
+
+		// Anything past the end of the cache has been evicted
+		cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+	}
+
+	memcpy(indices, &output[0], triCount * 3 * sizeof(unsigned int));
+}
+
+// --------------------------------------------------------
+// Reorders vertices into the order the index buffer first
+// uses them, and rewrites the indices to match.  Unused
+// vertices are dropped from the end
+//
+// Returns the number of vertices still in use
+// --------------------------------------------------------
+unsigned int MeshOptimizer::OptimizeVertexFetch(Vertex* verts, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount)
+{
+	const unsigned int unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertexCount, unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertexCount);
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] == unused)
+		{
+			remap[v] = (unsigned int)reordered.size();
+			reordered.push_back(verts[v]);
+		}
+		indices[i] = remap[v];
+	}
+
+	if (!reordered.empty())
+		memcpy(verts, &reordered[0], reordered.size() * sizeof(Vertex));
+	return (unsigned int)reordered.size();
+}
+
+// --------------------------------------------------------
+// Runs an index list through a simulated FIFO post-transform
+// cache, which is how most GPUs behave
+//
+// cacheSize - Number of entries in the simulated cache
+//
+// ACMR ranges from 0.5 (ideal) to 3.0 (no reuse at all), and
+// ATVR from 1.0 (every vertex transformed once) upward
+// --------------------------------------------------------
+VertexCacheStats MeshOptimizer::SimulateVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+
+	// A vertex is in the FIFO if it was added within the last
+	// "cacheSize" misses - tracking the time it was added is
+	// cheaper than shifting an actual queue around
+	std::vector<unsigned int> addedAt(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (time - addedAt[v] > cacheSize)
+		{
+			addedAt[v] = time++;
+			stats.Misses++;
+		}
+	}
+
+	unsigned int triCount = indexCount / 3;
+	stats.ACMR = triCount ? stats.Misses / (float)triCount : 0.0f;
+	stats.ATVR = vertexCount ? stats.Misses / (float)vertexCount : 0.0f;
+	return stats;
+}
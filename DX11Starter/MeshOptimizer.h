@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Results of running an index buffer through a simulated
+// post-transform vertex cache
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	unsigned int Misses;	// Vertices the GPU would have to transform
+	float ACMR;				// Average cache miss ratio (misses per triangle)
+	float ATVR;				// Average transformed vertex ratio (misses per vertex)
+};
+
+// --------------------------------------------------------
+// CPU-side mesh optimization, run on the vertex and index
+// arrays before they are uploaded to the GPU
+//
+//  - OptimizeVertexCache reorders triangles for the GPU's
+//    post-transform vertex cache (Tom Forsyth's algorithm)
+//  - OptimizeVertexFetch then reorders the vertices to match,
+//    so vertex fetches walk memory front to back
+//  - SimulateVertexCache measures the result without a GPU
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	static void OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+	static unsigned int OptimizeVertexFetch(Vertex* verts, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
+
+	static VertexCacheStats SimulateVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize);
+};
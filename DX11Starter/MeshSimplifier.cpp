@@ -0,0 +1,671 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace DirectX;
+
+// Placeholders in the open edge tables
+#define SIMPLIFY_NO_VERTEX 0xFFFFFFFFu
+#define SIMPLIFY_MANY_VERTICES 0xFFFFFFFEu
+
+// How strongly borders and seams resist moving away from
+// themselves, relative to the faces around them
+#define SIMPLIFY_BORDER_WEIGHT 10.0f
+
+// Cost of changing a corner's UV or normal, in squared
+// distance (as a fraction of the mesh's size)
+#define SIMPLIFY_ATTRIBUTE_WEIGHT 1e-3f
+
+// Collapses that turn a triangle further than this (the cosine
+// of the angle between its old and new normals) are rejected
+#define SIMPLIFY_MIN_FLIP_COS 0.25f
+
+// A level needs at least this many triangles to be simplified
+// further, and must shrink to this fraction of the level before
+// it to be kept
+#define LOD_MIN_TRIANGLES 32
+#define LOD_MAX_REDUCTION 0.85f
+
+// Largest error a single level may add (relative to the mesh size)
+#define LOD_MAX_LEVEL_ERROR 0.1f
+
+// --------------------------------------------------------
+// How a vertex may move during simplification
+// --------------------------------------------------------
+enum SimplifyVertexKind
+{
+	SIMPLIFY_MANIFOLD,	// Interior vertex, can collapse anywhere
+	SIMPLIFY_BORDER,	// On an open edge, slides along it
+	SIMPLIFY_SEAM,		// One of two split vertices, slides along the seam
+	SIMPLIFY_LOCKED		// Anything more complex - never moves
+};
+
+// --------------------------------------------------------
+// Symmetric 4x4 error quadric, plus the total area that
+// went into it (so errors are an average squared distance)
+// --------------------------------------------------------
+struct Quadric
+{
+	float A00, A11, A22, A01, A02, A12;
+	float B0, B1, B2;
+	float C;
+	float Weight;
+
+	void AddPlane(float a, float b, float c, float d, float w)
+	{
+		A00 += a * a * w; A11 += b * b * w; A22 += c * c * w;
+		A01 += a * b * w; A02 += a * c * w; A12 += b * c * w;
+		B0 += a * d * w; B1 += b * d * w; B2 += c * d * w;
+		C += d * d * w;
+		Weight += w;
+	}
+
+	void Add(const Quadric& q)
+	{
+		A00 += q.A00; A11 += q.A11; A22 += q.A22;
+		A01 += q.A01; A02 += q.A02; A12 += q.A12;
+		B0 += q.B0; B1 += q.B1; B2 += q.B2;
+		C += q.C;
+		Weight += q.Weight;
+	}
+
+	float Error(const XMFLOAT3& p) const
+	{
+		float rx = A00 * p.x + A01 * p.y + A02 * p.z;
+		float ry = A01 * p.x + A11 * p.y + A12 * p.z;
+		float rz = A02 * p.x + A12 * p.y + A22 * p.z;
+		float r = rx * p.x + ry * p.y + rz * p.z + 2.0f * (B0 * p.x + B1 * p.y + B2 * p.z) + C;
+		return Weight > 0.0f ? fabsf(r) / Weight : fabsf(r);
+	}
+};
+
+// --------------------------------------------------------
+// A possible edge collapse, moving Vertex onto Target
+// --------------------------------------------------------
+struct Collapse
+{
+	unsigned int Vertex;
+	unsigned int Target;
+	float Cost;
+
+	bool operator<(const Collapse& other) const { return Cost < other.Cost; }
+};
+
+// --------------------------------------------------------
+// Hashes a position by its exact bits, to find split vertices
+// --------------------------------------------------------
+struct PositionKey
+{
+	unsigned int Bits[3];
+
+	bool operator==(const PositionKey& other) const
+	{
+		return memcmp(Bits, other.Bits, sizeof(Bits)) == 0;
+	}
+};
+
+struct PositionKeyHash
+{
+	size_t operator()(const PositionKey& k) const
+	{
+		return (size_t)(k.Bits[0] * 73856093u ^ k.Bits[1] * 19349663u ^ k.Bits[2] * 83492791u);
+	}
+};
+
+// --------------------------------------------------------
+// A triangle's indices, rotated so equal triangles compare
+// equal, and where it was in the index list
+// --------------------------------------------------------
+struct TriangleKey
+{
+	unsigned int V[3];
+	unsigned int Order;
+
+	bool operator<(const TriangleKey& other) const
+	{
+		if (V[0] != other.V[0]) return V[0] < other.V[0];
+		if (V[1] != other.V[1]) return V[1] < other.V[1];
+		if (V[2] != other.V[2]) return V[2] < other.V[2];
+		return Order < other.Order;
+	}
+
+	bool operator==(const TriangleKey& other) const
+	{
+		return V[0] == other.V[0] && V[1] == other.V[1] && V[2] == other.V[2];
+	}
+
+	static bool ByOrder(const TriangleKey& a, const TriangleKey& b) { return a.Order < b.Order; }
+};
+
+static inline unsigned long long EdgeKey(unsigned int a, unsigned int b)
+{
+	return ((unsigned long long)a << 32) | b;
+}
+
+static inline bool HasEdge(const std::vector<unsigned long long>& edges, unsigned int a, unsigned int b)
+{
+	return std::binary_search(edges.begin(), edges.end(), EdgeKey(a, b));
+}
+
+// --------------------------------------------------------
+// Finds each vertex's open edges (half edges with no twin
+// running the other way) and decides how it may move
+//
+// remap - The first vertex at each vertex's position
+// wedge - Ring of the vertices sharing each position
+// --------------------------------------------------------
+static void ClassifyVertices(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+	const std::vector<unsigned int>& remap, const std::vector<unsigned int>& wedge,
+	std::vector<unsigned char>& kinds, std::vector<unsigned int>& openOut, std::vector<unsigned int>& openIn,
+	std::vector<unsigned long long>& edges, std::vector<unsigned long long>& positionEdges)
+{
+	edges.resize(indexCount);
+	positionEdges.resize(indexCount);
+	for (unsigned int i = 0; i < indexCount; i += 3)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = indices[i + e];
+			unsigned int b = indices[i + (e + 1) % 3];
+			edges[i + e] = EdgeKey(a, b);
+			positionEdges[i + e] = EdgeKey(remap[a], remap[b]);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	std::sort(positionEdges.begin(), positionEdges.end());
+
+	openOut.assign(vertexCount, SIMPLIFY_NO_VERTEX);
+	openIn.assign(vertexCount, SIMPLIFY_NO_VERTEX);
+	for (unsigned int i = 0; i < indexCount; i += 3)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = indices[i + e];
+			unsigned int b = indices[i + (e + 1) % 3];
+			if (HasEdge(edges, b, a))
+				continue;
+
+			openOut[a] = openOut[a] == SIMPLIFY_NO_VERTEX ? b : SIMPLIFY_MANY_VERTICES;
+			openIn[b] = openIn[b] == SIMPLIFY_NO_VERTEX ? a : SIMPLIFY_MANY_VERTICES;
+		}
+	}
+
+	kinds.resize(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		unsigned int siblings = 1;
+		for (unsigned int s = wedge[v]; s != v && siblings < 3; s = wedge[s])
+			siblings++;
+
+		unsigned int out = openOut[v];
+		unsigned int in = openIn[v];
+		if (out == SIMPLIFY_NO_VERTEX && in == SIMPLIFY_NO_VERTEX)
+		{
+			kinds[v] = siblings == 1 ? SIMPLIFY_MANIFOLD : SIMPLIFY_LOCKED;
+		}
+		else if (out >= SIMPLIFY_MANY_VERTICES || in >= SIMPLIFY_MANY_VERTICES)
+		{
+			kinds[v] = SIMPLIFY_LOCKED;
+		}
+		else
+		{
+			// A seam edge is open, but its position has a twin edge
+			bool outSeam = HasEdge(positionEdges, remap[out], remap[v]);
+			bool inSeam = HasEdge(positionEdges, remap[v], remap[in]);
+			if (siblings == 1 && !outSeam && !inSeam)
+				kinds[v] = SIMPLIFY_BORDER;
+			else if (siblings == 2 && outSeam && inSeam)
+				kinds[v] = SIMPLIFY_SEAM;
+			else
+				kinds[v] = SIMPLIFY_LOCKED;
+		}
+	}
+
+	// Both sides of a seam have to agree, or neither can move
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		if (kinds[v] == SIMPLIFY_SEAM && kinds[wedge[v]] != SIMPLIFY_SEAM)
+			kinds[v] = kinds[wedge[v]] = SIMPLIFY_LOCKED;
+	}
+}
+
+// --------------------------------------------------------
+// Can vertex v collapse onto t?  Seam vertices also need
+// their twin to collapse onto t's twin, which is returned
+// in siblingTarget (SIMPLIFY_NO_VERTEX for other kinds)
+// --------------------------------------------------------
+static bool CanCollapse(unsigned int v, unsigned int t,
+	const std::vector<unsigned int>& remap, const std::vector<unsigned int>& wedge,
+	const std::vector<unsigned char>& kinds,
+	const std::vector<unsigned int>& openOut, const std::vector<unsigned int>& openIn,
+	unsigned int* siblingTarget)
+{
+	*siblingTarget = SIMPLIFY_NO_VERTEX;
+	if (remap[v] == remap[t])
+		return false;
+
+	switch (kinds[v])
+	{
+	case SIMPLIFY_MANIFOLD:
+		return true;
+
+	case SIMPLIFY_BORDER:
+		return t == openOut[v] || t == openIn[v];
+
+	case SIMPLIFY_SEAM:
+	{
+		if (t != openOut[v] && t != openIn[v])
+			return false;
+
+		unsigned int s = wedge[v];
+		if (remap[openOut[s]] == remap[t])
+			*siblingTarget = openOut[s];
+		else if (remap[openIn[s]] == remap[t])
+			*siblingTarget = openIn[s];
+		return *siblingTarget != SIMPLIFY_NO_VERTEX;
+	}
+
+	default:
+		return false;
+	}
+}
+
+// --------------------------------------------------------
+// Difference in UV and normal between two vertices
+// --------------------------------------------------------
+static inline float AttributeError(const Vertex& a, const Vertex& b)
+{
+	float du = a.UV.x - b.UV.x;
+	float dv = a.UV.y - b.UV.y;
+	float nx = a.Normal.x - b.Normal.x;
+	float ny = a.Normal.y - b.Normal.y;
+	float nz = a.Normal.z - b.Normal.z;
+	return (du * du + dv * dv + nx * nx + ny * ny + nz * nz) * SIMPLIFY_ATTRIBUTE_WEIGHT;
+}
+
+// --------------------------------------------------------
+// Would moving every vertex at v's position to t's position
+// turn any of the triangles around it over?
+// --------------------------------------------------------
+static bool FlipsTriangles(unsigned int v, unsigned int t, const unsigned int* indices,
+	const std::vector<unsigned int>& remap, const std::vector<XMFLOAT3>& positions,
+	const unsigned int* triangles, unsigned int triangleCount)
+{
+	unsigned int rv = remap[v];
+	unsigned int rt = remap[t];
+	XMVECTOR target = XMLoadFloat3(&positions[t]);
+
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		const unsigned int* tri = indices + triangles[i] * 3;
+		unsigned int r0 = remap[tri[0]], r1 = remap[tri[1]], r2 = remap[tri[2]];
+
+		// Triangles on the collapsing edge just disappear
+		if (r0 == rt || r1 == rt || r2 == rt)
+			continue;
+
+		XMVECTOR p0 = XMLoadFloat3(&positions[tri[0]]);
+		XMVECTOR p1 = XMLoadFloat3(&positions[tri[1]]);
+		XMVECTOR p2 = XMLoadFloat3(&positions[tri[2]]);
+		XMVECTOR before = XMVector3Cross(p1 - p0, p2 - p0);
+
+		if (r0 == rv) p0 = target;
+		if (r1 == rv) p1 = target;
+		if (r2 == rv) p2 = target;
+		XMVECTOR after = XMVector3Cross(p1 - p0, p2 - p0);
+
+		float dot = XMVectorGetX(XMVector3Dot(before, after));
+		float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+		if (dot <= SIMPLIFY_MIN_FLIP_COS * lengths)
+			return true;
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Simplifies a mesh by collapsing its cheapest edges
+//
+// Works in passes: every allowed collapse is costed and
+// sorted, then the cheapest are applied, skipping any that
+// touch a neighborhood already changed in this pass
+//
+// verts            - The vertices (positions, uvs and normals)
+// indices          - The index list to simplify (a multiple of 3)
+// targetIndexCount - Stop once the index count is this or lower
+// targetError      - Largest error allowed, as a fraction of the
+//                    mesh's largest dimension
+// destination      - Receives the indices (room for indexCount)
+// resultError      - Receives the object space error of the result
+//
+// Returns the number of indices written to destination
+// --------------------------------------------------------
+unsigned int MeshSimplifier::Simplify(const Vertex* verts, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount,
+	unsigned int targetIndexCount, float targetError,
+	unsigned int* destination, float* resultError)
+{
+	*resultError = 0.0f;
+	if (vertexCount == 0 || indexCount == 0)
+		return 0;
+
+	// Scale positions into a unit cube, so errors don't depend on the mesh's size
+	XMFLOAT3 minimum = verts[0].Position;
+	XMFLOAT3 maximum = verts[0].Position;
+	for (unsigned int v = 1; v < vertexCount; v++)
+	{
+		const XMFLOAT3& p = verts[v].Position;
+		minimum = XMFLOAT3(std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z));
+		maximum = XMFLOAT3(std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z));
+	}
+	float extent = std::max(maximum.x - minimum.x, std::max(maximum.y - minimum.y, maximum.z - minimum.z));
+	if (extent <= 0.0f)
+		extent = 1.0f;
+
+	std::vector<XMFLOAT3> positions(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		const XMFLOAT3& p = verts[v].Position;
+		positions[v] = XMFLOAT3((p.x - minimum.x) / extent, (p.y - minimum.y) / extent, (p.z - minimum.z) / extent);
+	}
+
+	// Link up the vertices that share a position (split by a seam)
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned int> wedge(vertexCount);
+	std::unordered_map<PositionKey, unsigned int, PositionKeyHash> firstAtPosition;
+	firstAtPosition.reserve(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		PositionKey key;
+		memcpy(key.Bits, &verts[v].Position, sizeof(key.Bits));
+		unsigned int first = firstAtPosition.insert(std::make_pair(key, v)).first->second;
+
+		remap[v] = first;
+		wedge[v] = v;
+		if (first != v)
+		{
+			wedge[v] = wedge[first];
+			wedge[first] = v;
+		}
+	}
+
+	// Start from the input, minus any degenerate or repeated triangles
+	// (some exports hold a second, coincident copy of every face, and
+	// those would make every edge look non-manifold)
+	std::vector<TriangleKey> seen;
+	seen.reserve(indexCount / 3);
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+			continue;
+
+		// Rotate the smallest index to the front, keeping the winding
+		TriangleKey key;
+		if (a < b && a < c)	{ key.V[0] = a; key.V[1] = b; key.V[2] = c; }
+		else if (b < c)		{ key.V[0] = b; key.V[1] = c; key.V[2] = a; }
+		else				{ key.V[0] = c; key.V[1] = a; key.V[2] = b; }
+		key.Order = i;
+		seen.push_back(key);
+	}
+	std::sort(seen.begin(), seen.end());
+	seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+
+	// Back in their original order
+	std::sort(seen.begin(), seen.end(), TriangleKey::ByOrder);
+	unsigned int count = 0;
+	for (size_t t = 0; t < seen.size(); t++)
+	{
+		destination[count++] = indices[seen[t].Order];
+		destination[count++] = indices[seen[t].Order + 1];
+		destination[count++] = indices[seen[t].Order + 2];
+	}
+
+	std::vector<unsigned char> kinds;
+	std::vector<unsigned int> openOut;
+	std::vector<unsigned int> openIn;
+	std::vector<unsigned long long> edges;
+	std::vector<unsigned long long> positionEdges;
+	ClassifyVertices(destination, count, vertexCount, remap, wedge, kinds, openOut, openIn, edges, positionEdges);
+
+	// Quadrics (one per position) from the planes of the triangles, plus
+	// planes standing up along open edges to hold borders and seams in place
+	Quadric zero = {};
+	std::vector<Quadric> quadrics(vertexCount, zero);
+	for (unsigned int i = 0; i < count; i += 3)
+	{
+		const unsigned int* tri = destination + i;
+		XMVECTOR p0 = XMLoadFloat3(&positions[tri[0]]);
+		XMVECTOR p1 = XMLoadFloat3(&positions[tri[1]]);
+		XMVECTOR p2 = XMLoadFloat3(&positions[tri[2]]);
+		XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+		float doubleArea = XMVectorGetX(XMVector3Length(normal));
+		if (doubleArea <= 0.0f)
+			continue;
+
+		normal /= doubleArea;
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, normal);
+		float d = -XMVectorGetX(XMVector3Dot(normal, p0));
+		for (int c = 0; c < 3; c++)
+			quadrics[remap[tri[c]]].AddPlane(n.x, n.y, n.z, d, doubleArea * 0.5f);
+
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = tri[e];
+			unsigned int b = tri[(e + 1) % 3];
+			if (HasEdge(edges, b, a))
+				continue;
+
+			XMVECTOR pa = XMLoadFloat3(&positions[a]);
+			XMVECTOR edge = XMLoadFloat3(&positions[b]) - pa;
+			float length = XMVectorGetX(XMVector3Length(edge));
+			if (length <= 0.0f)
+				continue;
+
+			XMVECTOR edgeNormal = XMVector3Normalize(XMVector3Cross(edge, normal));
+			XMFLOAT3 en;
+			XMStoreFloat3(&en, edgeNormal);
+			float ed = -XMVectorGetX(XMVector3Dot(edgeNormal, pa));
+			float weight = length * length * SIMPLIFY_BORDER_WEIGHT;
+			quadrics[remap[a]].AddPlane(en.x, en.y, en.z, ed, weight);
+			quadrics[remap[b]].AddPlane(en.x, en.y, en.z, ed, weight);
+		}
+	}
+
+	float costLimit = targetError * targetError;
+	float maxCost = 0.0f;
+	std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+	std::vector<unsigned int> triangles;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseTo(vertexCount);
+	std::vector<bool> locked(vertexCount);
+
+	while (count > targetIndexCount)
+	{
+		// The triangles around each position
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (unsigned int i = 0; i < count; i++)
+			triangleOffsets[remap[destination[i]] + 1]++;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		triangles.resize(count);
+		{
+			std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (unsigned int i = 0; i < count; i++)
+				triangles[fill[remap[destination[i]]]++] = i / 3;
+		}
+
+		// Cost every edge, in whichever direction is allowed and cheaper
+		collapses.clear();
+		for (unsigned int i = 0; i < count; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = destination[i + e];
+				unsigned int b = destination[i + (e + 1) % 3];
+
+				Collapse best = { 0, 0, FLT_MAX };
+				unsigned int ends[2][2] = { { a, b }, { b, a } };
+				for (int d = 0; d < 2; d++)
+				{
+					unsigned int v = ends[d][0];
+					unsigned int t = ends[d][1];
+					unsigned int siblingTarget;
+					if (!CanCollapse(v, t, remap, wedge, kinds, openOut, openIn, &siblingTarget))
+						continue;
+
+					float cost = quadrics[remap[v]].Error(positions[t]) + AttributeError(verts[v], verts[t]);
+					if (siblingTarget != SIMPLIFY_NO_VERTEX)
+						cost = std::max(cost, quadrics[remap[v]].Error(positions[t]) + AttributeError(verts[wedge[v]], verts[siblingTarget]));
+
+					if (cost < best.Cost)
+					{
+						best.Vertex = v;
+						best.Target = t;
+						best.Cost = cost;
+					}
+				}
+
+				if (best.Cost < FLT_MAX)
+					collapses.push_back(best);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		// Apply the cheapest, one per neighborhood
+		for (unsigned int v = 0; v < vertexCount; v++)
+			collapseTo[v] = v;
+		std::fill(locked.begin(), locked.end(), false);
+
+		unsigned int trianglesToRemove = (count - targetIndexCount) / 3 + 1;
+		unsigned int removed = 0;
+		for (size_t c = 0; c < collapses.size() && removed < trianglesToRemove; c++)
+		{
+			const Collapse& collapse = collapses[c];
+			if (collapse.Cost > costLimit)
+				break;
+
+			unsigned int v = collapse.Vertex;
+			unsigned int t = collapse.Target;
+			unsigned int rv = remap[v];
+			unsigned int rt = remap[t];
+			if (locked[rv] || locked[rt])
+				continue;
+
+			const unsigned int* around = &triangles[triangleOffsets[rv]];
+			unsigned int aroundCount = triangleOffsets[rv + 1] - triangleOffsets[rv];
+			if (FlipsTriangles(v, t, destination, remap, positions, around, aroundCount))
+				continue;
+
+			unsigned int siblingTarget;
+			CanCollapse(v, t, remap, wedge, kinds, openOut, openIn, &siblingTarget);
+			collapseTo[v] = t;
+			if (siblingTarget != SIMPLIFY_NO_VERTEX)
+				collapseTo[wedge[v]] = siblingTarget;
+
+			// Nothing around the collapse can change again this pass
+			for (unsigned int i = 0; i < aroundCount; i++)
+			{
+				const unsigned int* tri = destination + around[i] * 3;
+				locked[remap[tri[0]]] = locked[remap[tri[1]]] = locked[remap[tri[2]]] = true;
+			}
+			locked[rt] = true;
+
+			quadrics[rt].Add(quadrics[rv]);
+			maxCost = std::max(maxCost, collapse.Cost);
+			removed += kinds[v] == SIMPLIFY_BORDER ? 1 : 2;
+		}
+
+		if (removed == 0)
+			break;
+
+		// Rewrite the triangles, dropping the ones that collapsed away
+		unsigned int newCount = 0;
+		for (unsigned int i = 0; i < count; i += 3)
+		{
+			unsigned int a = collapseTo[destination[i]];
+			unsigned int b = collapseTo[destination[i + 1]];
+			unsigned int c = collapseTo[destination[i + 2]];
+			if (remap[a] != remap[b] && remap[b] != remap[c] && remap[a] != remap[c])
+			{
+				destination[newCount++] = a;
+				destination[newCount++] = b;
+				destination[newCount++] = c;
+			}
+		}
+		count = newCount;
+
+		ClassifyVertices(destination, count, vertexCount, remap, wedge, kinds, openOut, openIn, edges, positionEdges);
+	}
+
+	*resultError = sqrtf(maxCost) * extent;
+	return count;
+}
+
+// --------------------------------------------------------
+// Builds a chain of detail levels, each simplified from the
+// one before it and aiming for half its triangles.  Levels
+// are vertex cache optimized, and stored one after another
+//
+// indices - The full mesh going in, with every level coming out
+// lods    - Receives the index range and error of each level
+// maxLods - Room in lods (the full mesh is always level 0)
+// --------------------------------------------------------
+unsigned int MeshSimplifier::BuildLodChain(const Vertex* verts, unsigned int vertexCount,
+	std::vector<unsigned int>& indices, MeshLod* lods, unsigned int maxLods)
+{
+	lods[0].IndexOffset = 0;
+	lods[0].IndexCount = (unsigned int)indices.size();
+	lods[0].Error = 0.0f;
+	unsigned int lodCount = 1;
+
+	std::vector<unsigned int> level(indices);
+	std::vector<unsigned int> next(indices.size());
+	while (lodCount < maxLods && level.size() / 3 >= LOD_MIN_TRIANGLES)
+	{
+		unsigned int target = (unsigned int)(level.size() / 6) * 3;
+		float error;
+		unsigned int count = Simplify(verts, vertexCount, &level[0], (unsigned int)level.size(),
+			target, LOD_MAX_LEVEL_ERROR, &next[0], &error);
+
+		// Not worth keeping a level that barely changed
+		if (count == 0 || count > level.size() * LOD_MAX_REDUCTION)
+			break;
+
+		next.resize(count);
+		MeshOptimizer::OptimizeVertexCache(&next[0], count, vertexCount);
+
+		// Errors add up, since each level starts from the last one
+		MeshLod& lod = lods[lodCount++];
+		lod.IndexOffset = (unsigned int)indices.size();
+		lod.IndexCount = count;
+		lod.Error = lods[lodCount - 2].Error + error;
+		indices.insert(indices.end(), next.begin(), next.end());
+
+		level.swap(next);
+		next.resize(level.size());
+	}
+
+	return lodCount;
+}
+
+// --------------------------------------------------------
+// Picks a level of detail for the current view
+//
+// pixelsPerUnit - How many pixels one object space unit covers
+//                 at the object's distance
+// maxPixelError - Most pixels a level may be off by on screen
+// --------------------------------------------------------
+unsigned int MeshSimplifier::SelectLod(const MeshLod* lods, unsigned int lodCount,
+	float pixelsPerUnit, float maxPixelError)
+{
+	unsigned int lod = 0;
+	while (lod + 1 < lodCount && lods[lod + 1].Error * pixelsPerUnit <= maxPixelError)
+		lod++;
+	return lod;
+}
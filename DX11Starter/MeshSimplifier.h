@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Most detail levels a mesh keeps, including the full mesh
+#define MESH_MAX_LODS 5
+
+// --------------------------------------------------------
+// One level of detail - a range of the mesh's index buffer.
+// Every level shares the same vertex buffer
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int IndexOffset;
+	unsigned int IndexCount;
+	float Error;	// Object space distance the level may be off by
+};
+
+// --------------------------------------------------------
+// Mesh simplification with quadric error metrics (Garland
+// and Heckbert), collapsing edges onto existing vertices so
+// every level of detail can index the original vertices
+//
+// UV and normal seams are kept intact: vertices on a seam
+// (split vertices sharing a position) only slide along the
+// seam, together with their twin on the other side, and
+// mesh borders only slide along the border.  Collapses also
+// pay for the change in UV and normal they cause
+// --------------------------------------------------------
+class MeshSimplifier
+{
+public:
+	// Simplifies until the index count is at most targetIndexCount, or
+	// no collapse is left under targetError (relative to the mesh size).
+	// Returns the new index count, written to destination
+	static unsigned int Simplify(const Vertex* verts, unsigned int vertexCount,
+		const unsigned int* indices, unsigned int indexCount,
+		unsigned int targetIndexCount, float targetError,
+		unsigned int* destination, float* resultError);
+
+	// Appends coarser levels to indices (which starts as the full mesh),
+	// each about half the last.  Returns the number of levels in lods
+	static unsigned int BuildLodChain(const Vertex* verts, unsigned int vertexCount,
+		std::vector<unsigned int>& indices, MeshLod* lods, unsigned int maxLods);
+
+	// Picks the coarsest level whose error stays under maxPixelError
+	// pixelsPerUnit - Screen pixels covered by one object space unit
+	static unsigned int SelectLod(const MeshLod* lods, unsigned int lodCount,
+		float pixelsPerUnit, float maxPixelError);
+};
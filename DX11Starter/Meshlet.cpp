@@ -0,0 +1,271 @@
+#include "Meshlet.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+// Triangles with less (doubled) area than this have no usable
+// normal, and are left out of their meshlet's normal cone
+#define MESHLET_MIN_TRIANGLE_AREA 1e-12f
+
+// Normal cones wider than this (the smallest dot product between
+// the axis and a normal) can't be culled often enough to test
+#define MESHLET_MIN_CONE_DOT 0.1f
+
+// --------------------------------------------------------
+// Fills in a meshlet's bounding sphere and normal cone
+//
+// meshletVerts - The meshlet's distinct vertices
+// --------------------------------------------------------
+template <typename Index>
+static void ComputeMeshletBounds(const Vertex* verts, const Index* indices,
+	const unsigned int* meshletVerts, Meshlet* meshlet)
+{
+	// Bounding sphere (Ritter's) - start with the sphere across
+	// two far apart vertices, then grow it to fit any stragglers
+	XMVECTOR first = XMLoadFloat3(&verts[meshletVerts[0]].Position);
+	XMVECTOR a = first;
+	float farthest = -1.0f;
+	for (unsigned int v = 0; v < meshlet->VertexCount; v++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[meshletVerts[v]].Position);
+		float d = XMVectorGetX(XMVector3LengthSq(p - first));
+		if (d > farthest) { farthest = d; a = p; }
+	}
+
+	XMVECTOR b = a;
+	farthest = -1.0f;
+	for (unsigned int v = 0; v < meshlet->VertexCount; v++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[meshletVerts[v]].Position);
+		float d = XMVectorGetX(XMVector3LengthSq(p - a));
+		if (d > farthest) { farthest = d; b = p; }
+	}
+
+	XMVECTOR center = (a + b) * 0.5f;
+	float radius = sqrtf(farthest) * 0.5f;
+	for (unsigned int v = 0; v < meshlet->VertexCount; v++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[meshletVerts[v]].Position);
+		float d = XMVectorGetX(XMVector3Length(p - center));
+		if (d > radius)
+		{
+			// Move the center towards the vertex, just far
+			// enough to cover it and the old sphere
+			float grownRadius = (radius + d) * 0.5f;
+			center += (p - center) * ((grownRadius - radius) / d);
+			radius = grownRadius;
+		}
+	}
+
+	XMStoreFloat3(&meshlet->Center, center);
+	meshlet->Radius = radius;
+
+	// Normal cone - the axis is the average of the triangle normals,
+	// and the angle is that of the normal farthest from it.  Normals
+	// face the viewer of a clockwise (front facing) triangle
+	XMFLOAT3 normals[MESHLET_MAX_TRIANGLES];
+	unsigned int normalCount = 0;
+	XMVECTOR normalSum = XMVectorZero();
+	const Index* tri = indices + meshlet->IndexOffset;
+	for (unsigned int t = 0; t < meshlet->TriangleCount; t++, tri += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[tri[0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&verts[tri[1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&verts[tri[2]].Position);
+		XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+
+		float length = XMVectorGetX(XMVector3Length(n));
+		if (length < MESHLET_MIN_TRIANGLE_AREA)
+			continue;
+
+		n /= length;
+		normalSum += n;
+		XMStoreFloat3(&normals[normalCount++], n);
+	}
+
+	meshlet->ConeAxis = XMFLOAT3(0, 0, 0);
+	meshlet->ConeCutoff = 1.0f;
+	float sumLength = XMVectorGetX(XMVector3Length(normalSum));
+	if (normalCount == 0 || sumLength < MESHLET_MIN_TRIANGLE_AREA)
+		return;
+
+	XMVECTOR axis = normalSum / sumLength;
+	float minDot = 1.0f;
+	for (unsigned int n = 0; n < normalCount; n++)
+		minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[n]), axis)));
+
+	XMStoreFloat3(&meshlet->ConeAxis, axis);
+	if (minDot > MESHLET_MIN_CONE_DOT)
+		meshlet->ConeCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+// --------------------------------------------------------
+// Splits a mesh into meshlets of at most MESHLET_MAX_VERTICES
+// vertices and MESHLET_MAX_TRIANGLES triangles
+//
+// verts    - The mesh's vertices (only positions are used)
+// indices  - The index list (a multiple of 3), 32 or 16-bit
+// meshlets - Receives the meshlets, in index buffer order
+// --------------------------------------------------------
+template <typename Index>
+static void BuildMeshlets(const Vertex* verts, unsigned int vertexCount,
+	const Index* indices, unsigned int indexCount,
+	std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+	unsigned int triCount = indexCount / 3;
+	if (triCount == 0 || vertexCount == 0)
+		return;
+	meshlets.reserve(triCount / MESHLET_MAX_TRIANGLES + 1);
+
+	// The meshlet each vertex was last added to, so we can tell
+	// which of a triangle's vertices the current meshlet already has
+	std::vector<unsigned int> owner(vertexCount, 0xFFFFFFFF);
+	unsigned int meshletVerts[MESHLET_MAX_VERTICES];
+
+	Meshlet current = {};
+	unsigned int id = 0;
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		const Index* tri = indices + t * 3;
+
+		// How many vertices would this triangle add?
+		unsigned int newVerts = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			if (owner[tri[c]] != id &&
+				(c < 1 || tri[c] != tri[0]) &&
+				(c < 2 || tri[c] != tri[1]))
+				newVerts++;
+		}
+
+		// Full?  Finish this meshlet and start the next one here
+		if (current.TriangleCount == MESHLET_MAX_TRIANGLES ||
+			current.VertexCount + newVerts > MESHLET_MAX_VERTICES)
+		{
+			ComputeMeshletBounds(verts, indices, meshletVerts, &current);
+			meshlets.push_back(current);
+
+			current = Meshlet();
+			current.IndexOffset = t * 3;
+			id++;
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			if (owner[tri[c]] != id)
+			{
+				owner[tri[c]] = id;
+				meshletVerts[current.VertexCount++] = tri[c];
+			}
+		}
+		current.TriangleCount++;
+	}
+
+	ComputeMeshletBounds(verts, indices, meshletVerts, &current);
+	meshlets.push_back(current);
+}
+
+void MeshletBuilder::Build(const Vertex* verts, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount,
+	std::vector<Meshlet>& meshlets)
+{
+	BuildMeshlets(verts, vertexCount, indices, indexCount, meshlets);
+}
+
+void MeshletBuilder::Build(const Vertex* verts, unsigned int vertexCount,
+	const unsigned short* indices, unsigned int indexCount,
+	std::vector<Meshlet>& meshlets)
+{
+	BuildMeshlets(verts, vertexCount, indices, indexCount, meshlets);
+}
+
+// --------------------------------------------------------
+// Extracts the six clipping planes of a view * projection
+// matrix (Gribb & Hartmann), in D3D's 0 to w depth range
+// --------------------------------------------------------
+void MeshletCuller::ExtractFrustumPlanes(FXMMATRIX viewProj, XMFLOAT4 planes[6])
+{
+	// Row vectors are multiplied by the matrix's columns
+	XMMATRIX columns = XMMatrixTranspose(viewProj);
+
+	XMStoreFloat4(&planes[0], XMPlaneNormalize(columns.r[3] + columns.r[0]));	// Left
+	XMStoreFloat4(&planes[1], XMPlaneNormalize(columns.r[3] - columns.r[0]));	// Right
+	XMStoreFloat4(&planes[2], XMPlaneNormalize(columns.r[3] + columns.r[1]));	// Bottom
+	XMStoreFloat4(&planes[3], XMPlaneNormalize(columns.r[3] - columns.r[1]));	// Top
+	XMStoreFloat4(&planes[4], XMPlaneNormalize(columns.r[2]));					// Near
+	XMStoreFloat4(&planes[5], XMPlaneNormalize(columns.r[3] - columns.r[2]));	// Far
+}
+
+// --------------------------------------------------------
+// Frustum and normal cone culls a mesh's meshlets
+//
+// planes         - World space frustum planes (see ExtractFrustumPlanes)
+// cameraPosition - World space eye position, for the cone test
+// visible        - Receives a 1 or 0 for each meshlet
+// stats          - Totals to add this mesh's results to (optional)
+// --------------------------------------------------------
+void MeshletCuller::Cull(const Meshlet* meshlets, unsigned int meshletCount,
+	const XMFLOAT4X4& world, const XMFLOAT4 planes[6],
+	const XMFLOAT3& cameraPosition,
+	unsigned char* visible, MeshletCullStats* stats)
+{
+	// Bring the planes and eye into object space.  A world plane p
+	// is (world * p) in object space, which after normalizing
+	// measures object space distances, just like the bounds
+	XMMATRIX w = XMLoadFloat4x4(&world);
+	XMMATRIX worldColumns = XMMatrixTranspose(w);
+	XMVECTOR localPlanes[6];
+	for (int p = 0; p < 6; p++)
+		localPlanes[p] = XMPlaneNormalize(XMVector4Transform(XMLoadFloat4(&planes[p]), worldColumns));
+
+	XMVECTOR det;
+	XMMATRIX invWorld = XMMatrixInverse(&det, w);
+	XMVECTOR eye = XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), invWorld);
+
+	// Mirroring flips the winding order, so the cones no longer say
+	// which side gets culled - skip that test rather than guess
+	bool coneTest = XMVectorGetX(det) > 0.0f;
+
+	unsigned int frustumCulled = 0;
+	unsigned int coneCulled = 0;
+	unsigned int triangles = 0;
+	unsigned int culledTriangles = 0;
+	for (unsigned int m = 0; m < meshletCount; m++)
+	{
+		const Meshlet& meshlet = meshlets[m];
+		XMVECTOR center = XMLoadFloat3(&meshlet.Center);
+		triangles += meshlet.TriangleCount;
+
+		// Entirely behind any one plane?
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+			inside = XMVectorGetX(XMPlaneDotCoord(localPlanes[p], center)) >= -meshlet.Radius;
+
+		// Is every triangle facing away from the eye?  True if the
+		// whole sphere is past the cone's apex as seen from the eye
+		bool facingAway = false;
+		if (inside && coneTest && meshlet.ConeCutoff < 1.0f)
+		{
+			XMVECTOR toCenter = center - eye;
+			float distance = XMVectorGetX(XMVector3Length(toCenter));
+			float along = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&meshlet.ConeAxis)));
+			facingAway = along >= meshlet.ConeCutoff * distance + meshlet.Radius;
+		}
+
+		visible[m] = inside && !facingAway;
+		if (!inside) frustumCulled++;
+		if (facingAway) coneCulled++;
+		if (!visible[m]) culledTriangles += meshlet.TriangleCount;
+	}
+
+	if (stats)
+	{
+		stats->Meshlets += meshletCount;
+		stats->Triangles += triangles;
+		stats->FrustumCulled += frustumCulled;
+		stats->ConeCulled += coneCulled;
+		stats->CulledTriangles += culledTriangles;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Vertex.h"
+
+// Limits of a single meshlet (the usual mesh shader sizes, so
+// the clusters stay small enough to cull finely)
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// --------------------------------------------------------
+// A cluster of neighboring triangles from a mesh
+//
+// Each meshlet is a contiguous run of the mesh's index
+// buffer, so visible meshlets can be drawn with plain
+// DrawIndexed calls (adjacent ones merged into one)
+// --------------------------------------------------------
+struct Meshlet
+{
+	unsigned int IndexOffset;		// First index in the mesh's index buffer
+	unsigned int TriangleCount;		// At most MESHLET_MAX_TRIANGLES
+	unsigned int VertexCount;		// Distinct vertices, at most MESHLET_MAX_VERTICES
+
+	// Bounding sphere, in object space
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+
+	// Cone around every triangle normal.  ConeCutoff is the sine
+	// of its half angle, or 1 if the normals are too spread out
+	// for the meshlet to ever be backface culled
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// --------------------------------------------------------
+// Totals from culling meshlets - Cull() adds to these, so
+// one set can cover a whole frame
+// --------------------------------------------------------
+struct MeshletCullStats
+{
+	unsigned int Meshlets;
+	unsigned int Triangles;
+	unsigned int FrustumCulled;		// Meshlets outside the frustum
+	unsigned int ConeCulled;		// Meshlets facing away from the camera
+	unsigned int CulledTriangles;
+};
+
+// --------------------------------------------------------
+// Splits an indexed mesh into meshlets
+//
+// Triangles are taken in index buffer order (which is
+// already sorted for the vertex cache, so neighbors are
+// close together), starting a new meshlet whenever the
+// next triangle would break the vertex or triangle limit.
+// Indices can be 32 or 16-bit, as they are in the buffers
+// --------------------------------------------------------
+class MeshletBuilder
+{
+public:
+	static void Build(const Vertex* verts, unsigned int vertexCount,
+		const unsigned int* indices, unsigned int indexCount,
+		std::vector<Meshlet>& meshlets);
+	static void Build(const Vertex* verts, unsigned int vertexCount,
+		const unsigned short* indices, unsigned int indexCount,
+		std::vector<Meshlet>& meshlets);
+};
+
+// --------------------------------------------------------
+// CPU visibility tests for meshlets - no GPU needed, so
+// these can also be run (and timed) headlessly
+//
+// The frustum planes are transformed into each object's
+// space rather than transforming every meshlet's bounds,
+// which keeps both tests exact under non-uniform scale
+// --------------------------------------------------------
+class MeshletCuller
+{
+public:
+	// Planes of a (row vector) view * projection matrix, in the
+	// matrix's input space, normalized and facing inwards
+	static void ExtractFrustumPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6]);
+
+	// Marks each meshlet 1 (visible) or 0 (culled)
+	// world - Object to world matrix (not transposed for HLSL)
+	static void Cull(const Meshlet* meshlets, unsigned int meshletCount,
+		const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4 planes[6],
+		const DirectX::XMFLOAT3& cameraPosition,
+		unsigned char* visible, MeshletCullStats* stats);
+};
@@ -0,0 +1,818 @@
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+
+using namespace DirectX;
+
+// Largest polygon we'll triangulate - anything past this is ignored
+#define OBJ_MAX_FACE_CORNERS 32
+
+// Smallest slice of a file worth handing to its own thread
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+
+// Largest and smallest windows a streaming read maps at once.  A
+// line longer than the window can't be parsed
+#define OBJ_MAX_STREAM_WINDOW (64 * 1024 * 1024)
+#define OBJ_MIN_STREAM_WINDOW (64 * 1024)
+
+// Marks an unused slot in a weld table
+#define OBJ_EMPTY_SLOT 0xFFFFFFFFu
+
+// A negative face index with nothing that far back
+#define OBJ_BAD_INDEX 0xFFFFFFFFu
+
+// Exact powers of ten representable by a double
+static const double powersOfTen[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+	1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// --------------------------------------------------------
+// Tokenizer helpers - all of these take the current read
+// position and the end of the buffer, and never read past it
+// --------------------------------------------------------
+static inline bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
+
+static inline const char* SkipLine(const char* p, const char* end)
+{
+	while (p < end && *p != '\n')
+		p++;
+	return p < end ? p + 1 : p;
+}
+
+// --------------------------------------------------------
+// Parses a decimal float like "-0.493844" or "1.5e-3"
+//
+// Digits are accumulated into a 64-bit integer mantissa and
+// scaled by an exact power of ten at the end, which gives the
+// same result as strtof for the values OBJ exporters write
+// --------------------------------------------------------
+static const char* ParseFloat(const char* p, const char* end, float* out)
+{
+	p = SkipSpaces(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+
+	// Integer part
+	for (; p < end && IsDigit(*p); p++)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) digits++;
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+
+	// Fractional part
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && IsDigit(*p); p++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) digits++;
+				exponent--;
+			}
+		}
+	}
+
+	// Exponent
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExp = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExp = (*p == '-');
+			p++;
+		}
+
+		int e = 0;
+		for (; p < end && IsDigit(*p); p++)
+		{
+			if (e < 1000) e = e * 10 + (*p - '0');
+		}
+		exponent += negativeExp ? -e : e;
+	}
+
+	// Scale the mantissa, in steps if the exponent is out of table range
+	double value = (double)mantissa;
+	while (exponent < -22) { value /= 1e22; exponent += 22; }
+	while (exponent > 22) { value *= 1e22; exponent -= 22; }
+	if (exponent < 0)
+		value /= powersOfTen[-exponent];
+	else
+		value *= powersOfTen[exponent];
+
+	*out = (float)(negative ? -value : value);
+	return p;
+}
+
+// --------------------------------------------------------
+// Parses a face index, leaving 0 if there are no digits (OBJ
+// indices are 1-based, so 0 = missing)
+//
+// A negative index counts back from the last of the count
+// attributes read so far (-1 is the last), and is turned
+// into the usual 1-based one.  One reaching back past the
+// first is left as OBJ_BAD_INDEX, which no file can have
+// --------------------------------------------------------
+static inline const char* ParseIndex(const char* p, const char* end, size_t count, unsigned int* out)
+{
+	bool negative = p < end && *p == '-';
+	if (negative)
+		p++;
+
+	unsigned int value = 0;
+	for (; p < end && IsDigit(*p); p++)
+		value = value * 10 + (*p - '0');
+
+	if (negative)
+		value = value > 0 && value <= count ? (unsigned int)(count - value + 1) : OBJ_BAD_INDEX;
+
+	*out = value;
+	return p;
+}
+
+// Does a face corner start here?
+static inline bool IsCornerStart(const char* p, const char* end)
+{
+	return p < end && (IsDigit(*p) || *p == '-');
+}
+
+// --------------------------------------------------------
+// Constructor
+// --------------------------------------------------------
+ObjReader::ObjReader()
+{
+}
+
+// --------------------------------------------------------
+// Destructor
+// --------------------------------------------------------
+ObjReader::~ObjReader()
+{
+}
+
+// --------------------------------------------------------
+// Maps the OBJ file into memory and parses it
+//
+// file        - Path of the .obj file
+// verts       - Receives the assembled vertices
+// indices     - Receives the indices of those vertices
+// threadCount - Threads to parse with (0 = all hardware threads)
+//
+// Returns true if the file was read, false if it couldn't be opened
+// --------------------------------------------------------
+bool ObjReader::Read(const char* file, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int threadCount)
+{
+	MappedFile obj;
+	if (!obj.Open(file))
+		return false;
+
+	Parse(obj.GetData(), obj.GetData() + obj.GetSize(), verts, indices, threadCount);
+	return true;
+}
+
+// --------------------------------------------------------
+// Parses OBJ text, optionally across several threads
+//
+// The text is split on line boundaries into one chunk per
+// thread, and parsed in two passes:
+//  1. Each chunk reads its v/vt/vn lines, and the results are
+//     appended in chunk order to get the file's global arrays
+//  2. Each chunk triangulates its f lines into corners, which
+//     are then welded in chunk order into shared vertices
+// Since chunks are always merged in file order, the output is
+// identical no matter how many threads are used
+//
+// begin/end   - The range of text to parse
+// verts       - Receives the assembled vertices (replacing any already there)
+// indices     - Receives the indices of those vertices (likewise)
+// threadCount - Threads to parse with (0 = all hardware threads)
+// --------------------------------------------------------
+void ObjReader::Parse(const char* begin, const char* end, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	// Nothing's left over from an earlier read, in the outputs
+	// either, just like ReadStreaming
+	positions.clear();
+	normals.clear();
+	uvs.clear();
+	verts.clear();
+	indices.clear();
+
+	std::vector<Chunk> chunks;
+	SplitIntoChunks(begin, end, threadCount, chunks);
+	size_t chunkCount = chunks.size();
+
+	// Pass 1: attributes (chunk 0 runs on this thread)
+	std::vector<std::thread> workers;
+	for (size_t c = 1; c < chunkCount; c++)
+		workers.push_back(std::thread(ParseAttributes, &chunks[c]));
+	ParseAttributes(&chunks[0]);
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+	workers.clear();
+
+	// Merge the attributes in file order, noting how many come
+	// before each chunk for its relative indices
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t uvCount = 0;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		AttributeCounts before = { positionCount, uvCount, normalCount };
+		chunks[c].Before = before;
+		positionCount += chunks[c].Positions.size();
+		normalCount += chunks[c].Normals.size();
+		uvCount += chunks[c].UVs.size();
+	}
+	positions.reserve(positionCount);
+	normals.reserve(normalCount);
+	uvs.reserve(uvCount);
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		positions.insert(positions.end(), chunks[c].Positions.begin(), chunks[c].Positions.end());
+		normals.insert(normals.end(), chunks[c].Normals.begin(), chunks[c].Normals.end());
+		uvs.insert(uvs.end(), chunks[c].UVs.begin(), chunks[c].UVs.end());
+
+		// Done with the chunk's copy
+		std::vector<XMFLOAT3>().swap(chunks[c].Positions);
+		std::vector<XMFLOAT3>().swap(chunks[c].Normals);
+		std::vector<XMFLOAT2>().swap(chunks[c].UVs);
+	}
+
+	// Pass 2: faces, which only read the merged attribute counts
+	for (size_t c = 1; c < chunkCount; c++)
+		workers.push_back(std::thread(&ObjReader::ParseFaces, this, &chunks[c]));
+	ParseFaces(&chunks[0]);
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+
+	// Weld the corners in file order.  Corners with the same
+	// position/uv/normal indices are found with a cheap lookup on
+	// the index triplet, and new triplets are checked against the
+	// vertex values as well, since many exporters write a separate
+	// (but identical) normal for every corner of every face
+	size_t cornerCount = 0;
+	for (size_t c = 0; c < chunkCount; c++)
+		cornerCount += chunks[c].Corners.size();
+
+	std::unordered_map<Corner, unsigned int, CornerHash> weldedCorners;
+	std::unordered_map<VertexKey, unsigned int, VertexKeyHash> weldedValues;
+	weldedCorners.reserve(cornerCount / 2);
+	weldedValues.reserve(cornerCount / 4);
+	indices.reserve(cornerCount);
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		for (size_t i = 0; i < chunks[c].Corners.size(); i++)
+		{
+			const Corner& corner = chunks[c].Corners[i];
+			std::pair<std::unordered_map<Corner, unsigned int, CornerHash>::iterator, bool> result =
+				weldedCorners.insert(std::make_pair(corner, 0u));
+
+			// First time we've seen this triplet?
+			if (result.second)
+			{
+				Vertex vert;
+				MakeVertex(corner, &vert);
+
+				VertexKey key = { vert.Position, vert.UV, vert.Normal };
+				std::pair<std::unordered_map<VertexKey, unsigned int, VertexKeyHash>::iterator, bool> value =
+					weldedValues.insert(std::make_pair(key, (unsigned int)verts.size()));
+				if (value.second)
+					verts.push_back(vert);
+
+				result.first->second = value.first->second;
+			}
+
+			indices.push_back(result.first->second);
+		}
+	}
+
+	// Done with the raw attributes
+	std::vector<XMFLOAT3>().swap(positions);
+	std::vector<XMFLOAT3>().swap(normals);
+	std::vector<XMFLOAT2>().swap(uvs);
+}
+
+// --------------------------------------------------------
+// Reads an OBJ file without ever mapping or holding all of it
+//
+// The file is read through a window that slides over it in
+// two passes:
+//  1. Lines are counted, so the attribute and index arrays
+//     can be allocated once at their exact sizes
+//  2. Lines are parsed, with each face welded straight into
+//     the output through an open addressing table
+// Since faces can only use attributes from earlier lines,
+// nothing ever needs to look back outside the window
+//
+// For any file that follows that rule, as OBJ requires, the
+// output is identical to Read()'s.  Everything the read
+// allocates, plus the window, is kept under memoryBudget;
+// if the mesh won't fit, the read stops and returns false
+//
+// file         - Path of the .obj file
+// verts        - Receives the assembled vertices
+// indices      - Receives the indices of those vertices
+// memoryBudget - Most bytes the import may use, output included
+// --------------------------------------------------------
+bool ObjReader::ReadStreaming(const char* file, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, size_t memoryBudget)
+{
+	MappedFile obj;
+	if (!obj.OpenUnmapped(file))
+		return false;
+
+	// Keep the window a small part of the budget
+	size_t windowSize = std::max(std::min((size_t)OBJ_MAX_STREAM_WINDOW, memoryBudget / 16), (size_t)OBJ_MIN_STREAM_WINDOW);
+
+	// Pass 1: count the lines (stopping early means a line didn't
+	// fit in a window, or the file couldn't be mapped)
+	LineCounts counts = {};
+	unsigned long long offset = 0;
+	const char* begin;
+	const char* end;
+	while (NextWindow(obj, &offset, windowSize, &begin, &end))
+		CountLines(begin, end, &counts);
+	if (offset != obj.GetFileSize())
+		return false;
+
+	// Would the attributes and indices alone break the budget?  Most
+	// meshes also end up with about one vertex per position, and the
+	// weld table starts at the power of two that keeps them at most
+	// half full (so up to four slots a vertex)
+	unsigned long long expectedVerts = std::min(counts.Positions, counts.Triangles * 3);
+	unsigned long long slotCount = 16;
+	while (slotCount < expectedVerts * 2)
+		slotCount *= 2;
+	unsigned long long needed =
+		counts.Positions * sizeof(XMFLOAT3) +
+		counts.Normals * sizeof(XMFLOAT3) +
+		counts.UVs * sizeof(XMFLOAT2) +
+		counts.Triangles * 3 * sizeof(unsigned int) +
+		expectedVerts * sizeof(Vertex) +
+		slotCount * sizeof(unsigned int) +
+		windowSize;
+	if (needed > memoryBudget)
+		return false;
+
+	// Allocate everything once.  Vertices past the expected count
+	// are added in blocks, rather than doubling the array
+	positions.clear();
+	normals.clear();
+	uvs.clear();
+	positions.reserve((size_t)counts.Positions);
+	normals.reserve((size_t)counts.Normals);
+	uvs.reserve((size_t)counts.UVs);
+	verts.clear();
+	indices.clear();
+	verts.reserve((size_t)expectedVerts);
+	indices.reserve((size_t)(counts.Triangles * 3));
+
+	WeldTable weld;
+	GrowWeldTable(weld, verts, (size_t)slotCount);
+
+	// Pass 2: parse and weld
+	size_t vertexBlock = (size_t)(counts.Positions / 8) + 1024;
+	bool fits = true;
+	offset = 0;
+	while (fits && NextWindow(obj, &offset, windowSize, &begin, &end))
+		fits = ParseWindow(begin, end, verts, indices, weld, vertexBlock, windowSize, memoryBudget);
+	obj.Close();
+
+	// Done with the raw attributes and the table either way
+	std::vector<XMFLOAT3>().swap(positions);
+	std::vector<XMFLOAT3>().swap(normals);
+	std::vector<XMFLOAT2>().swap(uvs);
+	std::vector<unsigned int>().swap(weld.Slots);
+
+	if (!fits)
+	{
+		std::vector<Vertex>().swap(verts);
+		std::vector<unsigned int>().swap(indices);
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Maps the next window of a streaming read, trimmed back to
+// the end of its last whole line
+//
+// offset - Where the window starts, moved past what it covers
+//
+// Returns false at the end of the file, if the window can't
+// be mapped, or if a single line is longer than the window
+// --------------------------------------------------------
+bool ObjReader::NextWindow(MappedFile& obj, unsigned long long* offset, size_t windowSize, const char** begin, const char** end)
+{
+	if (*offset >= obj.GetFileSize() || !obj.MapWindow(*offset, windowSize))
+		return false;
+
+	const char* b = obj.GetData();
+	const char* e = b + obj.GetSize();
+
+	// Unless this is the end of the file, stop after the last newline
+	if (*offset + obj.GetSize() < obj.GetFileSize())
+	{
+		while (e > b && e[-1] != '\n')
+			e--;
+		if (e == b)
+			return false;
+	}
+
+	*begin = b;
+	*end = e;
+	*offset += (unsigned long long)(e - b);
+	return true;
+}
+
+// --------------------------------------------------------
+// Pass 1 of a streaming read - counts the attributes and
+// triangles in a window, without parsing any numbers
+// --------------------------------------------------------
+void ObjReader::CountLines(const char* begin, const char* end, LineCounts* counts)
+{
+	const char* p = begin;
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p + 1 >= end)
+			break;
+
+		if (p[0] == 'v' && p[1] == 'n')
+			counts->Normals++;
+		else if (p[0] == 'v' && p[1] == 't')
+			counts->UVs++;
+		else if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			counts->Positions++;
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			// Count the corners, the same way ParseFace reads them
+			int cornerCount = 0;
+			p++;
+			while (true)
+			{
+				p = SkipSpaces(p, end);
+				if (!IsCornerStart(p, end))
+					break;
+				while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+					p++;
+				cornerCount++;
+			}
+
+			cornerCount = std::min(cornerCount, OBJ_MAX_FACE_CORNERS);
+			if (cornerCount > 2)
+				counts->Triangles += cornerCount - 2;
+		}
+
+		p = SkipLine(p, end);
+	}
+}
+
+// --------------------------------------------------------
+// Pass 2 of a streaming read - parses the lines of a window,
+// welding each face's corners into the output as it goes
+//
+// Returns false if the vertices outgrow the memory budget
+// --------------------------------------------------------
+bool ObjReader::ParseWindow(const char* begin, const char* end, std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+	WeldTable& weld, size_t vertexBlock, size_t windowSize, size_t memoryBudget)
+{
+	std::vector<Corner> faceCorners;
+	faceCorners.reserve(OBJ_MAX_FACE_CORNERS * 3);
+
+	const char* p = begin;
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p + 1 >= end)
+			break;
+
+		// Check the type of line
+		if (p[0] == 'v' && p[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			p = ParseFloat(p + 2, end, &norm.x);
+			p = ParseFloat(p, end, &norm.y);
+			p = ParseFloat(p, end, &norm.z);
+			normals.push_back(norm);
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			XMFLOAT2 uv;
+			p = ParseFloat(p + 2, end, &uv.x);
+			p = ParseFloat(p, end, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			XMFLOAT3 pos;
+			p = ParseFloat(p + 1, end, &pos.x);
+			p = ParseFloat(p, end, &pos.y);
+			p = ParseFloat(p, end, &pos.z);
+			positions.push_back(pos);
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			// Faces only use what's been read before them
+			AttributeCounts counts = { positions.size(), uvs.size(), normals.size() };
+			faceCorners.clear();
+			p = ParseFace(p + 1, end, counts, faceCorners);
+
+			for (size_t i = 0; i < faceCorners.size(); i++)
+			{
+				Vertex vert;
+				MakeVertex(faceCorners[i], &vert);
+
+				// Keep the table at most half full, so probes stay short
+				if ((verts.size() + 1) * 2 > weld.Slots.size())
+				{
+					size_t grownBytes = StreamFootprint(verts, indices, weld, windowSize) + weld.Slots.size() * sizeof(unsigned int);
+					if (grownBytes > memoryBudget)
+						return false;
+					GrowWeldTable(weld, verts, weld.Slots.size() * 2);
+				}
+
+				// Look for an identical vertex
+				VertexKey key = { vert.Position, vert.UV, vert.Normal };
+				unsigned int slot = (unsigned int)VertexKeyHash()(key) & weld.Mask;
+				while (weld.Slots[slot] != OBJ_EMPTY_SLOT)
+				{
+					const Vertex& other = verts[weld.Slots[slot]];
+					VertexKey otherKey = { other.Position, other.UV, other.Normal };
+					if (otherKey == key)
+						break;
+					slot = (slot + 1) & weld.Mask;
+				}
+
+				// New vertex?  Grow the output first if it's full - the old
+				// and new arrays both exist while it's copied
+				if (weld.Slots[slot] == OBJ_EMPTY_SLOT)
+				{
+					if (verts.size() == verts.capacity())
+					{
+						size_t grownBytes = StreamFootprint(verts, indices, weld, windowSize) + (verts.size() + vertexBlock) * sizeof(Vertex);
+						if (grownBytes > memoryBudget)
+							return false;
+						verts.reserve(verts.size() + vertexBlock);
+					}
+
+					weld.Slots[slot] = (unsigned int)verts.size();
+					verts.push_back(vert);
+				}
+
+				indices.push_back(weld.Slots[slot]);
+			}
+		}
+
+		// Anything else (comments, groups, materials) is skipped
+		p = SkipLine(p, end);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Rebuilds a weld table with a new number of slots (a power
+// of two).  Every vertex is in the table, so they're simply
+// re-added, and the old slots can go first
+// --------------------------------------------------------
+void ObjReader::GrowWeldTable(WeldTable& weld, const std::vector<Vertex>& verts, size_t slotCount)
+{
+	std::vector<unsigned int>().swap(weld.Slots);
+	weld.Slots.assign(slotCount, OBJ_EMPTY_SLOT);
+	weld.Mask = (unsigned int)(slotCount - 1);
+
+	for (size_t v = 0; v < verts.size(); v++)
+	{
+		VertexKey key = { verts[v].Position, verts[v].UV, verts[v].Normal };
+		unsigned int slot = (unsigned int)VertexKeyHash()(key) & weld.Mask;
+		while (weld.Slots[slot] != OBJ_EMPTY_SLOT)
+			slot = (slot + 1) & weld.Mask;
+		weld.Slots[slot] = (unsigned int)v;
+	}
+}
+
+// --------------------------------------------------------
+// Bytes currently allocated by a streaming read
+// --------------------------------------------------------
+size_t ObjReader::StreamFootprint(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, const WeldTable& weld, size_t windowSize)
+{
+	return
+		positions.capacity() * sizeof(XMFLOAT3) +
+		normals.capacity() * sizeof(XMFLOAT3) +
+		uvs.capacity() * sizeof(XMFLOAT2) +
+		verts.capacity() * sizeof(Vertex) +
+		indices.capacity() * sizeof(unsigned int) +
+		weld.Slots.capacity() * sizeof(unsigned int) +
+		windowSize;
+}
+
+// --------------------------------------------------------
+// Splits the text into roughly equal chunks that each start
+// at the beginning of a line.  Small files get fewer chunks,
+// since starting a thread costs more than parsing them
+// --------------------------------------------------------
+void ObjReader::SplitIntoChunks(const char* begin, const char* end, unsigned int threadCount, std::vector<Chunk>& chunks)
+{
+	size_t size = (size_t)(end - begin);
+	size_t chunkCount = std::min((size_t)threadCount, size / OBJ_MIN_CHUNK_SIZE);
+	if (chunkCount < 1)
+		chunkCount = 1;
+
+	chunks.resize(chunkCount);
+	const char* chunkBegin = begin;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		// Push the split forward to the start of the next line
+		const char* chunkEnd = end;
+		if (c + 1 < chunkCount)
+		{
+			chunkEnd = begin + size * (c + 1) / chunkCount;
+			if (chunkEnd < chunkBegin)
+				chunkEnd = chunkBegin;
+			chunkEnd = SkipLine(chunkEnd, end);
+		}
+
+		chunks[c].Begin = chunkBegin;
+		chunks[c].End = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+}
+
+// --------------------------------------------------------
+// Pass 1 - reads the v, vt and vn lines of a chunk
+// --------------------------------------------------------
+void ObjReader::ParseAttributes(Chunk* chunk)
+{
+	const char* p = chunk->Begin;
+	const char* end = chunk->End;
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p + 1 >= end)
+			break;
+
+		// Check the type of line
+		if (p[0] == 'v' && p[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			p = ParseFloat(p + 2, end, &norm.x);
+			p = ParseFloat(p, end, &norm.y);
+			p = ParseFloat(p, end, &norm.z);
+			chunk->Normals.push_back(norm);
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			XMFLOAT2 uv;
+			p = ParseFloat(p + 2, end, &uv.x);
+			p = ParseFloat(p, end, &uv.y);
+			chunk->UVs.push_back(uv);
+		}
+		else if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			XMFLOAT3 pos;
+			p = ParseFloat(p + 1, end, &pos.x);
+			p = ParseFloat(p, end, &pos.y);
+			p = ParseFloat(p, end, &pos.z);
+			chunk->Positions.push_back(pos);
+		}
+
+		// Anything else (faces, comments, groups, materials) is skipped
+		p = SkipLine(p, end);
+	}
+}
+
+// --------------------------------------------------------
+// Pass 2 - triangulates the f lines of a chunk into a
+// list of corners (three per triangle).  The attribute
+// lines are only counted, for relative indices
+// --------------------------------------------------------
+void ObjReader::ParseFaces(Chunk* chunk)
+{
+	AttributeCounts counts = chunk->Before;
+	const char* p = chunk->Begin;
+	const char* end = chunk->End;
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p + 1 >= end)
+			break;
+
+		if (p[0] == 'v' && p[1] == 'n')
+			counts.Normals++;
+		else if (p[0] == 'v' && p[1] == 't')
+			counts.UVs++;
+		else if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			counts.Positions++;
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			p = ParseFace(p + 1, end, counts, chunk->Corners);
+
+		p = SkipLine(p, end);
+	}
+}
+
+// --------------------------------------------------------
+// Parses the "p/t/n p/t/n p/t/n ..." corners of a face line
+// and adds its triangles to the corner list
+//
+// counts - The attributes before the line, for negative indices
+//
+// Returns the read position after the last corner
+// --------------------------------------------------------
+const char* ObjReader::ParseFace(const char* p, const char* end, const AttributeCounts& counts, std::vector<Corner>& triangles)
+{
+	Corner corners[OBJ_MAX_FACE_CORNERS];
+	int cornerCount = 0;
+
+	while (true)
+	{
+		p = SkipSpaces(p, end);
+		if (!IsCornerStart(p, end))
+			break;
+
+		// Each corner is "position/uv/normal", where uv and normal are optional
+		Corner corner = { 0, 0, 0 };
+		p = ParseIndex(p, end, counts.Positions, &corner.Position);
+		if (p < end && *p == '/')
+		{
+			p = ParseIndex(p + 1, end, counts.UVs, &corner.UV);
+			if (p < end && *p == '/')
+				p = ParseIndex(p + 1, end, counts.Normals, &corner.Normal);
+		}
+
+		// Skip the whole face if it points at data we don't have
+		if (corner.Position == 0 ||
+			corner.Position > positions.size() ||
+			corner.UV > uvs.size() ||
+			corner.Normal > normals.size())
+			return p;
+
+		if (cornerCount < OBJ_MAX_FACE_CORNERS)
+			corners[cornerCount++] = corner;
+	}
+
+	// Fan out the polygon, flipping the winding order from
+	// right-handed to left-handed as we go.  For triangles and
+	// quads this matches (v1, v3, v2) and (v1, v4, v3)
+	for (int i = 2; i < cornerCount; i++)
+	{
+		triangles.push_back(corners[0]);
+		triangles.push_back(corners[i]);
+		triangles.push_back(corners[i - 1]);
+	}
+
+	return p;
+}
+
+// --------------------------------------------------------
+// Builds a single vertex from a corner's 1-based OBJ indices,
+// converting it from the file's right-handed space to our
+// left-handed space.  The indices must already be validated
+// --------------------------------------------------------
+void ObjReader::MakeVertex(const Corner& corner, Vertex* vert)
+{
+	vert->Position = positions[corner.Position - 1];
+	vert->UV = corner.UV ? uvs[corner.UV - 1] : XMFLOAT2(0, 0);
+	vert->Normal = corner.Normal ? normals[corner.Normal - 1] : XMFLOAT3(0, 0, 0);
+	vert->Tangent = XMFLOAT4(0, 0, 0, 1);
+
+	// Flip the UV's since they're probably "upside down", and
+	// invert the position and normal Z (RH to LH)
+	vert->UV.y = 1.0f - vert->UV.y;
+	vert->Position.z *= -1.0f;
+	vert->Normal.z *= -1.0f;
+}
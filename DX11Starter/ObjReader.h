@@ -0,0 +1,144 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstring>
+#include <vector>
+#include "MappedFile.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Fast OBJ file reader
+//
+// Maps the file into memory and parses it in place with a
+// hand-written number tokenizer (no sscanf, no locale),
+// producing an indexed mesh where every distinct
+// position/uv/normal combination is one vertex
+//
+// Files too big to hold in memory alongside the mesh can be
+// read with ReadStreaming, which walks the file a window at
+// a time and keeps the whole import under a memory budget
+// --------------------------------------------------------
+class ObjReader
+{
+public:
+	ObjReader();
+	~ObjReader();
+
+	// Reads the file into verts/indices - returns false if it can't be opened
+	//  - threadCount of 0 uses every hardware thread, 1 parses serially
+	bool Read(const char* file, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int threadCount = 1);
+
+	// Parses OBJ text that is already in memory
+	void Parse(const char* begin, const char* end, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int threadCount = 1);
+
+	// Reads the file one window at a time - returns false if it can't be
+	// opened, or the import would need more than memoryBudget bytes
+	bool ReadStreaming(const char* file, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, size_t memoryBudget);
+
+private:
+	// Raw data from the file
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<DirectX::XMFLOAT2> uvs;
+
+	// One "p/t/n" corner of a face, as 1-based OBJ indices (0 = missing)
+	struct Corner
+	{
+		unsigned int Position;
+		unsigned int UV;
+		unsigned int Normal;
+
+		bool operator==(const Corner& other) const
+		{
+			return Position == other.Position && UV == other.UV && Normal == other.Normal;
+		}
+	};
+
+	struct CornerHash
+	{
+		size_t operator()(const Corner& c) const
+		{
+			unsigned long long h = c.Position * 0x9E3779B97F4A7C15ull;
+			h ^= (c.UV + 0x7F4A7C15ull + (h << 6) + (h >> 2)) * 0xBF58476D1CE4E5B9ull;
+			h ^= (c.Normal + 0x94D049BBull + (h << 6) + (h >> 2)) * 0x94D049BB133111EBull;
+			return (size_t)(h ^ (h >> 31));
+		}
+	};
+
+	// The attributes of a vertex, compared bit for bit when welding
+	struct VertexKey
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT2 UV;
+		DirectX::XMFLOAT3 Normal;
+
+		bool operator==(const VertexKey& other) const
+		{
+			return memcmp(this, &other, sizeof(VertexKey)) == 0;
+		}
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& k) const
+		{
+			// FNV-1a over the raw bytes
+			const unsigned char* bytes = (const unsigned char*)&k;
+			unsigned long long h = 14695981039346656037ull;
+			for (size_t i = 0; i < sizeof(VertexKey); i++)
+				h = (h ^ bytes[i]) * 1099511628211ull;
+			return (size_t)h;
+		}
+	};
+
+	// How many of each attribute come before a line - negative
+	// face indices count back from these
+	struct AttributeCounts
+	{
+		size_t Positions;
+		size_t UVs;
+		size_t Normals;
+	};
+
+	// A line-aligned slice of the file, parsed by one thread
+	struct Chunk
+	{
+		const char* Begin;
+		const char* End;
+		AttributeCounts Before;	// In the chunks before this one
+		std::vector<DirectX::XMFLOAT3> Positions;
+		std::vector<DirectX::XMFLOAT3> Normals;
+		std::vector<DirectX::XMFLOAT2> UVs;
+		std::vector<Corner> Corners;
+	};
+
+	// Totals from the counting pass of a streaming read
+	struct LineCounts
+	{
+		unsigned long long Positions;
+		unsigned long long UVs;
+		unsigned long long Normals;
+		unsigned long long Triangles;
+	};
+
+	// Open addressing table of vertex indices, for welding
+	// without a node allocation per vertex
+	struct WeldTable
+	{
+		std::vector<unsigned int> Slots;	// Vertex index, or OBJ_EMPTY_SLOT
+		unsigned int Mask;
+	};
+
+	static bool NextWindow(MappedFile& obj, unsigned long long* offset, size_t windowSize, const char** begin, const char** end);
+	static void CountLines(const char* begin, const char* end, LineCounts* counts);
+	bool ParseWindow(const char* begin, const char* end, std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+		WeldTable& weld, size_t vertexBlock, size_t windowSize, size_t memoryBudget);
+	static void GrowWeldTable(WeldTable& weld, const std::vector<Vertex>& verts, size_t slotCount);
+	size_t StreamFootprint(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, const WeldTable& weld, size_t windowSize);
+
+	void SplitIntoChunks(const char* begin, const char* end, unsigned int threadCount, std::vector<Chunk>& chunks);
+	static void ParseAttributes(Chunk* chunk);
+	void ParseFaces(Chunk* chunk);
+	const char* ParseFace(const char* p, const char* end, const AttributeCounts& counts, std::vector<Corner>& triangles);
+	void MakeVertex(const Corner& corner, Vertex* vert);
+};
@@ -2,9 +2,6 @@
 // Constant buffer for C++ data being passed in
 cbuffer externalData : register(b0)
 {
-    matrix view;
-    matrix projection;
-
 	int startIndex;
 
 	float3 acceleration;
@@ -16,7 +13,14 @@ cbuffer externalData : register(b0)
 	float endSize;
 
 	float lifetime;
-	float currentTime;
+};
+
+// The camera and the time, shared with every shader
+cbuffer perFrame : register(b1)
+{
+	matrix view;
+	matrix projection;
+	float time;
 };
 
 
@@ -57,7 +61,7 @@ VertexToPixel main(uint id : SV_VertexID)
 	Particle p = ParticleData.Load(particleID + startIndex);
 
 	// Calc the age percent
-	float t = currentTime - p.SpawnTime;
+	float t = time - p.SpawnTime;
 	float agePercent = t / lifetime; // The "age percent": 0 - 1
 
 	// Calc anything based on time
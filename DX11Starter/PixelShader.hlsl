@@ -15,7 +15,7 @@ struct VertexToPixel
 	float3 normal       : NORMAL;
 	float3 worldPos		: POSITION;
 	float2 uv           : TEXCOORD;    //UV
-	float3 tangent      : TANGENT;
+	float4 tangent      : TANGENT;     //Tangent, w = handedness
 };
 
 // --------------------------------------------------------
@@ -33,6 +33,8 @@ struct DirectionaLight
 	float4 DiffuseColor;
 	float3 Direction;
 };
+
+// Shared with every shader - set once a frame
 cbuffer dLightData : register(b0)
 {
 	DirectionaLight dLight1;
@@ -60,15 +62,16 @@ SamplerState sampState : register(s0);//How you use  your texture
 float4 main(VertexToPixel input) : SV_TARGET
 {
 	input.normal = normalize(input.normal);
-	input.tangent = normalize(input.tangent);
+	float3 tangent = normalize(input.tangent.xyz);
 
 	// Sample from the normal map (and UNPACK values)
 	float3 normalFromMap = NormalTexture.Sample(sampState, input.uv).rgb * 2 - 1;
 
 	// Create the matrix that will allow us to go from tangent space to world space
+	// (the bitangent is flipped where the UVs are mirrored)
 	float3 N = input.normal;
-	float3 T = normalize(input.tangent - N * dot(input.tangent, N));
-	float3 B = cross(T, N);
+	float3 T = normalize(tangent - N * dot(tangent, N));
+	float3 B = cross(T, N) * input.tangent.w;
 	float3x3 TBN = float3x3(T, B, N);
 
 	// Overwrite the initial normal with the version from the
@@ -13,7 +13,7 @@ struct VertexToPixel
 	float4 position		: SV_POSITION;
 	float2 uv			: TEXCOORD;
 	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;
 	float3 worldPos		: POSITION;
 	noperspective float2 screenUV		: TEXCOORD1;
 };
@@ -30,15 +30,15 @@ float4 main(VertexToPixel input) : SV_TARGET
 {
 	// Fix for poor normals: re-normalizing interpolated normals
 	input.normal = normalize(input.normal);
-	input.tangent = normalize(input.tangent);
+	float3 tangent = normalize(input.tangent.xyz);
 
 	// Sample and unpack normal
 	float3 normalFromTexture = NormalMap.Sample(BasicSampler, input.uv).xyz * 2 - 1;
 
 	// Create the TBN matrix which allows us to go from TANGENT space to WORLD space
 	float3 N = input.normal;
-	float3 T = normalize(input.tangent - N * dot(input.tangent, N));
-	float3 B = cross(T, N);
+	float3 T = normalize(tangent - N * dot(tangent, N));
+	float3 B = cross(T, N) * input.tangent.w;
 	float3x3 TBN = float3x3(T, B, N);
 
 	// Overwrite the existing normal (we've been using for lighting),
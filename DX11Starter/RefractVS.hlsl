@@ -3,8 +3,15 @@
 cbuffer externalData : register(b0)
 {
 	matrix world;
+};
+
+// Shared with every shader - set once a frame.  Every shader
+// declaring it must lay it out the same, or gets its own
+cbuffer perFrame : register(b1)
+{
 	matrix view;
 	matrix projection;
+	float time;		// Seconds since the game started
 };
 
 // Struct representing a single vertex worth of data
@@ -13,7 +20,7 @@ struct VertexShaderInput
 	float3 position		: POSITION;
 	float2 uv			: TEXCOORD;
 	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;
 };
 
 // Out of the vertex shader (and eventually input to the PS)
@@ -22,7 +29,7 @@ struct VertexToPixel
 	float4 position		: SV_POSITION;
 	float2 uv			: TEXCOORD;
 	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;
 	float3 worldPos		: POSITION;
 	noperspective float2 screenUV		: TEXCOORD1;
 };
@@ -48,7 +55,8 @@ VertexToPixel main(VertexShaderInput input)
 	output.normal = normalize(output.normal); // Make sure it's length is 1
 
 	// Make sure the tangent is in WORLD space and a unit vector
-	output.tangent = normalize(mul(input.tangent, (float3x3)world));
+	output.tangent.xyz = normalize(mul(input.tangent.xyz, (float3x3)world));
+	output.tangent.w = input.tangent.w;
 
 	// Pass through the uv
 	output.uv = input.uv;
@@ -0,0 +1,194 @@
+#include "RenderBackend.h"
+
+D3D11RenderBackend::D3D11RenderBackend(ID3D11DeviceContext* context, SimpleVertexShader* instancedVS,
+	std::string samplerName, std::string textureName, std::string normalMapName)
+{
+	this->context = context;
+	this->instancedVS = instancedVS;
+	boundVS = 0;
+	worldHandle = transWorldHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	positionCenterHandle = positionExtentHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	uvOffsetHandle = uvScaleHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	samplerHandle = textureHandle = normalMapHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	this->samplerName = samplerName;
+	this->textureName = textureName;
+	this->normalMapName = normalMapName;
+	samplerNameHash = HashShaderName(samplerName);
+	textureNameHash = HashShaderName(textureName);
+	normalMapNameHash = HashShaderName(normalMapName);
+}
+
+void D3D11RenderBackend::BindShaders(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader)
+{
+	// The camera is in the shared per frame buffer already
+	boundVS = vertexShader;
+	boundVS->SetShader();
+
+	worldHandle = boundVS->GetVariableHandle(SHADER_NAME("world"));
+	transWorldHandle = boundVS->GetVariableHandle(SHADER_NAME("transWorld"));
+	positionCenterHandle = boundVS->GetVariableHandle(SHADER_NAME("positionCenter"));
+	positionExtentHandle = boundVS->GetVariableHandle(SHADER_NAME("positionExtent"));
+	uvOffsetHandle = boundVS->GetVariableHandle(SHADER_NAME("uvOffset"));
+	uvScaleHandle = boundVS->GetVariableHandle(SHADER_NAME("uvScale"));
+	samplerHandle = pixelShader->GetSamplerHandle(samplerNameHash);
+	textureHandle = pixelShader->GetShaderResourceViewHandle(textureNameHash);
+	normalMapHandle = pixelShader->GetShaderResourceViewHandle(normalMapNameHash);
+
+	pixelShader->CopyAllBufferData();
+	pixelShader->SetShader();
+}
+
+void D3D11RenderBackend::BindMaterial(Material* material)
+{
+	material->SetSamplerState(samplerHandle);
+	material->SetShaderResourceView(textureHandle);
+	material->SetShaderResourceNormalMapView(normalMapHandle);
+}
+
+void D3D11RenderBackend::BindMesh(Mesh* mesh)
+{
+	ID3D11Buffer* vertexBuffer = mesh->GetVertexBuffer();
+	UINT stride = mesh->GetVertexStride();
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	context->IASetIndexBuffer(mesh->GetIndexBuffer(), mesh->GetIndexFormat(), 0);
+
+	// Goes out with the next object's matrices
+	if (mesh->GetVertexFormat() == VERTEX_FORMAT_COMPACT)
+	{
+		const VertexQuantization& quantization = mesh->GetQuantization();
+		boundVS->SetFloat3(positionCenterHandle, quantization.PositionCenter);
+		boundVS->SetFloat3(positionExtentHandle, quantization.PositionExtent);
+		boundVS->SetFloat2(uvOffsetHandle, quantization.UVOffset);
+		boundVS->SetFloat2(uvScaleHandle, quantization.UVScale);
+	}
+}
+
+void D3D11RenderBackend::SetObjectMatrices(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose)
+{
+	boundVS->SetMatrix4x4(worldHandle, world);
+	boundVS->SetMatrix4x4(transWorldHandle, worldInverseTranspose);
+	boundVS->CopyAllBufferData();
+}
+
+void D3D11RenderBackend::DrawIndexed(unsigned int indexCount, unsigned int firstIndex)
+{
+	context->DrawIndexed(indexCount, firstIndex, 0);
+}
+
+void D3D11RenderBackend::UploadBuffer(ID3D11Buffer* buffer, const void* data, unsigned int byteCount)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	memcpy(mapped.pData, data, byteCount);
+	context->Unmap(buffer, 0);
+}
+
+void D3D11RenderBackend::BindInstancedMaterial(Material* material)
+{
+	boundVS = 0;
+	instancedVS->SetShader();
+
+	material->SetSamplerState(samplerName);
+	material->SetShaderResourceView(textureName);
+	material->SetShaderResourceNormalMapView(normalMapName);
+	material->PixelShaderCopyAllBufferData();
+	material->SetPixelShader();
+}
+
+void D3D11RenderBackend::BindInstancedMesh(Mesh* mesh, ID3D11Buffer* instanceBuffer, unsigned int instanceStride)
+{
+	ID3D11Buffer* buffers[2] = { mesh->GetVertexBuffer(), instanceBuffer };
+	UINT strides[2] = { mesh->GetVertexStride(), instanceStride };
+	UINT offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	context->IASetIndexBuffer(mesh->GetIndexBuffer(), mesh->GetIndexFormat(), 0);
+}
+
+void D3D11RenderBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+	unsigned int firstIndex, unsigned int firstInstance)
+{
+	context->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, 0, firstInstance);
+}
+
+CountingRenderBackend::CountingRenderBackend(RenderBackend* inner)
+{
+	this->inner = inner;
+	ResetStats();
+}
+
+const RenderBackendStats& CountingRenderBackend::GetStats()
+{
+	return stats;
+}
+
+void CountingRenderBackend::ResetStats()
+{
+	stats = RenderBackendStats();
+}
+
+void CountingRenderBackend::BindShaders(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader)
+{
+	stats.ShaderBinds++;
+	if (inner)
+		inner->BindShaders(vertexShader, pixelShader);
+}
+
+void CountingRenderBackend::BindMaterial(Material* material)
+{
+	stats.MaterialBinds++;
+	if (inner)
+		inner->BindMaterial(material);
+}
+
+void CountingRenderBackend::BindMesh(Mesh* mesh)
+{
+	stats.MeshBinds++;
+	if (inner)
+		inner->BindMesh(mesh);
+}
+
+void CountingRenderBackend::SetObjectMatrices(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose)
+{
+	stats.ObjectUpdates++;
+	if (inner)
+		inner->SetObjectMatrices(world, worldInverseTranspose);
+}
+
+void CountingRenderBackend::DrawIndexed(unsigned int indexCount, unsigned int firstIndex)
+{
+	stats.Draws++;
+	if (inner)
+		inner->DrawIndexed(indexCount, firstIndex);
+}
+
+void CountingRenderBackend::UploadBuffer(ID3D11Buffer* buffer, const void* data, unsigned int byteCount)
+{
+	stats.Uploads++;
+	stats.BytesUploaded += byteCount;
+	if (inner)
+		inner->UploadBuffer(buffer, data, byteCount);
+}
+
+void CountingRenderBackend::BindInstancedMaterial(Material* material)
+{
+	stats.MaterialBinds++;
+	if (inner)
+		inner->BindInstancedMaterial(material);
+}
+
+void CountingRenderBackend::BindInstancedMesh(Mesh* mesh, ID3D11Buffer* instanceBuffer, unsigned int instanceStride)
+{
+	stats.MeshBinds++;
+	if (inner)
+		inner->BindInstancedMesh(mesh, instanceBuffer, instanceStride);
+}
+
+void CountingRenderBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+	unsigned int firstIndex, unsigned int firstInstance)
+{
+	stats.Draws++;
+	stats.Instances += instanceCount;
+	if (inner)
+		inner->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, firstInstance);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <string>
+#include "SimpleShader.h"
+#include "Mesh.h"
+#include "Material.h"
+
+// --------------------------------------------------------
+// What the instanced renderer and render queue ask of the
+// GPU.  Keeping it behind an interface lets them be run (and
+// their state changes counted) without a device
+// --------------------------------------------------------
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() { }
+
+	// One object at a time.  A mesh's binding only holds until the
+	// shaders change (compact meshes set their ranges on the shader)
+	virtual void BindShaders(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader) = 0;
+	virtual void BindMaterial(Material* material) = 0;
+	virtual void BindMesh(Mesh* mesh) = 0;
+	// Both as GameEntity keeps them
+	virtual void SetObjectMatrices(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int firstIndex) = 0;
+
+	// Replaces the whole contents of a dynamic buffer
+	virtual void UploadBuffer(ID3D11Buffer* buffer, const void* data, unsigned int byteCount) = 0;
+	// Shaders and textures for drawing instances of a material
+	virtual void BindInstancedMaterial(Material* material) = 0;
+	// The mesh's vertices and indices, with per instance data in slot 1
+	virtual void BindInstancedMesh(Mesh* mesh, ID3D11Buffer* instanceBuffer, unsigned int instanceStride) = 0;
+	virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+		unsigned int firstIndex, unsigned int firstInstance) = 0;
+};
+
+// --------------------------------------------------------
+// Draws through a D3D11 context.  Instances use InstancedVS
+// with each material's own pixel shader and textures
+// --------------------------------------------------------
+class D3D11RenderBackend : public RenderBackend
+{
+public:
+	// The names are the pixel shader's sampler and texture variables
+	D3D11RenderBackend(ID3D11DeviceContext* context, SimpleVertexShader* instancedVS,
+		std::string samplerName, std::string textureName, std::string normalMapName);
+
+	void BindShaders(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader);
+	void BindMaterial(Material* material);
+	void BindMesh(Mesh* mesh);
+	void SetObjectMatrices(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose);
+	void DrawIndexed(unsigned int indexCount, unsigned int firstIndex);
+
+	void UploadBuffer(ID3D11Buffer* buffer, const void* data, unsigned int byteCount);
+	void BindInstancedMaterial(Material* material);
+	void BindInstancedMesh(Mesh* mesh, ID3D11Buffer* instanceBuffer, unsigned int instanceStride);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+		unsigned int firstIndex, unsigned int firstInstance);
+
+private:
+	ID3D11DeviceContext* context;
+	SimpleVertexShader* instancedVS;
+	SimpleVertexShader* boundVS;	// From the last BindShaders
+
+	// Looked up when the shaders are bound, for setting per object
+	SimpleShaderHandle worldHandle;
+	SimpleShaderHandle transWorldHandle;
+	SimpleShaderHandle positionCenterHandle;
+	SimpleShaderHandle positionExtentHandle;
+	SimpleShaderHandle uvOffsetHandle;
+	SimpleShaderHandle uvScaleHandle;
+	SimpleShaderHandle samplerHandle;
+	SimpleShaderHandle textureHandle;
+	SimpleShaderHandle normalMapHandle;
+	std::string samplerName;
+	std::string textureName;
+	std::string normalMapName;
+	// Hashed once, as the pixel shader changes with the batch
+	ShaderNameHash samplerNameHash;
+	ShaderNameHash textureNameHash;
+	ShaderNameHash normalMapNameHash;
+};
+
+// --------------------------------------------------------
+// Totals from a CountingRenderBackend
+// --------------------------------------------------------
+struct RenderBackendStats
+{
+	unsigned int Uploads;
+	unsigned int BytesUploaded;
+	unsigned int ShaderBinds;
+	unsigned int MaterialBinds;	// Instanced or not
+	unsigned int MeshBinds;		// Instanced or not
+	unsigned int ObjectUpdates;
+	unsigned int Draws;			// Instanced or not
+	unsigned int Instances;
+};
+
+// --------------------------------------------------------
+// Counts everything asked of it, then passes it on to
+// another backend (or nowhere, if that's 0)
+// --------------------------------------------------------
+class CountingRenderBackend : public RenderBackend
+{
+public:
+	CountingRenderBackend(RenderBackend* inner);
+
+	const RenderBackendStats& GetStats();
+	void ResetStats();
+
+	void BindShaders(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader);
+	void BindMaterial(Material* material);
+	void BindMesh(Mesh* mesh);
+	void SetObjectMatrices(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose);
+	void DrawIndexed(unsigned int indexCount, unsigned int firstIndex);
+
+	void UploadBuffer(ID3D11Buffer* buffer, const void* data, unsigned int byteCount);
+	void BindInstancedMaterial(Material* material);
+	void BindInstancedMesh(Mesh* mesh, ID3D11Buffer* instanceBuffer, unsigned int instanceStride);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+		unsigned int firstIndex, unsigned int firstInstance);
+
+private:
+	RenderBackend* inner;
+	RenderBackendStats stats;
+};
@@ -0,0 +1,184 @@
+#include "RenderQueue.h"
+
+// The keys are sorted a byte at a time
+#define RENDER_RADIX_BITS 8
+#define RENDER_RADIX_BUCKETS (1 << RENDER_RADIX_BITS)
+#define RENDER_RADIX_PASSES (64 / RENDER_RADIX_BITS)
+
+RenderQueue::RenderQueue(float maxDepth)
+{
+	this->maxDepth = maxDepth;
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+// --------------------------------------------------------
+// Ids past what the key has room for wrap around, which
+// only costs some grouping - the draws still come out right
+// --------------------------------------------------------
+template<typename T>
+static unsigned int GetStateId(std::map<T, unsigned int>& ids, const T& state, unsigned int bits)
+{
+	typename std::map<T, unsigned int>::iterator it = ids.find(state);
+	if (it == ids.end())
+		it = ids.insert(std::make_pair(state, (unsigned int)ids.size())).first;
+	return it->second & ((1u << bits) - 1);
+}
+
+RenderSortKey RenderQueue::MakeKey(unsigned int pass, bool translucent, Material* material, Mesh* mesh, float depth)
+{
+	unsigned int shader = GetStateId(shaderIds,
+		std::make_pair(material->GetVertexShader(), material->GetPixelShader()), RENDER_KEY_SHADER_BITS);
+	unsigned int materialId = GetStateId(materialIds, material, RENDER_KEY_MATERIAL_BITS);
+	unsigned int meshId = GetStateId(meshIds, mesh, RENDER_KEY_MESH_BITS);
+
+	// Depth in [0, 1] of the range, then in steps of the bits there are
+	float depthScale = depth / maxDepth;
+	if (depthScale < 0.0f) depthScale = 0.0f;
+	if (depthScale > 1.0f) depthScale = 1.0f;
+	RenderSortKey depthMax = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+	RenderSortKey depthBits = (RenderSortKey)(depthScale * depthMax);
+
+	RenderSortKey state = shader;
+	state = (state << RENDER_KEY_MATERIAL_BITS) | materialId;
+	state = (state << RENDER_KEY_MESH_BITS) | meshId;
+
+	RenderSortKey key = pass & ((1u << RENDER_KEY_PASS_BITS) - 1);
+	key = (key << 1) | (translucent ? 1 : 0);
+	if (translucent)
+		key = (key << RENDER_KEY_DEPTH_BITS) | (depthMax - depthBits);
+	key = (key << (RENDER_KEY_SHADER_BITS + RENDER_KEY_MATERIAL_BITS + RENDER_KEY_MESH_BITS)) | state;
+	if (!translucent)
+		key = (key << RENDER_KEY_DEPTH_BITS) | depthBits;
+	return key;
+}
+
+void RenderQueue::Clear()
+{
+	commands.clear();
+	ranges.clear();
+	entries.clear();
+}
+
+void RenderQueue::Submit(RenderSortKey key, Material* material, Mesh* mesh,
+	const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose)
+{
+	RenderCommand command = { material, mesh, world, worldInverseTranspose, (unsigned int)ranges.size(), 0 };
+	SortEntry entry = { key, (unsigned int)commands.size() };
+	commands.push_back(command);
+	entries.push_back(entry);
+}
+
+void RenderQueue::AddRange(unsigned int firstIndex, unsigned int indexCount)
+{
+	RenderIndexRange range = { firstIndex, indexCount };
+	ranges.push_back(range);
+	commands.back().RangeCount++;
+}
+
+// --------------------------------------------------------
+// Least significant byte first radix sort.  Every byte's
+// counts come from one read of the keys, and bytes all the
+// keys share (most of them, in a typical frame) are skipped
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	unsigned int count = (unsigned int)entries.size();
+	if (count < 2)
+		return;
+
+	unsigned int counts[RENDER_RADIX_PASSES][RENDER_RADIX_BUCKETS] = {};
+	for (unsigned int i = 0; i < count; i++)
+	{
+		RenderSortKey key = entries[i].Key;
+		for (unsigned int p = 0; p < RENDER_RADIX_PASSES; p++)
+			counts[p][(key >> (p * RENDER_RADIX_BITS)) & (RENDER_RADIX_BUCKETS - 1)]++;
+	}
+
+	sortScratch.resize(count);
+	SortEntry* from = &entries[0];
+	SortEntry* to = &sortScratch[0];
+	for (unsigned int p = 0; p < RENDER_RADIX_PASSES; p++)
+	{
+		unsigned int shift = p * RENDER_RADIX_BITS;
+		if (counts[p][(from[0].Key >> shift) & (RENDER_RADIX_BUCKETS - 1)] == count)
+			continue;
+
+		unsigned int offsets[RENDER_RADIX_BUCKETS];
+		unsigned int offset = 0;
+		for (unsigned int b = 0; b < RENDER_RADIX_BUCKETS; b++)
+		{
+			offsets[b] = offset;
+			offset += counts[p][b];
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+			to[offsets[(from[i].Key >> shift) & (RENDER_RADIX_BUCKETS - 1)]++] = from[i];
+
+		SortEntry* swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != &entries[0])
+		entries.swap(sortScratch);
+}
+
+void RenderQueue::Execute(RenderBackend* backend)
+{
+	SimpleVertexShader* boundVS = 0;
+	SimplePixelShader* boundPS = 0;
+	Material* boundMaterial = 0;
+	Mesh* boundMesh = 0;
+
+	for (size_t e = 0; e < entries.size(); e++)
+	{
+		const RenderCommand& command = commands[entries[e].Command];
+		if (command.RangeCount == 0)
+			continue;
+
+		Material* material = command.CommandMaterial;
+		if (material->GetVertexShader() != boundVS || material->GetPixelShader() != boundPS)
+		{
+			boundVS = material->GetVertexShader();
+			boundPS = material->GetPixelShader();
+			backend->BindShaders(boundVS, boundPS);
+			boundMaterial = 0;
+			boundMesh = 0;
+		}
+		if (material != boundMaterial)
+		{
+			backend->BindMaterial(material);
+			boundMaterial = material;
+		}
+		if (command.CommandMesh != boundMesh)
+		{
+			backend->BindMesh(command.CommandMesh);
+			boundMesh = command.CommandMesh;
+		}
+
+		backend->SetObjectMatrices(command.World, command.WorldInverseTranspose);
+		for (unsigned int r = 0; r < command.RangeCount; r++)
+		{
+			const RenderIndexRange& range = ranges[command.FirstRange + r];
+			backend->DrawIndexed(range.IndexCount, range.FirstIndex);
+		}
+	}
+}
+
+unsigned int RenderQueue::GetCommandCount()
+{
+	return (unsigned int)entries.size();
+}
+
+const RenderCommand& RenderQueue::GetCommand(unsigned int command)
+{
+	return commands[entries[command].Command];
+}
+
+RenderSortKey RenderQueue::GetKey(unsigned int command)
+{
+	return entries[command].Key;
+}
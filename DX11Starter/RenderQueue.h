@@ -0,0 +1,99 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <map>
+#include <vector>
+#include "Mesh.h"
+#include "Material.h"
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// Orders one draw against the others.  From the top bit:
+//   pass (4) | translucent (1) | shader (11) | material (12) | mesh (12) | depth (24)
+// Opaque draws group by state and go front to back within
+// it.  Translucent ones must go back to front, so for them
+// the inverted depth moves up above the state:
+//   pass (4) | 1 | far-to-near depth (24) | shader | material | mesh
+// --------------------------------------------------------
+typedef unsigned long long RenderSortKey;
+
+#define RENDER_KEY_PASS_BITS 4
+#define RENDER_KEY_SHADER_BITS 11
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_MESH_BITS 12
+#define RENDER_KEY_DEPTH_BITS 24
+
+// --------------------------------------------------------
+// One submitted object, drawn as one or more index ranges
+// --------------------------------------------------------
+struct RenderCommand
+{
+	Material* CommandMaterial;
+	Mesh* CommandMesh;
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInverseTranspose;
+	unsigned int FirstRange;	// Into the queue's ranges
+	unsigned int RangeCount;
+};
+
+struct RenderIndexRange
+{
+	unsigned int FirstIndex;
+	unsigned int IndexCount;
+};
+
+// --------------------------------------------------------
+// Collects a frame's draws, sorts them by key (a radix sort,
+// so it stays linear however many there are) and runs them,
+// only binding shaders, materials and meshes that differ
+// from the draw before
+//
+// Each frame: Clear(), Submit() and AddRange() every object,
+// Sort(), Execute()
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	// maxDepth - Distance the depth bits of the keys span (past it all sorts the same)
+	RenderQueue(float maxDepth);
+	~RenderQueue();
+
+	// Packs a key, giving the shaders, material and mesh small ids
+	// of their own (kept from frame to frame)
+	RenderSortKey MakeKey(unsigned int pass, bool translucent, Material* material, Mesh* mesh, float depth);
+
+	void Clear();
+	// Copies the matrices (as GameEntity keeps them).  The object
+	// draws nothing until it's given ranges
+	void Submit(RenderSortKey key, Material* material, Mesh* mesh,
+		const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose);
+	// Adds indices to draw to the last object submitted
+	void AddRange(unsigned int firstIndex, unsigned int indexCount);
+
+	void Sort();
+	void Execute(RenderBackend* backend);
+
+	unsigned int GetCommandCount();
+	// In sorted order, once sorted
+	const RenderCommand& GetCommand(unsigned int command);
+	RenderSortKey GetKey(unsigned int command);
+
+private:
+	struct SortEntry
+	{
+		RenderSortKey Key;
+		unsigned int Command;
+	};
+
+	float maxDepth;
+
+	std::vector<RenderCommand> commands;
+	std::vector<RenderIndexRange> ranges;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> sortScratch;
+
+	// Ids, in the order things were first seen
+	std::map<std::pair<SimpleVertexShader*, SimplePixelShader*>, unsigned int> shaderIds;
+	std::map<Material*, unsigned int> materialIds;
+	std::map<Mesh*, unsigned int> meshIds;
+};
@@ -0,0 +1,84 @@
+#include "RingAllocator.h"
+
+RingAllocator::RingAllocator(unsigned int capacity, unsigned int alignment, unsigned int maxFrames)
+{
+	if (alignment == 0)
+		alignment = 1;
+
+	// Whole aligned pieces only
+	this->capacity = capacity & ~(alignment - 1);
+	this->alignment = alignment;
+	frameSizes.resize(maxFrames > 0 ? maxFrames : 1);
+	Reset();
+}
+
+RingAllocator::~RingAllocator()
+{
+}
+
+bool RingAllocator::Allocate(unsigned int size, unsigned int* offset)
+{
+	if (size == 0 || size > capacity)
+		return false;
+	unsigned int alignedSize = (size + alignment - 1) & ~(alignment - 1);
+
+	// Pieces don't wrap, so one that won't fit before the end
+	// goes at the start, and the end is skipped
+	unsigned int start = head;
+	unsigned int padding = 0;
+	if (capacity - head < alignedSize)
+	{
+		start = 0;
+		padding = capacity - head;
+	}
+
+	// The live bytes run from the head back to the oldest
+	// unretired frame - whatever's left is free
+	if (used + padding + alignedSize > capacity)
+		return false;
+
+	used += padding + alignedSize;
+	frameUsed += padding + alignedSize;
+	head = start + alignedSize;
+	if (head == capacity)
+		head = 0;
+
+	*offset = start;
+	return true;
+}
+
+bool RingAllocator::EndFrame()
+{
+	if (frameCount == frameSizes.size())
+		return false;
+
+	unsigned int last = (firstFrame + frameCount) % frameSizes.size();
+	frameSizes[last] = frameUsed;
+	frameCount++;
+	frameUsed = 0;
+	return true;
+}
+
+bool RingAllocator::RetireFrame()
+{
+	if (frameCount == 0)
+		return false;
+
+	used -= frameSizes[firstFrame];
+	firstFrame = (firstFrame + 1) % frameSizes.size();
+	frameCount--;
+
+	// Nothing live, so the next piece may as well start at 0
+	if (used == 0)
+		head = 0;
+	return true;
+}
+
+void RingAllocator::Reset()
+{
+	head = 0;
+	used = 0;
+	frameUsed = 0;
+	firstFrame = 0;
+	frameCount = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// Hands out pieces of a fixed size buffer in a ring, for
+// data written once and read by the GPU a frame or so later.
+// Only the offsets are kept here - the memory is whoever's
+// using it (see ConstantBufferRing)
+//
+// Allocations go one after another from the head, aligned,
+// never split across the end (it pads to the start instead).
+// EndFrame() fences what the frame used, and RetireFrame()
+// frees the oldest fenced frame once the GPU is done with
+// it.  Allocate() fails rather than overwrite a frame that
+// hasn't been retired
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	// capacity  - Bytes to hand out (rounded down to the alignment)
+	// alignment - Of every offset and size (a power of two)
+	// maxFrames - Frames that can be fenced and not yet retired
+	RingAllocator(unsigned int capacity, unsigned int alignment, unsigned int maxFrames);
+	~RingAllocator();
+
+	// Returns false (with nothing taken) if there isn't room
+	bool Allocate(unsigned int size, unsigned int* offset);
+
+	// Fences everything allocated since the last EndFrame().  Returns
+	// false (fencing nothing) if maxFrames are already fenced
+	bool EndFrame();
+	// The oldest fenced frame's memory is free again
+	bool RetireFrame();
+	// Everything is free (all of it was thrown away at once)
+	void Reset();
+
+	unsigned int GetCapacity() { return capacity; }
+	unsigned int GetAlignment() { return alignment; }
+	// Bytes in use, including padding and the current frame
+	unsigned int GetUsed() { return used; }
+	unsigned int GetFencedFrameCount() { return frameCount; }
+
+private:
+	unsigned int capacity;
+	unsigned int alignment;
+	unsigned int head;	// Where the next allocation starts
+	unsigned int used;	// Bytes behind the head still in use
+	unsigned int frameUsed;	// Bytes of them not yet fenced
+
+	// Bytes each fenced frame used, oldest at firstFrame
+	std::vector<unsigned int> frameSizes;
+	unsigned int firstFrame;
+	unsigned int frameCount;
+};
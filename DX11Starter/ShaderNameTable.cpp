@@ -0,0 +1,114 @@
+#include "ShaderNameTable.h"
+
+#include <cstring>
+
+// The fewest slots a table with anything in it has
+#define SHADER_NAME_TABLE_MIN_SLOTS 8
+
+ShaderNameTable::ShaderNameTable()
+{
+	mask = 0;
+	count = 0;
+}
+
+void ShaderNameTable::Reserve(unsigned int nameCount)
+{
+	// At most half full
+	unsigned int slotCount = SHADER_NAME_TABLE_MIN_SLOTS;
+	while (slotCount < nameCount * 2)
+		slotCount *= 2;
+
+	if (slotCount > slots.size())
+		Grow(slotCount);
+}
+
+bool ShaderNameTable::Insert(ShaderNameHash name, unsigned int value)
+{
+	if ((count + 1) * 2 > slots.size())
+		Grow(slots.empty() ? SHADER_NAME_TABLE_MIN_SLOTS : (unsigned int)slots.size() * 2);
+
+	unsigned int slot = FirstSlot(name);
+	while (slots[slot].Value != SHADER_NAME_NONE)
+	{
+		if (slots[slot].Name == name)
+			return false;
+		slot = (slot + 1) & mask;
+	}
+
+	slots[slot].Name = name;
+	slots[slot].Value = value;
+	count++;
+	return true;
+}
+
+unsigned int ShaderNameTable::Find(ShaderNameHash name) const
+{
+	if (count == 0)
+		return SHADER_NAME_NONE;
+
+	// Never full, so this always reaches an empty slot
+	unsigned int slot = FirstSlot(name);
+	while (slots[slot].Value != SHADER_NAME_NONE)
+	{
+		if (slots[slot].Name == name)
+			return slots[slot].Value;
+		slot = (slot + 1) & mask;
+	}
+	return SHADER_NAME_NONE;
+}
+
+void ShaderNameTable::Clear()
+{
+	std::vector<Slot>().swap(slots);
+	mask = 0;
+	count = 0;
+}
+
+// --------------------------------------------------------
+// Rebuilds the table with a new number of slots (a power
+// of two), re-adding everything in it
+// --------------------------------------------------------
+void ShaderNameTable::Grow(unsigned int slotCount)
+{
+	std::vector<Slot> old;
+	old.swap(slots);
+
+	Slot empty = { 0, SHADER_NAME_NONE };
+	slots.assign(slotCount, empty);
+	mask = slotCount - 1;
+
+	for (size_t s = 0; s < old.size(); s++)
+	{
+		if (old[s].Value == SHADER_NAME_NONE)
+			continue;
+
+		unsigned int slot = FirstSlot(old[s].Name);
+		while (slots[slot].Value != SHADER_NAME_NONE)
+			slot = (slot + 1) & mask;
+		slots[slot] = old[s];
+	}
+}
+
+// --------------------------------------------------------
+// HashShaderName for names only known at run time
+// --------------------------------------------------------
+ShaderNameHash HashShaderName(const std::string& name)
+{
+	const char* bytes = name.c_str();
+	size_t length = name.size();
+
+	ShaderNameHash hash = 14695981039346656037ULL;
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		ShaderNameHash word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * 1099511628211ULL;
+	}
+
+	// What's left, zero padded
+	ShaderNameHash word = 0;
+	memcpy(&word, bytes + i, length - i);
+	hash = (hash ^ word) * 1099511628211ULL;
+	return MixShaderNameHash(hash, length);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+typedef unsigned long long ShaderNameHash;
+
+// Not in the table
+#define SHADER_NAME_NONE 0xFFFFFFFF
+
+// --------------------------------------------------------
+// Hashes a variable, buffer or resource name - FNV-1a, but
+// taking 8 bytes (little endian) at a time, then mixed so
+// every bit of the name reaches the low bits.  Two names of
+// the same length, up to 8 bytes, never share a hash.  Longer
+// names fold several words into one, so any two can, if only
+// very rarely
+//
+// It's constexpr, so names known when compiling can be
+// hashed then (see SHADER_NAME).  The std::string version
+// gives the same hashes, reading whole words at run time
+// --------------------------------------------------------
+constexpr ShaderNameHash MixShaderNameHash(ShaderNameHash hash, size_t length)
+{
+	hash ^= length;
+	hash ^= hash >> 32;
+	hash *= 0xD6E8FEB86659FD93ULL;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+constexpr ShaderNameHash HashShaderName(const char* name)
+{
+	ShaderNameHash hash = 14695981039346656037ULL;
+	ShaderNameHash word = 0;
+	size_t length = 0;
+	for (; name[length]; length++)
+	{
+		word |= (ShaderNameHash)(unsigned char)name[length] << (length % 8 * 8);
+		if (length % 8 == 7)
+		{
+			hash = (hash ^ word) * 1099511628211ULL;
+			word = 0;
+		}
+	}
+	hash = (hash ^ word) * 1099511628211ULL;
+	return MixShaderNameHash(hash, length);
+}
+
+ShaderNameHash HashShaderName(const std::string& name);
+
+// The hash of a string literal, always worked out by the compiler
+#define SHADER_NAME(literal) (std::integral_constant<ShaderNameHash, HashShaderName(literal)>::value)
+
+// --------------------------------------------------------
+// Maps the names in a shader to small integers (indices
+// into the shader's own arrays), by the hashes of the names
+//
+// It's one flat array of slots, probed linearly and kept
+// at most half full, rather than a node per name - finding
+// a name is usually a single compare of two hashes, with
+// no string compares or pointers to follow.  The names
+// themselves aren't kept, so two names with the same hash
+// can't both be added - Insert refuses the second, and
+// ISimpleShader asserts that never happens
+// --------------------------------------------------------
+class ShaderNameTable
+{
+public:
+	ShaderNameTable();
+
+	// Makes room for nameCount names in all, so adding them won't grow it
+	void Reserve(unsigned int nameCount);
+	// False (and nothing changes) if the name's already there
+	bool Insert(ShaderNameHash name, unsigned int value);
+	// The name's value, or SHADER_NAME_NONE
+	unsigned int Find(ShaderNameHash name) const;
+	void Clear();
+
+	unsigned int GetCount() const { return count; }
+	// Bytes allocated for it
+	size_t GetFootprint() const { return slots.capacity() * sizeof(Slot); }
+
+private:
+	struct Slot
+	{
+		ShaderNameHash Name;
+		unsigned int Value;	// SHADER_NAME_NONE if empty
+	};
+
+	std::vector<Slot> slots;
+	unsigned int mask;
+	unsigned int count;
+
+	void Grow(unsigned int slotCount);
+	unsigned int FirstSlot(ShaderNameHash name) const { return (unsigned int)(name ^ (name >> 32)) & mask; }
+};
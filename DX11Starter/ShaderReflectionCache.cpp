@@ -0,0 +1,244 @@
+#include "ShaderReflectionCache.h"
+
+#include <utility>
+
+// The sidecar file's first four bytes
+static const unsigned char cacheMagic[4] = { 'S', 'R', 'F', 'L' };
+
+// Longest name a sidecar file can hold
+#define CACHE_MAX_NAME 0xFFFF
+
+// --------------------------------------------------------
+// Writing, one little endian field at a time
+// --------------------------------------------------------
+static void WriteUInt(std::vector<unsigned char>& bytes, unsigned int value)
+{
+	for (unsigned int i = 0; i < 4; i++)
+		bytes.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static void WriteUInt64(std::vector<unsigned char>& bytes, unsigned long long value)
+{
+	for (unsigned int i = 0; i < 8; i++)
+		bytes.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static void WriteString(std::vector<unsigned char>& bytes, const std::string& value)
+{
+	unsigned int length = value.size() < CACHE_MAX_NAME ? (unsigned int)value.size() : CACHE_MAX_NAME;
+	bytes.push_back((unsigned char)length);
+	bytes.push_back((unsigned char)(length >> 8));
+	bytes.insert(bytes.end(), value.begin(), value.begin() + length);
+}
+
+static void WriteResources(std::vector<unsigned char>& bytes, const std::vector<ReflectedResource>& resources)
+{
+	WriteUInt(bytes, (unsigned int)resources.size());
+	for (size_t r = 0; r < resources.size(); r++)
+	{
+		WriteString(bytes, resources[r].Name);
+		WriteUInt(bytes, resources[r].BindIndex);
+	}
+}
+
+// --------------------------------------------------------
+// Reading - every read checks it stays inside the bytes,
+// and once one fails the rest do too
+// --------------------------------------------------------
+struct CacheReader
+{
+	const unsigned char* Bytes;
+	size_t Size;
+	size_t Position;
+	bool Failed;
+};
+
+static bool ReadBytes(CacheReader* reader, size_t count)
+{
+	if (reader->Failed || reader->Size - reader->Position < count)
+	{
+		reader->Failed = true;
+		return false;
+	}
+	return true;
+}
+
+static unsigned int ReadUInt(CacheReader* reader)
+{
+	if (!ReadBytes(reader, 4))
+		return 0;
+
+	unsigned int value = 0;
+	for (unsigned int i = 0; i < 4; i++)
+		value |= (unsigned int)reader->Bytes[reader->Position++] << (i * 8);
+	return value;
+}
+
+static unsigned long long ReadUInt64(CacheReader* reader)
+{
+	if (!ReadBytes(reader, 8))
+		return 0;
+
+	unsigned long long value = 0;
+	for (unsigned int i = 0; i < 8; i++)
+		value |= (unsigned long long)reader->Bytes[reader->Position++] << (i * 8);
+	return value;
+}
+
+static std::string ReadString(CacheReader* reader)
+{
+	if (!ReadBytes(reader, 2))
+		return std::string();
+
+	size_t length = reader->Bytes[reader->Position] | (reader->Bytes[reader->Position + 1] << 8);
+	reader->Position += 2;
+	if (!ReadBytes(reader, length))
+		return std::string();
+
+	std::string value((const char*)reader->Bytes + reader->Position, length);
+	reader->Position += length;
+	return value;
+}
+
+// Counts come from the file, so they're checked against the
+// bytes left (each item takes at least minItemSize) before
+// anything is allocated for them
+static unsigned int ReadCount(CacheReader* reader, size_t minItemSize)
+{
+	unsigned int count = ReadUInt(reader);
+	if (!reader->Failed && (reader->Size - reader->Position) / minItemSize < count)
+		reader->Failed = true;
+	return reader->Failed ? 0 : count;
+}
+
+static void ReadResources(CacheReader* reader, std::vector<ReflectedResource>& resources)
+{
+	unsigned int count = ReadCount(reader, 6);
+	resources.resize(count);
+	for (unsigned int r = 0; r < count; r++)
+	{
+		resources[r].Name = ReadString(reader);
+		resources[r].BindIndex = ReadUInt(reader);
+	}
+}
+
+unsigned long long ShaderReflectionCache::HashBlob(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void ShaderReflectionCache::Write(const ShaderReflectionData& data, std::vector<unsigned char>& bytes)
+{
+	bytes.clear();
+	bytes.insert(bytes.end(), cacheMagic, cacheMagic + 4);
+	WriteUInt(bytes, SHADER_REFLECTION_CACHE_VERSION);
+	WriteUInt64(bytes, data.BlobHash);
+	WriteUInt64(bytes, data.BlobSize);
+
+	WriteUInt(bytes, (unsigned int)data.ConstantBuffers.size());
+	for (size_t b = 0; b < data.ConstantBuffers.size(); b++)
+	{
+		const ReflectedConstantBuffer& cb = data.ConstantBuffers[b];
+		WriteString(bytes, cb.Name);
+		WriteUInt(bytes, cb.Type);
+		WriteUInt(bytes, cb.Size);
+		WriteUInt(bytes, cb.BindIndex);
+
+		WriteUInt(bytes, (unsigned int)cb.Variables.size());
+		for (size_t v = 0; v < cb.Variables.size(); v++)
+		{
+			WriteString(bytes, cb.Variables[v].Name);
+			WriteUInt(bytes, cb.Variables[v].ByteOffset);
+			WriteUInt(bytes, cb.Variables[v].Size);
+		}
+	}
+
+	WriteResources(bytes, data.Textures);
+	WriteResources(bytes, data.Samplers);
+
+	// And a hash of all that, to catch damaged files
+	WriteUInt64(bytes, HashBlob(&bytes[0], bytes.size()));
+}
+
+// --------------------------------------------------------
+// The whole of Read, which can stop partway through data
+// --------------------------------------------------------
+static bool ReadCache(const unsigned char* bytes, size_t size,
+	unsigned long long blobHash, unsigned long long blobSize, ShaderReflectionData* data)
+{
+	// Is it whole?  The last 8 bytes hash the rest
+	if (size < 8)
+		return false;
+	size -= 8;
+	CacheReader check = { bytes, size + 8, size, false };
+	if (ReadUInt64(&check) != ShaderReflectionCache::HashBlob(bytes, size))
+		return false;
+
+	CacheReader reader = { bytes, size, 0, false };
+
+	// Is it a cache of this version, for this shader?
+	if (!ReadBytes(&reader, 4) ||
+		bytes[0] != cacheMagic[0] || bytes[1] != cacheMagic[1] ||
+		bytes[2] != cacheMagic[2] || bytes[3] != cacheMagic[3])
+		return false;
+	reader.Position = 4;
+	if (ReadUInt(&reader) != SHADER_REFLECTION_CACHE_VERSION)
+		return false;
+	data->BlobHash = ReadUInt64(&reader);
+	data->BlobSize = ReadUInt64(&reader);
+	if (reader.Failed || data->BlobHash != blobHash || data->BlobSize != blobSize)
+		return false;
+
+	// A buffer is at least a name length and four counts
+	unsigned int bufferCount = ReadCount(&reader, 18);
+	data->ConstantBuffers.resize(bufferCount);
+	for (unsigned int b = 0; b < bufferCount; b++)
+	{
+		ReflectedConstantBuffer& cb = data->ConstantBuffers[b];
+		cb.Name = ReadString(&reader);
+		cb.Type = ReadUInt(&reader);
+		cb.Size = ReadUInt(&reader);
+		cb.BindIndex = ReadUInt(&reader);
+
+		unsigned int variableCount = ReadCount(&reader, 10);
+		cb.Variables.resize(variableCount);
+		for (unsigned int v = 0; v < variableCount; v++)
+		{
+			ReflectedVariable& var = cb.Variables[v];
+			var.Name = ReadString(&reader);
+			var.ByteOffset = ReadUInt(&reader);
+			var.Size = ReadUInt(&reader);
+
+			// Variables have to lie inside their buffer
+			if (var.ByteOffset > cb.Size || var.Size > cb.Size - var.ByteOffset)
+				reader.Failed = true;
+		}
+	}
+
+	ReadResources(&reader, data->Textures);
+	ReadResources(&reader, data->Samplers);
+
+	// Anything left over means it's not what was written
+	return !reader.Failed && reader.Position == size;
+}
+
+bool ShaderReflectionCache::Read(const unsigned char* bytes, size_t size,
+	unsigned long long blobHash, unsigned long long blobSize, ShaderReflectionData* data)
+{
+	// Read into a fresh one, so a failure doesn't leave data half filled
+	ShaderReflectionData read = {};
+	if (!ReadCache(bytes, size, blobHash, blobSize, &read))
+	{
+		*data = ShaderReflectionData();
+		return false;
+	}
+	std::swap(*data, read);
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Bumped whenever the layout of the cache changes, so old
+// sidecar files are reflected over again rather than misread
+#define SHADER_REFLECTION_CACHE_VERSION 1
+
+struct ReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
+
+struct ReflectedConstantBuffer
+{
+	std::string Name;
+	unsigned int Type;		// A D3D_CBUFFER_TYPE
+	unsigned int Size;
+	unsigned int BindIndex;
+	std::vector<ReflectedVariable> Variables;
+};
+
+// A texture or sampler
+struct ReflectedResource
+{
+	std::string Name;
+	unsigned int BindIndex;
+};
+
+// --------------------------------------------------------
+// Everything ISimpleShader::LoadShaderFile needs to know
+// about a compiled shader, in the order D3DReflect gives it
+// --------------------------------------------------------
+struct ShaderReflectionData
+{
+	unsigned long long BlobHash;	// Of the compiled shader it describes
+	unsigned long long BlobSize;
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedResource> Textures;
+	std::vector<ReflectedResource> Samplers;
+};
+
+// --------------------------------------------------------
+// Turns the reflection of a shader into a small sidecar
+// file, and back.  D3DReflect (and walking everything it
+// finds) is slow next to reading a few hundred bytes, so
+// shaders reflect once and load this on later runs
+//
+// The file starts with the hash and size of the compiled
+// shader - a rebuilt shader no longer matches, and is
+// reflected again - and ends with a hash of itself, so a
+// damaged file is too.  Everything is written byte by byte in
+// little endian order, with no D3D types, so the format
+// reads the same anywhere
+// --------------------------------------------------------
+class ShaderReflectionCache
+{
+public:
+	// 64 bit FNV-1a of the compiled shader
+	static unsigned long long HashBlob(const void* data, size_t size);
+
+	static void Write(const ShaderReflectionData& data, std::vector<unsigned char>& bytes);
+	// False if the bytes are cut short, corrupt, an older version
+	// or for a different shader (if blobHash and blobSize don't match),
+	// and data is then left empty
+	static bool Read(const unsigned char* bytes, size_t size,
+		unsigned long long blobHash, unsigned long long blobSize, ShaderReflectionData* data);
+};
@@ -1,9 +1,17 @@
 #include "SimpleShader.h"
+#include "ConstantBufferRing.h"
+
+#include <cassert>
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+SimpleShaderUploadStats ISimpleShader::uploadStats = {};
+ConstantBufferRing* ISimpleShader::constantRing = 0;
+ISimpleShader* ISimpleShader::boundShaders[SIMPLE_SHADER_STAGE_COUNT] = {};
+bool ISimpleShader::restoringRing = false;
+
 // --------------------------------------------------------
 // Constructor accepts DirectX device & context
 // --------------------------------------------------------
@@ -14,6 +22,7 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	this->deviceContext = context;
 
 	// Set up fields
+	shaderValid = false;
 	constantBufferCount = 0;
 	constantBuffers = 0;
 	shaderBlob = 0;
@@ -35,11 +44,16 @@ ISimpleShader::~ISimpleShader()
 // --------------------------------------------------------
 void ISimpleShader::CleanUp()
 {
+	// Nothing to rebind once it's gone
+	if (IsBound())
+		boundShaders[GetStage()] = 0;
+
 	// Handle constant buffers and local data buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		constantBuffers[i].ConstantBuffer->Release();
-		delete[] constantBuffers[i].LocalDataBuffer;
+		if (!constantBuffers[i].Shared)
+			delete[] constantBuffers[i].LocalDataBuffer;
 	}
 
 	if (constantBuffers)
@@ -48,44 +62,37 @@ void ISimpleShader::CleanUp()
 		constantBufferCount = 0;
 	}
 
-	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
-		delete shaderResourceViews[i];
-	
-	for (unsigned int i = 0; i < samplerStates.size(); i++)
-		delete samplerStates[i];
-
 	// Clean up tables
-	varTable.clear();
-	cbTable.clear();
-	samplerTable.clear();
-	textureTable.clear();
+	shaderResourceViews.clear();
+	samplerStates.clear();
+	variables.clear();
+	varTable.Clear();
+	cbTable.Clear();
+	samplerTable.Clear();
+	textureTable.Clear();
 }
 
 // --------------------------------------------------------
-// Loads the specified shader and builds the variable table using shader
-// reflection.  This must be a separate step from the constructor since
-// we can't invoke derived class overrides in the base class constructor.
-//
-// shaderFile - A "wide string" specifying the compiled shader to load
-// 
-// Returns true if shader is loaded properly, false otherwise
+// Adds a name to one of a shader's tables.  Names in each
+// table of a shader are unique, so a name Insert refuses
+// shares its hash with another (see HashShaderName), and
+// can't be found.  Debug builds stop there
 // --------------------------------------------------------
-bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
+static bool InsertShaderName(ShaderNameTable& table, const std::string& name, unsigned int value)
 {
-	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
-	if (hr != S_OK)
-	{
-		return false;
-	}
+	bool inserted = table.Insert(HashShaderName(name), value);
+	assert(inserted && "Two names in the shader share a hash");
+	return inserted;
+}
 
-	// Create the shader - Calls an overloaded version of this abstract
-	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
-	if (!shaderValid)
-	{
-		return false;
-	}
+// --------------------------------------------------------
+// Gets what LoadShaderFile needs about the shader through
+// shader reflection
+// --------------------------------------------------------
+static void ReflectShader(ID3DBlob* shaderBlob, ShaderReflectionData* data)
+{
+	data->BlobHash = ShaderReflectionCache::HashBlob(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+	data->BlobSize = shaderBlob->GetBufferSize();
 
 	// Set up shader reflection to get information about
 	// this shader and its variables,  buffers, etc.
@@ -100,10 +107,6 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Get the number of buffers and make the resource array
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
 	// Handle bound resources (like shaders and samplers)
 	unsigned int resourceCount = shaderDesc.BoundResources;
 	for (unsigned int r = 0; r < resourceCount; r++)
@@ -112,37 +115,26 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
 		refl->GetResourceBindingDesc(r, &resourceDesc);
 
+		ReflectedResource resource;
+		resource.Name = resourceDesc.Name;
+		resource.BindIndex = resourceDesc.BindPoint;
+
 		// Check the type
 		switch (resourceDesc.Type)
 		{
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+			data->Textures.push_back(resource);
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+			data->Samplers.push_back(resource);
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	data->ConstantBuffers.resize(shaderDesc.ConstantBuffers);
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -151,34 +143,17 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		// Get the description of this buffer
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
-		
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
 
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
-
-		// Create this constant buffer
-		D3D11_BUFFER_DESC newBuffDesc;
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = max(bufferDesc.Size, 16); // NEW: Must be multiple of 16
-		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
-		newBuffDesc.MiscFlags = 0;
-		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
-
-		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+
+		ReflectedConstantBuffer& reflected = data->ConstantBuffers[b];
+		reflected.Name = bufferDesc.Name;
+		reflected.Type = bufferDesc.Type;
+		reflected.Size = bufferDesc.Size;
+		reflected.BindIndex = bindDesc.BindPoint;
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
@@ -187,28 +162,227 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			ID3D11ShaderReflectionVariable* var =
 				cb->GetVariableByIndex(v);
 			
-			// Get the description of the variable and its type
+			// Get the description of the variable
 			D3D11_SHADER_VARIABLE_DESC varDesc;
 			var->GetDesc(&varDesc);
 
+			ReflectedVariable variable;
+			variable.Name = varDesc.Name;
+			variable.ByteOffset = varDesc.StartOffset;
+			variable.Size = varDesc.Size;
+			reflected.Variables.push_back(variable);
+		}
+	}
+
+	// All set
+	refl->Release();
+}
+
+// --------------------------------------------------------
+// Reads the cached reflection of a shader, if the file's
+// there and was made from the same compiled shader
+// --------------------------------------------------------
+static bool ReadReflectionCache(LPCWSTR cacheFile, ID3DBlob* shaderBlob, ShaderReflectionData* data)
+{
+	ID3DBlob* cacheBlob;
+	if (D3DReadFileToBlob(cacheFile, &cacheBlob) != S_OK)
+		return false;
+
+	bool read = ShaderReflectionCache::Read(
+		(const unsigned char*)cacheBlob->GetBufferPointer(),
+		cacheBlob->GetBufferSize(),
+		ShaderReflectionCache::HashBlob(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize()),
+		shaderBlob->GetBufferSize(),
+		data);
+	cacheBlob->Release();
+	return read;
+}
+
+// --------------------------------------------------------
+// Caches the reflection of a shader.  If the file can't be
+// written, the shader's just reflected again next time
+// --------------------------------------------------------
+static void WriteReflectionCache(LPCWSTR cacheFile, const ShaderReflectionData& data)
+{
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(data, bytes);
+
+	ID3DBlob* cacheBlob;
+	if (D3DCreateBlob(bytes.size(), &cacheBlob) != S_OK)
+		return;
+	memcpy(cacheBlob->GetBufferPointer(), &bytes[0], bytes.size());
+	D3DWriteBlobToFile(cacheBlob, cacheFile, TRUE);
+	cacheBlob->Release();
+}
+
+// --------------------------------------------------------
+// Loads the specified shader and builds the variable table using shader
+// reflection.  This must be a separate step from the constructor since
+// we can't invoke derived class overrides in the base class constructor.
+//
+// Reflecting is slow, so what it finds is kept in a file beside the
+// shader (its name plus ".refl") and read from there on later runs,
+// for as long as the compiled shader's the same
+//
+// shaderFile - A "wide string" specifying the compiled shader to load
+// 
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
+{
+	// Load the shader to a blob and ensure it worked
+	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
+	if (hr != S_OK)
+	{
+		return false;
+	}
+
+	// Create the shader - Calls an overloaded version of this abstract
+	// method in the appropriate child class
+	shaderValid = CreateShader(shaderBlob);
+	if (!shaderValid)
+	{
+		return false;
+	}
+
+	// Get the variables, buffers, etc. from the cache if it's
+	// there and up to date, or by reflecting (and cache them)
+	std::wstring cacheFile = std::wstring(shaderFile) + L".refl";
+	ShaderReflectionData reflection = {};
+	if (!ReadReflectionCache(cacheFile.c_str(), shaderBlob, &reflection))
+	{
+		ReflectShader(shaderBlob, &reflection);
+		WriteReflectionCache(cacheFile.c_str(), reflection);
+	}
+
+	CreateResources(reflection);
+	return true;
+}
+
+// --------------------------------------------------------
+// Builds the tables of variables, buffers and resources,
+// and makes the constant buffers, from a shader's reflection
+// --------------------------------------------------------
+void ISimpleShader::CreateResources(const ShaderReflectionData& reflection)
+{
+	// Get the number of buffers and make the resource array
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+
+	// Size the tables up front, so they never grow
+	unsigned int variableCount = 0;
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+		variableCount += (unsigned int)reflection.ConstantBuffers[b].Variables.size();
+	cbTable.Reserve(constantBufferCount);
+	varTable.Reserve(variableCount);
+	textureTable.Reserve((unsigned int)reflection.Textures.size());
+	samplerTable.Reserve((unsigned int)reflection.Samplers.size());
+	variables.reserve(variableCount);
+	shaderResourceViews.reserve(reflection.Textures.size());
+	samplerStates.reserve(reflection.Samplers.size());
+	
+	// Handle bound resources (like shaders and samplers)
+	for (size_t t = 0; t < reflection.Textures.size(); t++)
+	{
+		// Create the SRV wrapper
+		SimpleSRV srv;
+		srv.BindIndex = reflection.Textures[t].BindIndex;		// Shader bind point
+		srv.Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+		if (!InsertShaderName(textureTable, reflection.Textures[t].Name, srv.Index))
+			continue;
+		shaderResourceViews.push_back(srv);
+	}
+
+	for (size_t s = 0; s < reflection.Samplers.size(); s++)
+	{
+		// Create the sampler wrapper
+		SimpleSampler samp;
+		samp.BindIndex = reflection.Samplers[s].BindIndex;	// Shader bind point
+		samp.Index = (unsigned int)samplerStates.size();	// Raw index
+
+		if (!InsertShaderName(samplerTable, reflection.Samplers[s].Name, samp.Index))
+			continue;
+		samplerStates.push_back(samp);
+	}
+
+	// Loop through all constant buffers
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ReflectedConstantBuffer& reflected = reflection.ConstantBuffers[b];
+		
+		// Save the type, which we reference when setting these buffers
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)reflected.Type;
+
+		// Set up the buffer and put its pointer in the table
+		constantBuffers[b].BindIndex = reflected.BindIndex;
+		constantBuffers[b].Name = reflected.Name;
+		InsertShaderName(cbTable, reflected.Name, b);
+		constantBuffers[b].Shared = 0;
+		constantBuffers[b].RingFirstConstant = 0;
+		constantBuffers[b].RingConstantCount = 0;
+		constantBuffers[b].RingEpoch = 0;
+
+		// A shared buffer stands in for ours, if the layout matches
+		SimpleSharedConstantBuffer* shared = 0;
+		if (constantBuffers[b].Type == D3D11_CT_CBUFFER)
+			shared = SimpleSharedConstantBuffer::Find(reflected.Name);
+		if (shared)
+		{
+			shared->CreateBuffer(reflected);
+			if (!shared->buffer.ConstantBuffer || !shared->MatchesLayout(reflected))
+				shared = 0;
+		}
+
+		if (shared)
+		{
+			constantBuffers[b].Shared = shared;
+			constantBuffers[b].ConstantBuffer = shared->buffer.ConstantBuffer;
+			constantBuffers[b].ConstantBuffer->AddRef();
+			constantBuffers[b].Size = shared->buffer.Size;
+			constantBuffers[b].LocalDataBuffer = shared->buffer.LocalDataBuffer;
+			constantBuffers[b].Dirty = false;
+			constantBuffers[b].DirtyStart = constantBuffers[b].DirtyEnd = 0;
+		}
+		else
+		{
+			// Create this constant buffer
+			D3D11_BUFFER_DESC newBuffDesc;
+			newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
+			newBuffDesc.ByteWidth = max(reflected.Size, 16); // NEW: Must be multiple of 16
+			newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+			newBuffDesc.CPUAccessFlags = 0;
+			newBuffDesc.MiscFlags = 0;
+			newBuffDesc.StructureByteStride = 0;
+			device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
+
+			// Set up the data buffer for this constant buffer
+			constantBuffers[b].Size = reflected.Size;
+			constantBuffers[b].LocalDataBuffer = new unsigned char[reflected.Size];
+			ZeroMemory(constantBuffers[b].LocalDataBuffer, reflected.Size);
+
+			// Nothing's on the GPU yet, so the first copy sends it all
+			constantBuffers[b].Dirty = true;
+			constantBuffers[b].DirtyStart = 0;
+			constantBuffers[b].DirtyEnd = reflected.Size;
+		}
+
+		// Loop through all variables in this buffer
+		for (size_t v = 0; v < reflected.Variables.size(); v++)
+		{
 			// Create the variable struct
 			SimpleShaderVariable varStruct;
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
+			varStruct.ByteOffset = reflected.Variables[v].ByteOffset;
+			varStruct.Size = reflected.Variables[v].Size;
 
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			// Add this variable to the table and the constant buffer.
+			// Its handle is its index in the list of all variables
+			if (InsertShaderName(varTable, reflected.Variables[v].Name, (unsigned int)variables.size()))
+				variables.push_back(varStruct);
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
-
-	// All set
-	refl->Release();
-	return true;
 }
 
 // --------------------------------------------------------
@@ -218,18 +392,17 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+SimpleShaderVariable* ISimpleShader::FindVariable(ShaderNameHash name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
-		varTable.find(name);
+	unsigned int handle = varTable.Find(name);
 
 	// Did we find the key?
-	if (result == varTable.end())
+	if (handle == SHADER_NAME_NONE)
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	// Grab the variable it names
+	SimpleShaderVariable* var = &variables[handle];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -242,18 +415,17 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
-SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
+SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(ShaderNameHash name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
-		cbTable.find(name);
+	unsigned int index = cbTable.Find(name);
 
 	// Did we find the key?
-	if (result == cbTable.end())
+	if (index == SHADER_NAME_NONE)
 		return 0;
 
 	// Success
-	return result->second;
+	return &constantBuffers[index];
 }
 
 // --------------------------------------------------------
@@ -264,9 +436,18 @@ void ISimpleShader::SetShader()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
+	// Buffers left in the ring under an older epoch may have been
+	// overwritten or discarded since, so they go again first
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (IsRingRangeStale(&constantBuffers[i]))
+			UploadBuffer(deviceContext, &constantBuffers[i]);
+	}
+
 	// Set the shader and any relevant constant buffers, which
 	// is an overloaded method in a subclass
 	SetShaderAndCBs();
+	boundShaders[GetStage()] = this;
 }
 
 // --------------------------------------------------------
@@ -279,13 +460,13 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy all data,
+	// rebinding any that moved if this shader's the one set
+	bool bound = IsBound();
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		if (UploadBuffer(deviceContext, &constantBuffers[i]) && bound)
+			SetConstantBuffer(i);
 	}
 }
 
@@ -309,14 +490,9 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if(index >= this->constantBufferCount)
 		return;
 
-	// Check for the buffer
-	SimpleConstantBuffer* cb = &this->constantBuffers[index];
-	if (!cb) return;
-
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	if (UploadBuffer(deviceContext, &this->constantBuffers[index]) && IsBound())
+		SetConstantBuffer(index);
 }
 
 // --------------------------------------------------------
@@ -326,19 +502,169 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 //              Useful for updating more frequently-changing
 //              variables without having to re-copy all buffers.
 // --------------------------------------------------------
-void ISimpleShader::CopyBufferData(std::string bufferName)
+void ISimpleShader::CopyBufferData(const std::string& bufferName)
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
 	// Check for the buffer
-	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(HashShaderName(bufferName));
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
+	if (UploadBuffer(deviceContext, cb) && IsBound())
+		SetConstantBuffer((unsigned int)(cb - constantBuffers));
+}
+
+// --------------------------------------------------------
+// Gets the buffer holding a constant buffer's data - the
+// shared buffer standing in for it, if there is one
+// --------------------------------------------------------
+SimpleConstantBuffer* ISimpleShader::GetDataBuffer(SimpleConstantBuffer* cb)
+{
+	return cb->Shared ? &cb->Shared->buffer : cb;
+}
+
+// --------------------------------------------------------
+// Writes part of a constant buffer's local data, growing
+// its dirty range to cover it.  Data that's already there
+// changes nothing
+// --------------------------------------------------------
+bool ISimpleShader::WriteBufferData(SimpleConstantBuffer* cb, unsigned int byteOffset, const void* data, unsigned int size)
+{
+	cb = GetDataBuffer(cb);
+	unsigned char* dest = cb->LocalDataBuffer + byteOffset;
+	if (memcmp(dest, data, size) == 0)
+		return true;
+
+	// Set the data in the local data buffer
+	memcpy(dest, data, size);
+
+	// And grow the range that needs uploading to cover it
+	unsigned int end = byteOffset + size;
+	if (!cb->Dirty)
+	{
+		cb->Dirty = true;
+		cb->DirtyStart = byteOffset;
+		cb->DirtyEnd = end;
+	}
+	else
+	{
+		if (byteOffset < cb->DirtyStart) cb->DirtyStart = byteOffset;
+		if (end > cb->DirtyEnd) cb->DirtyEnd = end;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies a constant buffer's local data to the GPU, if it
+// changed since the last time.  D3D11 can't update part of
+// a constant buffer, so the whole thing goes - the dirty
+// range is only counted.  With a ring, the data's appended
+// to it instead, and has to be bound at its new range
+// --------------------------------------------------------
+bool ISimpleShader::UploadBuffer(ID3D11DeviceContext* context, SimpleConstantBuffer* cb)
+{
+	cb = GetDataBuffer(cb);
+
+	// The shader's own buffers go in the ring, if there is one.  What's
+	// there is only good until the ring's epoch moves on
+	bool ring = constantRing && !cb->Shared && cb->Type == D3D11_CT_CBUFFER;
+	bool inRing = cb->RingConstantCount > 0;
+	bool current = ring ? inRing && cb->RingEpoch == constantRing->GetEpoch() : !inRing;
+	if (!cb->Dirty && current)
+	{
+		uploadStats.SkippedUploads++;
+		return false;
+	}
+
+	uploadStats.Uploads++;
+	uploadStats.BytesUploaded += cb->Size;
+	uploadStats.DirtyBytes += cb->Dirty ? cb->DirtyEnd - cb->DirtyStart : 0;
+	cb->Dirty = false;
+
+	// Writing may discard the ring, which leaves every shader still
+	// bound pointing at ranges of the renamed buffer
+	unsigned int discards = ring ? constantRing->GetDiscardCount() : 0;
+	bool written = ring && constantRing->Write(cb->LocalDataBuffer, cb->Size, &cb->RingFirstConstant, &cb->RingConstantCount);
+	if (written)
+		cb->RingEpoch = constantRing->GetEpoch();
+	if (ring && constantRing->GetDiscardCount() != discards)
+		RestoreBoundShaders();
+	if (written)
+		return true;
+
+	// Into the buffer's own
+	cb->RingConstantCount = 0;
+	context->UpdateSubresource(
+		cb->ConstantBuffer, 0, 0,
 		cb->LocalDataBuffer, 0, 0);
+	return inRing;
+}
+
+// --------------------------------------------------------
+// Whether a buffer was put in the ring under an epoch
+// that's passed (or a ring that's gone), so its range may
+// no longer hold its data
+// --------------------------------------------------------
+bool ISimpleShader::IsRingRangeStale(SimpleConstantBuffer* cb)
+{
+	cb = GetDataBuffer(cb);
+	return cb->RingConstantCount > 0 && (!constantRing || cb->RingEpoch != constantRing->GetEpoch());
+}
+
+// --------------------------------------------------------
+// After the ring's discarded mid frame, writes the buffers
+// of every shader still set on a stage again and rebinds
+// them, so the next draw doesn't read the renamed buffer.
+// A discard while doing so (a ring too small for even the
+// bound shaders) isn't chased any further
+// --------------------------------------------------------
+void ISimpleShader::RestoreBoundShaders()
+{
+	if (restoringRing)
+		return;
+
+	restoringRing = true;
+	for (unsigned int s = 0; s < SIMPLE_SHADER_STAGE_COUNT; s++)
+	{
+		ISimpleShader* shader = boundShaders[s];
+		if (!shader)
+			continue;
+
+		for (unsigned int i = 0; i < shader->constantBufferCount; i++)
+		{
+			if (shader->IsRingRangeStale(&shader->constantBuffers[i]) &&
+				UploadBuffer(shader->deviceContext, &shader->constantBuffers[i]))
+				shader->SetConstantBuffer(i);
+		}
+	}
+	restoringRing = false;
+}
+
+// --------------------------------------------------------
+// Sets (or with 0, clears) the ring every shader uploads
+// its own constant buffers to
+// --------------------------------------------------------
+void ISimpleShader::SetConstantBufferRing(ConstantBufferRing* ring)
+{
+	constantRing = ring && ring->IsSupported() ? ring : 0;
+}
+
+// --------------------------------------------------------
+// Gets the upload totals of every shader
+// --------------------------------------------------------
+const SimpleShaderUploadStats& ISimpleShader::GetUploadStats()
+{
+	return uploadStats;
+}
+
+// --------------------------------------------------------
+// Starts the upload totals over (at the start of a frame)
+// --------------------------------------------------------
+void ISimpleShader::ResetUploadStats()
+{
+	uploadStats = SimpleShaderUploadStats();
 }
 
 
@@ -352,109 +678,234 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 // Returns true if data is copied, false if variable doesn't 
 // exist or sizes don't match
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::SetData(const std::string& name, const void* data, unsigned int size)
 {
-	// Look for the variable and verify
-	SimpleShaderVariable* var = FindVariable(name, size);
-	if (var == 0)
+	return SetData(GetVariableHandle(name), data, size);
+}
+
+// --------------------------------------------------------
+// Sets a variable by handle with arbitrary data of the specified size.
+// Same as by name, without looking the name up
+//
+// handle - The variable, from GetVariableHandle()
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderHandle handle, const void* data, unsigned int size)
+{
+	// Verify the handle and size
+	if ((unsigned int)handle >= variables.size())
+		return false;
+	const SimpleShaderVariable& var = variables[handle];
+	if (var.Size != size)
 		return false;
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	// Set the data in the local data buffer (or the shared one)
+	return WriteBufferData(&constantBuffers[var.ConstantBufferIndex], var.ByteOffset, data, size);
+}
 
-	// Success
-	return true;
+// --------------------------------------------------------
+// Sets INTEGER data by name or handle
+// --------------------------------------------------------
+bool ISimpleShader::SetInt(const std::string& name, int data)
+{
+	return this->SetData(GetVariableHandle(name), (void*)(&data), sizeof(int));
+}
+
+bool ISimpleShader::SetInt(SimpleShaderHandle handle, int data)
+{
+	return this->SetData(handle, (void*)(&data), sizeof(int));
 }
 
 // --------------------------------------------------------
-// Sets INTEGER data
+// Sets a FLOAT variable by name or handle in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetInt(std::string name, int data)
+bool ISimpleShader::SetFloat(const std::string& name, float data)
 {
-	return this->SetData(name, (void*)(&data), sizeof(int));
+	return this->SetData(GetVariableHandle(name), (void*)(&data), sizeof(float));
+}
+
+bool ISimpleShader::SetFloat(SimpleShaderHandle handle, float data)
+{
+	return this->SetData(handle, (void*)(&data), sizeof(float));
 }
 
 // --------------------------------------------------------
-// Sets a FLOAT variable by name in the local data buffer
+// Sets a FLOAT2 variable by name or handle in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat(std::string name, float data)
+bool ISimpleShader::SetFloat2(const std::string& name, const float data[2])
 {
-	return this->SetData(name, (void*)(&data), sizeof(float));
+	return this->SetData(GetVariableHandle(name), (void*)data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat2(SimpleShaderHandle handle, const float data[2])
+{
+	return this->SetData(handle, (void*)data, sizeof(float) * 2);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT2 variable by name or handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat2(const std::string& name, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(GetVariableHandle(name), &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 2);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT3 variable by name or handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat3(const std::string& name, const float data[3])
+{
+	return this->SetData(GetVariableHandle(name), (void*)data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat3(SimpleShaderHandle handle, const float data[3])
+{
+	return this->SetData(handle, (void*)data, sizeof(float) * 3);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT3 variable by name or handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat3(const std::string& name, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(GetVariableHandle(name), &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT4 variable by name or handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat4(const std::string& name, const float data[4])
+{
+	return this->SetData(GetVariableHandle(name), (void*)data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetFloat4(SimpleShaderHandle handle, const float data[4])
+{
+	return this->SetData(handle, (void*)data, sizeof(float) * 4);
 }
 
 // --------------------------------------------------------
-// Sets a FLOAT2 variable by name in the local data buffer
+// Sets a FLOAT4 variable by name or handle in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const float data[2])
+bool ISimpleShader::SetFloat4(const std::string& name, const DirectX::XMFLOAT4& data)
 {
-	return this->SetData(name, (void*)data, sizeof(float) * 2);
+	return this->SetData(GetVariableHandle(name), &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
 }
 
 // --------------------------------------------------------
-// Sets a FLOAT2 variable by name in the local data buffer
+// Sets a MATRIX (4x4) variable by name or handle in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const float data[16])
 {
-	return this->SetData(name, &data, sizeof(float) * 2);
+	return this->SetData(GetVariableHandle(name), (void*)data, sizeof(float) * 16);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleShaderHandle handle, const float data[16])
+{
+	return this->SetData(handle, (void*)data, sizeof(float) * 16);
 }
 
 // --------------------------------------------------------
-// Sets a FLOAT3 variable by name in the local data buffer
+// Sets a MATRIX (4x4) variable by name or handle in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const float data[3])
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4& data)
 {
-	return this->SetData(name, (void*)data, sizeof(float) * 3);
+	return this->SetData(GetVariableHandle(name), &data, sizeof(float) * 16);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
 }
 
 // --------------------------------------------------------
-// Sets a FLOAT3 variable by name in the local data buffer
+// Gets the handle of a variable (or SIMPLE_SHADER_INVALID_HANDLE),
+// for setting it later without looking up its name
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
+SimpleShaderHandle ISimpleShader::GetVariableHandle(const std::string& name)
+{
+	return GetVariableHandle(HashShaderName(name));
+}
+
+SimpleShaderHandle ISimpleShader::GetVariableHandle(ShaderNameHash name)
 {
-	return this->SetData(name, &data, sizeof(float) * 3);
+	// Look for the key
+	unsigned int handle = varTable.Find(name);
+
+	// Did we find the key?
+	if (handle == SHADER_NAME_NONE)
+		return SIMPLE_SHADER_INVALID_HANDLE;
+
+	// Success
+	return (SimpleShaderHandle)handle;
 }
 
 // --------------------------------------------------------
-// Sets a FLOAT4 variable by name in the local data buffer
+// Gets the handle of an SRV (or SIMPLE_SHADER_INVALID_HANDLE)
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const float data[4])
+SimpleShaderHandle ISimpleShader::GetShaderResourceViewHandle(const std::string& name)
 {
-	return this->SetData(name, (void*)data, sizeof(float) * 4);
+	return GetShaderResourceViewHandle(HashShaderName(name));
+}
+
+SimpleShaderHandle ISimpleShader::GetShaderResourceViewHandle(ShaderNameHash name)
+{
+	unsigned int handle = textureTable.Find(name);
+	return handle != SHADER_NAME_NONE ? (SimpleShaderHandle)handle : SIMPLE_SHADER_INVALID_HANDLE;
 }
 
 // --------------------------------------------------------
-// Sets a FLOAT4 variable by name in the local data buffer
+// Gets the handle of a sampler (or SIMPLE_SHADER_INVALID_HANDLE)
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
+SimpleShaderHandle ISimpleShader::GetSamplerHandle(const std::string& name)
+{
+	return GetSamplerHandle(HashShaderName(name));
+}
+
+SimpleShaderHandle ISimpleShader::GetSamplerHandle(ShaderNameHash name)
 {
-	return this->SetData(name, &data, sizeof(float) * 4);
+	unsigned int handle = samplerTable.Find(name);
+	return handle != SHADER_NAME_NONE ? (SimpleShaderHandle)handle : SIMPLE_SHADER_INVALID_HANDLE;
 }
 
 // --------------------------------------------------------
-// Sets a MATRIX (4x4) variable by name in the local data buffer
+// Sets a shader resource view by name, in whichever stage
+// this shader is for
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
+bool ISimpleShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
-	return this->SetData(name, (void*)data, sizeof(float) * 16);
+	return SetShaderResourceView(GetShaderResourceViewHandle(name), srv);
 }
 
 // --------------------------------------------------------
-// Sets a MATRIX (4x4) variable by name in the local data buffer
+// Sets a sampler state by name, in whichever stage this
+// shader is for
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data)
+bool ISimpleShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
-	return this->SetData(name, &data, sizeof(float) * 16);
+	return SetSamplerState(GetSamplerHandle(name), samplerState);
 }
 
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
-const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
+const SimpleShaderVariable* ISimpleShader::GetVariableInfo(const std::string& name)
 {
-	return FindVariable(name, -1);
+	return FindVariable(HashShaderName(name), -1);
 }
 
 // --------------------------------------------------------
@@ -462,18 +913,9 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 //
 // name - the name of the SRV
 // --------------------------------------------------------
-const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
+const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(const std::string& name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSRV*>::iterator result =
-		textureTable.find(name);
-
-	// Did we find the key?
-	if (result == textureTable.end())
-		return 0;
-
-	// Success
-	return result->second;
+	return GetShaderResourceViewInfo((unsigned int)GetShaderResourceViewHandle(name));
 }
 
 
@@ -488,7 +930,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 	if (index >= shaderResourceViews.size()) return 0;
 
 	// Grab the bind index
-	return shaderResourceViews[index];
+	return &shaderResourceViews[index];
 }
 
 
@@ -497,18 +939,9 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // 
 // name - the name of the sampler
 // --------------------------------------------------------
-const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
+const SimpleSampler* ISimpleShader::GetSamplerInfo(const std::string& name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSampler*>::iterator result =
-		samplerTable.find(name);
-
-	// Did we find the key?
-	if (result == samplerTable.end())
-		return 0;
-
-	// Success
-	return result->second;
+	return GetSamplerInfo((unsigned int)GetSamplerHandle(name));
 }
 
 // --------------------------------------------------------
@@ -522,7 +955,7 @@ const SimpleSampler* ISimpleShader::GetSamplerInfo(unsigned int index)
 	if (index >= samplerStates.size()) return 0;
 
 	// Grab the bind index
-	return samplerStates[index];
+	return &samplerStates[index];
 }
 
 
@@ -550,9 +983,9 @@ unsigned int ISimpleShader::GetBufferSize(unsigned int index)
 // Gets info about a particular constant buffer 
 // by name, if it exists
 // --------------------------------------------------------
-const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string name)
+const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(const std::string& name)
 {
-	return FindConstantBuffer(name);
+	return FindConstantBuffer(HashShaderName(name));
 }
 
 // --------------------------------------------------------
@@ -607,6 +1040,29 @@ SimpleVertexShader::SimpleVertexShader(ID3D11Device * device, ID3D11DeviceContex
 	this->perInstanceCompatible = perInstanceCompatible;
 }
 
+// --------------------------------------------------------
+// Constructor overload which takes input layout elements
+//
+// The input layout is created from these elements during
+// LoadShader(), rather than from shader reflection - needed
+// when the vertex data isn't 32-bit (half floats, SNORMs, ...)
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(ID3D11Device * device, ID3D11DeviceContext * context, const D3D11_INPUT_ELEMENT_DESC * inputElements, unsigned int inputElementCount)
+	: ISimpleShader(device, context)
+{
+	this->inputLayout = 0;
+	this->shader = 0;
+	this->inputElements.assign(inputElements, inputElements + inputElementCount);
+
+	// Look for instance data the same way reflection would
+	this->perInstanceCompatible = false;
+	for (unsigned int i = 0; i < inputElementCount; i++)
+	{
+		if (inputElements[i].InputSlotClass == D3D11_INPUT_PER_INSTANCE_DATA)
+			this->perInstanceCompatible = true;
+	}
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -654,6 +1110,18 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 	if (inputLayout)
 		return true;
 
+	// Were we given the elements to make one from?
+	if (!inputElements.empty())
+	{
+		device->CreateInputLayout(
+			&inputElements[0],
+			(unsigned int)inputElements.size(),
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize(),
+			&inputLayout);
+		return true;
+	}
+
 	// Vertex shader was created successfully, so we now use the
 	// shader code to re-reflect and create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
@@ -769,25 +1237,48 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		SetConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer - at its range of the ring, if
+// that's where it was uploaded
+// --------------------------------------------------------
+void SimpleVertexShader::SetConstantBuffer(unsigned int index)
+{
+	const SimpleConstantBuffer& cb = constantBuffers[index];
+	if (cb.RingConstantCount > 0 && constantRing)
+	{
+		ID3D11Buffer* ring = constantRing->GetBuffer();
+		constantRing->GetContext1()->VSSetConstantBuffers1(
+			cb.BindIndex,
+			1,
+			&ring,
+			&cb.RingFirstConstant,
+			&cb.RingConstantCount);
+	}
+	else
+	{
 		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb.BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb.ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
 // Sets a shader resource view in the vertex shader stage
 //
-// name - The name of the texture resource in the shader
+// handle - The texture, from GetShaderResourceViewHandle()
 // srv - The shader resource view of the texture in GPU memory
 //
-// Returns true if a texture of the given name was found, false otherwise
+// Returns true if the handle names a texture, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleVertexShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
 	if (srvInfo == 0)
 		return false;
 
@@ -801,15 +1292,15 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 // --------------------------------------------------------
 // Sets a sampler state in the vertex shader stage
 //
-// name - The name of the sampler state in the shader
+// handle - The sampler, from GetSamplerHandle()
 // samplerState - The sampler state in GPU memory
 //
-// Returns true if a sampler of the given name was found, false otherwise
+// Returns true if the handle names a sampler, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleVertexShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
 	if (sampInfo == 0)
 		return false;
 
@@ -895,25 +1386,48 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		SetConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer - at its range of the ring, if
+// that's where it was uploaded
+// --------------------------------------------------------
+void SimplePixelShader::SetConstantBuffer(unsigned int index)
+{
+	const SimpleConstantBuffer& cb = constantBuffers[index];
+	if (cb.RingConstantCount > 0 && constantRing)
+	{
+		ID3D11Buffer* ring = constantRing->GetBuffer();
+		constantRing->GetContext1()->PSSetConstantBuffers1(
+			cb.BindIndex,
+			1,
+			&ring,
+			&cb.RingFirstConstant,
+			&cb.RingConstantCount);
+	}
+	else
+	{
 		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb.BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb.ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
 // Sets a shader resource view in the pixel shader stage
 //
-// name - The name of the texture resource in the shader
+// handle - The texture, from GetShaderResourceViewHandle()
 // srv - The shader resource view of the texture in GPU memory
 //
-// Returns true if a texture of the given name was found, false otherwise
+// Returns true if the handle names a texture, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimplePixelShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
 	if (srvInfo == 0)
 		return false;
 
@@ -927,15 +1441,15 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 // --------------------------------------------------------
 // Sets a sampler state in the pixel shader stage
 //
-// name - The name of the sampler state in the shader
+// handle - The sampler, from GetSamplerHandle()
 // samplerState - The sampler state in GPU memory
 //
-// Returns true if a sampler of the given name was found, false otherwise
+// Returns true if the handle names a sampler, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimplePixelShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
 	if (sampInfo == 0)
 		return false;
 
@@ -1023,25 +1537,48 @@ void SimpleDomainShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		SetConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer - at its range of the ring, if
+// that's where it was uploaded
+// --------------------------------------------------------
+void SimpleDomainShader::SetConstantBuffer(unsigned int index)
+{
+	const SimpleConstantBuffer& cb = constantBuffers[index];
+	if (cb.RingConstantCount > 0 && constantRing)
+	{
+		ID3D11Buffer* ring = constantRing->GetBuffer();
+		constantRing->GetContext1()->DSSetConstantBuffers1(
+			cb.BindIndex,
+			1,
+			&ring,
+			&cb.RingFirstConstant,
+			&cb.RingConstantCount);
+	}
+	else
+	{
 		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb.BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb.ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
 // Sets a shader resource view in the domain shader stage
 //
-// name - The name of the texture resource in the shader
+// handle - The texture, from GetShaderResourceViewHandle()
 // srv - The shader resource view of the texture in GPU memory
 //
-// Returns true if a texture of the given name was found, false otherwise
+// Returns true if the handle names a texture, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleDomainShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
 	if (srvInfo == 0)
 		return false;
 
@@ -1055,15 +1592,15 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 // --------------------------------------------------------
 // Sets a sampler state in the domain shader stage
 //
-// name - The name of the sampler state in the shader
+// handle - The sampler, from GetSamplerHandle()
 // samplerState - The sampler state in GPU memory
 //
-// Returns true if a sampler of the given name was found, false otherwise
+// Returns true if the handle names a sampler, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleDomainShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
 	if (sampInfo == 0)
 		return false;
 
@@ -1150,25 +1687,48 @@ void SimpleHullShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		SetConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer - at its range of the ring, if
+// that's where it was uploaded
+// --------------------------------------------------------
+void SimpleHullShader::SetConstantBuffer(unsigned int index)
+{
+	const SimpleConstantBuffer& cb = constantBuffers[index];
+	if (cb.RingConstantCount > 0 && constantRing)
+	{
+		ID3D11Buffer* ring = constantRing->GetBuffer();
+		constantRing->GetContext1()->HSSetConstantBuffers1(
+			cb.BindIndex,
+			1,
+			&ring,
+			&cb.RingFirstConstant,
+			&cb.RingConstantCount);
+	}
+	else
+	{
 		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb.BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb.ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
 // Sets a shader resource view in the hull shader stage
 //
-// name - The name of the texture resource in the shader
+// handle - The texture, from GetShaderResourceViewHandle()
 // srv - The shader resource view of the texture in GPU memory
 //
-// Returns true if a texture of the given name was found, false otherwise
+// Returns true if the handle names a texture, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleHullShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
 	if (srvInfo == 0)
 		return false;
 
@@ -1182,15 +1742,15 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResou
 // --------------------------------------------------------
 // Sets a sampler state in the hull shader stage
 //
-// name - The name of the sampler state in the shader
+// handle - The sampler, from GetSamplerHandle()
 // samplerState - The sampler state in GPU memory
 //
-// Returns true if a sampler of the given name was found, false otherwise
+// Returns true if the handle names a sampler, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleHullShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
 	if (sampInfo == 0)
 		return false;
 
@@ -1399,25 +1959,48 @@ void SimpleGeometryShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		SetConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer - at its range of the ring, if
+// that's where it was uploaded
+// --------------------------------------------------------
+void SimpleGeometryShader::SetConstantBuffer(unsigned int index)
+{
+	const SimpleConstantBuffer& cb = constantBuffers[index];
+	if (cb.RingConstantCount > 0 && constantRing)
+	{
+		ID3D11Buffer* ring = constantRing->GetBuffer();
+		constantRing->GetContext1()->GSSetConstantBuffers1(
+			cb.BindIndex,
+			1,
+			&ring,
+			&cb.RingFirstConstant,
+			&cb.RingConstantCount);
+	}
+	else
+	{
 		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb.BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb.ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
 // Sets a shader resource view in the Geometry shader stage
 //
-// name - The name of the texture resource in the shader
+// handle - The texture, from GetShaderResourceViewHandle()
 // srv - The shader resource view of the texture in GPU memory
 //
-// Returns true if a texture of the given name was found, false otherwise
+// Returns true if the handle names a texture, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleGeometryShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
 	if (srvInfo == 0)
 		return false;
 
@@ -1431,15 +2014,15 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderR
 // --------------------------------------------------------
 // Sets a sampler state in the Geometry shader stage
 //
-// name - The name of the sampler state in the shader
+// handle - The sampler, from GetSamplerHandle()
 // samplerState - The sampler state in GPU memory
 //
-// Returns true if a sampler of the given name was found, false otherwise
+// Returns true if the handle names a sampler, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleGeometryShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
 	if (sampInfo == 0)
 		return false;
 
@@ -1498,7 +2081,7 @@ void SimpleComputeShader::CleanUp()
 	ISimpleShader::CleanUp();
 	if (shader) { shader->Release(); shader = 0; }
 
-	uavTable.clear();
+	uavTable.Clear();
 }
 
 // --------------------------------------------------------
@@ -1560,7 +2143,7 @@ bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
 		case D3D_SIT_UAV_RWSTRUCTURED:
 		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
 		case D3D_SIT_UAV_RWTYPED:
-			uavTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
+			InsertShaderName(uavTable, resourceDesc.Name, resourceDesc.BindPoint);
 		}
 	}
 
@@ -1589,10 +2172,33 @@ void SimpleComputeShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		SetConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer - at its range of the ring, if
+// that's where it was uploaded
+// --------------------------------------------------------
+void SimpleComputeShader::SetConstantBuffer(unsigned int index)
+{
+	const SimpleConstantBuffer& cb = constantBuffers[index];
+	if (cb.RingConstantCount > 0 && constantRing)
+	{
+		ID3D11Buffer* ring = constantRing->GetBuffer();
+		constantRing->GetContext1()->CSSetConstantBuffers1(
+			cb.BindIndex,
+			1,
+			&ring,
+			&cb.RingFirstConstant,
+			&cb.RingConstantCount);
+	}
+	else
+	{
 		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb.BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb.ConstantBuffer);
 	}
 }
 
@@ -1652,15 +2258,15 @@ void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int
 // --------------------------------------------------------
 // Sets a shader resource view in the Compute shader stage
 //
-// name - The name of the texture resource in the shader
+// handle - The texture, from GetShaderResourceViewHandle()
 // srv - The shader resource view of the texture in GPU memory
 //
-// Returns true if a texture of the given name was found, false otherwise
+// Returns true if the handle names a texture, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleComputeShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
 	if (srvInfo == 0)
 		return false;
 
@@ -1674,15 +2280,15 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderRe
 // --------------------------------------------------------
 // Sets a sampler state in the Compute shader stage
 //
-// name - The name of the sampler state in the shader
+// handle - The sampler, from GetSamplerHandle()
 // samplerState - The sampler state in GPU memory
 //
-// Returns true if a sampler of the given name was found, false otherwise
+// Returns true if the handle names a sampler, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleComputeShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
 	if (sampInfo == 0)
 		return false;
 
@@ -1722,13 +2328,196 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11Unorder
 int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
 {
 	// Look for the key
-	std::unordered_map<std::string, unsigned int>::iterator result =
-		uavTable.find(name);
+	unsigned int bindIndex = uavTable.Find(HashShaderName(name));
 
 	// Did we find the key?
-	if (result == uavTable.end())
+	if (bindIndex == SHADER_NAME_NONE)
 		return -1;
 
 	// Success
+	return bindIndex;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ SHARED CONSTANT BUFFER ----------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+std::unordered_map<std::string, SimpleSharedConstantBuffer*> SimpleSharedConstantBuffer::sharedBuffers;
+
+// --------------------------------------------------------
+// Constructor - from now on, shaders loaded with a cbuffer
+// called name use this
+// --------------------------------------------------------
+SimpleSharedConstantBuffer::SimpleSharedConstantBuffer(ID3D11Device* device, ID3D11DeviceContext* context, const std::string& name)
+{
+	this->name = name;
+	this->device = device;
+	this->deviceContext = context;
+
+	// No layout (or buffer) until a shader using it is loaded
+	buffer.Name = name;
+	buffer.Type = D3D11_CT_CBUFFER;
+	buffer.Size = 0;
+	buffer.BindIndex = 0;
+	buffer.ConstantBuffer = 0;
+	buffer.LocalDataBuffer = 0;
+	buffer.Dirty = false;
+	buffer.DirtyStart = 0;
+	buffer.DirtyEnd = 0;
+	buffer.Shared = this;	// Never goes in the ring
+	buffer.RingFirstConstant = 0;
+	buffer.RingConstantCount = 0;
+	buffer.RingEpoch = 0;
+
+	sharedBuffers[name] = this;
+}
+
+// --------------------------------------------------------
+// Destructor - shaders already using it must be gone
+// --------------------------------------------------------
+SimpleSharedConstantBuffer::~SimpleSharedConstantBuffer()
+{
+	std::unordered_map<std::string, SimpleSharedConstantBuffer*>::iterator result =
+		sharedBuffers.find(name);
+	if (result != sharedBuffers.end() && result->second == this)
+		sharedBuffers.erase(result);
+
+	if (buffer.ConstantBuffer) { buffer.ConstantBuffer->Release(); }
+	delete[] buffer.LocalDataBuffer;
+}
+
+// --------------------------------------------------------
+// Gets the shared buffer for cbuffers called name (or null)
+// --------------------------------------------------------
+SimpleSharedConstantBuffer* SimpleSharedConstantBuffer::Find(const std::string& name)
+{
+	std::unordered_map<std::string, SimpleSharedConstantBuffer*>::iterator result =
+		sharedBuffers.find(name);
+	if (result == sharedBuffers.end())
+		return 0;
 	return result->second;
-}
\ No newline at end of file
+}
+
+// --------------------------------------------------------
+// Takes the size and variables of a shader's cbuffer, the
+// first time one is found
+// --------------------------------------------------------
+void SimpleSharedConstantBuffer::CreateBuffer(const ReflectedConstantBuffer& reflected)
+{
+	if (buffer.ConstantBuffer)
+		return;
+
+	unsigned int size = reflected.Size;
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = max(size, 16);
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	device->CreateBuffer(&desc, 0, &buffer.ConstantBuffer);
+
+	buffer.Size = size;
+	buffer.LocalDataBuffer = new unsigned char[size];
+	ZeroMemory(buffer.LocalDataBuffer, size);
+	buffer.Dirty = true;
+	buffer.DirtyStart = 0;
+	buffer.DirtyEnd = size;
+
+	for (size_t v = 0; v < reflected.Variables.size(); v++)
+	{
+		SimpleShaderVariable varStruct;
+		varStruct.ConstantBufferIndex = 0;
+		varStruct.ByteOffset = reflected.Variables[v].ByteOffset;
+		varStruct.Size = reflected.Variables[v].Size;
+
+		if (InsertShaderName(varTable, reflected.Variables[v].Name, (unsigned int)variables.size()))
+			variables.push_back(varStruct);
+		buffer.Variables.push_back(varStruct);
+	}
+}
+
+// --------------------------------------------------------
+// Whether a shader's cbuffer is laid out like this one - the
+// same size, and the same variables at the same offsets - so
+// writes through either land where the other expects them
+// --------------------------------------------------------
+bool SimpleSharedConstantBuffer::MatchesLayout(const ReflectedConstantBuffer& reflected)
+{
+	if (reflected.Size != buffer.Size || reflected.Variables.size() != buffer.Variables.size())
+		return false;
+
+	for (size_t v = 0; v < reflected.Variables.size(); v++)
+	{
+		const ReflectedVariable& var = reflected.Variables[v];
+		unsigned int handle = varTable.Find(HashShaderName(var.Name));
+		if (handle == SHADER_NAME_NONE ||
+			variables[handle].ByteOffset != var.ByteOffset ||
+			variables[handle].Size != var.Size)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Gets the handle of a variable (or SIMPLE_SHADER_INVALID_HANDLE)
+// --------------------------------------------------------
+SimpleShaderHandle SimpleSharedConstantBuffer::GetVariableHandle(const std::string& name)
+{
+	return GetVariableHandle(HashShaderName(name));
+}
+
+SimpleShaderHandle SimpleSharedConstantBuffer::GetVariableHandle(ShaderNameHash name)
+{
+	unsigned int handle = varTable.Find(name);
+	if (handle == SHADER_NAME_NONE)
+		return SIMPLE_SHADER_INVALID_HANDLE;
+	return (SimpleShaderHandle)handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable, as ISimpleShader::SetData does
+// --------------------------------------------------------
+bool SimpleSharedConstantBuffer::SetData(const std::string& name, const void* data, unsigned int size)
+{
+	return SetData(GetVariableHandle(name), data, size);
+}
+
+bool SimpleSharedConstantBuffer::SetData(SimpleShaderHandle handle, const void* data, unsigned int size)
+{
+	if ((unsigned int)handle >= variables.size())
+		return false;
+	const SimpleShaderVariable& var = variables[handle];
+	if (var.Size != size)
+		return false;
+
+	return ISimpleShader::WriteBufferData(&buffer, var.ByteOffset, data, size);
+}
+
+bool SimpleSharedConstantBuffer::SetFloat(const std::string& name, float data)
+{
+	return SetData(name, &data, sizeof(float));
+}
+
+bool SimpleSharedConstantBuffer::SetFloat3(const std::string& name, const DirectX::XMFLOAT3& data)
+{
+	return SetData(name, &data, sizeof(float) * 3);
+}
+
+bool SimpleSharedConstantBuffer::SetFloat4(const std::string& name, const DirectX::XMFLOAT4& data)
+{
+	return SetData(name, &data, sizeof(float) * 4);
+}
+
+bool SimpleSharedConstantBuffer::SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4& data)
+{
+	return SetData(name, &data, sizeof(float) * 16);
+}
+
+// --------------------------------------------------------
+// Uploads the buffer, if it changed since the last upload
+// --------------------------------------------------------
+void SimpleSharedConstantBuffer::CopyBufferData()
+{
+	if (buffer.ConstantBuffer)
+		ISimpleShader::UploadBuffer(deviceContext, &buffer);
+}
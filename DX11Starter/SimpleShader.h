@@ -10,6 +10,33 @@
 #include <vector>
 #include <string>
 
+#include "ShaderNameTable.h"
+#include "ShaderReflectionCache.h"
+
+// --------------------------------------------------------
+// Names a variable, SRV or sampler of one shader, looked up
+// once so setting it later skips hashing the name.  Only
+// good for the shader it came from
+//
+// Names can be looked up by hash too, so a handle for a
+// string literal needs no hashing at all:
+//   GetVariableHandle(SHADER_NAME("world"))
+// --------------------------------------------------------
+typedef int SimpleShaderHandle;
+#define SIMPLE_SHADER_INVALID_HANDLE -1
+
+// Pipeline stages, for tracking which shader is set on each
+#define SIMPLE_SHADER_STAGE_VERTEX 0
+#define SIMPLE_SHADER_STAGE_PIXEL 1
+#define SIMPLE_SHADER_STAGE_DOMAIN 2
+#define SIMPLE_SHADER_STAGE_HULL 3
+#define SIMPLE_SHADER_STAGE_GEOMETRY 4
+#define SIMPLE_SHADER_STAGE_COMPUTE 5
+#define SIMPLE_SHADER_STAGE_COUNT 6
+
+class SimpleSharedConstantBuffer;
+class ConstantBufferRing;
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -35,6 +62,36 @@ struct SimpleConstantBuffer
 	ID3D11Buffer* ConstantBuffer;
 	unsigned char* LocalDataBuffer;
 	std::vector<SimpleShaderVariable> Variables;
+
+	// Bytes [DirtyStart, DirtyEnd) of LocalDataBuffer changed
+	// since the last upload.  Clean buffers aren't uploaded
+	bool Dirty;
+	unsigned int DirtyStart;
+	unsigned int DirtyEnd;
+
+	// Set if the shader binds a shared buffer here instead of its
+	// own - its data and dirty range are the shared one's.  The
+	// shared buffer's own points back at it
+	SimpleSharedConstantBuffer* Shared;
+
+	// Where the last upload went in the constant buffer ring, in
+	// 16 byte constants (a count of 0 if it went to ConstantBuffer),
+	// and the ring's epoch then
+	unsigned int RingFirstConstant;
+	unsigned int RingConstantCount;
+	unsigned int RingEpoch;
+};
+
+// --------------------------------------------------------
+// Constant buffer uploads by every shader, for seeing what
+// a frame costs
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	unsigned int Uploads;
+	unsigned int BytesUploaded;	// Whole buffers
+	unsigned int DirtyBytes;	// The parts of them that changed
+	unsigned int SkippedUploads;	// Copies of buffers that hadn't changed
 };
 
 // --------------------------------------------------------
@@ -71,45 +128,80 @@ public:
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
-	// Activating the shader and copying data
+	// Totals since the last reset, across every shader.  Only
+	// for the thread that owns the device context
+	static const SimpleShaderUploadStats& GetUploadStats();
+	static void ResetUploadStats();
+
+	// Uploads of every shader's own cbuffers go into ring from
+	// now on, bound at offsets, rather than each into its own
+	// buffer (0 to go back).  Only a ring that IsSupported()
+	// is used.  Shared buffers always keep their own.  If the
+	// ring's discarded mid frame, the shaders set on each stage
+	// write theirs again, and others do when next set
+	static void SetConstantBufferRing(ConstantBufferRing* ring);
+
+	// Activating the shader and copying data.  Copies skip
+	// buffers that haven't changed since they were last copied
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
-	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(const std::string& bufferName);
+
+	// Handles, for things set often (see SimpleShaderHandle)
+	SimpleShaderHandle GetVariableHandle(const std::string& name);
+	SimpleShaderHandle GetVariableHandle(ShaderNameHash name);
+	SimpleShaderHandle GetShaderResourceViewHandle(const std::string& name);
+	SimpleShaderHandle GetShaderResourceViewHandle(ShaderNameHash name);
+	SimpleShaderHandle GetSamplerHandle(const std::string& name);
+	SimpleShaderHandle GetSamplerHandle(ShaderNameHash name);
 
 	// Sets arbitrary shader data
-	bool SetData(std::string name, const void* data, unsigned int size);
-
-	bool SetInt(std::string name, int data);
-	bool SetFloat(std::string name, float data);
-	bool SetFloat2(std::string name, const float data[2]);
-	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
-	bool SetFloat3(std::string name, const float data[3]);
-	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
-	bool SetFloat4(std::string name, const float data[4]);
-	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
-	bool SetMatrix4x4(std::string name, const float data[16]);
-	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+	bool SetData(const std::string& name, const void* data, unsigned int size);
+	bool SetData(SimpleShaderHandle handle, const void* data, unsigned int size);
+
+	bool SetInt(const std::string& name, int data);
+	bool SetInt(SimpleShaderHandle handle, int data);
+	bool SetFloat(const std::string& name, float data);
+	bool SetFloat(SimpleShaderHandle handle, float data);
+	bool SetFloat2(const std::string& name, const float data[2]);
+	bool SetFloat2(SimpleShaderHandle handle, const float data[2]);
+	bool SetFloat2(const std::string& name, const DirectX::XMFLOAT2& data);
+	bool SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(const std::string& name, const float data[3]);
+	bool SetFloat3(SimpleShaderHandle handle, const float data[3]);
+	bool SetFloat3(const std::string& name, const DirectX::XMFLOAT3& data);
+	bool SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(const std::string& name, const float data[4]);
+	bool SetFloat4(SimpleShaderHandle handle, const float data[4]);
+	bool SetFloat4(const std::string& name, const DirectX::XMFLOAT4& data);
+	bool SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(const std::string& name, const float data[16]);
+	bool SetMatrix4x4(SimpleShaderHandle handle, const float data[16]);
+	bool SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4& data);
+	bool SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data);
 
 	// Setting shader resources
-	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
-	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
+	virtual bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState) = 0;
 
 	// Getting data about variables and resources
-	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	const SimpleShaderVariable* GetVariableInfo(const std::string& name);
 	
-	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
+	const SimpleSRV* GetShaderResourceViewInfo(const std::string& name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
-	size_t GetShaderResourceViewCount() { return textureTable.size(); }
+	size_t GetShaderResourceViewCount() { return shaderResourceViews.size(); }
 	
-	const SimpleSampler* GetSamplerInfo(std::string name);
+	const SimpleSampler* GetSamplerInfo(const std::string& name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
-	size_t GetSamplerCount() { return samplerTable.size(); }
+	size_t GetSamplerCount() { return samplerStates.size(); }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
 	unsigned int GetBufferSize(unsigned int index);
-	const SimpleConstantBuffer* GetBufferInfo(std::string name);
+	const SimpleConstantBuffer* GetBufferInfo(const std::string& name);
 	const SimpleConstantBuffer* GetBufferInfo(unsigned int index);
 	
 	// Misc getters
@@ -127,22 +219,46 @@ protected:
 	
 	// Maps for variables and buffers
 	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
-	std::vector<SimpleSRV*>		shaderResourceViews;
-	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
-	std::unordered_map<std::string, SimpleSRV*> textureTable;
-	std::unordered_map<std::string, SimpleSampler*> samplerTable;
+	std::vector<SimpleSRV>		shaderResourceViews;	// By handle
+	std::vector<SimpleSampler>	samplerStates;			// By handle
+	std::vector<SimpleShaderVariable> variables;	// By handle
+	ShaderNameTable cbTable;		// Name to buffer index
+	ShaderNameTable varTable;		// Name to handle
+	ShaderNameTable textureTable;	// Name to handle
+	ShaderNameTable samplerTable;	// Name to handle
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual void SetConstantBuffer(unsigned int index) = 0;
+	virtual unsigned int GetStage() = 0;
+
+	// The shader last set on each stage, which rebinds its
+	// buffers when uploads move them in the ring
+	static ISimpleShader* boundShaders[SIMPLE_SHADER_STAGE_COUNT];
+	bool IsBound() { return boundShaders[GetStage()] == this; }
 
 	virtual void CleanUp();
 
+	// Builds everything from what LoadShaderFile found (or cached)
+	void CreateResources(const ShaderReflectionData& reflection);
+
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
-	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	SimpleShaderVariable* FindVariable(ShaderNameHash name, int size);
+	SimpleConstantBuffer* FindConstantBuffer(ShaderNameHash name);
+
+	// Where a buffer's data really lives (its shared buffer's, if any)
+	static SimpleConstantBuffer* GetDataBuffer(SimpleConstantBuffer* cb);
+	static bool WriteBufferData(SimpleConstantBuffer* cb, unsigned int byteOffset, const void* data, unsigned int size);
+	// Returns true if the buffer's binding changed (it moved in the ring)
+	static bool UploadBuffer(ID3D11DeviceContext* context, SimpleConstantBuffer* cb);
+	static bool IsRingRangeStale(SimpleConstantBuffer* cb);
+	static void RestoreBoundShaders();
+	static bool restoringRing;
+	static SimpleShaderUploadStats uploadStats;
+	static ConstantBufferRing* constantRing;
+
+	friend class SimpleSharedConstantBuffer;
 };
 
 // --------------------------------------------------------
@@ -153,20 +269,26 @@ class SimpleVertexShader : public ISimpleShader
 public:
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context);
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11InputLayout* inputLayout, bool perInstanceCompatible);
+	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, const D3D11_INPUT_ELEMENT_DESC* inputElements, unsigned int inputElementCount);
 	~SimpleVertexShader();
 	ID3D11VertexShader* GetDirectXShader() { return shader; }
 	ID3D11InputLayout* GetInputLayout() { return inputLayout; }
 	bool GetPerInstanceCompatible() { return perInstanceCompatible; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	bool perInstanceCompatible;
 	ID3D11InputLayout* inputLayout;
+	std::vector<D3D11_INPUT_ELEMENT_DESC> inputElements;
 	ID3D11VertexShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBuffer(unsigned int index);
+	unsigned int GetStage() { return SIMPLE_SHADER_STAGE_VERTEX; }
 	void CleanUp();
 };
 
@@ -181,13 +303,17 @@ public:
 	~SimplePixelShader();
 	ID3D11PixelShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11PixelShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBuffer(unsigned int index);
+	unsigned int GetStage() { return SIMPLE_SHADER_STAGE_PIXEL; }
 	void CleanUp();
 };
 
@@ -201,13 +327,17 @@ public:
 	~SimpleDomainShader();
 	ID3D11DomainShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11DomainShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBuffer(unsigned int index);
+	unsigned int GetStage() { return SIMPLE_SHADER_STAGE_DOMAIN; }
 	void CleanUp();
 };
 
@@ -221,13 +351,17 @@ public:
 	~SimpleHullShader();
 	ID3D11HullShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11HullShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBuffer(unsigned int index);
+	unsigned int GetStage() { return SIMPLE_SHADER_STAGE_HULL; }
 	void CleanUp();
 };
 
@@ -241,8 +375,10 @@ public:
 	~SimpleGeometryShader();
 	ID3D11GeometryShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
 
@@ -260,6 +396,8 @@ protected:
 	bool CreateShader(ID3DBlob* shaderBlob);
 	bool CreateShaderWithStreamOut(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBuffer(unsigned int index);
+	unsigned int GetStage() { return SIMPLE_SHADER_STAGE_GEOMETRY; }
 	void CleanUp();
 
 	// Helpers
@@ -280,15 +418,17 @@ public:
 	void DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
 	void DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ);
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
 
 protected:
 	ID3D11ComputeShader* shader;
-	std::unordered_map<std::string, unsigned int> uavTable;
+	ShaderNameTable uavTable;	// Name to bind index
 
 	unsigned int threadsX;
 	unsigned int threadsY;
@@ -297,5 +437,64 @@ protected:
 
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBuffer(unsigned int index);
+	unsigned int GetStage() { return SIMPLE_SHADER_STAGE_COMPUTE; }
 	void CleanUp();
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// A constant buffer shared by every shader with a cbuffer of
+// the same name.  Those shaders find it when they're loaded
+// and bind it in place of a buffer of their own, so data
+// that's the same for all of them (the camera, the lights)
+// is set and uploaded once a frame rather than per shader
+// per draw.  Setting it through any of the shaders works too
+//
+// Make it before loading the shaders and delete it after
+// them.  Its layout comes from the first shader found to
+// use it - a shader whose cbuffer of that name is laid out
+// differently (in size, or in any variable's name, offset or
+// size) keeps a buffer of its own
+// --------------------------------------------------------
+class SimpleSharedConstantBuffer
+{
+public:
+	SimpleSharedConstantBuffer(ID3D11Device* device, ID3D11DeviceContext* context, const std::string& name);
+	~SimpleSharedConstantBuffer();
+
+	// The one shared as name, or null
+	static SimpleSharedConstantBuffer* Find(const std::string& name);
+
+	const std::string& GetName() { return name; }
+	// False until a shader using it is loaded
+	bool HasLayout() { return buffer.ConstantBuffer != 0; }
+	ID3D11Buffer* GetBuffer() { return buffer.ConstantBuffer; }
+
+	SimpleShaderHandle GetVariableHandle(const std::string& name);
+	SimpleShaderHandle GetVariableHandle(ShaderNameHash name);
+	bool SetData(const std::string& name, const void* data, unsigned int size);
+	bool SetData(SimpleShaderHandle handle, const void* data, unsigned int size);
+	bool SetFloat(const std::string& name, float data);
+	bool SetFloat3(const std::string& name, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(const std::string& name, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4& data);
+
+	// Uploads it, if it changed since the last upload
+	void CopyBufferData();
+
+private:
+	std::string name;
+	ID3D11Device* device;
+	ID3D11DeviceContext* deviceContext;
+
+	SimpleConstantBuffer buffer;
+	std::vector<SimpleShaderVariable> variables;	// By handle
+	ShaderNameTable varTable;	// Name to handle
+
+	static std::unordered_map<std::string, SimpleSharedConstantBuffer*> sharedBuffers;
+
+	friend class ISimpleShader;
+	// Takes the layout of a shader's cbuffer, if there isn't one yet
+	void CreateBuffer(const ReflectedConstantBuffer& reflected);
+	bool MatchesLayout(const ReflectedConstantBuffer& reflected);
+};
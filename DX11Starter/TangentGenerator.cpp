@@ -0,0 +1,164 @@
+#include "TangentGenerator.h"
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+using namespace DirectX;
+
+// Meshes with fewer triangles than this per thread are done serially,
+// since starting a thread costs more than the work it would do
+#define TANGENT_MIN_TRIANGLES_PER_THREAD 16384
+
+// UV triangles with less (doubled) area than this are treated as
+// degenerate, and add nothing to their vertices' tangents
+#define TANGENT_MIN_UV_AREA 1e-20f
+
+// --------------------------------------------------------
+// Generates tangents for an indexed triangle list
+// Math adapted from: http://www.terathon.com/code/tangent.html
+//
+// verts       - The vertices (positions, uvs and normals already set)
+// indices     - The index list (a multiple of 3)
+// threadCount - Threads to accumulate with (0 = all hardware threads)
+// --------------------------------------------------------
+void TangentGenerator::Generate(Vertex* verts, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount,
+	unsigned int threadCount)
+{
+	if (vertexCount == 0)
+		return;
+
+	unsigned int triCount = indexCount / 3;
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	threadCount = std::max(1u, std::min(threadCount, triCount / TANGENT_MIN_TRIANGLES_PER_THREAD));
+
+	// Each thread scatters into its own copy of the sums, so
+	// no two threads ever write the same vertex
+	std::vector<std::vector<TangentSum> > partials(threadCount);
+	TangentSum zero = {};
+	for (unsigned int t = 0; t < threadCount; t++)
+		partials[t].assign(vertexCount, zero);
+
+	// Pass 1: triangles (thread 0 runs on this thread)
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		workers.push_back(std::thread(AccumulateTriangles, verts, indices,
+			(unsigned int)((unsigned long long)triCount * t / threadCount),
+			(unsigned int)((unsigned long long)triCount * (t + 1) / threadCount),
+			&partials[t][0]));
+	}
+	AccumulateTriangles(verts, indices, 0, triCount / threadCount, &partials[0][0]);
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+	workers.clear();
+
+	// Pass 2: vertices, each of which only reads its own sums
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		workers.push_back(std::thread(FinishVertices, verts,
+			(unsigned int)((unsigned long long)vertexCount * t / threadCount),
+			(unsigned int)((unsigned long long)vertexCount * (t + 1) / threadCount),
+			&partials[0], threadCount));
+	}
+	FinishVertices(verts, 0, vertexCount / threadCount, &partials[0], threadCount);
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+}
+
+// --------------------------------------------------------
+// Adds the tangent and bitangent of a range of triangles
+// to each of their vertices' sums
+//
+// Each triangle's edges are worked on as whole vectors, and
+// the sums are aligned so the scatter is a load/add/store
+// per vertex rather than six scalar adds
+// --------------------------------------------------------
+void TangentGenerator::AccumulateTriangles(const Vertex* verts,
+	const unsigned int* indices, unsigned int firstTriangle, unsigned int lastTriangle,
+	TangentSum* sums)
+{
+	for (unsigned int t = firstTriangle; t < lastTriangle; t++)
+	{
+		// Grab indices and vertices of the triangle
+		const unsigned int* tri = &indices[t * 3];
+		const Vertex* v1 = &verts[tri[0]];
+		const Vertex* v2 = &verts[tri[1]];
+		const Vertex* v3 = &verts[tri[2]];
+
+		// Calculate vectors relative to triangle positions
+		XMVECTOR p1 = XMLoadFloat3(&v1->Position);
+		XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&v2->Position), p1);
+		XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&v3->Position), p1);
+
+		// Do the same for vectors relative to triangle uv's
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		// Triangles with no UV area have no direction to give,
+		// and would otherwise divide by zero
+		float det = s1 * t2 - s2 * t1;
+		if (fabsf(det) <= TANGENT_MIN_UV_AREA)
+			continue;
+		XMVECTOR r = XMVectorReplicate(1.0f / det);
+
+		// Tangent = (t2 * e1 - t1 * e2) * r, bitangent = (s1 * e2 - s2 * e1) * r
+		XMVECTOR tangent = XMVectorMultiply(XMVectorSubtract(
+			XMVectorScale(e1, t2), XMVectorScale(e2, t1)), r);
+		XMVECTOR bitangent = XMVectorMultiply(XMVectorSubtract(
+			XMVectorScale(e2, s1), XMVectorScale(e1, s2)), r);
+
+		// Adjust tangents of each vert of the triangle
+		for (int c = 0; c < 3; c++)
+		{
+			TangentSum& sum = sums[tri[c]];
+			XMStoreFloat4A(&sum.Tangent, XMVectorAdd(XMLoadFloat4A(&sum.Tangent), tangent));
+			XMStoreFloat4A(&sum.Bitangent, XMVectorAdd(XMLoadFloat4A(&sum.Bitangent), bitangent));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Combines the partial sums of a range of vertices and turns
+// them into unit tangents with handedness
+// --------------------------------------------------------
+void TangentGenerator::FinishVertices(Vertex* verts, unsigned int firstVertex, unsigned int lastVertex,
+	const std::vector<TangentSum>* partials, unsigned int partialCount)
+{
+	const XMVECTOR epsilon = XMVectorReplicate(1e-12f);
+
+	for (unsigned int i = firstVertex; i < lastVertex; i++)
+	{
+		XMVECTOR tangent = XMLoadFloat4A(&partials[0][i].Tangent);
+		XMVECTOR bitangent = XMLoadFloat4A(&partials[0][i].Bitangent);
+		for (unsigned int p = 1; p < partialCount; p++)
+		{
+			tangent = XMVectorAdd(tangent, XMLoadFloat4A(&partials[p][i].Tangent));
+			bitangent = XMVectorAdd(bitangent, XMLoadFloat4A(&partials[p][i].Bitangent));
+		}
+
+		// Use Gram-Schmidt orthogonalize
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		tangent = XMVectorSubtract(tangent, XMVectorMultiply(normal, XMVector3Dot(normal, tangent)));
+
+		// Nothing usable (no valid UV triangles, or the tangent was
+		// parallel to the normal)?  Any vector perpendicular to the
+		// normal is better than a NaN
+		if (XMVector3Less(XMVector3LengthSq(tangent), epsilon))
+		{
+			XMVECTOR axis = fabsf(verts[i].Normal.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+			tangent = XMVector3Cross(normal, axis);
+			if (XMVector3Less(XMVector3LengthSq(tangent), epsilon))
+				tangent = XMVectorSet(1, 0, 0, 0);
+		}
+		tangent = XMVector3Normalize(tangent);
+
+		// Mirrored UVs flip the bitangent the shader rebuilds
+		float handedness = XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, tangent), bitangent)) < 0.0f ? -1.0f : 1.0f;
+
+		XMStoreFloat4(&verts[i].Tangent, XMVectorSetW(tangent, handedness));
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Generates per-vertex tangents for normal mapping
+//
+// Each triangle's tangent and bitangent are built with
+// DirectXMath vectors and scatter-added into the vertices
+// it touches.  Large meshes split their triangles across
+// threads, each adding into its own partial sums, which are
+// combined in thread order afterwards
+//
+// Each vertex's tangent is orthogonalized against its normal,
+// and its w holds the handedness of the UV mapping (+1 or -1),
+// so the bitangent is cross(T, N) * w
+// --------------------------------------------------------
+class TangentGenerator
+{
+public:
+	// Fills in Vertex::Tangent - threadCount of 0 uses every hardware thread
+	static void Generate(Vertex* verts, unsigned int vertexCount,
+		const unsigned int* indices, unsigned int indexCount,
+		unsigned int threadCount = 1);
+
+private:
+	// Sum of the tangents and bitangents of a vertex's triangles
+	// (w is unused - it keeps the sums aligned for SIMD loads)
+	struct TangentSum
+	{
+		DirectX::XMFLOAT4A Tangent;
+		DirectX::XMFLOAT4A Bitangent;
+	};
+
+	static void AccumulateTriangles(const Vertex* verts,
+		const unsigned int* indices, unsigned int firstTriangle, unsigned int lastTriangle,
+		TangentSum* sums);
+
+	static void FinishVertices(Vertex* verts, unsigned int firstVertex, unsigned int lastVertex,
+		const std::vector<TangentSum>* partials, unsigned int partialCount);
+};
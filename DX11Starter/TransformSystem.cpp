@@ -0,0 +1,526 @@
+#include "TransformSystem.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace DirectX;
+
+// Transforms per job when updating in parallel (and the fewest
+// worth splitting up at all)
+#define TRANSFORM_JOB_TRANSFORMS 4096
+
+// --------------------------------------------------------
+// Reorders the first count elements of v so element i is
+// the old element order[i]
+// --------------------------------------------------------
+template <typename T>
+static void Permute(std::vector<T>& v, const std::vector<unsigned int>& order, unsigned int count, std::vector<T>& scratch)
+{
+	scratch.assign(v.begin(), v.begin() + count);
+	for (unsigned int i = 0; i < count; i++)
+		v[i] = scratch[order[i]];
+}
+
+TransformSystem::TransformSystem()
+{
+	count = 0;
+	hierarchyChanged = false;
+	anyChanged = false;
+}
+
+TransformSystem::~TransformSystem()
+{
+}
+
+// --------------------------------------------------------
+// Adds a root transform at the end of the arrays (which
+// keeps them in depth first order), growing them by a
+// whole batch whenever the last one is full
+// --------------------------------------------------------
+TransformHandle TransformSystem::Create()
+{
+	if (count == positionX.size())
+	{
+		size_t size = count + TRANSFORM_BATCH_SIZE;
+		positionX.resize(size); positionY.resize(size); positionZ.resize(size);
+		rotationX.resize(size); rotationY.resize(size); rotationZ.resize(size); rotationW.resize(size);
+		scaleX.resize(size); scaleY.resize(size); scaleZ.resize(size);
+		localMatrices.resize(size);
+		localInverses.resize(size);
+		worldMatrices.resize(size);
+		inverseTransposes.resize(size);
+		dirtyBatches.push_back(1);
+		parentSlots.resize(size);
+		parentIndices.resize(size);
+		subtreeSizes.resize(size);
+		localChanged.resize(size);
+		indexToSlot.resize(size);
+		for (unsigned int i = count; i < size; i++)
+			SetIdentity(i);
+	}
+
+	TransformHandle handle;
+	if (freeSlots.empty())
+	{
+		handle.Slot = (unsigned int)slotToIndex.size();
+		slotToIndex.push_back(0);
+		generations.push_back(0);
+	}
+	else
+	{
+		handle.Slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	handle.Generation = generations[handle.Slot];
+
+	unsigned int index = count++;
+	slotToIndex[handle.Slot] = index;
+	indexToSlot[index] = handle.Slot;
+	SetIdentity(index);
+	parentSlots[index] = TRANSFORM_NO_PARENT;
+	parentIndices[index] = TRANSFORM_NO_PARENT;
+	subtreeSizes[index] = 1;
+	MarkChanged(index);
+	return handle;
+}
+
+// --------------------------------------------------------
+// Removes a transform by moving the last one into its place
+// --------------------------------------------------------
+void TransformSystem::Destroy(TransformHandle handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	// The children skip a level
+	unsigned int index = slotToIndex[handle.Slot];
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (parentSlots[i] == handle.Slot)
+			parentSlots[i] = parentSlots[index];
+	}
+
+	unsigned int last = --count;
+	if (index != last)
+	{
+		positionX[index] = positionX[last]; positionY[index] = positionY[last]; positionZ[index] = positionZ[last];
+		rotationX[index] = rotationX[last]; rotationY[index] = rotationY[last];
+		rotationZ[index] = rotationZ[last]; rotationW[index] = rotationW[last];
+		scaleX[index] = scaleX[last]; scaleY[index] = scaleY[last]; scaleZ[index] = scaleZ[last];
+		parentSlots[index] = parentSlots[last];
+		dirtyBatches[index / TRANSFORM_BATCH_SIZE] = 1;
+
+		indexToSlot[index] = indexToSlot[last];
+		slotToIndex[indexToSlot[index]] = index;
+	}
+	SetIdentity(last);
+
+	// Old handles to this slot are no longer valid
+	generations[handle.Slot]++;
+	freeSlots.push_back(handle.Slot);
+
+	// Moving the last transform breaks the order
+	hierarchyChanged = true;
+	anyChanged = true;
+}
+
+bool TransformSystem::IsValid(TransformHandle handle)
+{
+	return handle.Slot < generations.size() &&
+		generations[handle.Slot] == handle.Generation &&
+		slotToIndex[handle.Slot] < count &&
+		indexToSlot[slotToIndex[handle.Slot]] == handle.Slot;
+}
+
+unsigned int TransformSystem::GetCount()
+{
+	return count;
+}
+
+bool TransformSystem::SetParent(TransformHandle child, TransformHandle parent)
+{
+	// Refuse if the child is the parent or one of its ancestors
+	for (unsigned int slot = parent.Slot; slot != TRANSFORM_NO_PARENT; slot = parentSlots[slotToIndex[slot]])
+	{
+		if (slot == child.Slot)
+			return false;
+	}
+
+	parentSlots[GetIndex(child)] = parent.Slot;
+	hierarchyChanged = true;
+	anyChanged = true;
+	return true;
+}
+
+void TransformSystem::ClearParent(TransformHandle child)
+{
+	parentSlots[GetIndex(child)] = TRANSFORM_NO_PARENT;
+	hierarchyChanged = true;
+	anyChanged = true;
+}
+
+// The handle must be valid
+unsigned int TransformSystem::GetIndex(TransformHandle handle)
+{
+	return slotToIndex[handle.Slot];
+}
+
+void TransformSystem::SetIdentity(unsigned int index)
+{
+	positionX[index] = 0.0f; positionY[index] = 0.0f; positionZ[index] = 0.0f;
+	rotationX[index] = 0.0f; rotationY[index] = 0.0f; rotationZ[index] = 0.0f; rotationW[index] = 1.0f;
+	scaleX[index] = 1.0f; scaleY[index] = 1.0f; scaleZ[index] = 1.0f;
+	dirtyBatches[index / TRANSFORM_BATCH_SIZE] = 1;
+}
+
+// Records that a transform's local matrix needs rebuilding
+void TransformSystem::MarkChanged(unsigned int index)
+{
+	dirtyBatches[index / TRANSFORM_BATCH_SIZE] = 1;
+	localChanged[index] = 1;
+	anyChanged = true;
+}
+
+void TransformSystem::SetPosition(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int index = GetIndex(handle);
+	positionX[index] = x; positionY[index] = y; positionZ[index] = z;
+	MarkChanged(index);
+}
+
+void TransformSystem::SetScale(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int index = GetIndex(handle);
+	scaleX[index] = x; scaleY[index] = y; scaleZ[index] = z;
+	MarkChanged(index);
+}
+
+// Same angles (and order) as XMMatrixRotationRollPitchYaw
+void TransformSystem::SetRotation(TransformHandle handle, float pitch, float yaw, float roll)
+{
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	SetRotationQuaternion(handle, rotation);
+}
+
+void TransformSystem::SetRotationQuaternion(TransformHandle handle, const XMFLOAT4& rotation)
+{
+	// Composing assumes unit length
+	XMFLOAT4 unit;
+	XMStoreFloat4(&unit, XMQuaternionNormalize(XMLoadFloat4(&rotation)));
+
+	unsigned int index = GetIndex(handle);
+	rotationX[index] = unit.x; rotationY[index] = unit.y; rotationZ[index] = unit.z; rotationW[index] = unit.w;
+	MarkChanged(index);
+}
+
+XMFLOAT3 TransformSystem::GetPosition(TransformHandle handle)
+{
+	unsigned int index = GetIndex(handle);
+	return XMFLOAT3(positionX[index], positionY[index], positionZ[index]);
+}
+
+XMFLOAT3 TransformSystem::GetScale(TransformHandle handle)
+{
+	unsigned int index = GetIndex(handle);
+	return XMFLOAT3(scaleX[index], scaleY[index], scaleZ[index]);
+}
+
+XMFLOAT4 TransformSystem::GetRotationQuaternion(TransformHandle handle)
+{
+	unsigned int index = GetIndex(handle);
+	return XMFLOAT4(rotationX[index], rotationY[index], rotationZ[index], rotationW[index]);
+}
+
+// --------------------------------------------------------
+// The matrix getters never update anything themselves - they
+// run on job threads, where a lazy update would race.  Call
+// UpdateWorldMatrices() (on one thread) after any changes
+// --------------------------------------------------------
+XMFLOAT4X4* TransformSystem::GetWorldMatrix(TransformHandle handle)
+{
+	assert(!anyChanged && "UpdateWorldMatrices() before reading matrices");
+	return &worldMatrices[GetIndex(handle)];
+}
+
+XMFLOAT4X4* TransformSystem::GetWorldInverseTranspose(TransformHandle handle)
+{
+	assert(!anyChanged && "UpdateWorldMatrices() before reading matrices");
+	return &inverseTransposes[GetIndex(handle)];
+}
+
+// --------------------------------------------------------
+// Rebuilds the local matrices of changed batches, then the
+// world matrices of every changed subtree
+//
+// With jobs, batches are composed in parallel, then the
+// arrays are split into ranges that each propagate the
+// subtrees of the roots inside them - subtrees never share
+// matrices, so the ranges run in parallel too
+// --------------------------------------------------------
+void TransformSystem::UpdateWorldMatrices(JobSystem* jobs)
+{
+	if (!anyChanged)
+		return;
+
+	if (hierarchyChanged)
+		SortHierarchy();
+
+	unsigned int batchCount = (count + TRANSFORM_BATCH_SIZE - 1) / TRANSFORM_BATCH_SIZE;
+	if (!jobs || jobs->GetThreadCount() < 2 || count <= TRANSFORM_JOB_TRANSFORMS)
+	{
+		ComposeBatches(0, batchCount);
+		PropagateRange(0, count);
+		anyChanged = false;
+		return;
+	}
+
+	JobCounter composed;
+	jobs->ParallelFor(ComposeJob, this, batchCount, TRANSFORM_JOB_TRANSFORMS / TRANSFORM_BATCH_SIZE, &composed);
+	jobs->Wait(&composed);
+
+	JobCounter propagated;
+	jobs->ParallelFor(PropagateJob, this, count, TRANSFORM_JOB_TRANSFORMS, &propagated);
+	jobs->Wait(&propagated);
+
+	anyChanged = false;
+}
+
+void TransformSystem::ComposeBatches(unsigned int first, unsigned int last)
+{
+	for (unsigned int b = first; b < last; b++)
+	{
+		if (dirtyBatches[b])
+			ComposeBatch(b);
+	}
+}
+
+// --------------------------------------------------------
+// Propagates the changed subtrees under the roots in
+// [first, last), following the last one past the end.
+// Transforms before the range's first root belong to the
+// range before it
+//
+// One pass in array order.  Redoing a changed transform's
+// subtree covers any changes inside it, so the pass skips
+// past it
+// --------------------------------------------------------
+void TransformSystem::PropagateRange(unsigned int first, unsigned int last)
+{
+	unsigned int i = first;
+	while (i < count && parentIndices[i] != TRANSFORM_NO_PARENT)
+		i++;
+
+	while (i < count && (i < last || parentIndices[i] != TRANSFORM_NO_PARENT))
+	{
+		if (!localChanged[i])
+		{
+			i++;
+			continue;
+		}
+
+		PropagateSubtree(i);
+		i += subtreeSizes[i];
+	}
+}
+
+void TransformSystem::ComposeJob(void* data, unsigned int first, unsigned int last)
+{
+	((TransformSystem*)data)->ComposeBatches(first, last);
+}
+
+void TransformSystem::PropagateJob(void* data, unsigned int first, unsigned int last)
+{
+	((TransformSystem*)data)->PropagateRange(first, last);
+}
+
+// --------------------------------------------------------
+// Rebuilds the world matrices of a transform and everything
+// under it - a contiguous run, with parents first
+// --------------------------------------------------------
+void TransformSystem::PropagateSubtree(unsigned int root)
+{
+	unsigned int end = root + subtreeSizes[root];
+	for (unsigned int i = root; i < end; i++)
+	{
+		localChanged[i] = 0;
+		unsigned int parent = parentIndices[i];
+		if (parent == TRANSFORM_NO_PARENT)
+		{
+			worldMatrices[i] = localMatrices[i];
+			inverseTransposes[i] = localInverses[i];
+			continue;
+		}
+
+		// World matrices are stored transposed, so (local * parent)
+		// transposed is parent * local.  Inverses aren't, and the
+		// inverse of (local * parent) is inverse(parent) * inverse(local)
+		XMStoreFloat4x4(&worldMatrices[i], XMMatrixMultiply(
+			XMLoadFloat4x4(&worldMatrices[parent]), XMLoadFloat4x4(&localMatrices[i])));
+		XMStoreFloat4x4(&inverseTransposes[i], XMMatrixMultiply(
+			XMLoadFloat4x4(&inverseTransposes[parent]), XMLoadFloat4x4(&localInverses[i])));
+	}
+}
+
+// --------------------------------------------------------
+// Puts the arrays back in depth first order (keeping roots,
+// and the children of each transform, in their old order),
+// then marks everything changed
+// --------------------------------------------------------
+void TransformSystem::SortHierarchy()
+{
+	// Child lists, by old array index
+	std::vector<unsigned int> firstChild(count, TRANSFORM_NO_PARENT);
+	std::vector<unsigned int> nextSibling(count, TRANSFORM_NO_PARENT);
+	std::vector<unsigned int> oldParents(count);
+	for (unsigned int i = count; i-- > 0;)
+	{
+		oldParents[i] = parentSlots[i] == TRANSFORM_NO_PARENT ? TRANSFORM_NO_PARENT : slotToIndex[parentSlots[i]];
+		if (oldParents[i] != TRANSFORM_NO_PARENT)
+		{
+			nextSibling[i] = firstChild[oldParents[i]];
+			firstChild[oldParents[i]] = i;
+		}
+	}
+
+	// Walk each root's tree in pre-order
+	std::vector<unsigned int> order;
+	order.reserve(count);
+	for (unsigned int root = 0; root < count; root++)
+	{
+		if (oldParents[root] != TRANSFORM_NO_PARENT)
+			continue;
+
+		unsigned int node = root;
+		while (true)
+		{
+			order.push_back(node);
+			if (firstChild[node] != TRANSFORM_NO_PARENT)
+			{
+				node = firstChild[node];
+				continue;
+			}
+			while (node != root && nextSibling[node] == TRANSFORM_NO_PARENT)
+				node = oldParents[node];
+			if (node == root)
+				break;
+			node = nextSibling[node];
+		}
+	}
+
+	std::vector<float> floats;
+	Permute(positionX, order, count, floats); Permute(positionY, order, count, floats); Permute(positionZ, order, count, floats);
+	Permute(rotationX, order, count, floats); Permute(rotationY, order, count, floats);
+	Permute(rotationZ, order, count, floats); Permute(rotationW, order, count, floats);
+	Permute(scaleX, order, count, floats); Permute(scaleY, order, count, floats); Permute(scaleZ, order, count, floats);
+
+	std::vector<unsigned int> uints;
+	Permute(parentSlots, order, count, uints);
+	Permute(indexToSlot, order, count, uints);
+	for (unsigned int i = 0; i < count; i++)
+		slotToIndex[indexToSlot[i]] = i;
+
+	// Parents are now always before their children, so subtree
+	// sizes add up from the back
+	for (unsigned int i = 0; i < count; i++)
+	{
+		parentIndices[i] = parentSlots[i] == TRANSFORM_NO_PARENT ? TRANSFORM_NO_PARENT : slotToIndex[parentSlots[i]];
+		subtreeSizes[i] = 1;
+	}
+	for (unsigned int i = count; i-- > 0;)
+	{
+		if (parentIndices[i] != TRANSFORM_NO_PARENT)
+			subtreeSizes[parentIndices[i]] += subtreeSizes[i];
+	}
+
+	// Everything moved, so everything is redone
+	std::fill(localChanged.begin(), localChanged.begin() + count, 1);
+	std::fill(dirtyBatches.begin(), dirtyBatches.end(), 1);
+
+	hierarchyChanged = false;
+}
+
+// --------------------------------------------------------
+// Builds the local matrices (scale * rotation * translation)
+// and their inverses for one batch
+//
+// Each XMVECTOR holds one matrix element for all four
+// transforms.  A 4x4 transpose then turns four elements'
+// vectors into one row of each transform's matrix
+// --------------------------------------------------------
+void TransformSystem::ComposeBatch(unsigned int batch)
+{
+	unsigned int first = batch * TRANSFORM_BATCH_SIZE;
+
+	XMVECTOR x = XMLoadFloat4((const XMFLOAT4*)&rotationX[first]);
+	XMVECTOR y = XMLoadFloat4((const XMFLOAT4*)&rotationY[first]);
+	XMVECTOR z = XMLoadFloat4((const XMFLOAT4*)&rotationZ[first]);
+	XMVECTOR w = XMLoadFloat4((const XMFLOAT4*)&rotationW[first]);
+	XMVECTOR sx = XMLoadFloat4((const XMFLOAT4*)&scaleX[first]);
+	XMVECTOR sy = XMLoadFloat4((const XMFLOAT4*)&scaleY[first]);
+	XMVECTOR sz = XMLoadFloat4((const XMFLOAT4*)&scaleZ[first]);
+	XMVECTOR px = XMLoadFloat4((const XMFLOAT4*)&positionX[first]);
+	XMVECTOR py = XMLoadFloat4((const XMFLOAT4*)&positionY[first]);
+	XMVECTOR pz = XMLoadFloat4((const XMFLOAT4*)&positionZ[first]);
+
+	// Rotation matrix of each quaternion (the same one
+	// XMMatrixRotationQuaternion builds), element by element
+	XMVECTOR one = XMVectorReplicate(1.0f);
+	XMVECTOR x2 = XMVectorAdd(x, x);
+	XMVECTOR y2 = XMVectorAdd(y, y);
+	XMVECTOR z2 = XMVectorAdd(z, z);
+	XMVECTOR xx = XMVectorMultiply(x, x2), yy = XMVectorMultiply(y, y2), zz = XMVectorMultiply(z, z2);
+	XMVECTOR xy = XMVectorMultiply(x, y2), xz = XMVectorMultiply(x, z2), yz = XMVectorMultiply(y, z2);
+	XMVECTOR wx = XMVectorMultiply(w, x2), wy = XMVectorMultiply(w, y2), wz = XMVectorMultiply(w, z2);
+
+	XMVECTOR r00 = XMVectorSubtract(one, XMVectorAdd(yy, zz));
+	XMVECTOR r01 = XMVectorAdd(xy, wz);
+	XMVECTOR r02 = XMVectorSubtract(xz, wy);
+	XMVECTOR r10 = XMVectorSubtract(xy, wz);
+	XMVECTOR r11 = XMVectorSubtract(one, XMVectorAdd(xx, zz));
+	XMVECTOR r12 = XMVectorAdd(yz, wx);
+	XMVECTOR r20 = XMVectorAdd(xz, wy);
+	XMVECTOR r21 = XMVectorSubtract(yz, wx);
+	XMVECTOR r22 = XMVectorSubtract(one, XMVectorAdd(xx, yy));
+
+	// Local matrix - scaling first scales the rotation's rows.  Stored
+	// transposed, so each stored row is one of its columns
+	XMMATRIX row0 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r00, sx), XMVectorMultiply(r10, sy), XMVectorMultiply(r20, sz), px));
+	XMMATRIX row1 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r01, sx), XMVectorMultiply(r11, sy), XMVectorMultiply(r21, sz), py));
+	XMMATRIX row2 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r02, sx), XMVectorMultiply(r12, sy), XMVectorMultiply(r22, sz), pz));
+
+	// Inverse - the rotation's transpose, then the reciprocal scale,
+	// with the translation undone through both.  Not transposed
+	XMVECTOR rx = XMVectorReciprocal(sx);
+	XMVECTOR ry = XMVectorReciprocal(sy);
+	XMVECTOR rz = XMVectorReciprocal(sz);
+	XMVECTOR i00 = XMVectorMultiply(r00, rx), i01 = XMVectorMultiply(r10, ry), i02 = XMVectorMultiply(r20, rz);
+	XMVECTOR i10 = XMVectorMultiply(r01, rx), i11 = XMVectorMultiply(r11, ry), i12 = XMVectorMultiply(r21, rz);
+	XMVECTOR i20 = XMVectorMultiply(r02, rx), i21 = XMVectorMultiply(r12, ry), i22 = XMVectorMultiply(r22, rz);
+	XMVECTOR t0 = XMVectorNegate(XMVectorMultiplyAdd(px, i00, XMVectorMultiplyAdd(py, i10, XMVectorMultiply(pz, i20))));
+	XMVECTOR t1 = XMVectorNegate(XMVectorMultiplyAdd(px, i01, XMVectorMultiplyAdd(py, i11, XMVectorMultiply(pz, i21))));
+	XMVECTOR t2 = XMVectorNegate(XMVectorMultiplyAdd(px, i02, XMVectorMultiplyAdd(py, i12, XMVectorMultiply(pz, i22))));
+
+	XMVECTOR zero = XMVectorZero();
+	XMMATRIX inverse0 = XMMatrixTranspose(XMMATRIX(i00, i01, i02, zero));
+	XMMATRIX inverse1 = XMMatrixTranspose(XMMATRIX(i10, i11, i12, zero));
+	XMMATRIX inverse2 = XMMatrixTranspose(XMMATRIX(i20, i21, i22, zero));
+	XMMATRIX inverse3 = XMMatrixTranspose(XMMATRIX(t0, t1, t2, one));
+
+	XMVECTOR lastRow = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	for (unsigned int i = 0; i < TRANSFORM_BATCH_SIZE; i++)
+	{
+		XMFLOAT4X4& local = localMatrices[first + i];
+		XMStoreFloat4((XMFLOAT4*)local.m[0], row0.r[i]);
+		XMStoreFloat4((XMFLOAT4*)local.m[1], row1.r[i]);
+		XMStoreFloat4((XMFLOAT4*)local.m[2], row2.r[i]);
+		XMStoreFloat4((XMFLOAT4*)local.m[3], lastRow);
+
+		XMFLOAT4X4& inverse = localInverses[first + i];
+		XMStoreFloat4((XMFLOAT4*)inverse.m[0], inverse0.r[i]);
+		XMStoreFloat4((XMFLOAT4*)inverse.m[1], inverse1.r[i]);
+		XMStoreFloat4((XMFLOAT4*)inverse.m[2], inverse2.r[i]);
+		XMStoreFloat4((XMFLOAT4*)inverse.m[3], inverse3.r[i]);
+	}
+
+	dirtyBatches[batch] = 0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "JobSystem.h"
+
+// Transforms composed together in one SIMD batch (one per XMVECTOR lane)
+#define TRANSFORM_BATCH_SIZE 4
+
+// Parent of a transform with no parent
+#define TRANSFORM_NO_PARENT 0xFFFFFFFF
+
+// --------------------------------------------------------
+// Refers to one transform in a TransformSystem.  Handles
+// stay valid while other transforms come and go, and a
+// destroyed transform's handle is never valid again
+// --------------------------------------------------------
+struct TransformHandle
+{
+	unsigned int Slot;
+	unsigned int Generation;
+};
+
+// --------------------------------------------------------
+// Owns the position, rotation and scale of many objects,
+// the parent of each, and composes their world matrices
+//
+// Every component lives in its own tightly packed array
+// (structure of arrays), so a batch of TRANSFORM_BATCH_SIZE
+// transforms loads each component into one XMVECTOR and is
+// composed lane by lane, then transposed out into local
+// matrices.  Handles go through a slot table, so transforms
+// can move around in the arrays
+//
+// The arrays are kept in depth first order - parents come
+// before their children and every subtree is one contiguous
+// run - so world matrices are propagated in a single pass.
+// Only the subtrees under a transform that changed since the
+// last update are touched.  Changing the hierarchy (or
+// destroying a transform) re-sorts everything at the next
+// update instead
+//
+// Setters only record the change; UpdateWorldMatrices()
+// rebuilds what changed.  The matrix getters only read, so
+// jobs can call them at once - but only after an update, with
+// no changes since (which debug builds assert)
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+	TransformSystem();
+	~TransformSystem();
+
+	// New transforms start at the origin, unrotated, unscaled and unparented
+	TransformHandle Create();
+	// Children of a destroyed transform move up to its parent
+	void Destroy(TransformHandle handle);
+	bool IsValid(TransformHandle handle);
+	unsigned int GetCount();
+
+	// The child's position, rotation and scale become relative to the
+	// parent.  Fails (returning false) if it would make a cycle
+	bool SetParent(TransformHandle child, TransformHandle parent);
+	void ClearParent(TransformHandle child);
+
+	void SetPosition(TransformHandle handle, float x, float y, float z);
+	void SetScale(TransformHandle handle, float x, float y, float z);
+	void SetRotation(TransformHandle handle, float pitch, float yaw, float roll);
+	void SetRotationQuaternion(TransformHandle handle, const DirectX::XMFLOAT4& rotation);
+
+	DirectX::XMFLOAT3 GetPosition(TransformHandle handle);
+	DirectX::XMFLOAT3 GetScale(TransformHandle handle);
+	DirectX::XMFLOAT4 GetRotationQuaternion(TransformHandle handle);
+
+	// Both transposed for HLSL, as of the last UpdateWorldMatrices()
+	// (nothing may have changed since).  The pointers are only good
+	// until the next change to any transform
+	DirectX::XMFLOAT4X4* GetWorldMatrix(TransformHandle handle);
+	DirectX::XMFLOAT4X4* GetWorldInverseTranspose(TransformHandle handle);
+
+	// Rebuilds the matrices of every transform that changed, and
+	// of everything under them.  Spread over jobs if given any
+	void UpdateWorldMatrices(JobSystem* jobs = 0);
+
+private:
+	// Components, padded to a whole number of batches (the padding
+	// holds identity transforms, so it composes harmlessly)
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// Outputs, in the same order as the components.  Local matrices
+	// come from the components alone, world ones include the parents
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverses;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> inverseTransposes;
+	std::vector<unsigned char> dirtyBatches;
+
+	// Hierarchy
+	std::vector<unsigned int> parentSlots;		// TRANSFORM_NO_PARENT for roots
+	std::vector<unsigned int> parentIndices;	// Array index of the parent
+	std::vector<unsigned int> subtreeSizes;		// Including the transform itself
+	bool hierarchyChanged;						// The order needs rebuilding
+
+	// Transforms changed since the last update (by array index)
+	std::vector<unsigned char> localChanged;
+	bool anyChanged;
+
+	// Handle slot <-> array index
+	std::vector<unsigned int> slotToIndex;
+	std::vector<unsigned int> indexToSlot;
+	std::vector<unsigned int> generations;
+	std::vector<unsigned int> freeSlots;
+	unsigned int count;
+
+	unsigned int GetIndex(TransformHandle handle);
+	void SetIdentity(unsigned int index);
+	void MarkChanged(unsigned int index);
+	void ComposeBatch(unsigned int batch);
+	void ComposeBatches(unsigned int first, unsigned int last);
+	void PropagateSubtree(unsigned int root);
+	void PropagateRange(unsigned int first, unsigned int last);
+	void SortHierarchy();
+
+	// Job entry points (data is the TransformSystem)
+	static void ComposeJob(void* data, unsigned int first, unsigned int last);
+	static void PropagateJob(void* data, unsigned int first, unsigned int last);
+};
@@ -12,5 +12,40 @@ struct Vertex
 	DirectX::XMFLOAT3 Position;	    // The position of the vertex
 	DirectX::XMFLOAT2 UV;
 	DirectX::XMFLOAT3 Normal;        // normal
-	DirectX::XMFLOAT3 Tangent;//Normal Mapping
-};
\ No newline at end of file
+	DirectX::XMFLOAT4 Tangent;//Normal Mapping (w = handedness of the UVs)
+};
+
+// --------------------------------------------------------
+// Vertex layouts a mesh can be uploaded with
+// --------------------------------------------------------
+enum VertexFormat
+{
+	VERTEX_FORMAT_FULL,		// Vertex - 48 bytes of 32-bit floats
+	VERTEX_FORMAT_COMPACT	// CompactVertex - 20 bytes, see VertexCompressor
+};
+
+// --------------------------------------------------------
+// A quantized version of Vertex for large static meshes
+//
+// Positions and UVs are relative to the mesh's own ranges
+// (see VertexQuantization), and unit vectors are stored with
+// octahedral encoding
+// --------------------------------------------------------
+struct CompactVertex
+{
+	unsigned short Position[4];	// Half floats - xyz in [-1, 1] of the mesh bounds, w = tangent handedness
+	unsigned short UV[2];		// UNORM16 within the mesh's UV range
+	short Normal[2];			// SNORM16 octahedral
+	short Tangent[2];			// SNORM16 octahedral
+};
+
+// --------------------------------------------------------
+// Per-mesh ranges used to dequantize a CompactVertex
+// --------------------------------------------------------
+struct VertexQuantization
+{
+	DirectX::XMFLOAT3 PositionCenter;
+	DirectX::XMFLOAT3 PositionExtent;	// Half the size of the bounds
+	DirectX::XMFLOAT2 UVOffset;
+	DirectX::XMFLOAT2 UVScale;
+};
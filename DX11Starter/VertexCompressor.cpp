@@ -0,0 +1,246 @@
+#include "VertexCompressor.h"
+#include <DirectXPackedVector.h>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Input layouts for each VertexFormat, in the same order as
+// the members of Vertex and CompactVertex
+static const D3D11_INPUT_ELEMENT_DESC fullLayout[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+static const D3D11_INPUT_ELEMENT_DESC compactLayout[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT",  0, DXGI_FORMAT_R16G16_SNORM,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+// --------------------------------------------------------
+// Finds the ranges the mesh's positions and UVs will be
+// quantized within
+// --------------------------------------------------------
+void VertexCompressor::ComputeQuantization(const Vertex* verts, unsigned int vertexCount, VertexQuantization* quantization)
+{
+	XMFLOAT3 minPos(FLT_MAX, FLT_MAX, FLT_MAX), maxPos(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	XMFLOAT2 minUV(FLT_MAX, FLT_MAX), maxUV(-FLT_MAX, -FLT_MAX);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& v = verts[i];
+		minPos.x = fminf(minPos.x, v.Position.x); maxPos.x = fmaxf(maxPos.x, v.Position.x);
+		minPos.y = fminf(minPos.y, v.Position.y); maxPos.y = fmaxf(maxPos.y, v.Position.y);
+		minPos.z = fminf(minPos.z, v.Position.z); maxPos.z = fmaxf(maxPos.z, v.Position.z);
+		minUV.x = fminf(minUV.x, v.UV.x); maxUV.x = fmaxf(maxUV.x, v.UV.x);
+		minUV.y = fminf(minUV.y, v.UV.y); maxUV.y = fmaxf(maxUV.y, v.UV.y);
+	}
+
+	if (vertexCount == 0)
+	{
+		minPos = maxPos = XMFLOAT3(0, 0, 0);
+		minUV = maxUV = XMFLOAT2(0, 0);
+	}
+
+	// Flat axes still need a non-zero range to divide by
+	quantization->PositionCenter = XMFLOAT3(
+		(minPos.x + maxPos.x) * 0.5f,
+		(minPos.y + maxPos.y) * 0.5f,
+		(minPos.z + maxPos.z) * 0.5f);
+	quantization->PositionExtent = XMFLOAT3(
+		maxPos.x > minPos.x ? (maxPos.x - minPos.x) * 0.5f : 1.0f,
+		maxPos.y > minPos.y ? (maxPos.y - minPos.y) * 0.5f : 1.0f,
+		maxPos.z > minPos.z ? (maxPos.z - minPos.z) * 0.5f : 1.0f);
+	quantization->UVOffset = minUV;
+	quantization->UVScale = XMFLOAT2(
+		maxUV.x > minUV.x ? maxUV.x - minUV.x : 1.0f,
+		maxUV.y > minUV.y ? maxUV.y - minUV.y : 1.0f);
+}
+
+// --------------------------------------------------------
+// Compresses vertices into the CompactVertex layout
+// --------------------------------------------------------
+void VertexCompressor::Encode(const Vertex* verts, unsigned int vertexCount, const VertexQuantization& quantization, CompactVertex* compactVerts)
+{
+	const VertexQuantization& q = quantization;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& v = verts[i];
+		CompactVertex& c = compactVerts[i];
+
+		c.Position[0] = XMConvertFloatToHalf((v.Position.x - q.PositionCenter.x) / q.PositionExtent.x);
+		c.Position[1] = XMConvertFloatToHalf((v.Position.y - q.PositionCenter.y) / q.PositionExtent.y);
+		c.Position[2] = XMConvertFloatToHalf((v.Position.z - q.PositionCenter.z) / q.PositionExtent.z);
+		c.Position[3] = XMConvertFloatToHalf(v.Tangent.w < 0.0f ? -1.0f : 1.0f);
+
+		float u = (v.UV.x - q.UVOffset.x) / q.UVScale.x;
+		float t = (v.UV.y - q.UVOffset.y) / q.UVScale.y;
+		c.UV[0] = (unsigned short)(fminf(fmaxf(u, 0.0f), 1.0f) * 65535.0f + 0.5f);
+		c.UV[1] = (unsigned short)(fminf(fmaxf(t, 0.0f), 1.0f) * 65535.0f + 0.5f);
+
+		EncodeOctahedral(v.Normal, c.Normal);
+		EncodeOctahedral(XMFLOAT3(v.Tangent.x, v.Tangent.y, v.Tangent.z), c.Tangent);
+	}
+}
+
+// --------------------------------------------------------
+// Expands a CompactVertex back to full precision, the same
+// way CompactVS.hlsl does
+// --------------------------------------------------------
+void VertexCompressor::Decode(const CompactVertex& compactVert, const VertexQuantization& quantization, Vertex* vert)
+{
+	const VertexQuantization& q = quantization;
+	const CompactVertex& c = compactVert;
+
+	vert->Position = XMFLOAT3(
+		q.PositionCenter.x + XMConvertHalfToFloat(c.Position[0]) * q.PositionExtent.x,
+		q.PositionCenter.y + XMConvertHalfToFloat(c.Position[1]) * q.PositionExtent.y,
+		q.PositionCenter.z + XMConvertHalfToFloat(c.Position[2]) * q.PositionExtent.z);
+	vert->UV = XMFLOAT2(
+		q.UVOffset.x + c.UV[0] / 65535.0f * q.UVScale.x,
+		q.UVOffset.y + c.UV[1] / 65535.0f * q.UVScale.y);
+	vert->Normal = DecodeOctahedral(c.Normal);
+
+	XMFLOAT3 tangent = DecodeOctahedral(c.Tangent);
+	vert->Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, XMConvertHalfToFloat(c.Position[3]));
+}
+
+// --------------------------------------------------------
+// Round trips a mesh through the compact layout and finds
+// the largest error in each attribute
+// --------------------------------------------------------
+void VertexCompressor::MeasureError(const Vertex* verts, unsigned int vertexCount, CompactVertexError* error)
+{
+	VertexQuantization q;
+	ComputeQuantization(verts, vertexCount, &q);
+	std::vector<CompactVertex> compactVerts(vertexCount);
+	if (vertexCount > 0)
+		Encode(verts, vertexCount, q, &compactVerts[0]);
+
+	CompactVertexError e = {};
+	e.FullBytes = vertexCount * sizeof(Vertex);
+	e.CompactBytes = vertexCount * sizeof(CompactVertex);
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& v = verts[i];
+		Vertex d;
+		Decode(compactVerts[i], q, &d);
+
+		XMVECTOR position = XMLoadFloat3(&v.Position);
+		e.MaxPositionError = fmaxf(e.MaxPositionError,
+			XMVectorGetX(XMVector3Length(XMVectorSubtract(position, XMLoadFloat3(&d.Position)))));
+
+		e.MaxUVError = fmaxf(e.MaxUVError, fmaxf(fabsf(v.UV.x - d.UV.x), fabsf(v.UV.y - d.UV.y)));
+
+		// Compare directions only - the source vectors may not be unit length
+		XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&v.Normal));
+		e.MaxNormalError = fmaxf(e.MaxNormalError,
+			XMConvertToDegrees(XMVectorGetX(XMVector3AngleBetweenNormals(normal, XMLoadFloat3(&d.Normal)))));
+
+		XMVECTOR tangent = XMVector3Normalize(XMLoadFloat4(&v.Tangent));
+		e.MaxTangentError = fmaxf(e.MaxTangentError,
+			XMConvertToDegrees(XMVectorGetX(XMVector3AngleBetweenNormals(tangent, XMLoadFloat4(&d.Tangent)))));
+	}
+
+	*error = e;
+}
+
+// --------------------------------------------------------
+// Gets the input layout elements for a vertex format
+// --------------------------------------------------------
+const D3D11_INPUT_ELEMENT_DESC* VertexCompressor::GetInputLayout(VertexFormat format, unsigned int* elementCount)
+{
+	if (format == VERTEX_FORMAT_COMPACT)
+	{
+		*elementCount = sizeof(compactLayout) / sizeof(compactLayout[0]);
+		return compactLayout;
+	}
+
+	*elementCount = sizeof(fullLayout) / sizeof(fullLayout[0]);
+	return fullLayout;
+}
+
+// --------------------------------------------------------
+// Gets the size of one vertex in a vertex format
+// --------------------------------------------------------
+unsigned int VertexCompressor::GetStride(VertexFormat format)
+{
+	return format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+// --------------------------------------------------------
+// Octahedral encoding of a direction into two SNORM16s
+//
+// The direction is projected onto an octahedron, whose lower
+// half is folded out over the corners of the upper half.
+// Rounding each coordinate to the nearest step isn't always
+// the closest direction, so all four neighbors are tried
+// --------------------------------------------------------
+void VertexCompressor::EncodeOctahedral(const XMFLOAT3& v, short* encoded)
+{
+	float length = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if (length == 0.0f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 32767;
+		return;
+	}
+
+	float x = v.x / length;
+	float y = v.y / length;
+	if (v.z < 0.0f)
+	{
+		float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&v));
+	float bestDot = -2.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		short candidate[2] =
+		{
+			(short)((i & 1 ? ceilf(x * 32767.0f) : floorf(x * 32767.0f))),
+			(short)((i & 2 ? ceilf(y * 32767.0f) : floorf(y * 32767.0f))),
+		};
+		XMFLOAT3 decoded = DecodeOctahedral(candidate);
+		float dot = XMVectorGetX(XMVector3Dot(direction, XMLoadFloat3(&decoded)));
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Undoes EncodeOctahedral, returning a unit vector
+// --------------------------------------------------------
+XMFLOAT3 VertexCompressor::DecodeOctahedral(const short* encoded)
+{
+	float x = fmaxf(encoded[0] / 32767.0f, -1.0f);
+	float y = fmaxf(encoded[1] / 32767.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Worst-case error of a compressed mesh, compared to the
+// full precision vertices it was made from
+// --------------------------------------------------------
+struct CompactVertexError
+{
+	float MaxPositionError;		// Object space units
+	float MaxUVError;
+	float MaxNormalError;		// Degrees
+	float MaxTangentError;		// Degrees
+	unsigned int FullBytes;		// Size as Vertex
+	unsigned int CompactBytes;	// Size as CompactVertex
+};
+
+// --------------------------------------------------------
+// Converts Vertex data to the CompactVertex layout
+//
+//  - Positions become half floats, relative to the center
+//    and extent of the mesh's bounds
+//  - UVs become UNORM16, relative to the mesh's UV range
+//  - Normals and tangents are octahedral encoded into two
+//    SNORM16s each, and the tangent's handedness moves to
+//    the position's w
+//
+// The vertex shader undoes this with the ranges from the
+// mesh's VertexQuantization (see CompactVS.hlsl)
+// --------------------------------------------------------
+class VertexCompressor
+{
+public:
+	static void ComputeQuantization(const Vertex* verts, unsigned int vertexCount, VertexQuantization* quantization);
+	static void Encode(const Vertex* verts, unsigned int vertexCount, const VertexQuantization& quantization, CompactVertex* compactVerts);
+	static void Decode(const CompactVertex& compactVert, const VertexQuantization& quantization, Vertex* vert);
+
+	// Compresses a mesh and reports how much was lost
+	static void MeasureError(const Vertex* verts, unsigned int vertexCount, CompactVertexError* error);
+
+	// Input layout matching each format, and its size in bytes
+	static const D3D11_INPUT_ELEMENT_DESC* GetInputLayout(VertexFormat format, unsigned int* elementCount);
+	static unsigned int GetStride(VertexFormat format);
+
+private:
+	static void EncodeOctahedral(const DirectX::XMFLOAT3& v, short* encoded);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const short* encoded);
+};
@@ -4,13 +4,21 @@
 //    which will (eventually) hold data from our C++ code
 // - All non-pipeline variables that get their values from 
 //    our C++ code must be defined inside a Constant Buffer
-// - The name of the cbuffer itself is unimportant
+// - The name of the cbuffer itself is unimportant, except for
+//    shared ones (see SimpleSharedConstantBuffer)
 cbuffer externalData : register(b0)
 {
 	matrix world;
+	matrix transWorld;
+};
+
+// Shared with every shader - set once a frame.  Every shader
+// declaring it must lay it out the same, or gets its own
+cbuffer perFrame : register(b1)
+{
 	matrix view;
 	matrix projection;
-	matrix transWorld;
+	float time;		// Seconds since the game started
 };
 
 // Struct representing a single vertex worth of data
@@ -28,7 +36,7 @@ struct VertexShaderInput
 	float3 position		: POSITION;     // XYZ position
 	float2 uv           : TEXCOORD;    //UV
 	float3 normal       : NORMAL;      //Normal
-	float3 tangent      : TANGENT;
+	float4 tangent      : TANGENT;     //Tangent, w = handedness
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -47,7 +55,7 @@ struct VertexToPixel
 	float3 normal       : NORMAL;      //Normal
 	float3 worldPos		: POSITION;
 	float2 uv           : TEXCOORD;    //UV
-	float3 tangent      : TANGENT;
+	float4 tangent      : TANGENT;
 	
 };
 
@@ -89,7 +97,8 @@ VertexToPixel main( VertexShaderInput input )
 	// - The values will be interpolated per-pixel by the rasterizer
 	// - We don't need to alter it here, but we do need to send it to the pixel shader
 	//output.color = input.color;
-	output.tangent = normalize(mul(input.tangent, (float3x3)transWorld));
+	output.tangent.xyz = normalize(mul(input.tangent.xyz, (float3x3)transWorld));
+	output.tangent.w = input.tangent.w;
 	output.uv = input.uv;
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
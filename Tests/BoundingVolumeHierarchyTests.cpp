@@ -0,0 +1,235 @@
+#include "Test.h"
+#include "BoundingVolumeHierarchy.h"
+#include "FrustumCuller.h"
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// count unit boxes scattered through a cube of the given
+// size around the origin (fixed seed, so runs match)
+// --------------------------------------------------------
+static void ScatterBoxes(unsigned int count, float extent, unsigned int seed,
+	std::vector<XMFLOAT3>& mins, std::vector<XMFLOAT3>& maxs)
+{
+	mins.resize(count);
+	maxs.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float c[3];
+		for (int a = 0; a < 3; a++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			c[a] = ((seed >> 8) / 16777216.0f - 0.5f) * extent;
+		}
+		mins[i] = XMFLOAT3(c[0] - 0.5f, c[1] - 0.5f, c[2] - 0.5f);
+		maxs[i] = XMFLOAT3(c[0] + 0.5f, c[1] + 0.5f, c[2] + 0.5f);
+	}
+}
+
+// A camera at -z looking down +z at the middle of the boxes
+static void CenterFrustum(float distance, XMFLOAT4 planes[6])
+{
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 0, -distance, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.8f, 16.0f / 9.0f, 0.1f, distance * 2.0f);
+	MeshletCuller::ExtractFrustumPlanes(view * projection, planes);
+}
+
+// Objects [0, count) whose (live) boxes pass the brute force test
+static std::vector<unsigned int> BruteForceVisible(const std::vector<XMFLOAT3>& mins, const std::vector<XMFLOAT3>& maxs,
+	const std::vector<bool>& inTree, const XMFLOAT4 planes[6])
+{
+	std::vector<unsigned int> visible;
+	for (unsigned int i = 0; i < (unsigned int)mins.size(); i++)
+		if (inTree[i] && FrustumCuller::IsBoxVisible(mins[i], maxs[i], planes))
+			visible.push_back(i);
+	return visible;
+}
+
+TEST(BoundingVolumeHierarchyMatchesBruteForceCulling)
+{
+	unsigned int count = 2000;
+	std::vector<XMFLOAT3> mins;
+	std::vector<XMFLOAT3> maxs;
+	ScatterBoxes(count, 200.0f, 777, mins, maxs);
+	std::vector<bool> inTree(count, true);
+
+	BoundingVolumeHierarchy bvh;
+	bvh.Build(&mins[0], &maxs[0], count);
+	CHECK(bvh.GetObjectCount() == count);
+
+	XMFLOAT4 planes[6];
+	CenterFrustum(150.0f, planes);
+	std::vector<unsigned int> visible;
+	bvh.CullFrustum(planes, visible);
+	std::sort(visible.begin(), visible.end());
+	CHECK(visible == BruteForceVisible(mins, maxs, inTree, planes));
+	CHECK(!visible.empty() && visible.size() < count);
+
+	// Small nudges (inside the fattened boxes), big jumps (reinserted),
+	// and removals, then the same query again
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float move = (i % 3 == 0) ? 0.05f : (i % 3 == 1) ? 3.0f : 80.0f;
+		XMFLOAT3 offset(move, -move * 0.5f, move * 0.25f);
+		mins[i] = XMFLOAT3(mins[i].x + offset.x, mins[i].y + offset.y, mins[i].z + offset.z);
+		maxs[i] = XMFLOAT3(maxs[i].x + offset.x, maxs[i].y + offset.y, maxs[i].z + offset.z);
+		bvh.SetBounds(i, mins[i], maxs[i]);
+	}
+	for (unsigned int i = 0; i < count; i += 5)
+	{
+		bvh.Remove(i);
+		inTree[i] = false;
+	}
+	CHECK(bvh.GetObjectCount() == count - count / 5);
+
+	bvh.CullFrustum(planes, visible);
+	std::sort(visible.begin(), visible.end());
+	CHECK(visible == BruteForceVisible(mins, maxs, inTree, planes));
+}
+
+TEST(BoundingVolumeHierarchyIgnoresObjectsNotInTheTree)
+{
+	std::vector<XMFLOAT3> mins;
+	std::vector<XMFLOAT3> maxs;
+	ScatterBoxes(4, 10.0f, 99, mins, maxs);
+
+	BoundingVolumeHierarchy bvh;
+	bvh.Insert(0, mins[0], maxs[0]);
+	bvh.Insert(2, mins[2], maxs[2]);
+	bvh.Remove(2);
+
+	// Object 1 was never inserted, 2 was removed, and 3 and
+	// 1000 are past the end of everything the tree has seen
+	XMFLOAT3 origin(0, 0, 0);
+	bvh.SetBounds(1, origin, origin);
+	bvh.SetBounds(2, origin, origin);
+	bvh.SetBounds(3, origin, origin);
+	bvh.SetBounds(1000, origin, origin);
+	bvh.Remove(1000);
+	CHECK(bvh.GetObjectCount() == 1);
+
+	// None of them came back, and object 0 is still where it was
+	XMFLOAT4 planes[6];
+	CenterFrustum(30.0f, planes);
+	std::vector<unsigned int> visible;
+	bvh.CullFrustum(planes, visible);
+	CHECK(visible.size() == 1 && visible[0] == 0);
+
+	unsigned int hit = BVH_NONE;
+	float distance = 0.0f;
+	XMFLOAT3 center((mins[0].x + maxs[0].x) * 0.5f, (mins[0].y + maxs[0].y) * 0.5f, -50.0f);
+	CHECK(bvh.Raycast(center, XMFLOAT3(0, 0, 1), 1000.0f, &hit, &distance));
+	CHECK(hit == 0);
+}
+
+// --------------------------------------------------------
+// Build, a frame of every object moving (SetBounds, then
+// Refit), and a frustum query, for count objects.  The
+// brute force baselines test every object each frame: the
+// four-wide sphere test (FrustumCuller::CullSpheres) and a
+// plain IsBoxVisible loop
+// --------------------------------------------------------
+static void TimeCulling(unsigned int count, unsigned int frames)
+{
+	// About the same number in view whatever the count
+	float extent = 20.0f * powf((float)count, 1.0f / 3.0f);
+	std::vector<XMFLOAT3> mins;
+	std::vector<XMFLOAT3> maxs;
+	ScatterBoxes(count, extent, 4321, mins, maxs);
+	XMFLOAT4 planes[6];
+	CenterFrustum(extent * 0.25f, planes);
+
+	BoundingVolumeHierarchy bvh;
+	double start = TestSeconds();
+	bvh.Build(&mins[0], &maxs[0], count);
+	double buildSeconds = TestSeconds() - start;
+
+	// Everything drifts a little each frame, and every 100th
+	// object jumps across the scene
+	double refitSeconds = 0.0;
+	double querySeconds = 0.0;
+	std::vector<unsigned int> visible;
+	size_t bvhVisible = 0;
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float move = (i % 100 == f % 100) ? extent * 0.5f : 0.2f;
+			mins[i].x += move;
+			maxs[i].x += move;
+			if (maxs[i].x > extent * 0.5f)
+			{
+				mins[i].x -= extent;
+				maxs[i].x -= extent;
+			}
+		}
+
+		start = TestSeconds();
+		for (unsigned int i = 0; i < count; i++)
+			bvh.SetBounds(i, mins[i], maxs[i]);
+		bvh.Refit();
+		refitSeconds += TestSeconds() - start;
+
+		start = TestSeconds();
+		bvh.CullFrustum(planes, visible);
+		querySeconds += TestSeconds() - start;
+		bvhVisible += visible.size();
+	}
+
+	// The spheres are refilled from the boxes every frame, like
+	// a scene without a tree would have to
+	BoundingSpheres spheres;
+	spheres.CenterX.resize(count);
+	spheres.CenterY.resize(count);
+	spheres.CenterZ.resize(count);
+	spheres.Radius.resize(count);
+	std::vector<unsigned char> marks(count);
+	size_t sphereVisible = 0;
+	start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			spheres.CenterX[i] = (mins[i].x + maxs[i].x) * 0.5f;
+			spheres.CenterY[i] = (mins[i].y + maxs[i].y) * 0.5f;
+			spheres.CenterZ[i] = (mins[i].z + maxs[i].z) * 0.5f;
+			spheres.Radius[i] = 0.8660254f;
+		}
+		sphereVisible += FrustumCuller::CullSpheres(spheres, planes, &marks[0]);
+	}
+	double sphereSeconds = TestSeconds() - start;
+
+	size_t boxVisible = 0;
+	start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+		for (unsigned int i = 0; i < count; i++)
+			boxVisible += FrustumCuller::IsBoxVisible(mins[i], maxs[i], planes) ? 1 : 0;
+	double boxSeconds = TestSeconds() - start;
+
+	printf("  %8u objects: BVH build %8.3f ms, refit %8.3f ms, query %7.3f ms (%u visible)\n",
+		count, buildSeconds * 1000.0, refitSeconds * 1000.0 / frames, querySeconds * 1000.0 / frames,
+		(unsigned int)(bvhVisible / frames));
+	printf("  %8s          brute force spheres %8.3f ms (%u visible), boxes %8.3f ms (%u visible)\n",
+		"", sphereSeconds * 1000.0 / frames, (unsigned int)(sphereVisible / frames),
+		boxSeconds * 1000.0 / frames, (unsigned int)(boxVisible / frames));
+}
+
+BENCHMARK(BoundingVolumeHierarchyVsBruteForce)
+{
+	unsigned int frames = (unsigned int)GetBenchmarkParameter("frames", 10);
+	unsigned int count = (unsigned int)GetBenchmarkParameter("objects", 0);
+	if (count)
+	{
+		TimeCulling(count, frames);
+		return;
+	}
+
+	static const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (int c = 0; c < 3; c++)
+		TimeCulling(counts[c], frames);
+}
@@ -0,0 +1,153 @@
+#include "Test.h"
+#include "TestScene.h"
+#include "InstanceRenderer.h"
+#include "RenderBackend.h"
+
+#include <vector>
+
+using namespace DirectX;
+
+static XMFLOAT4X4 TestWorldMatrix(unsigned int id)
+{
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixTranspose(XMMatrixTranslation((float)id, 0, 0)));
+	return world;
+}
+
+// --------------------------------------------------------
+// Adds count objects, spread over every mesh/material pair
+// --------------------------------------------------------
+static void AddTestObjects(InstanceRenderer& renderer, const std::vector<Mesh*>& meshes,
+	const std::vector<Material*>& materials, unsigned int count)
+{
+	for (unsigned int id = 0; id < count; id++)
+	{
+		Mesh* mesh = meshes[id % meshes.size()];
+		Material* material = materials[id / meshes.size() % materials.size()];
+		XMFLOAT4X4 world = TestWorldMatrix(id);
+		renderer.Add(mesh, material, 0, world, world, id);
+	}
+}
+
+TEST(InstanceRendererDrawsOneCallPerBatch)
+{
+	std::vector<Mesh*> meshes;
+	std::vector<Material*> materials;
+	for (int i = 0; i < 2; i++)
+	{
+		meshes.push_back(CreateTestMesh());
+		materials.push_back(CreateTestMaterial());
+	}
+
+	InstanceRenderer renderer(0, 16);
+	AddTestObjects(renderer, meshes, materials, 1000);
+	renderer.Build(2);
+	CHECK(renderer.GetBatchCount() == 4);
+	CHECK(renderer.GetInstanceCount() == 1000);
+	CHECK(renderer.GetUnbatchedIds().empty());
+
+	// One upload of every instance, and one draw per mesh/material pair
+	CountingRenderBackend backend(0);
+	renderer.Draw(&backend);
+	const RenderBackendStats& stats = backend.GetStats();
+	CHECK(stats.Uploads == 1);
+	CHECK(stats.BytesUploaded == 1000 * sizeof(InstanceData));
+	CHECK(stats.Draws == 4);
+	CHECK(stats.Instances == 1000);
+	CHECK(stats.MeshBinds == 2);	// Batches are sorted by mesh first
+	CHECK(stats.MaterialBinds <= 4);
+	CHECK(stats.ObjectUpdates == 0);
+
+	// Each batch's instances are the objects that share its mesh and material
+	for (unsigned int b = 0; b < renderer.GetBatchCount(); b++)
+	{
+		const InstanceBatch& batch = renderer.GetBatch(b);
+		CHECK(batch.InstanceCount == 250);
+		for (unsigned int i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceCount; i++)
+		{
+			unsigned int id = renderer.GetInstanceId(i);
+			CHECK(meshes[id % meshes.size()] == batch.BatchMesh);
+			CHECK(materials[id / meshes.size() % materials.size()] == batch.BatchMaterial);
+		}
+	}
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		delete meshes[i];
+		DeleteTestMaterial(materials[i]);
+	}
+}
+
+TEST(InstanceRendererLeavesSmallGroupsUnbatched)
+{
+	Mesh* mesh = CreateTestMesh();
+	Material* common = CreateTestMaterial();
+	Material* rare = CreateTestMaterial();
+
+	InstanceRenderer renderer(0, 4);
+	XMFLOAT4X4 world = TestWorldMatrix(0);
+	for (unsigned int id = 0; id < 10; id++)
+		renderer.Add(mesh, common, 0, world, world, id);
+	renderer.Add(mesh, rare, 0, world, world, 10);
+	renderer.Build(2);
+
+	CHECK(renderer.GetBatchCount() == 1);
+	CHECK(renderer.GetUnbatchedIds().size() == 1);
+	CHECK(renderer.GetUnbatchedIds()[0] == 10);
+
+	// The unbatched object isn't drawn or uploaded (it's the caller's to draw)
+	CountingRenderBackend backend(0);
+	renderer.Draw(&backend);
+	CHECK(backend.GetStats().Draws == 1);
+	CHECK(backend.GetStats().Instances == 10);
+	CHECK(backend.GetStats().BytesUploaded == 10 * sizeof(InstanceData));
+
+	// Nothing batched draws nothing at all
+	renderer.Clear();
+	renderer.Add(mesh, rare, 0, world, world, 0);
+	renderer.Build(2);
+	backend.ResetStats();
+	renderer.Draw(&backend);
+	CHECK(backend.GetStats().Uploads == 0);
+	CHECK(backend.GetStats().Draws == 0);
+
+	delete mesh;
+	DeleteTestMaterial(common);
+	DeleteTestMaterial(rare);
+}
+
+BENCHMARK(InstanceRendererBuildAndDraw)
+{
+	unsigned int objectCount = (unsigned int)GetBenchmarkParameter("objects", 100000);
+	unsigned int frames = 20;
+
+	std::vector<Mesh*> meshes;
+	std::vector<Material*> materials;
+	for (int i = 0; i < 8; i++)
+	{
+		meshes.push_back(CreateTestMesh());
+		materials.push_back(CreateTestMaterial());
+	}
+
+	InstanceRenderer renderer(0, objectCount);
+	CountingRenderBackend backend(0);
+	double start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		renderer.Clear();
+		AddTestObjects(renderer, meshes, materials, objectCount);
+		renderer.Build(2);
+		backend.ResetStats();
+		renderer.Draw(&backend);
+	}
+	double seconds = (TestSeconds() - start) / frames;
+
+	printf("  %u objects: %.3f ms a frame, %u draws, %u bytes uploaded (one draw each: %u draws)\n",
+		objectCount, seconds * 1000.0, backend.GetStats().Draws, backend.GetStats().BytesUploaded, objectCount);
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		delete meshes[i];
+		DeleteTestMaterial(materials[i]);
+	}
+}
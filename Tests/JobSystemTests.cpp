@@ -0,0 +1,230 @@
+#include "Test.h"
+#include "TestScene.h"
+#include "JobSystem.h"
+#include "TransformSystem.h"
+#include "GameEntity.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Marks each item it's given, and forks a ParallelFor of
+// its own over a second array, to check nested joins
+// --------------------------------------------------------
+struct MarkJobData
+{
+	JobSystem* Jobs;
+	unsigned char* Marks;
+	unsigned char* InnerMarks;
+	unsigned int InnerCount;
+};
+
+static void MarkInnerJob(void* data, unsigned int first, unsigned int last)
+{
+	MarkJobData* job = (MarkJobData*)data;
+	for (unsigned int i = first; i < last; i++)
+		job->InnerMarks[i]++;
+}
+
+static void MarkJob(void* data, unsigned int first, unsigned int last)
+{
+	MarkJobData* job = (MarkJobData*)data;
+	for (unsigned int i = first; i < last; i++)
+		job->Marks[i]++;
+
+	if (first == 0)
+	{
+		JobCounter inner;
+		job->Jobs->ParallelFor(MarkInnerJob, job, job->InnerCount, 3, &inner);
+		job->Jobs->Wait(&inner);
+	}
+}
+
+TEST(JobSystemRunsEveryItemOnce)
+{
+	JobSystem jobs(4);
+	std::vector<unsigned char> marks(10000, 0);
+	std::vector<unsigned char> innerMarks(100, 0);
+	MarkJobData data = { &jobs, &marks[0], &innerMarks[0], (unsigned int)innerMarks.size() };
+
+	JobCounter done;
+	jobs.ParallelFor(MarkJob, &data, (unsigned int)marks.size(), 7, &done);
+	jobs.Wait(&done);
+	CHECK(done.Pending == 0);
+
+	bool once = true;
+	for (size_t i = 0; i < marks.size(); i++)
+		once = once && marks[i] == 1;
+	for (size_t i = 0; i < innerMarks.size(); i++)
+		once = once && innerMarks[i] == 1;
+	CHECK(once);
+}
+
+TEST(TransformSystemParallelUpdateMatchesSerial)
+{
+	// Enough transforms to be split into jobs, in chains of 10
+	unsigned int count = 20000;
+	TransformSystem serial;
+	TransformSystem parallel;
+	std::vector<TransformHandle> serialHandles(count);
+	std::vector<TransformHandle> parallelHandles(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		serialHandles[i] = serial.Create();
+		parallelHandles[i] = parallel.Create();
+		if (i % 10)
+		{
+			serial.SetParent(serialHandles[i], serialHandles[i - 1]);
+			parallel.SetParent(parallelHandles[i], parallelHandles[i - 1]);
+		}
+		serial.SetPosition(serialHandles[i], 0.1f * i, 1, 0);
+		parallel.SetPosition(parallelHandles[i], 0.1f * i, 1, 0);
+		serial.SetRotation(serialHandles[i], 0, 0.01f * (i % 10), 0);
+		parallel.SetRotation(parallelHandles[i], 0, 0.01f * (i % 10), 0);
+	}
+
+	JobSystem jobs(4);
+	serial.UpdateWorldMatrices();
+	parallel.UpdateWorldMatrices(&jobs);
+
+	// Then move every 7th one, so only some subtrees are redone
+	for (unsigned int i = 0; i < count; i += 7)
+	{
+		serial.SetScale(serialHandles[i], 2, 1, 1);
+		parallel.SetScale(parallelHandles[i], 2, 1, 1);
+	}
+	serial.UpdateWorldMatrices();
+	parallel.UpdateWorldMatrices(&jobs);
+
+	bool same = true;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		same = same &&
+			memcmp(serial.GetWorldMatrix(serialHandles[i]), parallel.GetWorldMatrix(parallelHandles[i]), sizeof(XMFLOAT4X4)) == 0 &&
+			memcmp(serial.GetWorldInverseTranspose(serialHandles[i]), parallel.GetWorldInverseTranspose(parallelHandles[i]), sizeof(XMFLOAT4X4)) == 0;
+	}
+	CHECK(same);
+}
+
+// --------------------------------------------------------
+// Picks the level of detail and culls the meshlets of
+// entities [first, last), the way Game's draw jobs do
+// --------------------------------------------------------
+struct SceneJobData
+{
+	GameEntity* const* Entities;
+	unsigned int* Lods;
+	MeshletCullStats* Stats;
+	XMFLOAT4 Frustum[6];
+	XMFLOAT3 CameraPosition;
+};
+
+static void CullSceneJob(void* data, unsigned int first, unsigned int last)
+{
+	SceneJobData* job = (SceneJobData*)data;
+	for (unsigned int i = first; i < last; i++)
+	{
+		GameEntity* entity = job->Entities[i];
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixTranspose(XMLoadFloat4x4(entity->GetWorldMatrix())));
+		job->Lods[i] = entity->SelectLod(world, job->CameraPosition, 500.0f, 1.0f);
+
+		job->Stats[i] = MeshletCullStats();
+		if (job->Lods[i] == 0)
+			entity->CullMeshlets(world, job->Frustum, job->CameraPosition, &job->Stats[i]);
+	}
+}
+
+// A size x size grid in the xy plane, with its CPU side only
+static Mesh* CreateGridMesh(unsigned int size)
+{
+	unsigned int row = size + 1;
+	std::vector<Vertex> verts(row * row);
+	for (unsigned int y = 0; y < row; y++)
+	{
+		for (unsigned int x = 0; x < row; x++)
+		{
+			Vertex& v = verts[y * row + x];
+			v = Vertex();
+			v.Position = XMFLOAT3(x / (float)size - 0.5f, y / (float)size - 0.5f, 0.0f);
+			v.UV = XMFLOAT2(x / (float)size, y / (float)size);
+			v.Normal = XMFLOAT3(0, 0, -1);
+		}
+	}
+
+	std::vector<unsigned int> indices;
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x;
+			unsigned int quad[6] = { v, v + row, v + 1, v + 1, v + row, v + row + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	return new Mesh(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), 0);
+}
+
+BENCHMARK(EntityUpdateScaling)
+{
+	unsigned int entityCount = (unsigned int)GetBenchmarkParameter("entities", 100000);
+	unsigned int maxThreads = (unsigned int)GetBenchmarkParameter("threads", std::thread::hardware_concurrency());
+	unsigned int frames = (unsigned int)GetBenchmarkParameter("frames", 10);
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	Mesh* mesh = CreateGridMesh(16);
+	Material* material = CreateTestMaterial();
+	TransformSystem transforms;
+	std::vector<GameEntity*> entities(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+		entities[i] = new GameEntity(mesh, material, &transforms);
+
+	// Looking down +z at a wall of entities, some of them off screen
+	SceneJobData scene = {};
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 0, -20, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.8f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	MeshletCuller::ExtractFrustumPlanes(view * projection, scene.Frustum);
+	scene.CameraPosition = XMFLOAT3(0, 0, -20);
+	std::vector<unsigned int> lods(entityCount);
+	std::vector<MeshletCullStats> stats(entityCount);
+	scene.Entities = &entities[0];
+	scene.Lods = &lods[0];
+	scene.Stats = &stats[0];
+
+	double oneThreadSeconds = 0.0;
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		JobSystem jobs(threads);
+		double start = TestSeconds();
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			// Move everyone (on this thread, like Game::Update), compose
+			// the matrices across the threads, then cull on them too
+			float t = f * 0.016f;
+			for (unsigned int i = 0; i < entityCount; i++)
+			{
+				entities[i]->Move((float)(i % 300) - 150.0f, (float)(i / 300 % 300) - 150.0f + t, (float)(i / 90000) * 2.0f);
+				entities[i]->Rotate(0, t, 0);
+			}
+			transforms.UpdateWorldMatrices(&jobs);
+
+			JobCounter culled;
+			jobs.ParallelFor(CullSceneJob, &scene, entityCount, 256, &culled);
+			jobs.Wait(&culled);
+		}
+		double seconds = (TestSeconds() - start) / frames;
+		if (threads == 1)
+			oneThreadSeconds = seconds;
+
+		printf("  %u entities, %2u threads: %8.3f ms a frame (%.2fx)\n",
+			entityCount, threads, seconds * 1000.0, oneThreadSeconds / seconds);
+	}
+
+	for (unsigned int i = 0; i < entityCount; i++)
+		delete entities[i];
+	delete mesh;
+	DeleteTestMaterial(material);
+}
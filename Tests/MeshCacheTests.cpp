@@ -0,0 +1,198 @@
+#include "Test.h"
+#include "MeshCache.h"
+#include "Mesh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+static bool WriteSourceFile(const std::string& path, const char* text)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	fwrite(text, 1, strlen(text), file);
+	fclose(file);
+	return true;
+}
+
+TEST(MeshCacheRejectsChangedOrMissingSource)
+{
+	std::string sourceFile = GetTempTestFile("cache_source.obj");
+	std::string cacheFile = GetTempTestFile("cache_source.obj.meshcache");
+	CHECK(WriteSourceFile(sourceFile, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"));
+
+	Vertex verts[3] = {};
+	verts[1].Position = XMFLOAT3(1, 0, 0);
+	verts[2].Position = XMFLOAT3(0, 1, 0);
+	unsigned int indices[3] = { 0, 1, 2 };
+	MeshLod lod = { 0, 3, 0.0f };
+	MeshBounds bounds = { XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 0), XMFLOAT3(0.5f, 0.5f, 0), 0.7071068f };
+	Meshlet meshlet = { 0, 1, 3, XMFLOAT3(0.5f, 0.5f, 0), 0.7071068f, XMFLOAT3(0, 0, -1), 0.0f };
+	CHECK(MeshCache::Write(cacheFile.c_str(), sourceFile.c_str(), verts, 3, indices, 3, &lod, 1, bounds, &meshlet, 1));
+
+	// Up to date, so the blobs come back as written (with 16-bit indices)
+	MeshCache cache;
+	CHECK(cache.Open(cacheFile.c_str(), sourceFile.c_str()));
+	CHECK(cache.GetVertexCount() == 3);
+	CHECK(cache.GetIndexSize() == sizeof(unsigned short));
+	CHECK(cache.GetIndexCount() == 3 && ((const unsigned short*)cache.GetIndices())[2] == 2);
+	CHECK(cache.GetVertices() && cache.GetVertices()[1].Position.x == 1.0f);
+	CHECK(cache.GetBounds() && memcmp(cache.GetBounds(), &bounds, sizeof(bounds)) == 0);
+	CHECK(cache.GetMeshletCount() == 1 && memcmp(cache.GetMeshlets(), &meshlet, sizeof(meshlet)) == 0);
+	cache.Close();
+
+	// A different source is stale
+	CHECK(WriteSourceFile(sourceFile, "v 0 0 0\nv 2 0 0\nv 0 2 0\nf 1 2 3\n# edited\n"));
+	CHECK(!cache.Open(cacheFile.c_str(), sourceFile.c_str()));
+
+	// And so is a source that can't be found, rather than trusted blindly
+	remove(sourceFile.c_str());
+	CHECK(!cache.Open(cacheFile.c_str(), sourceFile.c_str()));
+	CHECK(cache.GetHeader() == 0);
+
+	remove(cacheFile.c_str());
+}
+
+// A size x size grid OBJ, with a bump so its meshlets face different ways
+static std::string MakeGridObjText(unsigned int size)
+{
+	std::string text;
+	char line[128];
+	for (unsigned int y = 0; y <= size; y++)
+	{
+		for (unsigned int x = 0; x <= size; x++)
+		{
+			snprintf(line, sizeof(line), "v %g %g %g\nvt %g %g\n",
+				(float)x, (float)y, sinf(x * 0.4f) * cosf(y * 0.3f), x / (float)size, y / (float)size);
+			text += line;
+		}
+	}
+	text += "vn 0 0 -1\n";
+	unsigned int row = size + 1;
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x + 1;
+			snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1\nf %u/%u/1 %u/%u/1 %u/%u/1\n",
+				v, v, v + row, v + row, v + 1, v + 1, v + 1, v + 1, v + row, v + row, v + row + 1, v + row + 1);
+			text += line;
+		}
+	}
+	return text;
+}
+
+TEST(MeshCacheKeepsBoundsAndMeshlets)
+{
+	std::string sourceFile = GetTempTestFile("cache_grid.obj");
+	std::string cacheFile = sourceFile + ".meshcache";
+	remove(cacheFile.c_str());
+	CHECK(WriteSourceFile(sourceFile, MakeGridObjText(40).c_str()));
+
+	// The first load parses the OBJ and writes the cache, the
+	// second loads from it, with nothing worked out again
+	Mesh* cold = new Mesh(&sourceFile[0], 0);
+	MeshCache cache;
+	CHECK(cache.Open(cacheFile.c_str(), sourceFile.c_str()));
+	cache.Close();
+	Mesh* warm = new Mesh(&sourceFile[0], 0);
+
+	CHECK(cold->GetIndexCount() > 0 && warm->GetIndexCount() == cold->GetIndexCount());
+	CHECK(warm->GetLodCount() == cold->GetLodCount());
+	XMFLOAT3 coldMin = cold->GetBoundsMin(), warmMin = warm->GetBoundsMin();
+	XMFLOAT3 coldMax = cold->GetBoundsMax(), warmMax = warm->GetBoundsMax();
+	XMFLOAT3 coldCenter = cold->GetBoundsCenter(), warmCenter = warm->GetBoundsCenter();
+	CHECK(memcmp(&coldMin, &warmMin, sizeof(XMFLOAT3)) == 0);
+	CHECK(memcmp(&coldMax, &warmMax, sizeof(XMFLOAT3)) == 0);
+	CHECK(memcmp(&coldCenter, &warmCenter, sizeof(XMFLOAT3)) == 0);
+	CHECK(cold->GetBoundsRadius() > 0.0f && warm->GetBoundsRadius() == cold->GetBoundsRadius());
+	CHECK(coldMax.x == 40.0f && coldMax.y == 40.0f);
+	CHECK(cold->GetMeshlets().size() > 1 && warm->GetMeshlets().size() == cold->GetMeshlets().size());
+	CHECK(memcmp(&warm->GetMeshlets()[0], &cold->GetMeshlets()[0], cold->GetMeshlets().size() * sizeof(Meshlet)) == 0);
+
+	delete cold;
+	delete warm;
+	remove(cacheFile.c_str());
+	remove(sourceFile.c_str());
+}
+
+// Copies a file byte for byte
+static bool CopyTestFile(const std::string& from, const std::string& to)
+{
+	FILE* in = fopen(from.c_str(), "rb");
+	if (!in)
+		return false;
+	FILE* out = fopen(to.c_str(), "wb");
+	if (!out)
+	{
+		fclose(in);
+		return false;
+	}
+
+	char buffer[65536];
+	size_t read;
+	bool ok = true;
+	while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		ok = ok && fwrite(buffer, 1, read, out) == read;
+	fclose(in);
+	return fclose(out) == 0 && ok;
+}
+
+// --------------------------------------------------------
+// Loading every bundled OBJ as a Mesh (with no device, so
+// only the CPU side is timed): cold, from the OBJ with no
+// cache (parsing, optimizing, LODs, tangents, bounds,
+// meshlets, then writing the cache), and warm, from the
+// cache.  The OBJs are copied to the temp folder first, so
+// the caches don't end up beside the bundled files
+// --------------------------------------------------------
+BENCHMARK(MeshCacheColdVsWarmLoads)
+{
+	unsigned int runs = (unsigned int)GetBenchmarkParameter("runs", 5);
+	static const char* files[] = { "cone.obj", "cube.obj", "cylinder.obj", "helix.obj", "sphere.obj", "torus.obj" };
+
+	double coldTotal = 0.0;
+	double warmTotal = 0.0;
+	for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+	{
+		std::string sourceFile = GetTempTestFile(std::string("startup_") + files[f]);
+		std::string cacheFile = sourceFile + ".meshcache";
+		if (!CopyTestFile(FindTestFile(files[f]), sourceFile))
+		{
+			printf("  %-12s not found\n", files[f]);
+			continue;
+		}
+
+		double start = TestSeconds();
+		int indexCount = 0;
+		for (unsigned int r = 0; r < runs; r++)
+		{
+			remove(cacheFile.c_str());
+			Mesh mesh(&sourceFile[0], 0);
+			indexCount = mesh.GetIndexCount();
+		}
+		double coldSeconds = (TestSeconds() - start) / runs;
+
+		start = TestSeconds();
+		for (unsigned int r = 0; r < runs; r++)
+		{
+			Mesh mesh(&sourceFile[0], 0);
+			indexCount = mesh.GetIndexCount();
+		}
+		double warmSeconds = (TestSeconds() - start) / runs;
+
+		printf("  %-12s %7d indices: cold %8.3f ms, warm %8.3f ms (%.1fx)\n",
+			files[f], indexCount, coldSeconds * 1000.0, warmSeconds * 1000.0, coldSeconds / warmSeconds);
+		coldTotal += coldSeconds;
+		warmTotal += warmSeconds;
+
+		remove(cacheFile.c_str());
+		remove(sourceFile.c_str());
+	}
+	printf("  all files:           cold %8.3f ms, warm %8.3f ms\n", coldTotal * 1000.0, warmTotal * 1000.0);
+}
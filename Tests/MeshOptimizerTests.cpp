@@ -0,0 +1,77 @@
+#include "Test.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <vector>
+
+// --------------------------------------------------------
+// A size x size grid of quads, with its triangles shuffled
+// so there's little reuse for the cache to start with
+// --------------------------------------------------------
+static std::vector<unsigned int> MakeShuffledGrid(unsigned int size)
+{
+	std::vector<unsigned int> indices;
+	unsigned int row = size + 1;
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x;
+			unsigned int quad[6] = { v, v + 1, v + row, v + 1, v + row + 1, v + row };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	// Fixed seed, so every run sees the same order
+	unsigned int seed = 12345;
+	unsigned int triCount = (unsigned int)indices.size() / 3;
+	for (unsigned int t = triCount - 1; t > 0; t--)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		unsigned int other = (seed >> 8) % (t + 1);
+		for (int c = 0; c < 3; c++)
+			std::swap(indices[t * 3 + c], indices[other * 3 + c]);
+	}
+	return indices;
+}
+
+// Each triangle as a sortable key, corners in the order they're drawn
+static std::vector<unsigned long long> TriangleKeys(const std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+	std::vector<unsigned long long> keys;
+	for (size_t i = 0; i < indices.size(); i += 3)
+		keys.push_back(((unsigned long long)indices[i] * vertexCount + indices[i + 1]) * vertexCount + indices[i + 2]);
+	std::sort(keys.begin(), keys.end());
+	return keys;
+}
+
+TEST(MeshOptimizerReordersForTheVertexCache)
+{
+	unsigned int size = 64;
+	unsigned int vertexCount = (size + 1) * (size + 1);
+	std::vector<unsigned int> indices = MakeShuffledGrid(size);
+	std::vector<unsigned int> original = indices;
+
+	VertexCacheStats before = MeshOptimizer::SimulateVertexCache(&indices[0], (unsigned int)indices.size(), vertexCount, 16);
+	MeshOptimizer::OptimizeVertexCache(&indices[0], (unsigned int)indices.size(), vertexCount);
+	VertexCacheStats after = MeshOptimizer::SimulateVertexCache(&indices[0], (unsigned int)indices.size(), vertexCount, 16);
+
+	// The same triangles, facing the same way, just in a better order
+	CHECK(TriangleKeys(indices, vertexCount) == TriangleKeys(original, vertexCount));
+	CHECK(before.ACMR > 2.0f);
+	CHECK(after.ACMR < 0.75f);
+
+	// Reordering the vertices to match means each is fetched in order
+	std::vector<Vertex> verts(vertexCount);
+	CHECK(MeshOptimizer::OptimizeVertexFetch(&verts[0], vertexCount, &indices[0], (unsigned int)indices.size()) == vertexCount);
+	unsigned int nextNew = 0;
+	bool inOrder = true;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] > nextNew)
+			inOrder = false;
+		else if (indices[i] == nextNew)
+			nextNew++;
+	}
+	CHECK(inOrder);
+}
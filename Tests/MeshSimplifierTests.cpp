@@ -0,0 +1,143 @@
+#include "Test.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjReader.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// A gently rolling grid of size x size quads with UVs and
+// normals, so there's something for each level to remove
+// --------------------------------------------------------
+static void MakeRollingGrid(unsigned int size, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	unsigned int row = size + 1;
+	verts.resize(row * row);
+	for (unsigned int y = 0; y < row; y++)
+	{
+		for (unsigned int x = 0; x < row; x++)
+		{
+			float dx = 0.1f * cosf(x * 0.1f);
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(dx, 0, -1, 0)));
+
+			Vertex& v = verts[y * row + x];
+			v.Position = XMFLOAT3((float)x, (float)y, sinf(x * 0.1f));
+			v.UV = XMFLOAT2((float)x / size, (float)y / size);
+			v.Normal = normal;
+		}
+	}
+
+	indices.clear();
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x;
+			unsigned int quad[6] = { v, v + row, v + 1, v + 1, v + row, v + row + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+TEST(MeshSimplifierLodsShrinkToTheirTargets)
+{
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	MakeRollingGrid(64, verts, indices);
+	unsigned int vertexCount = (unsigned int)verts.size();
+	unsigned int fullCount = (unsigned int)indices.size();
+
+	MeshLod lods[MESH_MAX_LODS];
+	unsigned int lodCount = MeshSimplifier::BuildLodChain(&verts[0], vertexCount, indices, lods, MESH_MAX_LODS);
+
+	// A smooth 8192 triangle grid has room for every level
+	CHECK(lodCount == MESH_MAX_LODS);
+	CHECK(lods[0].IndexOffset == 0 && lods[0].IndexCount == fullCount && lods[0].Error == 0.0f);
+
+	for (unsigned int l = 1; l < lodCount; l++)
+	{
+		// Each level aims for half the triangles of the one before it,
+		// and is stored right after it
+		unsigned int target = lods[l - 1].IndexCount / 6 * 3;
+		CHECK(lods[l].IndexCount > 0 && lods[l].IndexCount % 3 == 0);
+		CHECK(lods[l].IndexCount <= target);
+		CHECK(lods[l].IndexCount <= lods[l - 1].IndexCount);
+		CHECK(lods[l].IndexOffset == lods[l - 1].IndexOffset + lods[l - 1].IndexCount);
+		CHECK(lods[l].Error >= lods[l - 1].Error);
+
+		// Still indexing the shared vertices, with no collapsed triangles
+		const unsigned int* tri = &indices[lods[l].IndexOffset];
+		for (unsigned int t = 0; t < lods[l].IndexCount / 3; t++, tri += 3)
+		{
+			CHECK(tri[0] < vertexCount && tri[1] < vertexCount && tri[2] < vertexCount);
+			CHECK(tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2]);
+		}
+	}
+	CHECK(indices.size() == lods[lodCount - 1].IndexOffset + lods[lodCount - 1].IndexCount);
+
+	// Asked for directly, any target is met when the error allows it
+	std::vector<unsigned int> full(indices.begin(), indices.begin() + fullCount);
+	std::vector<unsigned int> simplified(fullCount);
+	unsigned int targets[3] = { fullCount / 6 * 3, fullCount / 12 * 3, fullCount / 30 * 3 };
+	for (int t = 0; t < 3; t++)
+	{
+		float error;
+		unsigned int count = MeshSimplifier::Simplify(&verts[0], vertexCount, &full[0], fullCount,
+			targets[t], 1.0f, &simplified[0], &error);
+		CHECK(count > 0 && count <= targets[t]);
+	}
+}
+
+// --------------------------------------------------------
+// Builds the LOD chain of each bundled OBJ, prepared the way
+// Mesh does it.  A level's time is the difference between
+// building the chain with and without it
+// --------------------------------------------------------
+BENCHMARK(MeshSimplifierLodChain)
+{
+	unsigned int runs = (unsigned int)GetBenchmarkParameter("runs", 3);
+	static const char* files[] = { "cone.obj", "cube.obj", "cylinder.obj", "helix.obj", "sphere.obj", "torus.obj" };
+
+	for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> source;
+		ObjReader reader;
+		if (!reader.Read(FindTestFile(files[f]).c_str(), verts, source) || source.empty())
+		{
+			printf("  %-12s not found\n", files[f]);
+			continue;
+		}
+		MeshOptimizer::OptimizeVertexCache(&source[0], (unsigned int)source.size(), (unsigned int)verts.size());
+		verts.resize(MeshOptimizer::OptimizeVertexFetch(&verts[0], (unsigned int)verts.size(), &source[0], (unsigned int)source.size()));
+
+		// Best of a few runs of the chain cut off after each level
+		MeshLod lods[MESH_MAX_LODS];
+		unsigned int lodCount = 0;
+		double seconds[MESH_MAX_LODS + 1] = {};
+		for (unsigned int maxLods = 1; maxLods <= MESH_MAX_LODS; maxLods++)
+		{
+			seconds[maxLods] = 1e30;
+			for (unsigned int r = 0; r < runs; r++)
+			{
+				std::vector<unsigned int> indices(source);
+				double start = TestSeconds();
+				lodCount = MeshSimplifier::BuildLodChain(&verts[0], (unsigned int)verts.size(), indices, lods, maxLods);
+				seconds[maxLods] = fmin(seconds[maxLods], TestSeconds() - start);
+			}
+			if (lodCount < maxLods)
+				break;
+		}
+
+		printf("  %s, %u vertices\n", files[f], (unsigned int)verts.size());
+		for (unsigned int l = 0; l < lodCount; l++)
+		{
+			printf("    LOD %u: %7u triangles, error %-10g %8.3f ms\n",
+				l, lods[l].IndexCount / 3, lods[l].Error, fmax(seconds[l + 1] - seconds[l], 0.0) * 1000.0);
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#include "Test.h"
+#include "Mesh.h"
+
+TEST(MeshFromMissingFileIsEmpty)
+{
+	std::string path = GetTempTestFile("no_such_mesh.obj");
+	remove(path.c_str());
+
+	Mesh mesh(&path[0], 0);
+	CHECK(mesh.GetIndexCount() == 0);
+	CHECK(mesh.GetVertexBuffer() == 0 && mesh.GetIndexBuffer() == 0);
+	CHECK(mesh.GetMeshlets().empty());
+
+	// LOD 0 is still there (and empty), so picking a level is safe
+	CHECK(mesh.GetLodCount() == 1);
+	CHECK(mesh.GetLod(0).IndexCount == 0);
+	CHECK(mesh.SelectLod(100.0f, 1.0f) == 0);
+
+	CHECK(mesh.GetBoundsRadius() == 0.0f);
+	CHECK(mesh.GetBoundsCenter().x == 0.0f && mesh.GetBoundsCenter().y == 0.0f && mesh.GetBoundsCenter().z == 0.0f);
+	CHECK(mesh.GetBoundsMin().x == 0.0f && mesh.GetBoundsMax().x == 0.0f);
+}
@@ -0,0 +1,228 @@
+#include "Test.h"
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+TEST(MeshletBuilderTakes16BitIndices)
+{
+	// A bumpy grid, so the meshlets' spheres and cones all differ
+	unsigned int size = 40;
+	unsigned int row = size + 1;
+	std::vector<Vertex> verts(row * row);
+	for (unsigned int y = 0; y < row; y++)
+		for (unsigned int x = 0; x < row; x++)
+			verts[y * row + x].Position = XMFLOAT3((float)x, (float)y, sinf(x * 0.3f) * cosf(y * 0.2f));
+
+	std::vector<unsigned int> indices;
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x;
+			unsigned int quad[6] = { v, v + row, v + 1, v + 1, v + row, v + row + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+
+	std::vector<Meshlet> meshlets;
+	std::vector<Meshlet> shortMeshlets;
+	MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), meshlets);
+	MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &shortIndices[0], (unsigned int)shortIndices.size(), shortMeshlets);
+
+	// Every triangle lands in exactly one meshlet, in order, and both
+	// index sizes split the mesh the same way
+	CHECK(meshlets.size() > 1);
+	unsigned int nextIndex = 0;
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		CHECK(meshlets[m].IndexOffset == nextIndex);
+		CHECK(meshlets[m].TriangleCount <= MESHLET_MAX_TRIANGLES);
+		CHECK(meshlets[m].VertexCount <= MESHLET_MAX_VERTICES);
+		nextIndex += meshlets[m].TriangleCount * 3;
+	}
+	CHECK(nextIndex == indices.size());
+	CHECK(shortMeshlets.size() == meshlets.size());
+	CHECK(memcmp(&shortMeshlets[0], &meshlets[0], meshlets.size() * sizeof(Meshlet)) == 0);
+}
+
+// --------------------------------------------------------
+// A flat size x size patch in the xy plane, centered on the
+// origin.  Its triangles face -z, or +z when flipped
+// --------------------------------------------------------
+static void MakeMeshletPatch(unsigned int size, bool flipped, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	unsigned int row = size + 1;
+	verts.resize(row * row);
+	for (unsigned int y = 0; y < row; y++)
+		for (unsigned int x = 0; x < row; x++)
+			verts[y * row + x].Position = XMFLOAT3(x - size * 0.5f, y - size * 0.5f, 0.0f);
+
+	indices.clear();
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x;
+			unsigned int quad[6] = { v, v + row, v + 1, v + 1, v + row, v + row + 1 };
+			if (flipped)
+			{
+				std::swap(quad[1], quad[2]);
+				std::swap(quad[4], quad[5]);
+			}
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// A sphere of the given radius, its triangles facing out
+// --------------------------------------------------------
+static void MakeMeshletSphere(unsigned int segments, float radius, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	unsigned int stacks = segments / 2;
+	unsigned int row = segments + 1;
+	verts.resize((stacks + 1) * row);
+	for (unsigned int s = 0; s <= stacks; s++)
+	{
+		float phi = XM_PI * s / stacks;
+		for (unsigned int i = 0; i <= segments; i++)
+		{
+			float theta = XM_2PI * i / segments;
+			verts[s * row + i].Position = XMFLOAT3(
+				radius * sinf(phi) * cosf(theta), radius * cosf(phi), radius * sinf(phi) * sinf(theta));
+		}
+	}
+
+	// In 6 x 6 quad tiles, so each meshlet is a compact patch
+	// like the ones a vertex cache optimized mesh gives
+	indices.clear();
+	for (unsigned int tileS = 0; tileS < stacks; tileS += 6)
+	{
+		for (unsigned int tileI = 0; tileI < segments; tileI += 6)
+		{
+			for (unsigned int s = tileS; s < std::min(tileS + 6, stacks); s++)
+			{
+				for (unsigned int i = tileI; i < std::min(tileI + 6, segments); i++)
+				{
+					unsigned int v = s * row + i;
+					unsigned int quad[6] = { v, v + 1, v + row, v + 1, v + row + 1, v + row };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+		}
+	}
+}
+
+TEST(MeshletCullerRejectsBackFacingClusters)
+{
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	std::vector<Meshlet> front;
+	std::vector<Meshlet> back;
+	MakeMeshletPatch(12, false, verts, indices);
+	MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), front);
+	MakeMeshletPatch(12, true, verts, indices);
+	MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), back);
+
+	// Flat clusters have the tightest possible cones
+	CHECK(front.size() == back.size());
+	for (size_t m = 0; m < front.size(); m++)
+	{
+		CHECK(front[m].ConeCutoff < 0.01f && front[m].ConeAxis.z < -0.99f);
+		CHECK(back[m].ConeCutoff < 0.01f && back[m].ConeAxis.z > 0.99f);
+	}
+
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.8f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	std::vector<unsigned char> visible(front.size());
+
+	// Both patches are well inside the frustum, seen from either side -
+	// only the one facing the camera is kept
+	for (int side = 0; side < 2; side++)
+	{
+		float z = side == 0 ? -20.0f : 20.0f;
+		XMFLOAT4 planes[6];
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, z, 0), XMVectorZero(), XMVectorSet(0, 1, 0, 0));
+		MeshletCuller::ExtractFrustumPlanes(view * projection, planes);
+		XMFLOAT3 eye(0, 0, z);
+
+		const std::vector<Meshlet>& facing = side == 0 ? front : back;
+		const std::vector<Meshlet>& away = side == 0 ? back : front;
+
+		MeshletCullStats stats = {};
+		MeshletCuller::Cull(&facing[0], (unsigned int)facing.size(), world, planes, eye, &visible[0], &stats);
+		for (size_t m = 0; m < visible.size(); m++)
+			CHECK(visible[m] == 1);
+		CHECK(stats.FrustumCulled == 0 && stats.ConeCulled == 0 && stats.CulledTriangles == 0);
+
+		stats = MeshletCullStats();
+		MeshletCuller::Cull(&away[0], (unsigned int)away.size(), world, planes, eye, &visible[0], &stats);
+		for (size_t m = 0; m < visible.size(); m++)
+			CHECK(visible[m] == 0);
+		CHECK(stats.FrustumCulled == 0);
+		CHECK(stats.ConeCulled == away.size());
+		CHECK(stats.CulledTriangles == indices.size() / 3);
+	}
+}
+
+// --------------------------------------------------------
+// Culls a block of spheres seen from in front of one of its
+// corners, like a frame of GameEntity::CullMeshlets calls,
+// and reports how many triangles would still be drawn
+// --------------------------------------------------------
+BENCHMARK(MeshletCullingSubmittedTriangles)
+{
+	unsigned int side = (unsigned int)GetBenchmarkParameter("side", 10);
+	unsigned int segments = (unsigned int)GetBenchmarkParameter("segments", 64);
+	unsigned int frames = (unsigned int)GetBenchmarkParameter("frames", 20);
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	std::vector<Meshlet> meshlets;
+	MakeMeshletSphere(segments, 1.0f, verts, indices);
+	MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), meshlets);
+
+	unsigned int objectCount = side * side * side;
+	std::vector<XMFLOAT4X4> worlds(objectCount);
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		float x = (i % side) * 4.0f - side * 2.0f;
+		float y = (i / side % side) * 4.0f - side * 2.0f;
+		float z = (i / (side * side)) * 4.0f - side * 2.0f;
+		XMStoreFloat4x4(&worlds[i], XMMatrixTranslation(x, y, z));
+	}
+
+	XMFLOAT4 planes[6];
+	XMFLOAT3 eye(side * 2.0f, side * 1.0f, side * -3.0f);
+	XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&eye), XMVectorZero(), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.8f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	MeshletCuller::ExtractFrustumPlanes(view * projection, planes);
+
+	std::vector<unsigned char> visible(meshlets.size());
+	MeshletCullStats stats = {};
+	double start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		stats = MeshletCullStats();
+		for (unsigned int i = 0; i < objectCount; i++)
+			MeshletCuller::Cull(&meshlets[0], (unsigned int)meshlets.size(), worlds[i], planes, eye, &visible[0], &stats);
+	}
+	double seconds = (TestSeconds() - start) / frames;
+
+	printf("  %u objects of %u meshlets, %u triangles each\n",
+		objectCount, (unsigned int)meshlets.size(), (unsigned int)indices.size() / 3);
+	printf("  meshlets:  %u, %u outside the frustum, %u facing away\n",
+		stats.Meshlets, stats.FrustumCulled, stats.ConeCulled);
+	printf("  triangles: %u, %u submitted, %u culled (%.1f%%)\n",
+		stats.Triangles, stats.Triangles - stats.CulledTriangles, stats.CulledTriangles,
+		100.0 * stats.CulledTriangles / stats.Triangles);
+	printf("  %.3f ms a frame, %.1f ns a meshlet\n",
+		seconds * 1000.0, seconds * 1e9 / stats.Meshlets);
+}
@@ -0,0 +1,214 @@
+#include "Test.h"
+#include "ObjReader.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// --------------------------------------------------------
+// Writes a size x size grid of textured quads the way an
+// exporter would (positions, then uvs, then faces), a row
+// at a time so the file can be far bigger than memory
+//
+// Returns the size of the file, or 0 if it couldn't be written
+// --------------------------------------------------------
+static unsigned long long WriteGridObjFile(const std::string& path, unsigned int size)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return 0;
+
+	std::string text;
+	char line[128];
+	unsigned int row = size + 1;
+	bool ok = true;
+
+	for (unsigned int y = 0; y < row && ok; y++)
+	{
+		text.clear();
+		for (unsigned int x = 0; x < row; x++)
+		{
+			snprintf(line, sizeof(line), "v %f %f %f\n", (float)x, (float)y, 0.0f);
+			text += line;
+		}
+		ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+	}
+
+	for (unsigned int y = 0; y < row && ok; y++)
+	{
+		text.clear();
+		for (unsigned int x = 0; x < row; x++)
+		{
+			snprintf(line, sizeof(line), "vt %f %f\n", x / (float)size, y / (float)size);
+			text += line;
+		}
+		ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+	}
+
+	text = "vn 0 0 1\n";
+	ok = ok && fwrite(text.data(), 1, text.size(), file) == text.size();
+
+	for (unsigned int y = 0; y < size && ok; y++)
+	{
+		text.clear();
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x + 1;
+			snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1 %u/%u/1\n",
+				v, v, v + 1, v + 1, v + row + 1, v + row + 1, v + row, v + row);
+			text += line;
+		}
+		ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+	}
+
+	long long fileSize = ftell(file);
+	ok = (fclose(file) == 0) && ok && fileSize > 0;
+	return ok ? (unsigned long long)fileSize : 0;
+}
+
+// --------------------------------------------------------
+// Watches the resident set from another thread, and keeps
+// the most it grew past where it was when sampling started
+// --------------------------------------------------------
+class ResidentPeakSampler
+{
+public:
+	ResidentPeakSampler()
+	{
+		baseline = GetResidentBytes();
+		peak = baseline;
+		running = true;
+		sampler = std::thread(&ResidentPeakSampler::Sample, this);
+	}
+
+	size_t Stop()
+	{
+		running = false;
+		sampler.join();
+		size_t resident = GetResidentBytes();
+		if (resident > peak) peak = resident;
+		return peak - baseline;
+	}
+
+private:
+	size_t baseline;
+	std::atomic<size_t> peak;
+	std::atomic<bool> running;
+	std::thread sampler;
+
+	void Sample()
+	{
+		while (running)
+		{
+			size_t resident = GetResidentBytes();
+			if (resident > peak) peak = resident;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+};
+
+// --------------------------------------------------------
+// Big blocks go straight back to the OS when they're freed
+// (glibc otherwise raises its mmap threshold after the first
+// one, and keeps later blocks in the heap where the resident
+// set can't see them being reused)
+// --------------------------------------------------------
+static void ReturnFreedBlocksToSystem()
+{
+#if defined(__GLIBC__)
+	mallopt(M_MMAP_THRESHOLD, 256 * 1024);
+#endif
+}
+
+static bool ReadGridStreaming(const std::string& path, size_t budget, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	ObjReader reader;
+	return reader.ReadStreaming(path.c_str(), verts, indices, budget);
+}
+
+TEST(ObjReaderStreamingStaysUnderBudget)
+{
+	ReturnFreedBlocksToSystem();
+
+	// 513 x 513 vertices is just past a power of two, so the weld
+	// table is as big as it gets (close to four slots a vertex)
+	unsigned int size = 512;
+	unsigned int vertexCount = (size + 1) * (size + 1);
+	std::string path = GetTempTestFile("stream_grid.obj");
+	unsigned long long fileSize = WriteGridObjFile(path, size);
+	CHECK(fileSize > 0);
+
+	// Find the smallest budget the reader takes on (64KB either way).
+	// Refusing happens before anything is allocated
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	size_t refused = (size_t)(fileSize / 8);
+	size_t accepted = (size_t)(fileSize * 2);
+	CHECK(!ReadGridStreaming(path, refused, verts, indices));
+	CHECK(verts.empty() && indices.empty());
+	while (accepted - refused > 64 * 1024)
+	{
+		size_t budget = refused + (accepted - refused) / 2;
+		if (ReadGridStreaming(path, budget, verts, indices))
+			accepted = budget;
+		else
+			refused = budget;
+		std::vector<Vertex>().swap(verts);
+		std::vector<unsigned int>().swap(indices);
+	}
+
+	// With the tightest budget it accepts, the whole import (window
+	// and output included) has to stay inside it.  The slack covers
+	// the view's alignment and the sampler itself
+	ResidentPeakSampler sampler;
+	bool read = ReadGridStreaming(path, accepted, verts, indices);
+	size_t peak = sampler.Stop();
+	CHECK(read);
+	CHECK(peak <= accepted + 512 * 1024);
+	CHECK(verts.size() == vertexCount);
+	CHECK(indices.size() == size * size * 6);
+
+	remove(path.c_str());
+}
+
+BENCHMARK(ObjReaderStreamLargeFile)
+{
+	ReturnFreedBlocksToSystem();
+
+	// A grid vertex (with its uv and its share of the faces) is
+	// about 120 bytes of text
+	unsigned long long megabytes = GetBenchmarkParameter("megabytes", 2048);
+	unsigned int size = (unsigned int)sqrt(megabytes * 1024.0 * 1024.0 / 120.0);
+	std::string path = GetTempTestFile("stream_large.obj");
+
+	double start = TestSeconds();
+	unsigned long long fileSize = WriteGridObjFile(path, size);
+	if (fileSize == 0)
+	{
+		printf("  couldn't write %s\n", path.c_str());
+		return;
+	}
+	printf("  %u x %u grid, %.1f MB written in %.1f s\n", size, size, fileSize / 1048576.0, TestSeconds() - start);
+
+	// The cap is the size of the file unless --budget (in MB) says otherwise
+	size_t budget = (size_t)(GetBenchmarkParameter("budget", fileSize / 1048576) * 1048576);
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	start = TestSeconds();
+	ResidentPeakSampler sampler;
+	bool read = ReadGridStreaming(path, budget, verts, indices);
+	size_t peak = sampler.Stop();
+	double seconds = TestSeconds() - start;
+
+	printf("  %s under a %.1f MB budget: %.2f s (%.1f MB/s), resident set grew %.1f MB, %u verts %u indices\n",
+		read ? "read" : "refused", budget / 1048576.0, seconds, fileSize / 1048576.0 / seconds,
+		peak / 1048576.0, (unsigned int)verts.size(), (unsigned int)indices.size());
+
+	remove(path.c_str());
+}
@@ -0,0 +1,569 @@
+#include "Test.h"
+#include "ObjReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+// A quad, as two triangles sharing an edge
+static const char* quadObj =
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 1 1 0\n"
+	"v 0 1 0\n"
+	"vt 0 0\n"
+	"vt 1 0\n"
+	"vt 1 1\n"
+	"vt 0 1\n"
+	"vn 0 0 1\n"
+	"f 1/1/1 2/2/1 3/3/1\n"
+	"f 1/1/1 3/3/1 4/4/1\n";
+
+// The same quad, every face index counting back from the end
+static const char* relativeQuadObj =
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 1 1 0\n"
+	"v 0 1 0\n"
+	"vt 0 0\n"
+	"vt 1 0\n"
+	"vt 1 1\n"
+	"vt 0 1\n"
+	"vn 0 0 1\n"
+	"f -4/-4/-1 -3/-3/-1 -2/-2/-1\n"
+	"f -4/-4/-1 -2/-2/-1 -1/-1/-1\n";
+
+// --------------------------------------------------------
+// A size x size grid of quads, each with its own corners
+// written out (as exporters of unwelded meshes do), so the
+// attribute and face lines are interleaved all the way down
+// --------------------------------------------------------
+static std::string MakeGridObj(unsigned int size, bool relative)
+{
+	std::string text;
+	char line[128];
+	unsigned int written = 0;
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			static const unsigned int cornerX[4] = { 0, 1, 1, 0 };
+			static const unsigned int cornerY[4] = { 0, 0, 1, 1 };
+			for (int c = 0; c < 4; c++)
+			{
+				snprintf(line, sizeof(line), "v %u %u 0\nvt %g %g\n",
+					x + cornerX[c], y + cornerY[c], (float)cornerX[c], (float)cornerY[c]);
+				text += line;
+			}
+			text += "vn 0 0 1\n";
+
+			if (relative)
+				snprintf(line, sizeof(line), "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n");
+			else
+				snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n",
+					written + 1, written + 1, y * size + x + 1,
+					written + 2, written + 2, y * size + x + 1,
+					written + 3, written + 3, y * size + x + 1,
+					written + 4, written + 4, y * size + x + 1);
+			text += line;
+			written += 4;
+		}
+	}
+	return text;
+}
+
+static void ParseText(ObjReader& reader, const char* text, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	reader.Parse(text, text + strlen(text), verts, indices);
+}
+
+static bool SameMesh(const std::vector<Vertex>& vertsA, const std::vector<unsigned int>& indicesA,
+	const std::vector<Vertex>& vertsB, const std::vector<unsigned int>& indicesB)
+{
+	return
+		vertsA.size() == vertsB.size() &&
+		indicesA == indicesB &&
+		(vertsA.empty() || memcmp(&vertsA[0], &vertsB[0], vertsA.size() * sizeof(Vertex)) == 0);
+}
+
+static bool WriteTextFile(const std::string& path, const char* text)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	fwrite(text, 1, strlen(text), file);
+	fclose(file);
+	return true;
+}
+
+TEST(ObjReaderCanBeReused)
+{
+	// Another mesh first, whose attributes would shift the quad's
+	// indices, and whose vertices are still in the output vectors
+	const char* triangleObj =
+		"v 5 5 5\n"
+		"v 6 5 5\n"
+		"v 6 6 5\n"
+		"f 1 2 3\n";
+
+	std::vector<Vertex> freshVerts, reusedVerts;
+	std::vector<unsigned int> freshIndices, reusedIndices;
+	ObjReader fresh;
+	ParseText(fresh, quadObj, freshVerts, freshIndices);
+
+	ObjReader reused;
+	ParseText(reused, triangleObj, reusedVerts, reusedIndices);
+	CHECK(reusedVerts.size() == 3);
+	ParseText(reused, quadObj, reusedVerts, reusedIndices);
+	CHECK(SameMesh(freshVerts, freshIndices, reusedVerts, reusedIndices));
+	CHECK(reusedVerts.size() == 4);
+	CHECK(reusedIndices.size() == 6);
+}
+
+TEST(ObjReaderResolvesNegativeIndices)
+{
+	ObjReader reader;
+	std::vector<Vertex> verts, relativeVerts;
+	std::vector<unsigned int> indices, relativeIndices;
+	ParseText(reader, quadObj, verts, indices);
+	ParseText(reader, relativeQuadObj, relativeVerts, relativeIndices);
+	CHECK(relativeIndices.size() == 6);
+	CHECK(SameMesh(verts, indices, relativeVerts, relativeIndices));
+
+	// Relative to the attributes before the face, not the whole file
+	const char* interleavedObj =
+		"v 0 0 0\n"
+		"v 1 0 0\n"
+		"v 1 1 0\n"
+		"f -3 -2 -1\n"
+		"v 5 5 5\n"
+		"f -4 -3 -2\n";
+	ParseText(reader, interleavedObj, verts, indices);
+	CHECK(indices.size() == 6);
+	CHECK(verts.size() == 3);
+
+	// Reaching back past the first attribute drops the face
+	const char* badObj =
+		"v 0 0 0\n"
+		"v 1 0 0\n"
+		"v 1 1 0\n"
+		"f -4 -2 -1\n"
+		"f 1 2 3\n";
+	ParseText(reader, badObj, verts, indices);
+	CHECK(indices.size() == 3);
+
+	// And the same when the file's split across threads
+	std::string grid = MakeGridObj(200, false);
+	std::string relativeGrid = MakeGridObj(200, true);
+	std::vector<Vertex> threadedVerts;
+	std::vector<unsigned int> threadedIndices;
+	ParseText(reader, grid.c_str(), verts, indices);
+	reader.Parse(relativeGrid.c_str(), relativeGrid.c_str() + relativeGrid.size(), threadedVerts, threadedIndices, 4);
+	CHECK(indices.size() == 200 * 200 * 6);
+	CHECK(SameMesh(verts, indices, threadedVerts, threadedIndices));
+
+	// Streamed reads resolve them the same way
+	std::string path = GetTempTestFile("relative.obj");
+	CHECK(WriteTextFile(path, relativeQuadObj));
+	std::vector<Vertex> streamedVerts;
+	std::vector<unsigned int> streamedIndices;
+	CHECK(reader.ReadStreaming(path.c_str(), streamedVerts, streamedIndices, 64 * 1024 * 1024));
+	ParseText(reader, quadObj, verts, indices);
+	CHECK(SameMesh(verts, indices, streamedVerts, streamedIndices));
+	remove(path.c_str());
+}
+
+// --------------------------------------------------------
+// Reads an OBJ file the slow, obvious way - every face
+// corner becomes a vertex of its own, converted the same
+// way ObjReader does (Z and V flipped, winding reversed)
+// --------------------------------------------------------
+static bool ReadUnweldedCorners(const std::string& path, std::vector<Vertex>& corners)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file)
+		return false;
+
+	std::vector<XMFLOAT3> positions, normals;
+	std::vector<XMFLOAT2> uvs;
+	char line[1024];
+	while (fgets(line, sizeof(line), file))
+	{
+		XMFLOAT3 v;
+		if (strncmp(line, "v ", 2) == 0 && sscanf(line + 2, "%f %f %f", &v.x, &v.y, &v.z) == 3)
+			positions.push_back(v);
+		else if (strncmp(line, "vn ", 3) == 0 && sscanf(line + 3, "%f %f %f", &v.x, &v.y, &v.z) == 3)
+			normals.push_back(v);
+		else if (strncmp(line, "vt ", 3) == 0 && sscanf(line + 3, "%f %f", &v.x, &v.y) == 2)
+			uvs.push_back(XMFLOAT2(v.x, v.y));
+		else if (strncmp(line, "f ", 2) == 0)
+		{
+			std::vector<Vertex> face;
+			char* token = strtok(line + 2, " \t\r\n");
+			for (; token; token = strtok(0, " \t\r\n"))
+			{
+				int p = 0, t = 0, n = 0;
+				if (sscanf(token, "%d/%d/%d", &p, &t, &n) != 3 &&
+					sscanf(token, "%d//%d", &p, &n) != 2)
+					sscanf(token, "%d/%d", &p, &t);
+
+				Vertex corner = {};
+				corner.Position = positions[p - 1];
+				corner.UV = t ? uvs[t - 1] : XMFLOAT2(0, 0);
+				corner.Normal = n ? normals[n - 1] : XMFLOAT3(0, 0, 0);
+				corner.UV.y = 1.0f - corner.UV.y;
+				corner.Position.z *= -1.0f;
+				corner.Normal.z *= -1.0f;
+				face.push_back(corner);
+			}
+
+			for (size_t i = 2; i < face.size(); i++)
+			{
+				corners.push_back(face[0]);
+				corners.push_back(face[i]);
+				corners.push_back(face[i - 1]);
+			}
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+static bool SameCorner(const Vertex& a, const Vertex& b)
+{
+	return
+		memcmp(&a.Position, &b.Position, sizeof(a.Position)) == 0 &&
+		memcmp(&a.UV, &b.UV, sizeof(a.UV)) == 0 &&
+		memcmp(&a.Normal, &b.Normal, sizeof(a.Normal)) == 0;
+}
+
+// --------------------------------------------------------
+// Checks a welded mesh draws exactly the triangles of the
+// unwelded one, in the same order
+// --------------------------------------------------------
+static bool SameTriangles(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, const std::vector<Vertex>& corners)
+{
+	if (indices.size() != corners.size())
+		return false;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] >= verts.size() || !SameCorner(verts[indices[i]], corners[i]))
+			return false;
+	}
+	return true;
+}
+
+TEST(ObjReaderWeldsSharedCorners)
+{
+	// Distinct position/uv/normal combinations, and corners
+	struct WeldCase { const char* File; size_t Vertices; size_t Indices; };
+	static const WeldCase cases[] =
+	{
+		{ "cube.obj", 24, 72 },
+		{ "sphere.obj", 401, 4560 },
+		{ "torus.obj", 441, 2400 },
+	};
+
+	for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		std::string path = FindTestFile(cases[c].File);
+		std::vector<Vertex> corners;
+		CHECK(ReadUnweldedCorners(path, corners));
+		CHECK(corners.size() == cases[c].Indices);
+
+		// Every way of reading welds the same
+		ObjReader reader;
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		CHECK(reader.Read(path.c_str(), verts, indices, 1));
+		CHECK(verts.size() == cases[c].Vertices);
+		CHECK(indices.size() == cases[c].Indices);
+		CHECK(SameTriangles(verts, indices, corners));
+
+		std::vector<Vertex> threadedVerts;
+		std::vector<unsigned int> threadedIndices;
+		CHECK(reader.Read(path.c_str(), threadedVerts, threadedIndices, 0));
+		CHECK(SameMesh(verts, indices, threadedVerts, threadedIndices));
+
+		std::vector<Vertex> streamedVerts;
+		std::vector<unsigned int> streamedIndices;
+		CHECK(reader.ReadStreaming(path.c_str(), streamedVerts, streamedIndices, 64 * 1024 * 1024));
+		CHECK(SameMesh(verts, indices, streamedVerts, streamedIndices));
+	}
+}
+
+// --------------------------------------------------------
+// The loader Mesh used before ObjReader: getline and sscanf
+// on every line, and a vertex for every face corner
+// --------------------------------------------------------
+static bool ReadWithOldLoader(const std::string& path, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	std::ifstream obj(path);
+	if (!obj.is_open())
+		return false;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	unsigned int vertCounter = 0;
+	char chars[100];
+	verts.clear();
+	indices.clear();
+
+	while (obj.good())
+	{
+		obj.getline(chars, 100);
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			sscanf(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			XMFLOAT2 uv;
+			sscanf(chars, "vt %f %f", &uv.x, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			XMFLOAT3 pos;
+			sscanf(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			unsigned int i[12];
+			int facesRead = sscanf(chars, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u",
+				&i[0], &i[1], &i[2], &i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8], &i[9], &i[10], &i[11]);
+
+			// Flip the UVs, Z and the winding order, as ObjReader does
+			Vertex v[4] = {};
+			for (int c = 0; c < facesRead / 3; c++)
+			{
+				v[c].Position = positions[i[c * 3] - 1];
+				v[c].UV = uvs[i[c * 3 + 1] - 1];
+				v[c].Normal = normals[i[c * 3 + 2] - 1];
+				v[c].UV.y = 1.0f - v[c].UV.y;
+				v[c].Position.z *= -1.0f;
+				v[c].Normal.z *= -1.0f;
+			}
+
+			verts.push_back(v[0]);
+			verts.push_back(v[2]);
+			verts.push_back(v[1]);
+			if (facesRead == 12)
+			{
+				verts.push_back(v[0]);
+				verts.push_back(v[3]);
+				verts.push_back(v[2]);
+			}
+			while (vertCounter < verts.size())
+				indices.push_back(vertCounter++);
+		}
+	}
+	return true;
+}
+
+// The OBJs bundled in "OBJ Files", for --obj
+static const char* bundledObjs[] = { "cone.obj", "cube.obj", "cylinder.obj", "helix.obj", "sphere.obj", "torus.obj" };
+
+static bool ReadTextFile(const std::string& path, std::string& text)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	char buffer[65536];
+	size_t read;
+	text.clear();
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text.append(buffer, read);
+	fclose(file);
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies of an OBJ one after another, as one bigger file.
+// Each copy is moved along x (so the welder can't merge it
+// with the others) and its face indices are shifted past
+// the attributes of the copies before it
+// --------------------------------------------------------
+static std::string ReplicateObj(const std::string& text, unsigned int copies)
+{
+	// Attributes one copy adds - v, vt, vn, in face index order
+	unsigned int counts[3] = {};
+	for (size_t start = 0; start < text.size(); )
+	{
+		if (text.compare(start, 2, "v ") == 0) counts[0]++;
+		else if (text.compare(start, 3, "vt ") == 0) counts[1]++;
+		else if (text.compare(start, 3, "vn ") == 0) counts[2]++;
+		size_t end = text.find('\n', start);
+		start = end == std::string::npos ? text.size() : end + 1;
+	}
+
+	std::string result;
+	result.reserve(text.size() * copies + copies);
+	char number[64];
+	for (unsigned int k = 0; k < copies; k++)
+	{
+		size_t start = 0;
+		while (start < text.size())
+		{
+			size_t end = text.find('\n', start);
+			if (end == std::string::npos)
+				end = text.size();
+			std::string line = text.substr(start, end - start);
+			start = end + 1;
+
+			float x, y, z;
+			if (k > 0 && line.compare(0, 2, "v ") == 0 && sscanf(line.c_str() + 2, "%f %f %f", &x, &y, &z) == 3)
+			{
+				snprintf(number, sizeof(number), "v %f %f %f", x + k * 100.0f, y, z);
+				result += number;
+			}
+			else if (k > 0 && line.compare(0, 2, "f ") == 0)
+			{
+				// Rewrite each p/t/n corner (negative indices are already relative)
+				result += "f";
+				for (char* corner = strtok(&line[2], " \t\r"); corner; corner = strtok(0, " \t\r"))
+				{
+					result += ' ';
+					int field = 0;
+					for (char* c = corner; ; field++)
+					{
+						char* slash = strchr(c, '/');
+						if (slash)
+							*slash = 0;
+						if (*c)
+						{
+							int index = atoi(c);
+							snprintf(number, sizeof(number), "%d", index > 0 ? index + (int)(counts[field] * k) : index);
+							result += number;
+						}
+						if (!slash || field == 2)
+							break;
+						result += '/';
+						c = slash + 1;
+					}
+				}
+			}
+			else
+				result += line;
+			result += '\n';
+		}
+	}
+	return result;
+}
+
+// --------------------------------------------------------
+// Parse speed on 1, 2, 4, ... threads, up to all of them
+//
+// --grid=N     - Parse an N x N unwelded grid (the default)
+// --obj=N      - Parse bundledObjs[N - 1] instead, repeated
+//                --copies times
+// --threads=N  - Most threads to try
+//
+// Then reads each bundled file from disk with ObjReader and
+// with the old loader (best of --runs), to compare the two
+// --------------------------------------------------------
+BENCHMARK(ObjReaderParse)
+{
+	unsigned int gridSize = (unsigned int)GetBenchmarkParameter("grid", 300);
+	unsigned int obj = (unsigned int)GetBenchmarkParameter("obj", 0);
+	unsigned int copies = (unsigned int)GetBenchmarkParameter("copies", 32);
+	unsigned int maxThreads = (unsigned int)GetBenchmarkParameter("threads", std::thread::hardware_concurrency());
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	std::string text;
+	std::string source;
+	if (obj == 0)
+	{
+		text = MakeGridObj(gridSize, false);
+		printf("  %u x %u grid", gridSize, gridSize);
+	}
+	else if (obj <= sizeof(bundledObjs) / sizeof(bundledObjs[0]) &&
+		ReadTextFile(FindTestFile(bundledObjs[obj - 1]), source))
+	{
+		text = ReplicateObj(source, copies);
+		printf("  %s x %u", bundledObjs[obj - 1], copies);
+	}
+	else
+	{
+		printf("  --obj=%u not found\n", obj);
+		return;
+	}
+	printf(", %.1f MB\n", text.size() / 1048576.0);
+
+	ObjReader reader;
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	double oneThreadSeconds = 0.0;
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		double start = TestSeconds();
+		reader.Parse(text.c_str(), text.c_str() + text.size(), verts, indices, threads);
+		double seconds = TestSeconds() - start;
+		if (threads == 1)
+			oneThreadSeconds = seconds;
+
+		printf("  %2u threads: %8.1f ms (%5.0f MB/s, %.2fx), %u verts welded from %u corners\n",
+			threads, seconds * 1000.0, text.size() / 1048576.0 / seconds, oneThreadSeconds / seconds,
+			(unsigned int)verts.size(), (unsigned int)indices.size());
+		if (threads == maxThreads)
+			break;
+	}
+
+	unsigned int runs = (unsigned int)GetBenchmarkParameter("runs", 10);
+	double oldTotal = 0.0;
+	double newTotal = 0.0;
+	size_t bytesTotal = 0;
+	for (size_t f = 0; f < sizeof(bundledObjs) / sizeof(bundledObjs[0]); f++)
+	{
+		std::string path = FindTestFile(bundledObjs[f]);
+		if (!ReadTextFile(path, source))
+		{
+			printf("  %-12s not found\n", bundledObjs[f]);
+			continue;
+		}
+
+		double oldSeconds = 1e30;
+		double newSeconds = 1e30;
+		std::vector<Vertex> oldVerts;
+		std::vector<unsigned int> oldIndices;
+		for (unsigned int r = 0; r < runs; r++)
+		{
+			double start = TestSeconds();
+			ReadWithOldLoader(path, oldVerts, oldIndices);
+			oldSeconds = std::min(oldSeconds, TestSeconds() - start);
+
+			start = TestSeconds();
+			reader.Read(path.c_str(), verts, indices);
+			newSeconds = std::min(newSeconds, TestSeconds() - start);
+		}
+
+		// Both made the same triangles (the old loader's are unwelded)
+		CHECK(SameTriangles(verts, indices, oldVerts));
+
+		double megabytes = source.size() / 1048576.0;
+		printf("  %-12s %7.1f KB: old loader %6.0f MB/s, ObjReader %6.0f MB/s (%.1fx)\n",
+			bundledObjs[f], source.size() / 1024.0, megabytes / oldSeconds, megabytes / newSeconds, oldSeconds / newSeconds);
+		oldTotal += oldSeconds;
+		newTotal += newSeconds;
+		bytesTotal += source.size();
+	}
+	if (bytesTotal > 0)
+	{
+		printf("  all files    %7.1f KB: old loader %6.0f MB/s, ObjReader %6.0f MB/s (%.1fx)\n",
+			bytesTotal / 1024.0, bytesTotal / 1048576.0 / oldTotal, bytesTotal / 1048576.0 / newTotal, oldTotal / newTotal);
+	}
+}
@@ -0,0 +1,142 @@
+#include "Test.h"
+#include "TestScene.h"
+#include "RenderQueue.h"
+#include "RenderBackend.h"
+
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// A synthetic scene: materials spread over a few shader
+// pairs, and meshes.  Entity i uses material i % materials
+// and mesh i / materials % meshes, so in submission order
+// every draw changes all three
+// --------------------------------------------------------
+struct TestRenderScene
+{
+	std::vector<SimpleVertexShader*> VertexShaders;
+	std::vector<SimplePixelShader*> PixelShaders;
+	std::vector<Material*> Materials;
+	std::vector<Mesh*> Meshes;
+
+	TestRenderScene(unsigned int shaderCount, unsigned int materialCount, unsigned int meshCount)
+	{
+		for (unsigned int s = 0; s < shaderCount; s++)
+		{
+			VertexShaders.push_back(new SimpleVertexShader(0, 0));
+			PixelShaders.push_back(new SimplePixelShader(0, 0));
+		}
+		for (unsigned int m = 0; m < materialCount; m++)
+			Materials.push_back(new Material(VertexShaders[m % shaderCount], PixelShaders[m % shaderCount], 0, 0, 0));
+		for (unsigned int m = 0; m < meshCount; m++)
+			Meshes.push_back(CreateTestMesh());
+	}
+
+	~TestRenderScene()
+	{
+		for (size_t m = 0; m < Materials.size(); m++)
+			delete Materials[m];
+		for (size_t s = 0; s < VertexShaders.size(); s++)
+		{
+			delete VertexShaders[s];
+			delete PixelShaders[s];
+		}
+		for (size_t m = 0; m < Meshes.size(); m++)
+			delete Meshes[m];
+	}
+
+	// Queues entityCount opaque draws, at depths that don't follow the state
+	void Submit(RenderQueue& queue, unsigned int entityCount)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixIdentity());
+		queue.Clear();
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			Material* material = Materials[i % Materials.size()];
+			Mesh* mesh = Meshes[i / Materials.size() % Meshes.size()];
+			float depth = (float)((i * 7919) % 1000);
+			queue.Submit(queue.MakeKey(0, false, material, mesh, depth), material, mesh, world, world);
+			queue.AddRange(0, 6);
+		}
+	}
+};
+
+TEST(RenderQueueSortsAwayStateChanges)
+{
+	unsigned int shaderCount = 3;
+	unsigned int materialCount = 12;
+	unsigned int meshCount = 4;
+	unsigned int entityCount = 1200;
+	TestRenderScene scene(shaderCount, materialCount, meshCount);
+	RenderQueue queue(1000.0f);
+	CountingRenderBackend backend(0);
+
+	// As submitted, every draw binds everything again
+	scene.Submit(queue, entityCount);
+	queue.Execute(&backend);
+	RenderBackendStats unsorted = backend.GetStats();
+	CHECK(unsorted.Draws == entityCount);
+	CHECK(unsorted.ShaderBinds == entityCount);
+	CHECK(unsorted.MaterialBinds == entityCount);
+	CHECK(unsorted.MeshBinds == entityCount);
+
+	// Sorted, each shader pair and material is bound once, and each
+	// mesh once per material that uses it
+	scene.Submit(queue, entityCount);
+	queue.Sort();
+	backend.ResetStats();
+	queue.Execute(&backend);
+	RenderBackendStats sorted = backend.GetStats();
+	CHECK(sorted.Draws == entityCount);
+	CHECK(sorted.ObjectUpdates == entityCount);
+	CHECK(sorted.ShaderBinds == shaderCount);
+	CHECK(sorted.MaterialBinds == materialCount);
+	CHECK(sorted.MeshBinds == materialCount * meshCount);
+
+	// And within the same state, nearer draws go first
+	bool ordered = true;
+	for (unsigned int c = 1; c < queue.GetCommandCount(); c++)
+		ordered = ordered && queue.GetKey(c - 1) <= queue.GetKey(c);
+	CHECK(ordered);
+}
+
+BENCHMARK(RenderQueueStateChanges)
+{
+	unsigned int entityCount = (unsigned int)GetBenchmarkParameter("entities", 100000);
+	unsigned int materialCount = (unsigned int)GetBenchmarkParameter("materials", 256);
+	unsigned int shaderCount = (unsigned int)GetBenchmarkParameter("shaders", 16);
+	unsigned int meshCount = (unsigned int)GetBenchmarkParameter("meshes", 32);
+	unsigned int frames = (unsigned int)GetBenchmarkParameter("frames", 10);
+	TestRenderScene scene(shaderCount, materialCount, meshCount);
+	RenderQueue queue(1000.0f);
+	CountingRenderBackend backend(0);
+
+	double start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		backend.ResetStats();
+		scene.Submit(queue, entityCount);
+		queue.Execute(&backend);
+	}
+	double unsortedSeconds = (TestSeconds() - start) / frames;
+	RenderBackendStats unsorted = backend.GetStats();
+
+	start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		backend.ResetStats();
+		scene.Submit(queue, entityCount);
+		queue.Sort();
+		queue.Execute(&backend);
+	}
+	double sortedSeconds = (TestSeconds() - start) / frames;
+	RenderBackendStats sorted = backend.GetStats();
+
+	printf("  %u entities, %u materials over %u shaders, %u meshes\n", entityCount, materialCount, shaderCount, meshCount);
+	printf("  unsorted: %8.3f ms a frame, %7u shader, %7u material, %7u mesh binds\n",
+		unsortedSeconds * 1000.0, unsorted.ShaderBinds, unsorted.MaterialBinds, unsorted.MeshBinds);
+	printf("  sorted:   %8.3f ms a frame, %7u shader, %7u material, %7u mesh binds\n",
+		sortedSeconds * 1000.0, sorted.ShaderBinds, sorted.MaterialBinds, sorted.MeshBinds);
+}
@@ -0,0 +1,119 @@
+#include "Test.h"
+#include "RingAllocator.h"
+
+TEST(RingAllocatorAlignsAndRefusesToOverrun)
+{
+	// Capacity rounds down to whole aligned pieces
+	RingAllocator rounded(1000, 256, 2);
+	CHECK(rounded.GetCapacity() == 768);
+
+	RingAllocator ring(1024, 256, 2);
+	unsigned int offset = 99;
+	CHECK(!ring.Allocate(0, &offset));
+	CHECK(!ring.Allocate(1025, &offset));
+	CHECK(offset == 99);
+
+	// Sizes round up to the alignment, and offsets follow on
+	CHECK(ring.Allocate(1, &offset) && offset == 0);
+	CHECK(ring.GetUsed() == 256);
+	CHECK(ring.Allocate(300, &offset) && offset == 256);
+	CHECK(ring.GetUsed() == 768);
+
+	// 512 more won't fit before the end, and wrapping to the start
+	// would land on bytes still in use, so nothing is taken
+	CHECK(!ring.Allocate(512, &offset));
+	CHECK(ring.GetUsed() == 768);
+
+	// Fencing stops at maxFrames, and doesn't lose the unfenced bytes
+	CHECK(ring.EndFrame());
+	CHECK(ring.Allocate(256, &offset) && offset == 768);
+	CHECK(ring.EndFrame());
+	CHECK(!ring.Allocate(1, &offset));
+	CHECK(!ring.EndFrame());
+	CHECK(ring.GetFencedFrameCount() == 2);
+
+	// Retiring frees the oldest frame, and only it
+	CHECK(ring.RetireFrame());
+	CHECK(ring.GetFencedFrameCount() == 1);
+	CHECK(ring.GetUsed() == 256);
+	CHECK(ring.Allocate(768, &offset) && offset == 0);
+	CHECK(!ring.Allocate(1, &offset));
+
+	CHECK(ring.EndFrame());
+	CHECK(ring.RetireFrame());
+	CHECK(ring.RetireFrame());
+	CHECK(!ring.RetireFrame());
+	CHECK(ring.GetUsed() == 0);
+}
+
+TEST(RingAllocatorWrapsWithPadding)
+{
+	RingAllocator ring(1024, 256, 4);
+	unsigned int offset;
+	CHECK(ring.Allocate(512, &offset) && offset == 0);
+	CHECK(ring.EndFrame());
+	CHECK(ring.Allocate(256, &offset) && offset == 512);
+	CHECK(ring.EndFrame());
+	CHECK(ring.RetireFrame());
+	CHECK(ring.GetUsed() == 256);
+
+	// The head is at 768, and 512 won't fit before the end.  It goes
+	// at the start, and the 256 skipped at the end count as used
+	// (and belong to this frame) until it's retired
+	CHECK(ring.Allocate(512, &offset) && offset == 0);
+	CHECK(ring.GetUsed() == 1024);
+	CHECK(!ring.Allocate(1, &offset));
+	CHECK(ring.EndFrame());
+
+	// The frame at 512 goes first, then the wrapped one with its padding
+	CHECK(ring.RetireFrame());
+	CHECK(ring.GetUsed() == 768);
+	CHECK(ring.Allocate(256, &offset) && offset == 512);
+	CHECK(ring.RetireFrame());
+	CHECK(ring.GetUsed() == 256);
+	CHECK(ring.EndFrame());
+	CHECK(ring.RetireFrame());
+	CHECK(ring.GetUsed() == 0);
+
+	// Nothing live, so the next piece starts over at 0
+	CHECK(ring.Allocate(256, &offset) && offset == 0);
+}
+
+// --------------------------------------------------------
+// Allocations a frame (of cbuffer sized pieces) with the
+// GPU a couple of frames behind, the way ConstantBufferRing
+// drives it
+// --------------------------------------------------------
+BENCHMARK(RingAllocatorAllocationRate)
+{
+	unsigned int perFrame = (unsigned int)GetBenchmarkParameter("allocations", 10000);
+	unsigned int frames = (unsigned int)GetBenchmarkParameter("frames", 100);
+	unsigned int latency = 2;
+	RingAllocator ring(perFrame * 512 * (latency + 1), 256, latency + 1);
+
+	unsigned int allocated = 0;
+	unsigned int refused = 0;
+	unsigned long long offsetSum = 0;
+	double start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		for (unsigned int i = 0; i < perFrame; i++)
+		{
+			unsigned int offset;
+			if (ring.Allocate(64 + (i % 7) * 64, &offset))
+			{
+				allocated++;
+				offsetSum += offset;
+			}
+			else
+				refused++;
+		}
+		if (ring.GetFencedFrameCount() == latency + 1)
+			ring.RetireFrame();
+		ring.EndFrame();
+	}
+	double seconds = TestSeconds() - start;
+
+	printf("  %u allocations in %.3f ms: %.1f ns each, %u refused (offset sum %llu)\n",
+		allocated + refused, seconds * 1000.0, seconds * 1e9 / (allocated + refused), refused, offsetSum);
+}
@@ -0,0 +1,178 @@
+#include "Test.h"
+#include "TestDevice.h"
+#include "ShaderNameTable.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// "lights[0].color" style names, all longer than one word
+static std::vector<std::string> MakeLongNames(unsigned int count)
+{
+	std::vector<std::string> names;
+	for (unsigned int i = 0; i < count; i++)
+		names.push_back("pointLights[" + std::to_string(i) + "].colorAndIntensity");
+	return names;
+}
+
+TEST(ShaderNameTableRefusesSharedHashes)
+{
+	// Worked out by the compiler or at run time, long or short, it's the same hash
+	CHECK(SHADER_NAME("world") == HashShaderName(std::string("world")));
+	CHECK(SHADER_NAME("pointLights[12].colorAndIntensity") == HashShaderName(std::string("pointLights[12].colorAndIntensity")));
+	CHECK(HashShaderName(std::string("")) != HashShaderName(std::string("a")));
+
+	// A second name with the same hash is refused, and the first kept
+	ShaderNameTable table;
+	CHECK(table.Insert(SHADER_NAME("world"), 3));
+	CHECK(!table.Insert(SHADER_NAME("world"), 4));
+	CHECK(table.Find(SHADER_NAME("world")) == 3);
+	CHECK(table.GetCount() == 1);
+
+	// Lots of long names that only differ in the middle all go in,
+	// and come back out, across the table growing
+	std::vector<std::string> names = MakeLongNames(2000);
+	bool inserted = true;
+	for (unsigned int i = 0; i < (unsigned int)names.size(); i++)
+		inserted = inserted && table.Insert(HashShaderName(names[i]), i);
+	CHECK(inserted);
+	bool found = true;
+	for (unsigned int i = 0; i < (unsigned int)names.size(); i++)
+		found = found && table.Find(HashShaderName(names[i])) == i;
+	CHECK(found);
+	CHECK(table.Find(SHADER_NAME("pointLights[2000].colorAndIntensity")) == SHADER_NAME_NONE);
+	CHECK(table.GetCount() == names.size() + 1);
+}
+
+// --------------------------------------------------------
+// An allocator that counts what's live, for the footprint
+// of the std::unordered_map the table replaced
+// --------------------------------------------------------
+static size_t countedBytes = 0;
+
+template<typename T>
+struct CountingAllocator
+{
+	typedef T value_type;
+	CountingAllocator() {}
+	template<typename U> CountingAllocator(const CountingAllocator<U>&) {}
+	T* allocate(size_t n) { countedBytes += n * sizeof(T); return (T*)::operator new(n * sizeof(T)); }
+	void deallocate(T* p, size_t n) { countedBytes -= n * sizeof(T); ::operator delete(p); }
+};
+
+template<typename T, typename U> bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) { return true; }
+template<typename T, typename U> bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) { return false; }
+
+typedef std::unordered_map<std::string, unsigned int, std::hash<std::string>, std::equal_to<std::string>,
+	CountingAllocator<std::pair<const std::string, unsigned int>>> CountedNameMap;
+
+// Bytes a string holds outside itself (none for short ones)
+static size_t StringHeapBytes(const std::string& s)
+{
+	const char* data = s.data();
+	bool inside = data >= (const char*)&s && data < (const char*)(&s + 1);
+	return inside ? 0 : s.capacity() + 1;
+}
+
+// --------------------------------------------------------
+// Looking up the variables of a shader with hundreds of
+// them, in a random order: by name (hashed at run time, as
+// SetFloat(std::string) does), by a hash worked out ahead
+// (SHADER_NAME, or GetVariableHandle once), and through a
+// std::unordered_map<std::string> for comparison, with what
+// each takes in memory.  With a WARP device, the same goes
+// through a shader's SetFloat4 by name and by handle
+// --------------------------------------------------------
+BENCHMARK(ShaderNameTableLookups)
+{
+	unsigned int variableCount = (unsigned int)GetBenchmarkParameter("variables", 500);
+	unsigned int lookups = (unsigned int)GetBenchmarkParameter("lookups", 1000000);
+	std::vector<std::string> names = MakeLongNames(variableCount);
+	std::vector<ShaderNameHash> hashes(variableCount);
+	for (unsigned int i = 0; i < variableCount; i++)
+		hashes[i] = HashShaderName(names[i]);
+
+	std::vector<unsigned int> order(lookups);
+	unsigned int seed = 12345;
+	for (unsigned int i = 0; i < lookups; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		order[i] = (seed >> 8) % variableCount;
+	}
+
+	ShaderNameTable table;
+	table.Reserve(variableCount);
+	for (unsigned int i = 0; i < variableCount; i++)
+		table.Insert(hashes[i], i);
+
+	size_t mapStart = countedBytes;
+	CountedNameMap map;
+	for (unsigned int i = 0; i < variableCount; i++)
+		map.insert(std::make_pair(names[i], i));
+	size_t mapBytes = countedBytes - mapStart;
+	for (CountedNameMap::const_iterator it = map.begin(); it != map.end(); ++it)
+		mapBytes += StringHeapBytes(it->first);
+
+	unsigned long long sum = 0;
+	double start = TestSeconds();
+	for (unsigned int i = 0; i < lookups; i++)
+		sum += table.Find(HashShaderName(names[order[i]]));
+	double byNameSeconds = TestSeconds() - start;
+
+	start = TestSeconds();
+	for (unsigned int i = 0; i < lookups; i++)
+		sum += table.Find(hashes[order[i]]);
+	double byHashSeconds = TestSeconds() - start;
+
+	start = TestSeconds();
+	for (unsigned int i = 0; i < lookups; i++)
+		sum += map.find(names[order[i]])->second;
+	double mapSeconds = TestSeconds() - start;
+
+	printf("  %u variables, %u lookups (sum %llu)\n", variableCount, lookups, sum);
+	printf("  table by name  %6.1f ns, by hash %6.1f ns, %7u bytes\n",
+		byNameSeconds * 1e9 / lookups, byHashSeconds * 1e9 / lookups, (unsigned int)table.GetFootprint());
+	printf("  unordered_map  %6.1f ns,                 %7u bytes (with the names)\n",
+		mapSeconds * 1e9 / lookups, (unsigned int)mapBytes);
+
+	// And through a shader with them all in one cbuffer
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	if (!CreateTestDevice(&device, &context))
+	{
+		printf("  no WARP device, SetFloat4 not timed\n");
+		return;
+	}
+
+	ShaderReflectionData reflection = {};
+	ReflectedConstantBuffer buffer;
+	buffer.Name = "perMaterial";
+	buffer.Type = D3D11_CT_CBUFFER;
+	buffer.Size = variableCount * 16;
+	buffer.BindIndex = 0;
+	for (unsigned int i = 0; i < variableCount; i++)
+		AddTestVariable(buffer, names[i].c_str(), i * 16, 16);
+	reflection.ConstantBuffers.push_back(buffer);
+	TestShader<SimplePixelShader>* shader = new TestShader<SimplePixelShader>(device, context, reflection);
+
+	std::vector<SimpleShaderHandle> handles(variableCount);
+	for (unsigned int i = 0; i < variableCount; i++)
+		handles[i] = shader->GetVariableHandle(hashes[i]);
+
+	unsigned int set = 0;
+	start = TestSeconds();
+	for (unsigned int i = 0; i < lookups; i++)
+		set += shader->SetFloat4(names[order[i]], DirectX::XMFLOAT4((float)i, 0, 0, 1)) ? 1 : 0;
+	double setByNameSeconds = TestSeconds() - start;
+
+	start = TestSeconds();
+	for (unsigned int i = 0; i < lookups; i++)
+		set += shader->SetFloat4(handles[order[i]], DirectX::XMFLOAT4((float)i, 0, 0, 1)) ? 1 : 0;
+	double setByHandleSeconds = TestSeconds() - start;
+
+	printf("  SetFloat4 by name %6.1f ns, by handle %6.1f ns (%u set)\n",
+		setByNameSeconds * 1e9 / lookups, setByHandleSeconds * 1e9 / lookups, set);
+
+	delete shader;
+	ReleaseTestDevice(device, context);
+}
@@ -0,0 +1,279 @@
+#include "Test.h"
+#include "TestDevice.h"
+#include "ShaderReflectionCache.h"
+
+#include <cstring>
+#include <vector>
+
+// --------------------------------------------------------
+// A made up reflection: a couple of cbuffers, a texture and
+// a sampler, for a shader of the given hash and size
+// --------------------------------------------------------
+static ShaderReflectionData MakeTestReflection(unsigned long long blobHash, unsigned long long blobSize)
+{
+	ShaderReflectionData data = {};
+	data.BlobHash = blobHash;
+	data.BlobSize = blobSize;
+
+	ReflectedConstantBuffer perObject;
+	perObject.Name = "perObject";
+	perObject.Type = 0;
+	perObject.Size = 80;
+	perObject.BindIndex = 0;
+	ReflectedVariable world = { "world", 0, 64 };
+	ReflectedVariable tint = { "tint", 64, 16 };
+	perObject.Variables.push_back(world);
+	perObject.Variables.push_back(tint);
+	data.ConstantBuffers.push_back(perObject);
+
+	ReflectedConstantBuffer perFrame;
+	perFrame.Name = "perFrame";
+	perFrame.Type = 0;
+	perFrame.Size = 16;
+	perFrame.BindIndex = 1;
+	ReflectedVariable time = { "time", 0, 4 };
+	perFrame.Variables.push_back(time);
+	data.ConstantBuffers.push_back(perFrame);
+
+	ReflectedResource texture = { "diffuseTexture", 0 };
+	ReflectedResource sampler = { "basicSampler", 0 };
+	data.Textures.push_back(texture);
+	data.Samplers.push_back(sampler);
+	return data;
+}
+
+TEST(ShaderReflectionCacheFailedReadLeavesNothing)
+{
+	// A variable past the end of its buffer is only found after
+	// the buffers before it have been read
+	ShaderReflectionData bad = MakeTestReflection(1234, 5678);
+	bad.ConstantBuffers[1].Variables[0].ByteOffset = 64;
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(bad, bytes);
+
+	// Whatever was in the output before is gone too
+	ShaderReflectionData data = MakeTestReflection(1, 2);
+	CHECK(!ShaderReflectionCache::Read(&bytes[0], bytes.size(), 1234, 5678, &data));
+	CHECK(data.ConstantBuffers.empty());
+	CHECK(data.Textures.empty());
+	CHECK(data.Samplers.empty());
+	CHECK(data.BlobHash == 0 && data.BlobSize == 0);
+}
+
+// --------------------------------------------------------
+// Fixes up the hash at the end of a cache after its bytes
+// were changed, so only the change itself is tested
+// --------------------------------------------------------
+static void RehashCache(std::vector<unsigned char>& bytes)
+{
+	size_t size = bytes.size() - 8;
+	unsigned long long hash = ShaderReflectionCache::HashBlob(&bytes[0], size);
+	for (unsigned int i = 0; i < 8; i++)
+		bytes[size + i] = (unsigned char)(hash >> (i * 8));
+}
+
+TEST(ShaderReflectionCacheRoundTrips)
+{
+	// 64 bit FNV-1a, as anyone else would work it out
+	CHECK(ShaderReflectionCache::HashBlob("", 0) == 14695981039346656037ULL);
+	CHECK(ShaderReflectionCache::HashBlob("a", 1) == 0xaf63dc4c8601ec8cULL);
+
+	ShaderReflectionData written = MakeTestReflection(0x0123456789abcdefULL, 3072);
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(written, bytes);
+
+	ShaderReflectionData read = {};
+	CHECK(ShaderReflectionCache::Read(&bytes[0], bytes.size(), 0x0123456789abcdefULL, 3072, &read));
+	CHECK(read.BlobHash == written.BlobHash && read.BlobSize == written.BlobSize);
+	CHECK(read.ConstantBuffers.size() == 2);
+	bool same = read.ConstantBuffers.size() == written.ConstantBuffers.size();
+	for (size_t b = 0; same && b < read.ConstantBuffers.size(); b++)
+	{
+		const ReflectedConstantBuffer& r = read.ConstantBuffers[b];
+		const ReflectedConstantBuffer& w = written.ConstantBuffers[b];
+		same = r.Name == w.Name && r.Type == w.Type && r.Size == w.Size &&
+			r.BindIndex == w.BindIndex && r.Variables.size() == w.Variables.size();
+		for (size_t v = 0; same && v < r.Variables.size(); v++)
+		{
+			same = r.Variables[v].Name == w.Variables[v].Name &&
+				r.Variables[v].ByteOffset == w.Variables[v].ByteOffset &&
+				r.Variables[v].Size == w.Variables[v].Size;
+		}
+	}
+	CHECK(same);
+	CHECK(read.Textures.size() == 1 && read.Textures[0].Name == "diffuseTexture");
+	CHECK(read.Samplers.size() == 1 && read.Samplers[0].Name == "basicSampler");
+}
+
+TEST(ShaderReflectionCacheRejectsTruncatedFiles)
+{
+	ShaderReflectionData written = MakeTestReflection(42, 1000);
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(written, bytes);
+
+	// Cut short anywhere, including to nothing
+	unsigned int accepted = 0;
+	ShaderReflectionData read = {};
+	for (size_t size = 0; size < bytes.size(); size++)
+		accepted += ShaderReflectionCache::Read(&bytes[0], size, 42, 1000, &read) ? 1 : 0;
+	CHECK(accepted == 0);
+
+	// Or with something after the end
+	bytes.push_back(0);
+	CHECK(!ShaderReflectionCache::Read(&bytes[0], bytes.size(), 42, 1000, &read));
+}
+
+TEST(ShaderReflectionCacheRejectsStaleShaders)
+{
+	ShaderReflectionData written = MakeTestReflection(42, 1000);
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(written, bytes);
+
+	// A rebuilt shader hashes differently, or is a different size
+	ShaderReflectionData read = {};
+	CHECK(ShaderReflectionCache::Read(&bytes[0], bytes.size(), 42, 1000, &read));
+	CHECK(!ShaderReflectionCache::Read(&bytes[0], bytes.size(), 43, 1000, &read));
+	CHECK(!ShaderReflectionCache::Read(&bytes[0], bytes.size(), 42, 1001, &read));
+}
+
+TEST(ShaderReflectionCacheRejectsOtherVersions)
+{
+	ShaderReflectionData written = MakeTestReflection(42, 1000);
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(written, bytes);
+
+	// The version follows the four byte magic.  With the hash fixed
+	// up, the version is all that's wrong
+	ShaderReflectionData read = {};
+	bytes[4] = (unsigned char)(SHADER_REFLECTION_CACHE_VERSION + 1);
+	RehashCache(bytes);
+	CHECK(!ShaderReflectionCache::Read(&bytes[0], bytes.size(), 42, 1000, &read));
+
+	bytes[4] = (unsigned char)SHADER_REFLECTION_CACHE_VERSION;
+	RehashCache(bytes);
+	CHECK(ShaderReflectionCache::Read(&bytes[0], bytes.size(), 42, 1000, &read));
+}
+
+// --------------------------------------------------------
+// A pixel shader with a cbuffer of variableCount float4s,
+// and textureCount textures each with its own sampler, all
+// of them used so none are compiled away
+// --------------------------------------------------------
+static std::string MakeStartupShader(unsigned int variableCount, unsigned int textureCount)
+{
+	std::string source = "cbuffer perMaterial : register(b0)\n{\n";
+	for (unsigned int v = 0; v < variableCount; v++)
+		source += "\tfloat4 value" + std::to_string(v) + ";\n";
+	source += "};\n";
+	for (unsigned int t = 0; t < textureCount; t++)
+	{
+		source += "Texture2D texture" + std::to_string(t) + " : register(t" + std::to_string(t) + ");\n";
+		source += "SamplerState sampler" + std::to_string(t) + " : register(s" + std::to_string(t) + ");\n";
+	}
+	source += "float4 main(float4 position : SV_POSITION) : SV_TARGET\n{\n\tfloat4 color = 0;\n";
+	for (unsigned int v = 0; v < variableCount; v++)
+		source += "\tcolor += value" + std::to_string(v) + ";\n";
+	for (unsigned int t = 0; t < textureCount; t++)
+		source += "\tcolor *= texture" + std::to_string(t) + ".Sample(sampler" + std::to_string(t) + ", position.xy);\n";
+	source += "\treturn color;\n}\n";
+	return source;
+}
+
+// --------------------------------------------------------
+// What loading shaders at startup costs with and without
+// the cache.  The cache alone (hashing the compiled shader,
+// then reading its sidecar) is timed anywhere.  With a
+// shader compiler and a WARP device, whole LoadShaderFile
+// calls are timed too: the first run's (reflecting and
+// writing the sidecar) against later runs' (reading it)
+// --------------------------------------------------------
+BENCHMARK(ShaderReflectionCacheStartup)
+{
+	unsigned int variableCount = (unsigned int)GetBenchmarkParameter("variables", 16);
+	unsigned int textureCount = (unsigned int)GetBenchmarkParameter("textures", 2);
+	unsigned int blobBytes = (unsigned int)GetBenchmarkParameter("blobBytes", 3072);
+	unsigned int loads = (unsigned int)GetBenchmarkParameter("loads", 1000);
+
+	ShaderReflectionData reflection = MakeTestReflection(0, blobBytes);
+	ReflectedConstantBuffer& perMaterial = reflection.ConstantBuffers[0];
+	perMaterial.Variables.clear();
+	perMaterial.Size = variableCount * 16;
+	for (unsigned int v = 0; v < variableCount; v++)
+	{
+		ReflectedVariable variable = { "value" + std::to_string(v), v * 16, 16 };
+		perMaterial.Variables.push_back(variable);
+	}
+	for (unsigned int t = 1; t < textureCount; t++)
+	{
+		ReflectedResource texture = { "texture" + std::to_string(t), t };
+		ReflectedResource sampler = { "sampler" + std::to_string(t), t };
+		reflection.Textures.push_back(texture);
+		reflection.Samplers.push_back(sampler);
+	}
+	std::vector<unsigned char> blob(blobBytes, 0x5A);
+	reflection.BlobHash = ShaderReflectionCache::HashBlob(&blob[0], blob.size());
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(reflection, bytes);
+
+	unsigned int readCount = 0;
+	double start = TestSeconds();
+	for (unsigned int i = 0; i < loads; i++)
+	{
+		ShaderReflectionData read;
+		unsigned long long hash = ShaderReflectionCache::HashBlob(&blob[0], blob.size());
+		readCount += ShaderReflectionCache::Read(&bytes[0], bytes.size(), hash, blob.size(), &read) ? 1 : 0;
+	}
+	double cacheSeconds = (TestSeconds() - start) / loads;
+	printf("  %u variables, %u textures: %u byte sidecar, hashed and read in %.2f us (%u of %u read)\n",
+		variableCount, textureCount, (unsigned int)bytes.size(), cacheSeconds * 1e6, readCount, loads);
+
+	// The same shader for real, if it can be compiled
+	std::string source = MakeStartupShader(variableCount, textureCount);
+	ID3DBlob* shaderBlob = 0;
+	ID3DBlob* errors = 0;
+	HRESULT hr = D3DCompile(source.c_str(), source.size(), "startup", 0, 0, "main", "ps_5_0", 0, 0, &shaderBlob, &errors);
+	if (errors) errors->Release();
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	if (FAILED(hr) || !CreateTestDevice(&device, &context))
+	{
+		printf("  no shader compiler or WARP device, LoadShaderFile not timed\n");
+		if (shaderBlob) shaderBlob->Release();
+		return;
+	}
+
+	std::string shaderFile = GetTempTestFile("startup.cso");
+	std::string cacheFile = shaderFile + ".refl";
+	std::wstring wideShaderFile(shaderFile.begin(), shaderFile.end());
+	D3DWriteBlobToFile(shaderBlob, wideShaderFile.c_str(), TRUE);
+	shaderBlob->Release();
+
+	// Whole loads take far longer, so there are fewer.  Every
+	// first run starts without the sidecar
+	loads = loads / 10 + 1;
+	start = TestSeconds();
+	for (unsigned int i = 0; i < loads; i++)
+	{
+		remove(cacheFile.c_str());
+		SimplePixelShader* shader = new SimplePixelShader(device, context);
+		shader->LoadShaderFile(wideShaderFile.c_str());
+		delete shader;
+	}
+	double reflectSeconds = (TestSeconds() - start) / loads;
+
+	start = TestSeconds();
+	for (unsigned int i = 0; i < loads; i++)
+	{
+		SimplePixelShader* shader = new SimplePixelShader(device, context);
+		shader->LoadShaderFile(wideShaderFile.c_str());
+		delete shader;
+	}
+	double cachedSeconds = (TestSeconds() - start) / loads;
+
+	printf("  LoadShaderFile: %.1f us reflecting (and writing the sidecar), %.1f us from the sidecar\n",
+		reflectSeconds * 1e6, cachedSeconds * 1e6);
+
+	remove(cacheFile.c_str());
+	remove(shaderFile.c_str());
+	ReleaseTestDevice(device, context);
+}
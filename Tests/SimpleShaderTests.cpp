@@ -0,0 +1,248 @@
+#include "Test.h"
+#include "TestDevice.h"
+#include "SimpleShader.h"
+#include "ConstantBufferRing.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// One 96 byte cbuffer: a matrix, a float4 and a float
+// --------------------------------------------------------
+static ShaderReflectionData MakePerObjectReflection()
+{
+	ShaderReflectionData reflection = {};
+	ReflectedConstantBuffer buffer;
+	buffer.Name = "perObject";
+	buffer.Type = D3D11_CT_CBUFFER;
+	buffer.Size = 96;
+	buffer.BindIndex = 0;
+	AddTestVariable(buffer, "world", 0, 64);
+	AddTestVariable(buffer, "tint", 64, 16);
+	AddTestVariable(buffer, "time", 80, 4);
+	reflection.ConstantBuffers.push_back(buffer);
+	return reflection;
+}
+
+TEST(SimpleShaderOnlyUploadsChangedBuffers)
+{
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	if (!CreateTestDevice(&device, &context))
+	{
+		printf("  no WARP device, skipped\n");
+		return;
+	}
+
+	ISimpleShader::SetConstantBufferRing(0);
+	TestShader<SimpleVertexShader>* shader = new TestShader<SimpleVertexShader>(device, context, MakePerObjectReflection());
+	const SimpleConstantBuffer* cb = shader->GetBufferInfo(0);
+
+	// Nothing's on the GPU yet, so all of it goes first
+	CHECK(cb->Dirty && cb->DirtyStart == 0 && cb->DirtyEnd == 96);
+	ISimpleShader::ResetUploadStats();
+	shader->CopyAllBufferData();
+	CHECK(!cb->Dirty);
+	CHECK(ISimpleShader::GetUploadStats().Uploads == 1);
+	CHECK(ISimpleShader::GetUploadStats().BytesUploaded == 96);
+	CHECK(ISimpleShader::GetUploadStats().DirtyBytes == 96);
+
+	// Copying again, or setting what's already there, sends nothing
+	shader->CopyAllBufferData();
+	CHECK(shader->SetFloat("time", 0.0f));
+	CHECK(!cb->Dirty);
+	shader->CopyAllBufferData();
+	CHECK(ISimpleShader::GetUploadStats().Uploads == 1);
+	CHECK(ISimpleShader::GetUploadStats().SkippedUploads == 2);
+
+	// The dirty range grows to cover each change, in either direction
+	CHECK(shader->SetFloat4("tint", XMFLOAT4(1, 0.5f, 0.25f, 1)));
+	CHECK(cb->Dirty && cb->DirtyStart == 64 && cb->DirtyEnd == 80);
+	CHECK(shader->SetFloat("time", 2.0f));
+	CHECK(cb->DirtyStart == 64 && cb->DirtyEnd == 84);
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixTranslation(1, 2, 3));
+	CHECK(shader->SetMatrix4x4("world", world));
+	CHECK(cb->DirtyStart == 0 && cb->DirtyEnd == 84);
+
+	// And writing the same tint again doesn't shrink or move it
+	CHECK(shader->SetFloat4("tint", XMFLOAT4(1, 0.5f, 0.25f, 1)));
+	CHECK(cb->DirtyStart == 0 && cb->DirtyEnd == 84);
+	CHECK(memcmp(cb->LocalDataBuffer, &world, sizeof(world)) == 0);
+
+	shader->CopyAllBufferData();
+	CHECK(!cb->Dirty);
+	CHECK(ISimpleShader::GetUploadStats().Uploads == 2);
+	CHECK(ISimpleShader::GetUploadStats().BytesUploaded == 96 * 2);
+	CHECK(ISimpleShader::GetUploadStats().DirtyBytes == 96 + 84);
+	CHECK(ISimpleShader::GetUploadStats().SkippedUploads == 2);
+
+	// Sizes that don't match the variable are refused, and change nothing
+	CHECK(!shader->SetFloat("tint", 3.0f));
+	CHECK(!cb->Dirty);
+
+	delete shader;
+	ReleaseTestDevice(device, context);
+}
+
+// --------------------------------------------------------
+// A shader with just a "perFrame" cbuffer of two matrices
+// --------------------------------------------------------
+static ShaderReflectionData MakePerFrameReflection(const char* first, unsigned int firstOffset,
+	const char* second, unsigned int secondOffset)
+{
+	ShaderReflectionData reflection = {};
+	ReflectedConstantBuffer buffer;
+	buffer.Name = "perFrame";
+	buffer.Type = D3D11_CT_CBUFFER;
+	buffer.Size = 128;
+	buffer.BindIndex = 1;
+	AddTestVariable(buffer, first, firstOffset, 64);
+	AddTestVariable(buffer, second, secondOffset, 64);
+	reflection.ConstantBuffers.push_back(buffer);
+	return reflection;
+}
+
+TEST(SharedConstantBufferNeedsTheSameLayout)
+{
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	if (!CreateTestDevice(&device, &context))
+	{
+		printf("  no WARP device, skipped\n");
+		return;
+	}
+
+	SimpleSharedConstantBuffer* perFrame = new SimpleSharedConstantBuffer(device, context, "perFrame");
+	TestShader<SimpleVertexShader>* first = new TestShader<SimpleVertexShader>(device, context,
+		MakePerFrameReflection("view", 0, "projection", 64));
+	TestShader<SimpleVertexShader>* same = new TestShader<SimpleVertexShader>(device, context,
+		MakePerFrameReflection("view", 0, "projection", 64));
+	TestShader<SimpleVertexShader>* swapped = new TestShader<SimpleVertexShader>(device, context,
+		MakePerFrameReflection("projection", 0, "view", 64));
+	TestShader<SimpleVertexShader>* renamed = new TestShader<SimpleVertexShader>(device, context,
+		MakePerFrameReflection("view", 0, "viewProjection", 64));
+
+	// Only the same names at the same offsets share
+	CHECK(perFrame->HasLayout());
+	CHECK(first->GetBufferInfo(0)->Shared == perFrame);
+	CHECK(same->GetBufferInfo(0)->Shared == perFrame);
+	CHECK(swapped->GetBufferInfo(0)->Shared == 0);
+	CHECK(renamed->GetBufferInfo(0)->Shared == 0);
+	CHECK(swapped->GetBufferInfo(0)->ConstantBuffer != perFrame->GetBuffer());
+
+	// What's set through the shared buffer is what the sharing shaders
+	// see, and the others keep their own
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, XMMatrixTranslation(4, 5, 6));
+	CHECK(perFrame->SetMatrix4x4("view", view));
+	CHECK(memcmp(same->GetBufferInfo(0)->LocalDataBuffer, &view, sizeof(view)) == 0);
+	CHECK(memcmp(swapped->GetBufferInfo(0)->LocalDataBuffer + 64, &view, sizeof(view)) != 0);
+
+	delete first;
+	delete same;
+	delete swapped;
+	delete renamed;
+	delete perFrame;
+	ReleaseTestDevice(device, context);
+}
+
+// --------------------------------------------------------
+// Reads back the float at byteOffset of a cbuffer bound in
+// the ring from firstConstant, through a staging copy
+// --------------------------------------------------------
+static float ReadRingFloat(ID3D11Device* device, ID3D11DeviceContext* context, ConstantBufferRing* ring,
+	unsigned int firstConstant, unsigned int byteOffset)
+{
+	D3D11_BUFFER_DESC desc;
+	ring->GetBuffer()->GetDesc(&desc);
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	ID3D11Buffer* staging = 0;
+	if (FAILED(device->CreateBuffer(&desc, 0, &staging)))
+		return -1.0f;
+
+	float value = -1.0f;
+	context->CopyResource(staging, ring->GetBuffer());
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(context->Map(staging, 0, D3D11_MAP_READ, 0, &mapped)))
+	{
+		memcpy(&value, (unsigned char*)mapped.pData + firstConstant * 16 + byteOffset, sizeof(value));
+		context->Unmap(staging, 0);
+	}
+	staging->Release();
+	return value;
+}
+
+// Whether the vertex shader stage's cbuffer 0 is bound to a shader's range in the ring
+static bool VertexRangeBound(ConstantBufferRing* ring, const SimpleConstantBuffer* cb)
+{
+	ID3D11Buffer* buffer = 0;
+	unsigned int first = 0;
+	unsigned int count = 0;
+	ring->GetContext1()->VSGetConstantBuffers1(0, 1, &buffer, &first, &count);
+	if (buffer) buffer->Release();
+	return buffer == ring->GetBuffer() && first == cb->RingFirstConstant && count == cb->RingConstantCount;
+}
+
+TEST(ConstantBufferRingDiscardKeepsShadersData)
+{
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	if (!CreateTestDevice(&device, &context))
+	{
+		printf("  no WARP device, skipped\n");
+		return;
+	}
+
+	// Room for four cbuffers
+	ConstantBufferRing* ring = new ConstantBufferRing(device, context, 1024);
+	if (!ring->IsSupported())
+	{
+		printf("  no constant buffer offsetting, skipped\n");
+		delete ring;
+		ReleaseTestDevice(device, context);
+		return;
+	}
+	ISimpleShader::SetConstantBufferRing(ring);
+
+	// One vertex shader set on its stage, one only uploaded, and a
+	// pixel shader that then writes until the ring's discarded
+	TestShader<SimpleVertexShader>* bound = new TestShader<SimpleVertexShader>(device, context, MakePerObjectReflection());
+	TestShader<SimpleVertexShader>* unbound = new TestShader<SimpleVertexShader>(device, context, MakePerObjectReflection());
+	TestShader<SimplePixelShader>* filler = new TestShader<SimplePixelShader>(device, context, MakePerObjectReflection());
+	CHECK(bound->SetFloat("time", 1.0f));
+	bound->CopyAllBufferData();
+	bound->SetShader();
+	CHECK(unbound->SetFloat("time", 2.0f));
+	unbound->CopyAllBufferData();
+	filler->SetShader();
+	for (unsigned int i = 0; i < 8 && ring->GetDiscardCount() == 0; i++)
+	{
+		CHECK(filler->SetFloat("time", 10.0f + i));
+		filler->CopyAllBufferData();
+	}
+	CHECK(ring->GetDiscardCount() == 1);
+
+	// The bound shader was written again and rebound, with no copy of its own
+	const SimpleConstantBuffer* cb = bound->GetBufferInfo(0);
+	CHECK(cb->RingEpoch == ring->GetEpoch());
+	CHECK(VertexRangeBound(ring, cb));
+	CHECK(ReadRingFloat(device, context, ring, cb->RingFirstConstant, 80) == 1.0f);
+
+	// The other one goes again when it's set
+	unbound->SetShader();
+	cb = unbound->GetBufferInfo(0);
+	CHECK(cb->RingEpoch == ring->GetEpoch());
+	CHECK(VertexRangeBound(ring, cb));
+	CHECK(ReadRingFloat(device, context, ring, cb->RingFirstConstant, 80) == 2.0f);
+
+	ISimpleShader::SetConstantBufferRing(0);
+	delete bound;
+	delete unbound;
+	delete filler;
+	delete ring;
+	ReleaseTestDevice(device, context);
+}
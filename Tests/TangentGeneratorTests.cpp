@@ -0,0 +1,234 @@
+#include "Test.h"
+#include "TangentGenerator.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// The same tangents, one float at a time - what
+// TangentGenerator's vector math has to agree with
+// --------------------------------------------------------
+static void GenerateScalarTangents(Vertex* verts, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount)
+{
+	std::vector<XMFLOAT3> tangents(vertexCount, XMFLOAT3(0, 0, 0));
+	std::vector<XMFLOAT3> bitangents(vertexCount, XMFLOAT3(0, 0, 0));
+	for (unsigned int i = 0; i < indexCount; i += 3)
+	{
+		const Vertex& v1 = verts[indices[i]];
+		const Vertex& v2 = verts[indices[i + 1]];
+		const Vertex& v3 = verts[indices[i + 2]];
+
+		float x1 = v2.Position.x - v1.Position.x;
+		float y1 = v2.Position.y - v1.Position.y;
+		float z1 = v2.Position.z - v1.Position.z;
+		float x2 = v3.Position.x - v1.Position.x;
+		float y2 = v3.Position.y - v1.Position.y;
+		float z2 = v3.Position.z - v1.Position.z;
+
+		float s1 = v2.UV.x - v1.UV.x;
+		float t1 = v2.UV.y - v1.UV.y;
+		float s2 = v3.UV.x - v1.UV.x;
+		float t2 = v3.UV.y - v1.UV.y;
+
+		float det = s1 * t2 - s2 * t1;
+		if (fabsf(det) <= 1e-20f)
+			continue;
+		float r = 1.0f / det;
+
+		for (int c = 0; c < 3; c++)
+		{
+			XMFLOAT3& t = tangents[indices[i + c]];
+			t.x += (t2 * x1 - t1 * x2) * r;
+			t.y += (t2 * y1 - t1 * y2) * r;
+			t.z += (t2 * z1 - t1 * z2) * r;
+
+			XMFLOAT3& b = bitangents[indices[i + c]];
+			b.x += (s1 * x2 - s2 * x1) * r;
+			b.y += (s1 * y2 - s2 * y1) * r;
+			b.z += (s1 * z2 - s2 * z1) * r;
+		}
+	}
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const XMFLOAT3& n = verts[i].Normal;
+		XMFLOAT3 t = tangents[i];
+		const XMFLOAT3& b = bitangents[i];
+
+		// Gram-Schmidt orthogonalize, then normalize
+		float d = n.x * t.x + n.y * t.y + n.z * t.z;
+		t.x -= n.x * d;
+		t.y -= n.y * d;
+		t.z -= n.z * d;
+		float length = sqrtf(t.x * t.x + t.y * t.y + t.z * t.z);
+		t.x /= length;
+		t.y /= length;
+		t.z /= length;
+
+		// Handedness is the side of cross(N, T) the bitangent is on
+		float cx = n.y * t.z - n.z * t.y;
+		float cy = n.z * t.x - n.x * t.z;
+		float cz = n.x * t.y - n.y * t.x;
+		float w = cx * b.x + cy * b.y + cz * b.z < 0.0f ? -1.0f : 1.0f;
+
+		verts[i].Tangent = XMFLOAT4(t.x, t.y, t.z, w);
+	}
+}
+
+// --------------------------------------------------------
+// A bumpy grid of size x size quads whose right half has
+// its UVs mirrored (like a symmetric character's texture)
+// --------------------------------------------------------
+static void MakeTangentGrid(unsigned int size, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	unsigned int row = size + 1;
+	verts.resize(row * row);
+	for (unsigned int y = 0; y < row; y++)
+	{
+		for (unsigned int x = 0; x < row; x++)
+		{
+			// z = sin(0.3x) * cos(0.2y), and its normal
+			float z = sinf(x * 0.3f) * cosf(y * 0.2f);
+			float dx = 0.3f * cosf(x * 0.3f) * cosf(y * 0.2f);
+			float dy = -0.2f * sinf(x * 0.3f) * sinf(y * 0.2f);
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(dx, dy, -1, 0)));
+
+			float u = x <= size / 2 ? (float)x : (float)(size - x);
+			Vertex& v = verts[y * row + x];
+			v.Position = XMFLOAT3((float)x, (float)y, z);
+			v.UV = XMFLOAT2(u / size, 1.0f - (float)y / size);
+			v.Normal = normal;
+		}
+	}
+
+	indices.clear();
+	indices.reserve(size * size * 6);
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int v = y * row + x;
+			unsigned int quad[6] = { v, v + row, v + 1, v + 1, v + row, v + row + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+// Largest difference between two sets of tangents (any w mismatch is 2)
+static float MaxTangentDifference(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+{
+	float worst = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		float d = fmaxf(fmaxf(fabsf(a[i].Tangent.x - b[i].Tangent.x), fabsf(a[i].Tangent.y - b[i].Tangent.y)),
+			fmaxf(fabsf(a[i].Tangent.z - b[i].Tangent.z), fabsf(a[i].Tangent.w - b[i].Tangent.w)));
+		worst = fmaxf(worst, d);
+	}
+	return worst;
+}
+
+TEST(TangentGeneratorFlipsMirroredUVs)
+{
+	// A quad facing -z, once with u along +x and once with it mirrored
+	Vertex quad[4] = {};
+	quad[0].Position = XMFLOAT3(0, 0, 0);
+	quad[1].Position = XMFLOAT3(1, 0, 0);
+	quad[2].Position = XMFLOAT3(0, 1, 0);
+	quad[3].Position = XMFLOAT3(1, 1, 0);
+	unsigned int indices[6] = { 0, 2, 1, 1, 2, 3 };
+
+	for (int mirrored = 0; mirrored < 2; mirrored++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			float u = quad[i].Position.x;
+			quad[i].UV = XMFLOAT2(mirrored ? 1.0f - u : u, 1.0f - quad[i].Position.y);
+			quad[i].Normal = XMFLOAT3(0, 0, -1);
+		}
+		TangentGenerator::Generate(quad, 4, indices, 6);
+
+		// The tangent follows u, and w says the bitangent (down the
+		// texture, so -y) is now on the other side of cross(N, T)
+		float direction = mirrored ? -1.0f : 1.0f;
+		for (int i = 0; i < 4; i++)
+		{
+			CHECK(fabsf(quad[i].Tangent.x - direction) < 1e-5f);
+			CHECK(fabsf(quad[i].Tangent.y) < 1e-5f);
+			CHECK(fabsf(quad[i].Tangent.z) < 1e-5f);
+			CHECK(quad[i].Tangent.w == direction);
+		}
+	}
+}
+
+TEST(TangentGeneratorMatchesScalarTangents)
+{
+	// Big enough for four threads to each get a share
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	MakeTangentGrid(200, verts, indices);
+
+	std::vector<Vertex> scalar = verts;
+	GenerateScalarTangents(&scalar[0], (unsigned int)scalar.size(), &indices[0], (unsigned int)indices.size());
+
+	// Both sides of the mirror seam show up
+	unsigned int mirroredCount = 0;
+	for (size_t i = 0; i < scalar.size(); i++)
+		mirroredCount += scalar[i].Tangent.w < 0.0f;
+	CHECK(mirroredCount > 0 && mirroredCount < scalar.size());
+
+	// Threads only change the order the sums are added in
+	unsigned int threadCounts[2] = { 1, 4 };
+	for (int t = 0; t < 2; t++)
+	{
+		std::vector<Vertex> simd = verts;
+		TangentGenerator::Generate(&simd[0], (unsigned int)simd.size(), &indices[0], (unsigned int)indices.size(), threadCounts[t]);
+		CHECK(MaxTangentDifference(simd, scalar) < 1e-4f);
+	}
+}
+
+BENCHMARK(TangentGeneratorMillionTriangles)
+{
+	unsigned int triangles = (unsigned int)GetBenchmarkParameter("triangles", 1000000);
+	unsigned int maxThreads = (unsigned int)GetBenchmarkParameter("threads", std::thread::hardware_concurrency());
+	unsigned int runs = (unsigned int)GetBenchmarkParameter("runs", 5);
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	MakeTangentGrid((unsigned int)sqrt(triangles / 2.0), verts, indices);
+	unsigned int vertexCount = (unsigned int)verts.size();
+	unsigned int indexCount = (unsigned int)indices.size();
+
+	// Best of a few runs, each on a fresh copy of the vertices
+	std::vector<Vertex> scalar;
+	double scalarSeconds = 1e30;
+	for (unsigned int r = 0; r < runs; r++)
+	{
+		scalar = verts;
+		double start = TestSeconds();
+		GenerateScalarTangents(&scalar[0], vertexCount, &indices[0], indexCount);
+		scalarSeconds = fmin(scalarSeconds, TestSeconds() - start);
+	}
+	printf("  %u triangles, scalar:    %8.3f ms\n", indexCount / 3, scalarSeconds * 1000.0);
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		std::vector<Vertex> simd;
+		double seconds = 1e30;
+		for (unsigned int r = 0; r < runs; r++)
+		{
+			simd = verts;
+			double start = TestSeconds();
+			TangentGenerator::Generate(&simd[0], vertexCount, &indices[0], indexCount, threads);
+			seconds = fmin(seconds, TestSeconds() - start);
+		}
+		printf("  %u triangles, %2u threads: %8.3f ms (%.2fx), max difference %g\n",
+			indexCount / 3, threads, seconds * 1000.0, scalarSeconds / seconds, MaxTangentDifference(simd, scalar));
+	}
+}
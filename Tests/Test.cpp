@@ -0,0 +1,150 @@
+#include "Test.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+struct RegisteredTest
+{
+	const char* Name;
+	TestFunction Function;
+	bool Benchmark;
+};
+
+// Filled in before main(), in whatever order the files are linked
+static std::vector<RegisteredTest>& GetRegisteredTests()
+{
+	static std::vector<RegisteredTest> tests;
+	return tests;
+}
+
+static int failureCount = 0;
+static int testArgumentCount = 0;
+static char** testArguments = 0;
+
+TestRegistration::TestRegistration(const char* name, TestFunction function, bool benchmark)
+{
+	RegisteredTest test = { name, function, benchmark };
+	GetRegisteredTests().push_back(test);
+}
+
+void TestFailed(const char* file, int line, const char* expression)
+{
+	printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	failureCount++;
+}
+
+int RunTests(bool benchmarks, const char* filter)
+{
+	std::vector<RegisteredTest>& tests = GetRegisteredTests();
+	int run = 0;
+	int failedTests = 0;
+	for (size_t t = 0; t < tests.size(); t++)
+	{
+		if (tests[t].Benchmark != benchmarks)
+			continue;
+		if (filter && !strstr(tests[t].Name, filter))
+			continue;
+
+		printf("%s\n", tests[t].Name);
+		fflush(stdout);
+		int failuresBefore = failureCount;
+		tests[t].Function();
+		if (failureCount != failuresBefore)
+			failedTests++;
+		run++;
+	}
+
+	printf("%d %s run, %d failed (%d failed checks)\n",
+		run, benchmarks ? "benchmarks" : "tests", failedTests, failureCount);
+	return failureCount;
+}
+
+void SetTestArguments(int argc, char* argv[])
+{
+	testArgumentCount = argc;
+	testArguments = argv;
+}
+
+double TestSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string FindTestFile(const std::string& name)
+{
+	static const char* folders[] =
+	{
+		"OBJ Files/",
+		"../OBJ Files/",
+		"../../OBJ Files/",
+		"../../../OBJ Files/",
+	};
+
+	for (size_t f = 0; f < sizeof(folders) / sizeof(folders[0]); f++)
+	{
+		std::string path = std::string(folders[f]) + name;
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file)
+		{
+			fclose(file);
+			return path;
+		}
+	}
+	return name;
+}
+
+std::string GetTempTestFile(const std::string& name)
+{
+#if defined(_WIN32)
+	const char* folder = getenv("TEMP");
+	if (!folder) folder = ".";
+	return std::string(folder) + "\\DX11StarterTests_" + name;
+#else
+	const char* folder = getenv("TMPDIR");
+	if (!folder) folder = "/tmp";
+	return std::string(folder) + "/DX11StarterTests_" + name;
+#endif
+}
+
+size_t GetResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+#else
+	// The second number is the resident set, in pages
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+	unsigned long totalPages = 0, residentPages = 0;
+	int read = fscanf(file, "%lu %lu", &totalPages, &residentPages);
+	fclose(file);
+	return read == 2 ? (size_t)residentPages * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+unsigned long long GetBenchmarkParameter(const char* name, unsigned long long defaultValue)
+{
+	size_t nameLength = strlen(name);
+	for (int a = 1; a < testArgumentCount; a++)
+	{
+		const char* argument = testArguments[a];
+		if (strncmp(argument, "--", 2) == 0 &&
+			strncmp(argument + 2, name, nameLength) == 0 &&
+			argument[2 + nameLength] == '=')
+			return strtoull(argument + 3 + nameLength, 0, 10);
+	}
+	return defaultValue;
+}
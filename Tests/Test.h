@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+// --------------------------------------------------------
+// A very small test runner.  Each TEST and BENCHMARK is a
+// function registered before main() runs.  Tests CHECK what
+// they expect, and a failed CHECK is reported and counted
+// (the test carries on).  Benchmarks print what they time
+//
+//   TEST(WeldKeepsTriangles) { CHECK(count == 8); }
+//
+// Tests and benchmarks only use the modules they're about
+// (no window, and no GPU unless TestDevice.h finds one)
+// --------------------------------------------------------
+typedef void (*TestFunction)();
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, TestFunction function, bool benchmark);
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, true); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) TestFailed(__FILE__, __LINE__, #condition); } while (0)
+
+void TestFailed(const char* file, int line, const char* expression);
+
+// Runs every test (or benchmark) whose name contains filter,
+// and returns how many CHECKs failed
+int RunTests(bool benchmarks, const char* filter);
+
+// Keeps the command line for GetBenchmarkParameter
+void SetTestArguments(int argc, char* argv[]);
+
+// Seconds since some fixed point, for timing benchmarks
+double TestSeconds();
+
+// The path of a file in "OBJ Files", from wherever the tests
+// are run (the repo, the solution's output folders, ...)
+std::string FindTestFile(const std::string& name);
+
+// A file the tests can write and then delete
+std::string GetTempTestFile(const std::string& name);
+
+// Bytes of the process's memory that are in RAM right now
+size_t GetResidentBytes();
+
+// Lets a benchmark's size be changed from the command line
+// (--name=value), or it's defaultValue
+unsigned long long GetBenchmarkParameter(const char* name, unsigned long long defaultValue);
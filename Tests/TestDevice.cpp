@@ -0,0 +1,40 @@
+#include "TestDevice.h"
+
+bool CreateTestDevice(ID3D11Device** device, ID3D11DeviceContext** context)
+{
+	*device = 0;
+	*context = 0;
+	HRESULT hr = D3D11CreateDevice(
+		0,						// Default adapter (ignored for WARP)
+		D3D_DRIVER_TYPE_WARP,	// Software rendering, so no GPU is needed
+		0,
+		0,
+		0,
+		0,
+		D3D11_SDK_VERSION,
+		device,
+		0,
+		context);
+	if (FAILED(hr))
+	{
+		*device = 0;
+		*context = 0;
+		return false;
+	}
+	return true;
+}
+
+void ReleaseTestDevice(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+	if (context) context->Release();
+	if (device) device->Release();
+}
+
+void AddTestVariable(ReflectedConstantBuffer& buffer, const char* name, unsigned int byteOffset, unsigned int size)
+{
+	ReflectedVariable variable;
+	variable.Name = name;
+	variable.ByteOffset = byteOffset;
+	variable.Size = size;
+	buffer.Variables.push_back(variable);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <d3d11.h>
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// A WARP (software) device, for tests of code that makes
+// D3D objects.  It needs no window or GPU, but can still
+// fail to be made, and tests that need it then skip
+// --------------------------------------------------------
+
+// Returns false (with both set to 0) if there's no device to be had
+bool CreateTestDevice(ID3D11Device** device, ID3D11DeviceContext** context);
+void ReleaseTestDevice(ID3D11Device* device, ID3D11DeviceContext* context);
+
+// --------------------------------------------------------
+// A shader with no code, whose buffers, variables and
+// resources come from reflection made up by the test, as
+// if LoadShaderFile had found them
+// --------------------------------------------------------
+template<typename Shader>
+class TestShader : public Shader
+{
+public:
+	TestShader(ID3D11Device* device, ID3D11DeviceContext* context, const ShaderReflectionData& reflection)
+		: Shader(device, context)
+	{
+		this->shaderValid = true;
+		this->CreateResources(reflection);
+	}
+};
+
+// Adds a variable to the end of a made up constant buffer
+void AddTestVariable(ReflectedConstantBuffer& buffer, const char* name, unsigned int byteOffset, unsigned int size);
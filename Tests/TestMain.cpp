@@ -0,0 +1,28 @@
+#include "Test.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// Runs the tests, or with --bench the benchmarks instead.
+// Any other argument not starting with -- picks the ones
+// whose names contain it, and --name=value arguments set
+// benchmark sizes.  Returns the number of failed checks
+//
+//   Tests.exe
+//   Tests.exe --bench Transform --entities=1000000
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	bool benchmarks = false;
+	const char* filter = 0;
+	for (int a = 1; a < argc; a++)
+	{
+		if (strcmp(argv[a], "--bench") == 0)
+			benchmarks = true;
+		else if (strncmp(argv[a], "--", 2) != 0)
+			filter = argv[a];
+	}
+
+	SetTestArguments(argc, argv);
+	return RunTests(benchmarks, filter);
+}
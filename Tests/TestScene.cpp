@@ -0,0 +1,30 @@
+#include "TestScene.h"
+
+using namespace DirectX;
+
+Mesh* CreateTestMesh()
+{
+	Vertex vertices[4] =
+	{
+		{ XMFLOAT3(-1, -1, 0), XMFLOAT2(0, 1), XMFLOAT3(0, 0, -1), XMFLOAT4(0, 0, 0, 0) },
+		{ XMFLOAT3(-1, +1, 0), XMFLOAT2(0, 0), XMFLOAT3(0, 0, -1), XMFLOAT4(0, 0, 0, 0) },
+		{ XMFLOAT3(+1, +1, 0), XMFLOAT2(1, 0), XMFLOAT3(0, 0, -1), XMFLOAT4(0, 0, 0, 0) },
+		{ XMFLOAT3(+1, -1, 0), XMFLOAT2(1, 1), XMFLOAT3(0, 0, -1), XMFLOAT4(0, 0, 0, 0) },
+	};
+	unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+	return new Mesh(vertices, 4, indices, 6, 0);
+}
+
+Material* CreateTestMaterial()
+{
+	SimpleVertexShader* vertexShader = new SimpleVertexShader(0, 0);
+	SimplePixelShader* pixelShader = new SimplePixelShader(0, 0);
+	return new Material(vertexShader, pixelShader, 0, 0, 0);
+}
+
+void DeleteTestMaterial(Material* material)
+{
+	delete material->GetVertexShader();
+	delete material->GetPixelShader();
+	delete material;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Mesh.h"
+#include "Material.h"
+
+// --------------------------------------------------------
+// Things to draw for tests of the renderers, made without
+// a device.  Shaders made with no device are never loaded,
+// so they're only good as names for what's bound
+// --------------------------------------------------------
+
+// A quad (two triangles) with its CPU side only
+Mesh* CreateTestMesh();
+
+// A material with its own (never loaded) shaders, which
+// DeleteTestMaterial cleans up along with it
+Material* CreateTestMaterial();
+void DeleteTestMaterial(Material* material);
@@ -0,0 +1,260 @@
+#include "Test.h"
+#include "TransformSystem.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// What GameEntity did before the TransformSystem: its own
+// trans/scale/rot, a matrix rebuilt (and transposed) by
+// every setter, and a general inverse for every draw
+// --------------------------------------------------------
+struct BaselineEntity
+{
+	XMFLOAT3 Trans;
+	XMFLOAT3 Scale;
+	XMFLOAT3 Rot;
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 WorldInverseTranspose;
+
+	void Rebuild()
+	{
+		XMMATRIX scaling = XMMatrixScaling(Scale.x, Scale.y, Scale.z);
+		XMMATRIX rotation = XMMatrixRotationRollPitchYaw(Rot.x, Rot.y, Rot.z);
+		XMMATRIX translation = XMMatrixTranslation(Trans.x, Trans.y, Trans.z);
+		XMStoreFloat4x4(&World, XMMatrixTranspose(scaling * rotation * translation));
+	}
+
+	void Move(float x, float y, float z) { Trans = XMFLOAT3(x, y, z); Rebuild(); }
+	void SetScale(float x, float y, float z) { Scale = XMFLOAT3(x, y, z); Rebuild(); }
+	void Rotate(float x, float y, float z) { Rot = XMFLOAT3(x, y, z); Rebuild(); }
+
+	void PrepareMaterial()
+	{
+		XMMATRIX w = XMLoadFloat4x4(&World);
+		XMVECTOR d = XMMatrixDeterminant(w);
+		XMStoreFloat4x4(&WorldInverseTranspose, XMMatrixTranspose(XMMatrixInverse(&d, w)));
+	}
+};
+
+// Where benchmarks leave their results, so the work isn't optimized away
+static volatile float transformSink;
+
+static bool NearlyEqual(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			if (fabsf(a.m[r][c] - b.m[r][c]) > 1e-4f * (1.0f + fabsf(b.m[r][c])))
+				return false;
+	return true;
+}
+
+// The (not transposed) local matrix the system should build
+static XMMATRIX ReferenceLocal(const XMFLOAT3& position, const XMFLOAT3& rotation, const XMFLOAT3& scale)
+{
+	return XMMatrixScaling(scale.x, scale.y, scale.z) *
+		XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) *
+		XMMatrixTranslation(position.x, position.y, position.z);
+}
+
+static bool MatchesReference(TransformSystem& transforms, TransformHandle handle, FXMMATRIX world)
+{
+	XMFLOAT4X4 expectedWorld;
+	XMFLOAT4X4 expectedInverseTranspose;
+	XMStoreFloat4x4(&expectedWorld, XMMatrixTranspose(world));
+	XMStoreFloat4x4(&expectedInverseTranspose, XMMatrixInverse(0, world));
+	return NearlyEqual(*transforms.GetWorldMatrix(handle), expectedWorld) &&
+		NearlyEqual(*transforms.GetWorldInverseTranspose(handle), expectedInverseTranspose);
+}
+
+TEST(TransformSystemMatchesReferenceMatrices)
+{
+	// A chain of three, plus some roots so the chain spans batches
+	TransformSystem transforms;
+	std::vector<TransformHandle> roots;
+	for (int i = 0; i < 6; i++)
+		roots.push_back(transforms.Create());
+	TransformHandle parent = transforms.Create();
+	TransformHandle child = transforms.Create();
+	TransformHandle grandchild = transforms.Create();
+	CHECK(transforms.SetParent(child, parent));
+	CHECK(transforms.SetParent(grandchild, child));
+	CHECK(!transforms.SetParent(parent, grandchild));
+
+	XMFLOAT3 parentPos(1, 2, 3), parentRot(0.3f, 0.2f, 0.1f), parentScale(2, 2, 2);
+	XMFLOAT3 childPos(0, 1, 0), childRot(0, 1.0f, 0), childScale(1, 3, 1);
+	XMFLOAT3 grandPos(-1, 0, 4), grandRot(0.5f, 0, -0.4f), grandScale(0.5f, 0.5f, 2);
+	transforms.SetPosition(parent, parentPos.x, parentPos.y, parentPos.z);
+	transforms.SetRotation(parent, parentRot.x, parentRot.y, parentRot.z);
+	transforms.SetScale(parent, parentScale.x, parentScale.y, parentScale.z);
+	transforms.SetPosition(child, childPos.x, childPos.y, childPos.z);
+	transforms.SetRotation(child, childRot.x, childRot.y, childRot.z);
+	transforms.SetScale(child, childScale.x, childScale.y, childScale.z);
+	transforms.SetPosition(grandchild, grandPos.x, grandPos.y, grandPos.z);
+	transforms.SetRotation(grandchild, grandRot.x, grandRot.y, grandRot.z);
+	transforms.SetScale(grandchild, grandScale.x, grandScale.y, grandScale.z);
+	transforms.UpdateWorldMatrices();
+
+	XMMATRIX parentWorld = ReferenceLocal(parentPos, parentRot, parentScale);
+	XMMATRIX childWorld = ReferenceLocal(childPos, childRot, childScale) * parentWorld;
+	XMMATRIX grandWorld = ReferenceLocal(grandPos, grandRot, grandScale) * childWorld;
+	CHECK(MatchesReference(transforms, parent, parentWorld));
+	CHECK(MatchesReference(transforms, child, childWorld));
+	CHECK(MatchesReference(transforms, grandchild, grandWorld));
+	CHECK(MatchesReference(transforms, roots[0], XMMatrixIdentity()));
+
+	// Moving only the top of the chain still carries down to the bottom
+	parentPos = XMFLOAT3(-5, 0, 1);
+	transforms.SetPosition(parent, parentPos.x, parentPos.y, parentPos.z);
+	transforms.UpdateWorldMatrices();
+	parentWorld = ReferenceLocal(parentPos, parentRot, parentScale);
+	childWorld = ReferenceLocal(childPos, childRot, childScale) * parentWorld;
+	grandWorld = ReferenceLocal(grandPos, grandRot, grandScale) * childWorld;
+	CHECK(MatchesReference(transforms, child, childWorld));
+	CHECK(MatchesReference(transforms, grandchild, grandWorld));
+
+	// And the old entity path builds the same world matrix
+	BaselineEntity baseline = {};
+	baseline.Scale = grandScale;
+	baseline.Rotate(grandRot.x, grandRot.y, grandRot.z);
+	baseline.Move(grandPos.x, grandPos.y, grandPos.z);
+	XMFLOAT4X4 grandLocal;
+	XMStoreFloat4x4(&grandLocal, XMMatrixTranspose(ReferenceLocal(grandPos, grandRot, grandScale)));
+	CHECK(NearlyEqual(baseline.World, grandLocal));
+}
+
+// --------------------------------------------------------
+// Per-frame update of count entities, the way Game::Update
+// moves one (Move, Scale, Rotate, Move), then reading the
+// matrices each draw needs.  Old path vs TransformSystem
+// --------------------------------------------------------
+static void TimeEntityUpdates(unsigned int count, unsigned int frames)
+{
+	// The old entities were each allocated on their own
+	std::vector<BaselineEntity*> entities(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		entities[i] = new BaselineEntity();
+		entities[i]->Scale = XMFLOAT3(1, 1, 1);
+		entities[i]->Rebuild();
+	}
+
+	float checksum = 0.0f;
+	double start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		float t = f * 0.016f;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			BaselineEntity* e = entities[i];
+			e->Move((float)i, t, 0);
+			e->SetScale(1, 1 + t, 1);
+			e->Rotate(0, t, 0);
+			e->Move((float)i, t, 1);
+			e->PrepareMaterial();
+			checksum += e->WorldInverseTranspose.m[3][3];
+		}
+	}
+	double baselineSeconds = (TestSeconds() - start) / frames;
+
+	for (unsigned int i = 0; i < count; i++)
+		delete entities[i];
+	entities.clear();
+
+	TransformSystem transforms;
+	std::vector<TransformHandle> handles(count);
+	for (unsigned int i = 0; i < count; i++)
+		handles[i] = transforms.Create();
+	transforms.UpdateWorldMatrices();
+
+	start = TestSeconds();
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		float t = f * 0.016f;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			transforms.SetPosition(handles[i], (float)i, t, 0);
+			transforms.SetScale(handles[i], 1, 1 + t, 1);
+			transforms.SetRotation(handles[i], 0, t, 0);
+			transforms.SetPosition(handles[i], (float)i, t, 1);
+		}
+		transforms.UpdateWorldMatrices();
+		for (unsigned int i = 0; i < count; i++)
+			checksum += transforms.GetWorldInverseTranspose(handles[i])->m[3][3] + transforms.GetWorldMatrix(handles[i])->m[3][3];
+	}
+	double systemSeconds = (TestSeconds() - start) / frames;
+
+	transformSink = checksum;
+	printf("  %8u entities: old path %8.3f ms, TransformSystem %8.3f ms a frame (%.1fx)\n",
+		count, baselineSeconds * 1000.0, systemSeconds * 1000.0, baselineSeconds / systemSeconds);
+}
+
+BENCHMARK(TransformSystemEntityUpdate)
+{
+	unsigned int frames = (unsigned int)GetBenchmarkParameter("frames", 5);
+	unsigned int count = (unsigned int)GetBenchmarkParameter("entities", 0);
+	if (count)
+	{
+		TimeEntityUpdates(count, frames);
+		return;
+	}
+
+	static const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (int c = 0; c < 3; c++)
+		TimeEntityUpdates(counts[c], frames);
+}
+
+// --------------------------------------------------------
+// Builds count transforms in groups of groupSize.  Deep
+// groups are one long chain, wide ones a root with every
+// other transform as its direct child
+// --------------------------------------------------------
+static void BuildHierarchy(TransformSystem& transforms, std::vector<TransformHandle>& handles,
+	unsigned int count, unsigned int groupSize, bool deep)
+{
+	handles.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		handles[i] = transforms.Create();
+		transforms.SetPosition(handles[i], 0.01f, 0, 0);
+		transforms.SetRotation(handles[i], 0, 0.001f, 0);
+
+		unsigned int groupStart = i - i % groupSize;
+		if (i != groupStart)
+			transforms.SetParent(handles[i], deep ? handles[i - 1] : handles[groupStart]);
+	}
+	transforms.UpdateWorldMatrices();
+}
+
+BENCHMARK(TransformSystemHierarchyPropagation)
+{
+	unsigned int count = (unsigned int)GetBenchmarkParameter("transforms", 100000);
+	unsigned int groupSize = (unsigned int)GetBenchmarkParameter("group", 1000);
+	unsigned int frames = (unsigned int)GetBenchmarkParameter("frames", 10);
+
+	for (int deep = 1; deep >= 0; deep--)
+	{
+		TransformSystem transforms;
+		std::vector<TransformHandle> handles;
+		BuildHierarchy(transforms, handles, count, groupSize, deep != 0);
+
+		// Every 100th transform, then all of them.  In a deep
+		// chain, moving one moves everything below it too
+		static const unsigned int strides[] = { 100, 1 };
+		for (int s = 0; s < 2; s++)
+		{
+			double start = TestSeconds();
+			for (unsigned int f = 0; f < frames; f++)
+			{
+				for (unsigned int i = f % strides[s]; i < count; i += strides[s])
+					transforms.SetPosition(handles[i], 0.01f, (float)f, 0);
+				transforms.UpdateWorldMatrices();
+			}
+			double seconds = (TestSeconds() - start) / frames;
+			printf("  %s, %u transforms in groups of %u, %3u%% moved: %8.3f ms a frame\n",
+				deep ? "deep" : "wide", count, groupSize, 100 / strides[s], seconds * 1000.0);
+		}
+	}
+}
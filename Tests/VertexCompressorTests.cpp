@@ -0,0 +1,86 @@
+#include "Test.h"
+#include "VertexCompressor.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// A number in [0, 1) from a fixed seed, so every run sees the same vertices
+static float NextRandom(unsigned int* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return (*seed >> 8) / 16777216.0f;
+}
+
+// A random unit vector
+static XMFLOAT3 RandomDirection(unsigned int* seed)
+{
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(
+		NextRandom(seed) - 0.5f, NextRandom(seed) - 0.5f, NextRandom(seed) - 0.5f, 0) + XMVectorSet(0, 0, 1e-3f, 0)));
+	return direction;
+}
+
+TEST(VertexCompressorRoundTripsWithinQuantization)
+{
+	// Vertices in an uneven, off-center box with UVs past [0, 1],
+	// every direction of normal and both tangent handednesses
+	unsigned int seed = 12345;
+	std::vector<Vertex> verts(4096);
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		Vertex& v = verts[i];
+		v.Position = XMFLOAT3(100.0f + NextRandom(&seed) * 20.0f, -5.0f + NextRandom(&seed) * 2.0f, NextRandom(&seed) * 0.1f);
+		v.UV = XMFLOAT2(NextRandom(&seed) * 4.0f - 1.0f, NextRandom(&seed));
+		v.Normal = RandomDirection(&seed);
+		XMFLOAT3 tangent = RandomDirection(&seed);
+		v.Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, i % 3 == 0 ? -1.0f : 1.0f);
+	}
+	unsigned int count = (unsigned int)verts.size();
+
+	VertexQuantization q;
+	VertexCompressor::ComputeQuantization(&verts[0], count, &q);
+	std::vector<CompactVertex> compactVerts(count);
+	VertexCompressor::Encode(&verts[0], count, q, &compactVerts[0]);
+
+	// Half floats in [-1, 1] round to within 2^-12, and UNORM16 to
+	// within half a step, each scaled by the mesh's range (with a
+	// little room for the float math around them)
+	XMFLOAT3 positionError(q.PositionExtent.x / 4000.0f, q.PositionExtent.y / 4000.0f, q.PositionExtent.z / 4000.0f);
+	XMFLOAT2 uvError(q.UVScale.x / 130000.0f, q.UVScale.y / 130000.0f);
+
+	// SNORM16 octahedral directions land within about 2^-14 of the
+	// original (compared as vectors - acos is too coarse this close)
+	float directionError = 1.5e-4f;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Vertex& v = verts[i];
+		Vertex d;
+		VertexCompressor::Decode(compactVerts[i], q, &d);
+
+		CHECK(fabsf(d.Position.x - v.Position.x) <= positionError.x);
+		CHECK(fabsf(d.Position.y - v.Position.y) <= positionError.y);
+		CHECK(fabsf(d.Position.z - v.Position.z) <= positionError.z);
+		CHECK(fabsf(d.UV.x - v.UV.x) <= uvError.x);
+		CHECK(fabsf(d.UV.y - v.UV.y) <= uvError.y);
+
+		XMVECTOR normal = XMVectorSubtract(XMLoadFloat3(&d.Normal), XMLoadFloat3(&v.Normal));
+		XMVECTOR tangent = XMVectorSubtract(XMLoadFloat4(&d.Tangent), XMLoadFloat4(&v.Tangent));
+		CHECK(XMVectorGetX(XMVector3Length(normal)) <= directionError);
+		CHECK(XMVectorGetX(XMVector3Length(tangent)) <= directionError);
+		CHECK(d.Tangent.w == v.Tangent.w);
+	}
+
+	// And the report Mesh prints agrees (its angles go through acos,
+	// so they can't be checked any finer than a few hundredths of a degree)
+	CompactVertexError error;
+	VertexCompressor::MeasureError(&verts[0], count, &error);
+	CHECK(error.MaxPositionError <= sqrtf(positionError.x * positionError.x +
+		positionError.y * positionError.y + positionError.z * positionError.z));
+	CHECK(error.MaxUVError <= fmaxf(uvError.x, uvError.y));
+	CHECK(error.MaxNormalError <= 0.05f && error.MaxTangentError <= 0.05f);
+	CHECK(error.FullBytes == count * sizeof(Vertex) && error.CompactBytes == count * sizeof(CompactVertex));
+	CHECK(sizeof(CompactVertex) == VertexCompressor::GetStride(VERTEX_FORMAT_COMPACT));
+}